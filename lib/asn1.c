@@ -103,36 +103,58 @@ _gss_asn1_get_length_der (const char *der, size_t der_len, size_t * len)
     }
 }
 
+/* Compute the size of the mechanism-independent token header for a
+   token with the given OID and INLEN octets of inner token data, and
+   write the header to OUT unless OUT is NULL.  This lets mechanisms
+   build their inner token in place, right after the header. */
+size_t
+_gss_encapsulate_token_header (const char *oid, size_t oidlen,
+			       size_t inlen, char *out)
+{
+  size_t oidlenlen;
+  size_t asn1len, asn1lenlen;
+  unsigned char *p = (unsigned char *) out;
+
+  _gss_asn1_length_der (oidlen, NULL, &oidlenlen);
+  asn1len = 1 + oidlenlen + oidlen + inlen;
+  _gss_asn1_length_der (asn1len, NULL, &asn1lenlen);
+
+  if (p)
+    {
+      *p++ = '\x60';
+      _gss_asn1_length_der (asn1len, p, &asn1lenlen);
+      p += asn1lenlen;
+      *p++ = '\x06';
+      _gss_asn1_length_der (oidlen, p, &oidlenlen);
+      p += oidlenlen;
+      memcpy (p, oid, oidlen);
+    }
+
+  return 1 + asn1lenlen + 1 + oidlenlen + oidlen;
+}
+
 OM_uint32
 _gss_encapsulate_token_prefix (const char *prefix, size_t prefixlen,
 			       const char *in, size_t inlen,
 			       const char *oid, OM_uint32 oidlen,
 			       void **out, size_t * outlen)
 {
-  size_t oidlenlen;
-  size_t asn1len, asn1lenlen;
-  unsigned char *p;
+  size_t hdrlen;
+  char *p;
 
   if (prefix == NULL)
     prefixlen = 0;
 
-  _gss_asn1_length_der (oidlen, NULL, &oidlenlen);
-  asn1len = 1 + oidlenlen + oidlen + prefixlen + inlen;
-  _gss_asn1_length_der (asn1len, NULL, &asn1lenlen);
+  hdrlen = _gss_encapsulate_token_header (oid, oidlen,
+					  prefixlen + inlen, NULL);
 
-  *outlen = 1 + asn1lenlen + asn1len;
+  *outlen = hdrlen + prefixlen + inlen;
   p = *out = malloc (*outlen);
   if (!p)
     return -1;
 
-  *p++ = '\x60';
-  _gss_asn1_length_der (asn1len, p, &asn1lenlen);
-  p += asn1lenlen;
-  *p++ = '\x06';
-  _gss_asn1_length_der (oidlen, p, &oidlenlen);
-  p += oidlenlen;
-  memcpy (p, oid, oidlen);
-  p += oidlen;
+  _gss_encapsulate_token_header (oid, oidlen, prefixlen + inlen, p);
+  p += hdrlen;
   if (prefixlen > 0)
     {
       memcpy (p, prefix, prefixlen);
@@ -192,7 +214,9 @@ gss_encapsulate_token (gss_const_buffer_t input_token,
   return GSS_S_COMPLETE;
 }
 
-static int
+/* Parse the mechanism-independent token header of IN.  On success,
+   OID and OUT point into IN, so nothing is copied or allocated. */
+int
 _gss_decapsulate_token (const char *in, size_t inlen,
 			char **oid, size_t * oidlen,
 			char **out, size_t * outlen)
@@ -272,6 +296,56 @@ OM_uint32
 gss_decapsulate_token (gss_const_buffer_t input_token,
 		       gss_const_OID token_oid,
 		       gss_buffer_t output_token)
+{
+  gss_buffer_desc view;
+  OM_uint32 maj_stat;
+
+  if (!output_token)
+    return GSS_S_CALL_INACCESSIBLE_WRITE;
+
+  maj_stat = gss_decapsulate_token_view (input_token, token_oid, &view);
+  if (maj_stat != GSS_S_COMPLETE)
+    return maj_stat;
+
+  output_token->length = view.length;
+  output_token->value = malloc (view.length);
+  if (!output_token->value)
+    return GSS_S_FAILURE;
+
+  memcpy (output_token->value, view.value, view.length);
+
+  return GSS_S_COMPLETE;
+}
+
+/**
+ * gss_decapsulate_token_view:
+ * @input_token: (buffer, opaque, read) Buffer with GSS-API context token.
+ * @token_oid: (Object ID, read) Expected object identifier of token.
+ * @output_token: (buffer, opaque, modify) Decapsulated token data;
+ *   points into @input_token and must not be released.
+ *
+ * Like gss_decapsulate_token(), but nothing is copied: @output_token
+ * is set to the part of @input_token that follows the
+ * mechanism-independent token header.  It remains valid for as long
+ * as @input_token does.
+ *
+ * WARNING: This function is a GNU GSS specific extension, and is not
+ * part of the official GSS API.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Indicates successful completion, and that output
+ * parameters holds correct information.
+ *
+ * `GSS_S_DEFECTIVE_TOKEN`: Means that the token failed consistency
+ * checks (e.g., OID mismatch or ASN.1 DER length errors).
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_decapsulate_token_view (gss_const_buffer_t input_token,
+			    gss_const_OID token_oid,
+			    gss_buffer_t output_token)
 {
   gss_OID_desc tmpoid;
   char *oid = NULL, *out = NULL;
@@ -296,11 +370,7 @@ gss_decapsulate_token (gss_const_buffer_t input_token,
     return GSS_S_DEFECTIVE_TOKEN;
 
   output_token->length = outlen;
-  output_token->value = malloc (outlen);
-  if (!output_token->value)
-    return GSS_S_FAILURE;
-
-  memcpy (output_token->value, out, outlen);
+  output_token->value = out;
 
   return GSS_S_COMPLETE;
 }
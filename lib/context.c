@@ -25,6 +25,118 @@
 /* _gss_find_mech */
 #include "meta.h"
 
+/* Store a new context for MECH in *CONTEXT_HANDLE, for the
+   mechanism to set up. */
+static OM_uint32
+context_new (OM_uint32 * minor_status, _gss_mech_api_t mech,
+	     gss_ctx_id_t * context_handle)
+{
+  *context_handle = calloc (sizeof (**context_handle), 1);
+  if (!*context_handle)
+    {
+      if (minor_status)
+	*minor_status = ENOMEM;
+      return GSS_S_FAILURE;
+    }
+  (*context_handle)->mech = mech->mech;
+  (*context_handle)->api = mech;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Free a context from context_new that MECH failed to set up, along
+   with whatever the mechanism attached to it. */
+static void
+context_abort (_gss_mech_api_t mech, gss_ctx_id_t * context_handle)
+{
+  mech->delete_sec_context (NULL, context_handle, GSS_C_NO_BUFFER);
+  free (*context_handle);
+  *context_handle = GSS_C_NO_CONTEXT;
+}
+
+static OM_uint32
+_gss_init_sec_context1 (OM_uint32 * minor_status,
+			const gss_cred_id_t initiator_cred_handle,
+			gss_ctx_id_t * context_handle,
+			const gss_name_t target_name,
+			const gss_OID mech_type,
+			OM_uint32 req_flags,
+			OM_uint32 time_req,
+			const gss_channel_bindings_t input_chan_bindings,
+			const gss_buffer_t input_token,
+			gss_OID * actual_mech_type,
+			gss_buffer_t output_token,
+			OM_uint32 * ret_flags, OM_uint32 * time_rec)
+{
+  OM_uint32 maj_stat;
+  _gss_mech_api_t mech;
+  int freecontext = 0;
+
+  if (output_token)
+    {
+      output_token->length = 0;
+      output_token->value = NULL;
+    }
+
+  if (ret_flags)
+    *ret_flags = 0;
+
+  if (!context_handle)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_NO_CONTEXT | GSS_S_CALL_INACCESSIBLE_READ;
+    }
+
+  if (output_token == GSS_C_NO_BUFFER)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_FAILURE | GSS_S_CALL_BAD_STRUCTURE;
+    }
+
+  if (*context_handle == GSS_C_NO_CONTEXT)
+    mech = _gss_find_mech (mech_type);
+  else
+    mech = _gss_ctx_mech (*context_handle);
+  if (mech == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
+    }
+
+  if (actual_mech_type)
+    *actual_mech_type = mech->mech;
+
+  if (*context_handle == GSS_C_NO_CONTEXT)
+    {
+      maj_stat = context_new (minor_status, mech, context_handle);
+      if (GSS_ERROR (maj_stat))
+	return maj_stat;
+      freecontext = 1;
+    }
+
+  maj_stat = mech->init_sec_context (minor_status,
+				     initiator_cred_handle,
+				     context_handle,
+				     target_name,
+				     mech_type,
+				     req_flags,
+				     time_req,
+				     input_chan_bindings,
+				     input_token,
+				     actual_mech_type,
+				     output_token, ret_flags, time_rec);
+
+  if (GSS_ERROR (maj_stat) && freecontext)
+    context_abort (mech, context_handle);
+  else if (freecontext)
+    _gss_stats_context (1);
+
+  return maj_stat;
+}
+
 /**
  * gss_init_sec_context:
  * @minor_status: (integer, modify) Mechanism specific status code.
@@ -242,6 +354,11 @@
  * - True - Do not reveal the initiator's identity to the acceptor.
  * - False - Authenticate normally.
  *
+ * `GSS_C_ASYNC_FLAG`::
+ * - True - Return GSS_S_WOULD_BLOCK instead of waiting for the
+ * network, see gss_init_sec_context_fd().  This is a GNU extension.
+ * - False - Wait for the network.
+ *
  * The `ret_flags` values:
  *
  * `GSS_C_DELEG_FLAG`::
@@ -302,6 +419,11 @@
  * application is required to complete the context, and that
  * gss_init_sec_context must be called again with that token.
  *
+ * `GSS_S_WOULD_BLOCK`: Only with `GSS_C_ASYNC_FLAG`.  No token was
+ * produced, and gss_init_sec_context must be called again with the
+ * same arguments once the descriptor returned by
+ * gss_init_sec_context_fd() is readable.
+ *
  * `GSS_S_DEFECTIVE_TOKEN`: Indicates that consistency checks
  * performed on the input_token failed.
  *
@@ -354,18 +476,110 @@ gss_init_sec_context (OM_uint32 * minor_status,
 		      gss_buffer_t output_token,
 		      OM_uint32 * ret_flags, OM_uint32 * time_rec)
 {
+  uint64_t start = _gss_stats_start ();
   OM_uint32 maj_stat;
+
+  maj_stat = _gss_init_sec_context1 (minor_status, initiator_cred_handle,
+				     context_handle, target_name, mech_type,
+				     req_flags, time_req, input_chan_bindings,
+				     input_token, actual_mech_type,
+				     output_token, ret_flags, time_rec);
+
+  return _gss_stats_end (_GSS_STATS_INIT_SEC_CONTEXT, start, maj_stat);
+}
+
+static OM_uint32
+_gss_init_sec_context_fd1 (OM_uint32 * minor_status,
+			   const gss_ctx_id_t context_handle, int *fd)
+{
   _gss_mech_api_t mech;
-  int freecontext = 0;
 
-  if (output_token)
-    {
-      output_token->length = 0;
-      output_token->value = NULL;
-    }
+  if (minor_status)
+    *minor_status = 0;
 
-  if (ret_flags)
-    *ret_flags = 0;
+  if (fd)
+    *fd = -1;
+
+  if (!context_handle)
+    return GSS_S_NO_CONTEXT;
+
+  if (!fd)
+    return GSS_S_FAILURE | GSS_S_CALL_INACCESSIBLE_WRITE;
+
+  mech = _gss_ctx_mech (context_handle);
+  if (mech == NULL)
+    return GSS_S_BAD_MECH;
+
+  if (mech->init_sec_context_fd == NULL)
+    return GSS_S_UNAVAILABLE;
+
+  return mech->init_sec_context_fd (minor_status, context_handle, fd);
+}
+
+/**
+ * gss_init_sec_context_fd:
+ * @minor_status: (Integer, modify) Mechanism specific status code.
+ * @context_handle: (gss_ctx_id_t, read) Context for which
+ *   gss_init_sec_context() returned `GSS_S_WOULD_BLOCK`.
+ * @fd: (int, modify) File descriptor that becomes readable when
+ *   gss_init_sec_context() can make progress.
+ *
+ * Get the file descriptor to wait for, with poll() or select(),
+ * before calling gss_init_sec_context() again after it returned
+ * `GSS_S_WOULD_BLOCK`.  Do not read from or close the descriptor; it
+ * belongs to the context and stays valid until the next call to
+ * gss_init_sec_context() or gss_delete_sec_context().  Deleting a
+ * context that is waiting returns immediately; the helper thread
+ * finishes the pending operation and frees its handle in the
+ * background.
+ *
+ * WARNING: This function is a GNU GSS specific extension, and is not
+ * part of the official GSS API.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * `GSS_S_NO_CONTEXT`: The context_handle parameter did not identify a
+ * valid context.
+ *
+ * `GSS_S_FAILURE`: No operation is pending on the context.
+ *
+ * `GSS_S_UNAVAILABLE`: The mechanism does not support asynchronous
+ * context initiation.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_init_sec_context_fd (OM_uint32 * minor_status,
+			 const gss_ctx_id_t context_handle, int *fd)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_init_sec_context_fd1 (minor_status, context_handle, fd);
+
+  return _gss_stats_end (_GSS_STATS_INIT_SEC_CONTEXT_FD, start, maj_stat);
+}
+
+static OM_uint32
+_gss_accept_sec_context1 (OM_uint32 * minor_status,
+			  gss_ctx_id_t * context_handle,
+			  const gss_cred_id_t acceptor_cred_handle,
+			  const gss_buffer_t input_token_buffer,
+			  const gss_channel_bindings_t input_chan_bindings,
+			  gss_name_t * src_name,
+			  gss_OID * mech_type,
+			  gss_buffer_t output_token,
+			  OM_uint32 * ret_flags,
+			  OM_uint32 * time_rec,
+			  gss_cred_id_t * delegated_cred_handle)
+{
+  _gss_mech_api_t mech;
+  OM_uint32 maj_stat;
+  gss_buffer_t token = input_token_buffer;
+  gss_buffer_desc inner;
+  int newcontext;
 
   if (!context_handle)
     {
@@ -374,17 +588,41 @@ gss_init_sec_context (OM_uint32 * minor_status,
       return GSS_S_NO_CONTEXT | GSS_S_CALL_INACCESSIBLE_READ;
     }
 
-  if (output_token == GSS_C_NO_BUFFER)
+  newcontext = *context_handle == GSS_C_NO_CONTEXT;
+  if (newcontext)
     {
-      if (minor_status)
-	*minor_status = 0;
-      return GSS_S_FAILURE | GSS_S_CALL_BAD_STRUCTURE;
-    }
+      gss_OID_desc oid;
+      char *oidp, *innerp;
+      size_t oidlen, innerlen;
 
-  if (*context_handle == GSS_C_NO_CONTEXT)
-    mech = _gss_find_mech (mech_type);
+      /* The initial token names the mechanism, see RFC 2743 section
+         3.1.  The mechanism gets the inner token, so that the header
+         is parsed only here. */
+      if (input_token_buffer == GSS_C_NO_BUFFER
+	  || _gss_decapsulate_token (input_token_buffer->value,
+				     input_token_buffer->length,
+				     &oidp, &oidlen,
+				     &innerp, &innerlen) != 0)
+	{
+	  if (minor_status)
+	    *minor_status = 0;
+	  return GSS_S_DEFECTIVE_TOKEN;
+	}
+
+      oid.length = oidlen;
+      oid.elements = oidp;
+      mech = _gss_find_mech_no_default (&oid);
+
+      if (mech && acceptor_cred_handle != GSS_C_NO_CREDENTIAL
+	  && _gss_cred_mech (acceptor_cred_handle) != mech)
+	mech = NULL;
+
+      inner.length = innerlen;
+      inner.value = innerp;
+      token = &inner;
+    }
   else
-    mech = _gss_find_mech ((*context_handle)->mech);
+    mech = _gss_ctx_mech (*context_handle);
   if (mech == NULL)
     {
       if (minor_status)
@@ -392,39 +630,31 @@ gss_init_sec_context (OM_uint32 * minor_status,
       return GSS_S_BAD_MECH;
     }
 
-  if (actual_mech_type)
-    *actual_mech_type = mech->mech;
+  if (mech_type)
+    *mech_type = mech->mech;
 
-  if (*context_handle == GSS_C_NO_CONTEXT)
+  if (newcontext)
     {
-      *context_handle = calloc (sizeof (**context_handle), 1);
-      if (!*context_handle)
-	{
-	  if (minor_status)
-	    *minor_status = ENOMEM;
-	  return GSS_S_FAILURE;
-	}
-      (*context_handle)->mech = mech->mech;
-      freecontext = 1;
+      maj_stat = context_new (minor_status, mech, context_handle);
+      if (GSS_ERROR (maj_stat))
+	return maj_stat;
     }
 
-  maj_stat = mech->init_sec_context (minor_status,
-				     initiator_cred_handle,
-				     context_handle,
-				     target_name,
-				     mech_type,
-				     req_flags,
-				     time_req,
-				     input_chan_bindings,
-				     input_token,
-				     actual_mech_type,
-				     output_token, ret_flags, time_rec);
+  maj_stat = mech->accept_sec_context (minor_status,
+				       context_handle,
+				       acceptor_cred_handle,
+				       token,
+				       input_chan_bindings,
+				       src_name,
+				       mech_type,
+				       output_token,
+				       ret_flags,
+				       time_rec, delegated_cred_handle);
 
-  if (GSS_ERROR (maj_stat) && freecontext)
-    {
-      free (*context_handle);
-      *context_handle = GSS_C_NO_CONTEXT;
-    }
+  if (GSS_ERROR (maj_stat) && newcontext)
+    context_abort (mech, context_handle);
+  else if (newcontext)
+    _gss_stats_context (1);
 
   return maj_stat;
 }
@@ -693,8 +923,27 @@ gss_accept_sec_context (OM_uint32 * minor_status,
 			OM_uint32 * ret_flags,
 			OM_uint32 * time_rec,
 			gss_cred_id_t * delegated_cred_handle)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_accept_sec_context1 (minor_status, context_handle,
+				       acceptor_cred_handle,
+				       input_token_buffer, input_chan_bindings,
+				       src_name, mech_type, output_token,
+				       ret_flags, time_rec,
+				       delegated_cred_handle);
+
+  return _gss_stats_end (_GSS_STATS_ACCEPT_SEC_CONTEXT, start, maj_stat);
+}
+
+static OM_uint32
+_gss_delete_sec_context1 (OM_uint32 * minor_status,
+			  gss_ctx_id_t * context_handle,
+			  gss_buffer_t output_token)
 {
   _gss_mech_api_t mech;
+  OM_uint32 ret;
 
   if (!context_handle)
     {
@@ -705,12 +954,18 @@ gss_accept_sec_context (OM_uint32 * minor_status,
 
   if (*context_handle == GSS_C_NO_CONTEXT)
     {
-      /* FIXME: We should extract GSS-API mechanism OID from token
-         here, and use it to find the proper mechanism. */
-      mech = _gss_find_mech (GSS_C_NO_OID);
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_NO_CONTEXT | GSS_S_CALL_BAD_STRUCTURE;
     }
-  else
-    mech = _gss_find_mech ((*context_handle)->mech);
+
+  if (output_token != GSS_C_NO_BUFFER)
+    {
+      output_token->length = 0;
+      output_token->value = NULL;
+    }
+
+  mech = _gss_ctx_mech (*context_handle);
   if (mech == NULL)
     {
       if (minor_status)
@@ -718,19 +973,13 @@ gss_accept_sec_context (OM_uint32 * minor_status,
       return GSS_S_BAD_MECH;
     }
 
-  if (mech_type)
-    *mech_type = mech->mech;
+  ret = mech->delete_sec_context (NULL, context_handle, output_token);
+
+  free (*context_handle);
+  *context_handle = GSS_C_NO_CONTEXT;
+  _gss_stats_context (-1);
 
-  return mech->accept_sec_context (minor_status,
-				   context_handle,
-				   acceptor_cred_handle,
-				   input_token_buffer,
-				   input_chan_bindings,
-				   src_name,
-				   mech_type,
-				   output_token,
-				   ret_flags,
-				   time_rec, delegated_cred_handle);
+  return ret;
 }
 
 /**
@@ -785,43 +1034,21 @@ gss_delete_sec_context (OM_uint32 * minor_status,
 			gss_ctx_id_t * context_handle,
 			gss_buffer_t output_token)
 {
-  _gss_mech_api_t mech;
-  OM_uint32 ret;
-
-  if (!context_handle)
-    {
-      if (minor_status)
-	*minor_status = 0;
-      return GSS_S_NO_CONTEXT | GSS_S_CALL_INACCESSIBLE_READ;
-    }
-
-  if (*context_handle == GSS_C_NO_CONTEXT)
-    {
-      if (minor_status)
-	*minor_status = 0;
-      return GSS_S_NO_CONTEXT | GSS_S_CALL_BAD_STRUCTURE;
-    }
-
-  if (output_token != GSS_C_NO_BUFFER)
-    {
-      output_token->length = 0;
-      output_token->value = NULL;
-    }
-
-  mech = _gss_find_mech ((*context_handle)->mech);
-  if (mech == NULL)
-    {
-      if (minor_status)
-	*minor_status = 0;
-      return GSS_S_BAD_MECH;
-    }
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
 
-  ret = mech->delete_sec_context (NULL, context_handle, output_token);
+  maj_stat = _gss_delete_sec_context1 (minor_status, context_handle,
+				       output_token);
 
-  free (*context_handle);
-  *context_handle = GSS_C_NO_CONTEXT;
+  return _gss_stats_end (_GSS_STATS_DELETE_SEC_CONTEXT, start, maj_stat);
+}
 
-  return ret;
+static OM_uint32
+_gss_process_context_token1 (OM_uint32 * minor_status,
+			     const gss_ctx_id_t context_handle,
+			     const gss_buffer_t token_buffer)
+{
+  return GSS_S_FAILURE;
 }
 
 /**
@@ -862,7 +1089,37 @@ gss_process_context_token (OM_uint32 * minor_status,
 			   const gss_ctx_id_t context_handle,
 			   const gss_buffer_t token_buffer)
 {
-  return GSS_S_FAILURE;
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_process_context_token1 (minor_status, context_handle,
+					  token_buffer);
+
+  return _gss_stats_end (_GSS_STATS_PROCESS_CONTEXT_TOKEN, start, maj_stat);
+}
+
+static OM_uint32
+_gss_context_time1 (OM_uint32 * minor_status,
+		    const gss_ctx_id_t context_handle, OM_uint32 * time_rec)
+{
+  _gss_mech_api_t mech;
+
+  if (context_handle == GSS_C_NO_CONTEXT)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_NO_CONTEXT | GSS_S_CALL_BAD_STRUCTURE;
+    }
+
+  mech = _gss_ctx_mech (context_handle);
+  if (mech == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
+    }
+
+  return mech->context_time (minor_status, context_handle, time_rec);
 }
 
 /**
@@ -891,24 +1148,23 @@ OM_uint32
 gss_context_time (OM_uint32 * minor_status,
 		  const gss_ctx_id_t context_handle, OM_uint32 * time_rec)
 {
-  _gss_mech_api_t mech;
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
 
-  if (context_handle == GSS_C_NO_CONTEXT)
-    {
-      if (minor_status)
-	*minor_status = 0;
-      return GSS_S_NO_CONTEXT | GSS_S_CALL_BAD_STRUCTURE;
-    }
+  maj_stat = _gss_context_time1 (minor_status, context_handle, time_rec);
 
-  mech = _gss_find_mech (context_handle->mech);
-  if (mech == NULL)
-    {
-      if (minor_status)
-	*minor_status = 0;
-      return GSS_S_BAD_MECH;
-    }
+  return _gss_stats_end (_GSS_STATS_CONTEXT_TIME, start, maj_stat);
+}
 
-  return mech->context_time (minor_status, context_handle, time_rec);
+static OM_uint32
+_gss_inquire_context1 (OM_uint32 * minor_status,
+		       const gss_ctx_id_t context_handle,
+		       gss_name_t * src_name, gss_name_t * targ_name,
+		       OM_uint32 * lifetime_rec, gss_OID * mech_type,
+		       OM_uint32 * ctx_flags, int *locally_initiated,
+		       int *open)
+{
+  return GSS_S_FAILURE;
 }
 
 /**
@@ -1024,7 +1280,57 @@ gss_inquire_context (OM_uint32 * minor_status,
 		     gss_OID * mech_type,
 		     OM_uint32 * ctx_flags, int *locally_initiated, int *open)
 {
-  return GSS_S_FAILURE;
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_inquire_context1 (minor_status, context_handle, src_name,
+				    targ_name, lifetime_rec, mech_type,
+				    ctx_flags, locally_initiated, open);
+
+  return _gss_stats_end (_GSS_STATS_INQUIRE_CONTEXT, start, maj_stat);
+}
+
+static OM_uint32
+_gss_wrap_size_limit1 (OM_uint32 * minor_status,
+		       const gss_ctx_id_t context_handle,
+		       int conf_req_flag,
+		       gss_qop_t qop_req,
+		       OM_uint32 req_output_size, OM_uint32 * max_input_size)
+{
+  _gss_mech_api_t mech;
+
+  if (!context_handle)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_NO_CONTEXT;
+    }
+
+  if (!max_input_size)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_CALL_INACCESSIBLE_WRITE;
+    }
+
+  mech = _gss_ctx_mech (context_handle);
+  if (mech == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
+    }
+
+  if (mech->wrap_size_limit == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_UNAVAILABLE;
+    }
+
+  return mech->wrap_size_limit (minor_status, context_handle,
+				conf_req_flag, qop_req,
+				req_output_size, max_input_size);
 }
 
 /**
@@ -1086,7 +1392,64 @@ gss_wrap_size_limit (OM_uint32 * minor_status,
 		     gss_qop_t qop_req,
 		     OM_uint32 req_output_size, OM_uint32 * max_input_size)
 {
-  return GSS_S_FAILURE;
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_wrap_size_limit1 (minor_status, context_handle,
+				    conf_req_flag, qop_req, req_output_size,
+				    max_input_size);
+
+  return _gss_stats_end (_GSS_STATS_WRAP_SIZE_LIMIT, start, maj_stat);
+}
+
+static OM_uint32
+_gss_export_sec_context1 (OM_uint32 * minor_status,
+			  gss_ctx_id_t * context_handle,
+			  gss_buffer_t interprocess_token)
+{
+  _gss_mech_api_t mech;
+  OM_uint32 maj_stat;
+
+  if (!context_handle || *context_handle == GSS_C_NO_CONTEXT)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_NO_CONTEXT;
+    }
+
+  if (!interprocess_token)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_CALL_INACCESSIBLE_WRITE;
+    }
+
+  mech = _gss_ctx_mech (*context_handle);
+  if (mech == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
+    }
+
+  if (mech->export_sec_context == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_UNAVAILABLE;
+    }
+
+  maj_stat = mech->export_sec_context (minor_status, context_handle,
+				       interprocess_token);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  mech->delete_sec_context (NULL, context_handle, GSS_C_NO_BUFFER);
+  free (*context_handle);
+  *context_handle = GSS_C_NO_CONTEXT;
+  _gss_stats_context (-1);
+
+  return GSS_S_COMPLETE;
 }
 
 /**
@@ -1128,6 +1491,12 @@ gss_wrap_size_limit (OM_uint32 * minor_status,
  * protect the interprocess token, and ensure that any process to
  * which the token is transferred is trustworthy.
  *
+ * In this implementation, only fully established contexts may be
+ * exported, and the interprocess token is not encrypted.  The
+ * Kerberos V5 token carries the session key, the sequence numbers,
+ * the context flags, the peer name and the ticket end time, and can
+ * be imported without access to the ticket cache or keytab.
+ *
  * If creation of the interprocess token is successful, the
  * implementation shall deallocate all process-wide resources
  * associated with the security context, and set the context_handle to
@@ -1155,7 +1524,60 @@ gss_export_sec_context (OM_uint32 * minor_status,
 			gss_ctx_id_t * context_handle,
 			gss_buffer_t interprocess_token)
 {
-  return GSS_S_UNAVAILABLE;
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_export_sec_context1 (minor_status, context_handle,
+				       interprocess_token);
+
+  return _gss_stats_end (_GSS_STATS_EXPORT_SEC_CONTEXT, start, maj_stat);
+}
+
+static OM_uint32
+_gss_import_sec_context1 (OM_uint32 * minor_status,
+			  const gss_buffer_t interprocess_token,
+			  gss_ctx_id_t * context_handle)
+{
+  _gss_mech_api_t mech;
+  OM_uint32 maj_stat;
+  gss_OID_desc oid;
+  char *oidp, *data;
+  size_t oidlen, datalen;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  if (!interprocess_token || !context_handle)
+    return GSS_S_CALL_INACCESSIBLE_READ;
+
+  if (_gss_decapsulate_token (interprocess_token->value,
+			      interprocess_token->length,
+			      &oidp, &oidlen, &data, &datalen) != 0)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  oid.elements = oidp;
+  oid.length = oidlen;
+
+  mech = _gss_find_mech_no_default (&oid);
+  if (mech == NULL)
+    return GSS_S_BAD_MECH;
+
+  if (mech->import_sec_context == NULL)
+    return GSS_S_UNAVAILABLE;
+
+  maj_stat = context_new (minor_status, mech, context_handle);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  maj_stat = mech->import_sec_context (minor_status, interprocess_token,
+				       context_handle);
+
+  if (GSS_ERROR (maj_stat))
+    context_abort (mech, context_handle);
+  else
+    _gss_stats_context (1);
+
+  return maj_stat;
 }
 
 /**
@@ -1191,5 +1613,11 @@ gss_import_sec_context (OM_uint32 * minor_status,
 			const gss_buffer_t interprocess_token,
 			gss_ctx_id_t * context_handle)
 {
-  return GSS_S_UNAVAILABLE;
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_import_sec_context1 (minor_status, interprocess_token,
+				       context_handle);
+
+  return _gss_stats_end (_GSS_STATS_IMPORT_SEC_CONTEXT, start, maj_stat);
 }
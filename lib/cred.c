@@ -25,6 +25,72 @@
 /* _gss_find_mech */
 #include "meta.h"
 
+static OM_uint32
+_gss_acquire_cred1 (OM_uint32 * minor_status,
+		    const gss_name_t desired_name,
+		    OM_uint32 time_req,
+		    const gss_OID_set desired_mechs,
+		    gss_cred_usage_t cred_usage,
+		    gss_cred_id_t * output_cred_handle,
+		    gss_OID_set * actual_mechs, OM_uint32 * time_rec)
+{
+  _gss_mech_api_t mech = NULL;
+  OM_uint32 maj_stat;
+
+  if (!output_cred_handle)
+    return GSS_S_NO_CRED | GSS_S_CALL_INACCESSIBLE_WRITE;
+
+  if (desired_mechs != GSS_C_NO_OID_SET)
+    {
+      size_t i;
+
+      /* Is the desired_mechs an "OR" or "AND" list?  I.e., if the OID
+         set contain several OIDs, MUST the credential work with all
+         of them?  Or just any of them?  The specification isn't
+         entirely clear on this, to me.  This implement an OR list,
+         chosing the first mechanism in the OID set we support.  We
+         need more information in meta.c to implement AND lists. */
+
+      for (i = 0; mech == NULL && i < desired_mechs->count; i++)
+	mech = _gss_find_mech ((&desired_mechs->elements)[i]);
+    }
+  else
+    mech = _gss_find_mech (GSS_C_NO_OID);
+
+  if (mech == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
+    }
+
+  *output_cred_handle = calloc (sizeof (**output_cred_handle), 1);
+  if (!*output_cred_handle)
+    {
+      if (minor_status)
+	*minor_status = ENOMEM;
+      return GSS_S_FAILURE;
+    }
+  (*output_cred_handle)->mech = mech->mech;
+  (*output_cred_handle)->api = mech;
+
+  maj_stat = mech->acquire_cred (minor_status,
+				 desired_name,
+				 time_req,
+				 desired_mechs,
+				 cred_usage,
+				 output_cred_handle, actual_mechs, time_rec);
+  if (GSS_ERROR (maj_stat))
+    {
+      free (*output_cred_handle);
+      *output_cred_handle = GSS_C_NO_CREDENTIAL;
+      return maj_stat;
+    }
+  _gss_stats_cred (1);
+
+  return GSS_S_COMPLETE;
+}
+
 /**
  * gss_acquire_cred:
  * @minor_status: (integer, modify) Mechanism specific status code.
@@ -125,59 +191,29 @@ gss_acquire_cred (OM_uint32 * minor_status,
 		  gss_cred_id_t * output_cred_handle,
 		  gss_OID_set * actual_mechs, OM_uint32 * time_rec)
 {
-  _gss_mech_api_t mech = NULL;
+  uint64_t start = _gss_stats_start ();
   OM_uint32 maj_stat;
 
-  if (!output_cred_handle)
-    return GSS_S_NO_CRED | GSS_S_CALL_INACCESSIBLE_WRITE;
-
-  if (desired_mechs != GSS_C_NO_OID_SET)
-    {
-      size_t i;
+  maj_stat = _gss_acquire_cred1 (minor_status, desired_name, time_req,
+				 desired_mechs, cred_usage, output_cred_handle,
+				 actual_mechs, time_rec);
 
-      /* Is the desired_mechs an "OR" or "AND" list?  I.e., if the OID
-         set contain several OIDs, MUST the credential work with all
-         of them?  Or just any of them?  The specification isn't
-         entirely clear on this, to me.  This implement an OR list,
-         chosing the first mechanism in the OID set we support.  We
-         need more information in meta.c to implement AND lists. */
-
-      for (i = 0; mech == NULL && i < desired_mechs->count; i++)
-	mech = _gss_find_mech ((&desired_mechs->elements)[i]);
-    }
-  else
-    mech = _gss_find_mech (GSS_C_NO_OID);
-
-  if (mech == NULL)
-    {
-      if (minor_status)
-	*minor_status = 0;
-      return GSS_S_BAD_MECH;
-    }
-
-  *output_cred_handle = calloc (sizeof (**output_cred_handle), 1);
-  if (!*output_cred_handle)
-    {
-      if (minor_status)
-	*minor_status = ENOMEM;
-      return GSS_S_FAILURE;
-    }
-  (*output_cred_handle)->mech = mech->mech;
-
-  maj_stat = mech->acquire_cred (minor_status,
-				 desired_name,
-				 time_req,
-				 desired_mechs,
-				 cred_usage,
-				 output_cred_handle, actual_mechs, time_rec);
-  if (GSS_ERROR (maj_stat))
-    {
-      free (*output_cred_handle);
-      *output_cred_handle = GSS_C_NO_CREDENTIAL;
-      return maj_stat;
-    }
+  return _gss_stats_end (_GSS_STATS_ACQUIRE_CRED, start, maj_stat);
+}
 
-  return GSS_S_COMPLETE;
+static OM_uint32
+_gss_add_cred1 (OM_uint32 * minor_status,
+		const gss_cred_id_t input_cred_handle,
+		const gss_name_t desired_name,
+		const gss_OID desired_mech,
+		gss_cred_usage_t cred_usage,
+		OM_uint32 initiator_time_req,
+		OM_uint32 acceptor_time_req,
+		gss_cred_id_t * output_cred_handle,
+		gss_OID_set * actual_mechs,
+		OM_uint32 * initiator_time_rec, OM_uint32 * acceptor_time_rec)
+{
+  return GSS_S_UNAVAILABLE;
 }
 
 /**
@@ -331,7 +367,53 @@ gss_add_cred (OM_uint32 * minor_status,
 	      gss_OID_set * actual_mechs,
 	      OM_uint32 * initiator_time_rec, OM_uint32 * acceptor_time_rec)
 {
-  return GSS_S_UNAVAILABLE;
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_add_cred1 (minor_status, input_cred_handle, desired_name,
+			     desired_mech, cred_usage, initiator_time_req,
+			     acceptor_time_req, output_cred_handle,
+			     actual_mechs, initiator_time_rec,
+			     acceptor_time_rec);
+
+  return _gss_stats_end (_GSS_STATS_ADD_CRED, start, maj_stat);
+}
+
+static OM_uint32
+_gss_inquire_cred1 (OM_uint32 * minor_status,
+		    const gss_cred_id_t cred_handle,
+		    gss_name_t * name,
+		    OM_uint32 * lifetime,
+		    gss_cred_usage_t * cred_usage, gss_OID_set * mechanisms)
+{
+  gss_cred_id_t credh = cred_handle;
+  _gss_mech_api_t mech;
+  OM_uint32 maj_stat;
+
+  if (cred_handle == GSS_C_NO_CREDENTIAL)
+    {
+      maj_stat = gss_acquire_cred (minor_status, GSS_C_NO_NAME,
+				   GSS_C_INDEFINITE, GSS_C_NO_OID_SET,
+				   GSS_C_INITIATE, &credh, NULL, NULL);
+      if (GSS_ERROR (maj_stat))
+	return maj_stat;
+    }
+
+  mech = _gss_cred_mech (credh);
+  if (mech == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
+    }
+
+  maj_stat = mech->inquire_cred (minor_status, credh, name, lifetime,
+				 cred_usage, mechanisms);
+
+  if (cred_handle == GSS_C_NO_CREDENTIAL)
+    gss_release_cred (NULL, &credh);
+
+  return maj_stat;
 }
 
 /**
@@ -378,20 +460,36 @@ gss_inquire_cred (OM_uint32 * minor_status,
 		  OM_uint32 * lifetime,
 		  gss_cred_usage_t * cred_usage, gss_OID_set * mechanisms)
 {
-  gss_cred_id_t credh = cred_handle;
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_inquire_cred1 (minor_status, cred_handle, name, lifetime,
+				 cred_usage, mechanisms);
+
+  return _gss_stats_end (_GSS_STATS_INQUIRE_CRED, start, maj_stat);
+}
+
+static OM_uint32
+_gss_inquire_cred_by_mech1 (OM_uint32 * minor_status,
+			    const gss_cred_id_t cred_handle,
+			    const gss_OID mech_type,
+			    gss_name_t * name,
+			    OM_uint32 * initiator_lifetime,
+			    OM_uint32 * acceptor_lifetime,
+			    gss_cred_usage_t * cred_usage)
+{
   _gss_mech_api_t mech;
+  gss_cred_id_t credh = cred_handle;
   OM_uint32 maj_stat;
 
-  if (cred_handle == GSS_C_NO_CREDENTIAL)
+  if (mech_type == GSS_C_NO_OID)
     {
-      maj_stat = gss_acquire_cred (minor_status, GSS_C_NO_NAME,
-				   GSS_C_INDEFINITE, GSS_C_NO_OID_SET,
-				   GSS_C_INITIATE, &credh, NULL, NULL);
-      if (GSS_ERROR (maj_stat))
-	return maj_stat;
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
     }
 
-  mech = _gss_find_mech (credh->mech);
+  mech = _gss_find_mech (mech_type);
   if (mech == NULL)
     {
       if (minor_status)
@@ -399,8 +497,23 @@ gss_inquire_cred (OM_uint32 * minor_status,
       return GSS_S_BAD_MECH;
     }
 
-  maj_stat = mech->inquire_cred (minor_status, credh, name, lifetime,
-				 cred_usage, mechanisms);
+  if (cred_handle == GSS_C_NO_CREDENTIAL)
+    {
+      maj_stat = gss_acquire_cred (minor_status,
+				   GSS_C_NO_NAME, GSS_C_INDEFINITE,
+				   /* FIXME: We should create an OID
+				      set with mech_type and pass it
+				      as desired_mechs.  Maybe even
+				      check actual_mechs too. */
+				   GSS_C_NO_OID_SET,
+				   GSS_C_INITIATE, &credh, NULL, NULL);
+      if (GSS_ERROR (maj_stat))
+	return maj_stat;
+    }
+
+  maj_stat = mech->inquire_cred_by_mech (minor_status, credh, mech_type, name,
+					 initiator_lifetime,
+					 acceptor_lifetime, cred_usage);
 
   if (cred_handle == GSS_C_NO_CREDENTIAL)
     gss_release_cred (NULL, &credh);
@@ -463,48 +576,53 @@ gss_inquire_cred_by_mech (OM_uint32 * minor_status,
 			  OM_uint32 * initiator_lifetime,
 			  OM_uint32 * acceptor_lifetime,
 			  gss_cred_usage_t * cred_usage)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_inquire_cred_by_mech1 (minor_status, cred_handle, mech_type,
+					 name, initiator_lifetime,
+					 acceptor_lifetime, cred_usage);
+
+  return _gss_stats_end (_GSS_STATS_INQUIRE_CRED_BY_MECH, start, maj_stat);
+}
+
+static OM_uint32
+_gss_release_cred1 (OM_uint32 * minor_status, gss_cred_id_t * cred_handle)
 {
   _gss_mech_api_t mech;
-  gss_cred_id_t credh = cred_handle;
   OM_uint32 maj_stat;
 
-  if (mech_type == GSS_C_NO_OID)
+  if (!cred_handle)
     {
       if (minor_status)
 	*minor_status = 0;
-      return GSS_S_BAD_MECH;
+      return GSS_S_NO_CRED | GSS_S_CALL_INACCESSIBLE_READ;
     }
 
-  mech = _gss_find_mech (mech_type);
-  if (mech == NULL)
+  if (*cred_handle == GSS_C_NO_CREDENTIAL)
     {
       if (minor_status)
 	*minor_status = 0;
-      return GSS_S_BAD_MECH;
+      return GSS_S_COMPLETE;
     }
 
-  if (cred_handle == GSS_C_NO_CREDENTIAL)
+  mech = _gss_cred_mech (*cred_handle);
+  if (mech == NULL)
     {
-      maj_stat = gss_acquire_cred (minor_status,
-				   GSS_C_NO_NAME, GSS_C_INDEFINITE,
-				   /* FIXME: We should create an OID
-				      set with mech_type and pass it
-				      as desired_mechs.  Maybe even
-				      check actual_mechs too. */
-				   GSS_C_NO_OID_SET,
-				   GSS_C_INITIATE, &credh, NULL, NULL);
-      if (GSS_ERROR (maj_stat))
-	return maj_stat;
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_DEFECTIVE_CREDENTIAL;
     }
 
-  maj_stat = mech->inquire_cred_by_mech (minor_status, credh, mech_type, name,
-					 initiator_lifetime,
-					 acceptor_lifetime, cred_usage);
-
-  if (cred_handle == GSS_C_NO_CREDENTIAL)
-    gss_release_cred (NULL, &credh);
+  maj_stat = mech->release_cred (minor_status, cred_handle);
+  free (*cred_handle);
+  *cred_handle = GSS_C_NO_CREDENTIAL;
+  _gss_stats_cred (-1);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
 
-  return maj_stat;
+  return GSS_S_COMPLETE;
 }
 
 /**
@@ -529,36 +647,10 @@ gss_inquire_cred_by_mech (OM_uint32 * minor_status,
 OM_uint32
 gss_release_cred (OM_uint32 * minor_status, gss_cred_id_t * cred_handle)
 {
-  _gss_mech_api_t mech;
+  uint64_t start = _gss_stats_start ();
   OM_uint32 maj_stat;
 
-  if (!cred_handle)
-    {
-      if (minor_status)
-	*minor_status = 0;
-      return GSS_S_NO_CRED | GSS_S_CALL_INACCESSIBLE_READ;
-    }
+  maj_stat = _gss_release_cred1 (minor_status, cred_handle);
 
-  if (*cred_handle == GSS_C_NO_CREDENTIAL)
-    {
-      if (minor_status)
-	*minor_status = 0;
-      return GSS_S_COMPLETE;
-    }
-
-  mech = _gss_find_mech ((*cred_handle)->mech);
-  if (mech == NULL)
-    {
-      if (minor_status)
-	*minor_status = 0;
-      return GSS_S_DEFECTIVE_CREDENTIAL;
-    }
-
-  maj_stat = mech->release_cred (minor_status, cred_handle);
-  free (*cred_handle);
-  *cred_handle = GSS_C_NO_CREDENTIAL;
-  if (GSS_ERROR (maj_stat))
-    return maj_stat;
-
-  return GSS_S_COMPLETE;
+  return _gss_stats_end (_GSS_STATS_RELEASE_CRED, start, maj_stat);
 }
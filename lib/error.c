@@ -25,6 +25,8 @@
 /* _gss_find_mech */
 #include "meta.h"
 
+#include <locale.h>
+
 struct gss_status_codes
 {
   gss_uint32 err;
@@ -92,9 +94,223 @@ static struct gss_status_codes gss_supplementary_errors[] = {
   {GSS_S_UNSEQ_TOKEN, "GSS_S_UNSEQ_TOKEN",
    N_("A later token has already been processed")},
   {GSS_S_GAP_TOKEN, "GSS_S_GAP_TOKEN",
-   N_("An expected per-message token was not received")}
+   N_("An expected per-message token was not received")},
+  {GSS_S_WOULD_BLOCK, "GSS_S_WOULD_BLOCK",
+   N_("The function must be called again when its descriptor is "
+      "readable")}
+};
+
+#define COUNT(a) (sizeof (a) / sizeof ((a)[0]))
+
+/* Every text that display_status_text can return has an index: the
+   calling errors come first, then the routine errors, then the
+   supplementary information, and last "No error". */
+#define STATUS_ROUTINE COUNT (gss_calling_errors)
+#define STATUS_SUPPLEMENTARY (STATUS_ROUTINE + COUNT (gss_routine_errors))
+#define STATUS_NO_ERROR (STATUS_SUPPLEMENTARY + COUNT (gss_supplementary_errors))
+#define STATUS_TEXTS (STATUS_NO_ERROR + 1)
+
+/* The translations of all the texts for one locale.  The strings
+   that gettext returns stay valid, so they are looked up the first
+   time a status is displayed in the locale, and the tables are kept
+   until the process exits.  New tables are pushed on the list under
+   status_lock; readers walk it without a lock. */
+struct status_table
+{
+  struct status_table *next;
+  char *locale;
+  const char *text[STATUS_TEXTS];
 };
 
+_GSS_LOCK_DEFINE (status_lock);
+static struct status_table *status_tables;
+static int textdomain_bound;
+
+/* Bind the text domain of the library, once. */
+void
+_gss_textdomain (void)
+{
+  if (_gss_load (&textdomain_bound))
+    return;
+
+  _gss_lock (status_lock);
+  if (!textdomain_bound)
+    {
+      bindtextdomain (PACKAGE PO_SUFFIX, LOCALEDIR);
+      _gss_store (&textdomain_bound, 1);
+    }
+  _gss_unlock (status_lock);
+}
+
+static const char *
+status_msgid (size_t i)
+{
+  if (i < STATUS_ROUTINE)
+    return gss_calling_errors[i].text;
+  if (i < STATUS_SUPPLEMENTARY)
+    return gss_routine_errors[i - STATUS_ROUTINE].text;
+  if (i < STATUS_NO_ERROR)
+    return gss_supplementary_errors[i - STATUS_SUPPLEMENTARY].text;
+  return N_("No error");
+}
+
+static struct status_table *
+status_table_find (const char *locale)
+{
+  struct status_table *t;
+
+  for (t = _gss_load (&status_tables); t; t = t->next)
+    if (strcmp (t->locale, locale) == 0)
+      return t;
+
+  return NULL;
+}
+
+/* Return the text with index I, translated for the current message
+   locale. */
+static const char *
+status_text (size_t i)
+{
+  struct status_table *t;
+  const char *locale = NULL;
+  size_t j;
+
+  _gss_textdomain ();
+
+#ifdef LC_MESSAGES
+  locale = setlocale (LC_MESSAGES, NULL);
+#endif
+  if (!locale)
+    locale = "C";
+
+  t = status_table_find (locale);
+  if (!t)
+    {
+      _gss_lock (status_lock);
+      t = status_table_find (locale);
+      if (!t && (t = malloc (sizeof (*t))) != NULL)
+	{
+	  t->locale = strdup (locale);
+	  if (t->locale)
+	    {
+	      for (j = 0; j < STATUS_TEXTS; j++)
+		t->text[j] = _(status_msgid (j));
+	      t->next = status_tables;
+	      _gss_store (&status_tables, t);
+	    }
+	  else
+	    {
+	      free (t);
+	      t = NULL;
+	    }
+	}
+      _gss_unlock (status_lock);
+    }
+
+  return t ? t->text[i] : _(status_msgid (i));
+}
+
+/* Find the text describing the first condition in the GSS status
+   code STATUS_VALUE that is not yet recorded in *MESSAGE_CONTEXT, and
+   record it there. */
+static OM_uint32
+display_status_text (OM_uint32 status_value,
+		     OM_uint32 * message_context, const char **text)
+{
+  size_t i;
+
+  if (message_context)
+    {
+      *message_context |=
+	GSS_C_ROUTINE_ERROR_MASK << GSS_C_ROUTINE_ERROR_OFFSET;
+      if ((status_value & ~*message_context) == 0)
+	*message_context = 0;
+    }
+
+  switch (GSS_ROUTINE_ERROR (status_value))
+    {
+    case 0:
+      break;
+
+    case GSS_S_BAD_MECH:
+    case GSS_S_BAD_NAME:
+    case GSS_S_BAD_NAMETYPE:
+    case GSS_S_BAD_BINDINGS:
+    case GSS_S_BAD_STATUS:
+    case GSS_S_BAD_SIG:
+    case GSS_S_NO_CRED:
+    case GSS_S_NO_CONTEXT:
+    case GSS_S_DEFECTIVE_TOKEN:
+    case GSS_S_DEFECTIVE_CREDENTIAL:
+    case GSS_S_CREDENTIALS_EXPIRED:
+    case GSS_S_CONTEXT_EXPIRED:
+    case GSS_S_FAILURE:
+    case GSS_S_BAD_QOP:
+    case GSS_S_UNAUTHORIZED:
+    case GSS_S_UNAVAILABLE:
+    case GSS_S_DUPLICATE_ELEMENT:
+    case GSS_S_NAME_NOT_MN:
+      *text = status_text (STATUS_ROUTINE
+			   + (GSS_ROUTINE_ERROR (status_value) >>
+			      GSS_C_ROUTINE_ERROR_OFFSET) - 1);
+      return GSS_S_COMPLETE;
+      break;
+
+    default:
+      return GSS_S_BAD_STATUS;
+      break;
+    }
+
+  if (message_context)
+    {
+      *message_context |=
+	GSS_C_CALLING_ERROR_MASK << GSS_C_CALLING_ERROR_OFFSET;
+      if ((status_value & ~*message_context) == 0)
+	*message_context = 0;
+    }
+
+  switch (GSS_CALLING_ERROR (status_value))
+    {
+    case 0:
+      break;
+
+    case GSS_S_CALL_INACCESSIBLE_READ:
+    case GSS_S_CALL_INACCESSIBLE_WRITE:
+    case GSS_S_CALL_BAD_STRUCTURE:
+      *text = status_text ((GSS_CALLING_ERROR (status_value) >>
+			    GSS_C_CALLING_ERROR_OFFSET) - 1);
+      return GSS_S_COMPLETE;
+      break;
+
+    default:
+      return GSS_S_BAD_STATUS;
+      break;
+    }
+
+  for (i = 0; i < COUNT (gss_supplementary_errors); i++)
+    if (gss_supplementary_errors[i].err &
+	GSS_SUPPLEMENTARY_INFO (status_value))
+      {
+	*text = status_text (STATUS_SUPPLEMENTARY + i);
+	if (message_context)
+	  {
+	    *message_context |= gss_supplementary_errors[i].err;
+	    if ((status_value & ~*message_context) == 0)
+	      *message_context = 0;
+	  }
+	return GSS_S_COMPLETE;
+      }
+
+  if (GSS_SUPPLEMENTARY_INFO (status_value))
+    return GSS_S_BAD_STATUS;
+
+  if (message_context)
+    *message_context = 0;
+  *text = status_text (STATUS_NO_ERROR);
+
+  return GSS_S_COMPLETE;
+}
+
 /**
  * gss_display_status:
  * @minor_status: (integer, modify) Mechanism specific status code.
@@ -186,9 +402,10 @@ gss_display_status (OM_uint32 * minor_status,
 		    const gss_OID mech_type,
 		    OM_uint32 * message_context, gss_buffer_t status_string)
 {
-  size_t i;
+  OM_uint32 maj_stat;
+  const char *text;
 
-  bindtextdomain (PACKAGE PO_SUFFIX, LOCALEDIR);
+  _gss_textdomain ();
 
   if (minor_status)
     *minor_status = 0;
@@ -199,117 +416,11 @@ gss_display_status (OM_uint32 * minor_status,
   switch (status_type)
     {
     case GSS_C_GSS_CODE:
-      if (message_context)
-	{
-	  *message_context |=
-	    GSS_C_ROUTINE_ERROR_MASK << GSS_C_ROUTINE_ERROR_OFFSET;
-	  if ((status_value & ~*message_context) == 0)
-	    *message_context = 0;
-	}
-
-      switch (GSS_ROUTINE_ERROR (status_value))
-	{
-	case 0:
-	  break;
-
-	case GSS_S_BAD_MECH:
-	case GSS_S_BAD_NAME:
-	case GSS_S_BAD_NAMETYPE:
-	case GSS_S_BAD_BINDINGS:
-	case GSS_S_BAD_STATUS:
-	case GSS_S_BAD_SIG:
-	case GSS_S_NO_CRED:
-	case GSS_S_NO_CONTEXT:
-	case GSS_S_DEFECTIVE_TOKEN:
-	case GSS_S_DEFECTIVE_CREDENTIAL:
-	case GSS_S_CREDENTIALS_EXPIRED:
-	case GSS_S_CONTEXT_EXPIRED:
-	case GSS_S_FAILURE:
-	case GSS_S_BAD_QOP:
-	case GSS_S_UNAUTHORIZED:
-	case GSS_S_UNAVAILABLE:
-	case GSS_S_DUPLICATE_ELEMENT:
-	case GSS_S_NAME_NOT_MN:
-	  status_string->value =
-	    strdup (_(gss_routine_errors
-		      [(GSS_ROUTINE_ERROR (status_value) >>
-			GSS_C_ROUTINE_ERROR_OFFSET) - 1].text));
-	  if (!status_string->value)
-	    {
-	      if (minor_status)
-		*minor_status = ENOMEM;
-	      return GSS_S_FAILURE;
-	    }
-	  status_string->length = strlen (status_string->value);
-	  return GSS_S_COMPLETE;
-	  break;
-
-	default:
-	  return GSS_S_BAD_STATUS;
-	  break;
-	}
-
-      if (message_context)
-	{
-	  *message_context |=
-	    GSS_C_CALLING_ERROR_MASK << GSS_C_CALLING_ERROR_OFFSET;
-	  if ((status_value & ~*message_context) == 0)
-	    *message_context = 0;
-	}
+      maj_stat = display_status_text (status_value, message_context, &text);
+      if (GSS_ERROR (maj_stat))
+	return maj_stat;
 
-      switch (GSS_CALLING_ERROR (status_value))
-	{
-	case 0:
-	  break;
-
-	case GSS_S_CALL_INACCESSIBLE_READ:
-	case GSS_S_CALL_INACCESSIBLE_WRITE:
-	case GSS_S_CALL_BAD_STRUCTURE:
-	  status_string->value =
-	    strdup (_(gss_calling_errors
-		      [(GSS_CALLING_ERROR (status_value) >>
-			GSS_C_CALLING_ERROR_OFFSET) - 1].text));
-	  if (!status_string->value)
-	    {
-	      if (minor_status)
-		*minor_status = ENOMEM;
-	      return GSS_S_FAILURE;
-	    }
-	  status_string->length = strlen (status_string->value);
-	  return GSS_S_COMPLETE;
-	  break;
-
-	default:
-	  return GSS_S_BAD_STATUS;
-	  break;
-	}
-
-      for (i = 0; i < sizeof (gss_supplementary_errors) /
-	   sizeof (gss_supplementary_errors[0]); i++)
-	if (gss_supplementary_errors[i].err &
-	    GSS_SUPPLEMENTARY_INFO (status_value))
-	  {
-	    status_string->value =
-	      strdup (_(gss_supplementary_errors[i].text));
-	    if (!status_string->value)
-	      {
-		if (minor_status)
-		  *minor_status = ENOMEM;
-		return GSS_S_FAILURE;
-	      }
-	    status_string->length = strlen (status_string->value);
-	    *message_context |= gss_supplementary_errors[i].err;
-	    if ((status_value & ~*message_context) == 0)
-	      *message_context = 0;
-	    return GSS_S_COMPLETE;
-	  }
-
-      if (GSS_SUPPLEMENTARY_INFO (status_value))
-	return GSS_S_BAD_STATUS;
-
-      if (message_context)
-	*message_context = 0;
-      status_string->value = strdup (_("No error"));
+      status_string->value = strdup (text);
       if (!status_string->value)
 	{
 	  if (minor_status)
@@ -336,3 +447,152 @@ gss_display_status (OM_uint32 * minor_status,
 
   return GSS_S_COMPLETE;
 }
+
+/**
+ * gss_display_status_into:
+ * @minor_status: (integer, modify) Mechanism specific status code.
+ * @status_value: (Integer, read) Status value to be converted.
+ * @status_type: (Integer, read) GSS_C_GSS_CODE - status_value is a
+ *   GSS status code. GSS_C_MECH_CODE - status_value is a mechanism
+ *   status code.
+ * @mech_type: (Object ID, read, optional) Underlying mechanism (used
+ *   to interpret a minor status value). Supply GSS_C_NO_OID to obtain
+ *   the system default.
+ * @message_context: (Integer, read/modify) Should be initialized to
+ *   zero by the application prior to the first call.
+ * @status_string: (buffer, character string, modify) Caller storage
+ *   for the textual interpretation of the status_value, and its size.
+ *
+ * Like gss_display_status(), but the text is written to the storage
+ * that @status_string points to, whose length field holds the size
+ * of that storage on input and the length of the text on output.
+ * The text is not zero terminated.
+ *
+ * If the storage is too small, `GSS_S_FAILURE` is returned with
+ * @minor_status set to ERANGE, the length field is set to the size
+ * needed, and @message_context is left unchanged so that the call
+ * can be repeated with more storage.
+ *
+ * WARNING: This function is a GNU GSS specific extension, and is not
+ * part of the official GSS API.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * `GSS_S_BAD_MECH`: Indicates that translation in accordance with an
+ * unsupported mechanism type was requested.
+ *
+ * `GSS_S_BAD_STATUS`: The status value was not recognized, or the
+ * status type was neither GSS_C_GSS_CODE nor GSS_C_MECH_CODE.
+ *
+ * `GSS_S_FAILURE`: The storage is too small, or another failure.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_display_status_into (OM_uint32 * minor_status,
+			 OM_uint32 status_value,
+			 int status_type,
+			 const gss_OID mech_type,
+			 OM_uint32 * message_context,
+			 gss_buffer_t status_string)
+{
+  OM_uint32 saved_context = message_context ? *message_context : 0;
+  OM_uint32 maj_stat;
+  gss_buffer_desc tmp;
+  const char *text;
+  size_t len;
+
+  _gss_textdomain ();
+
+  if (minor_status)
+    *minor_status = 0;
+
+  if (message_context)
+    status_value &= ~*message_context;
+
+  switch (status_type)
+    {
+    case GSS_C_GSS_CODE:
+      maj_stat = display_status_text (status_value, message_context, &text);
+      if (GSS_ERROR (maj_stat))
+	return maj_stat;
+      len = strlen (text);
+      break;
+
+    case GSS_C_MECH_CODE:
+      {
+	_gss_mech_api_t mech;
+
+	/* Mechanisms only hand out allocated strings. */
+	mech = _gss_find_mech (mech_type);
+	maj_stat = mech->display_status (minor_status, status_value,
+					 status_type, mech_type,
+					 message_context, &tmp);
+	if (GSS_ERROR (maj_stat))
+	  return maj_stat;
+	text = tmp.value;
+	len = tmp.length;
+      }
+      break;
+
+    default:
+      return GSS_S_BAD_STATUS;
+    }
+
+  maj_stat = _gss_buffer_fits (minor_status, status_string, len);
+  if (maj_stat == GSS_S_COMPLETE)
+    {
+      memcpy (status_string->value, text, len);
+      status_string->length = len;
+    }
+  else if (message_context)
+    *message_context = saved_context;
+
+  if (status_type == GSS_C_MECH_CODE)
+    free (tmp.value);
+
+  return maj_stat;
+}
+
+/**
+ * gss_display_status_text:
+ * @minor_status: (integer, modify) Mechanism specific status code.
+ * @status_value: (Integer, read) GSS status code to be converted.
+ * @message_context: (Integer, read/modify) Should be initialized to
+ *   zero by the application prior to the first call.
+ * @status_string: (character string, modify) Returned text.
+ *
+ * Like gss_display_status() for a GSS_C_GSS_CODE status, but
+ * @status_string is set to a zero terminated string owned by the
+ * library, which stays valid until the process exits and must not be
+ * modified or freed.  No memory is allocated after the first call in
+ * each message locale.  Mechanism status codes are only available
+ * through gss_display_status() and gss_display_status_into().
+ *
+ * WARNING: This function is a GNU GSS specific extension, and is not
+ * part of the official GSS API.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * `GSS_S_BAD_STATUS`: The status value was not recognized.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_display_status_text (OM_uint32 * minor_status,
+			 OM_uint32 status_value,
+			 OM_uint32 * message_context,
+			 const char **status_string)
+{
+  if (minor_status)
+    *minor_status = 0;
+
+  if (message_context)
+    status_value &= ~*message_context;
+
+  return display_status_text (status_value, message_context, status_string);
+}
@@ -32,6 +32,145 @@ extern const char *gss_check_version (const char *req_version);
 /* See ext.c. */
 extern int gss_userok (const gss_name_t name, const char *username);
 
+/* See rcache.c. */
+extern OM_uint32 gss_set_replay_cache (OM_uint32 * minor_status,
+				       const char *filename, size_t slots);
+
+/* See plugin.c. */
+extern OM_uint32 gss_set_mech_config (OM_uint32 * minor_status,
+				      const char *filename);
+
+/* See asn1.c. */
+extern OM_uint32
+gss_decapsulate_token_view (gss_const_buffer_t input_token,
+			    gss_const_OID token_oid,
+			    gss_buffer_t output_token);
+
+/* Scatter/gather per-message protection, see msg.c.  The buffer
+   types and flags have the same values as in other GSS-API
+   implementations. */
+typedef struct gss_iov_buffer_desc_struct
+{
+  OM_uint32 type;
+  gss_buffer_desc buffer;
+} gss_iov_buffer_desc, *gss_iov_buffer_t;
+
+#define GSS_C_NO_IOV_BUFFER ((gss_iov_buffer_t) 0)
+
+#define GSS_IOV_BUFFER_TYPE_EMPTY 0
+#define GSS_IOV_BUFFER_TYPE_DATA 1
+#define GSS_IOV_BUFFER_TYPE_HEADER 2
+#define GSS_IOV_BUFFER_TYPE_MECH_PARAMS 3
+#define GSS_IOV_BUFFER_TYPE_TRAILER 7
+#define GSS_IOV_BUFFER_TYPE_PADDING 9
+#define GSS_IOV_BUFFER_TYPE_STREAM 10
+#define GSS_IOV_BUFFER_TYPE_SIGN_ONLY 11
+
+#define GSS_IOV_BUFFER_FLAG_MASK 0xFFFF0000
+#define GSS_IOV_BUFFER_FLAG_ALLOCATE 0x00010000
+#define GSS_IOV_BUFFER_FLAG_ALLOCATED 0x00020000
+
+#define GSS_IOV_BUFFER_TYPE(type) ((type) & ~GSS_IOV_BUFFER_FLAG_MASK)
+#define GSS_IOV_BUFFER_FLAGS(type) ((type) & GSS_IOV_BUFFER_FLAG_MASK)
+
+extern OM_uint32
+gss_wrap_iov (OM_uint32 * minor_status,
+	      gss_ctx_id_t context_handle,
+	      int conf_req_flag,
+	      gss_qop_t qop_req,
+	      int *conf_state, gss_iov_buffer_desc * iov, int iov_count);
+extern OM_uint32
+gss_unwrap_iov (OM_uint32 * minor_status,
+		gss_ctx_id_t context_handle,
+		int *conf_state,
+		gss_qop_t * qop_state, gss_iov_buffer_desc * iov, int iov_count);
+extern OM_uint32
+gss_wrap_iov_length (OM_uint32 * minor_status,
+		     gss_ctx_id_t context_handle,
+		     int conf_req_flag,
+		     gss_qop_t qop_req,
+		     int *conf_state,
+		     gss_iov_buffer_desc * iov, int iov_count);
+extern OM_uint32
+gss_release_iov_buffer (OM_uint32 * minor_status,
+			gss_iov_buffer_desc * iov, int iov_count);
+
+/* Per-message functions writing into caller storage, see msg.c and
+   error.c.  The length field of the output buffer holds the size of
+   the storage on input. */
+extern OM_uint32
+gss_wrap_into (OM_uint32 * minor_status,
+	       const gss_ctx_id_t context_handle,
+	       int conf_req_flag,
+	       gss_qop_t qop_req,
+	       const gss_buffer_t input_message_buffer,
+	       int *conf_state, gss_buffer_t output_message_buffer);
+extern OM_uint32
+gss_unwrap_into (OM_uint32 * minor_status,
+		 const gss_ctx_id_t context_handle,
+		 const gss_buffer_t input_message_buffer,
+		 gss_buffer_t output_message_buffer,
+		 int *conf_state, gss_qop_t * qop_state);
+extern OM_uint32
+gss_get_mic_into (OM_uint32 * minor_status,
+		  const gss_ctx_id_t context_handle,
+		  gss_qop_t qop_req,
+		  const gss_buffer_t message_buffer,
+		  gss_buffer_t message_token);
+extern OM_uint32
+gss_display_status_into (OM_uint32 * minor_status,
+			 OM_uint32 status_value,
+			 int status_type,
+			 const gss_OID mech_type,
+			 OM_uint32 * message_context,
+			 gss_buffer_t status_string);
+extern OM_uint32
+gss_display_status_text (OM_uint32 * minor_status,
+			 OM_uint32 status_value,
+			 OM_uint32 * message_context,
+			 const char **status_string);
+
+/* Asynchronous context initiation, see context.c.  With
+   GSS_C_ASYNC_FLAG, gss_init_sec_context may return GSS_S_WOULD_BLOCK
+   instead of waiting for the network, and should be called again
+   once the descriptor from gss_init_sec_context_fd is readable. */
+#define GSS_C_ASYNC_FLAG (1 << 16)
+#define GSS_S_WOULD_BLOCK (1ul << (GSS_C_SUPPLEMENTARY_OFFSET + 5))
+
+extern OM_uint32
+gss_init_sec_context_fd (OM_uint32 * minor_status,
+			 const gss_ctx_id_t context_handle, int *fd);
+
+/* Call statistics, see stats.c.  Index I of the latency histogram
+   counts the calls that took less than 2^I nanoseconds, and the last
+   index all slower calls. */
+#define GSS_STATS_BUCKETS 32
+
+typedef struct gss_stats_entry_struct
+{
+  const char *name;
+  unsigned long long calls;
+  unsigned long long failures;
+  unsigned long long total_ns;
+  unsigned long long latency[GSS_STATS_BUCKETS];
+} gss_stats_entry_desc;
+
+typedef struct gss_stats_struct
+{
+  /* Currently allocated. */
+  unsigned long long contexts;
+  unsigned long long credentials;
+  size_t count;
+  gss_stats_entry_desc *entries;
+} gss_stats_desc, *gss_stats_t;
+
+#define GSS_C_NO_STATS ((gss_stats_t) 0)
+
+extern OM_uint32 gss_stats_snapshot (OM_uint32 * minor_status,
+				     gss_stats_t * stats);
+extern OM_uint32 gss_release_stats (OM_uint32 * minor_status,
+				    gss_stats_t * stats);
+
 /* Static versions of the public OIDs for use, e.g., in static
    variable initalization.  See oid.c. */
 extern gss_OID_desc GSS_C_NT_USER_NAME_static;
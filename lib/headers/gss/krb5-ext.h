@@ -40,4 +40,8 @@ extern gss_OID_desc GSS_KRB5_NT_PRINCIPAL_NAME_static;
 extern gss_OID_desc GSS_KRB5_NT_MACHINE_UID_NAME_static;
 extern gss_OID_desc GSS_KRB5_NT_STRING_UID_NAME_static;
 
+/* See krb5/name.c. */
+extern OM_uint32 gss_krb5_name_cache_stats (OM_uint32 * minor_status,
+					    size_t * hits, size_t * misses);
+
 #endif /* GSS_KRB5_EXT_H */
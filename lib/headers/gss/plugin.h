@@ -0,0 +1,208 @@
+/* gss/plugin.h --- Header file for GSS-API mechanism plugins.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+/*
+ * This file contains the GNU GSS specific interface that mechanism
+ * plugins implement.  It is not included by gss.h.
+ *
+ * A plugin is a shared object listed in the gss/mech.conf file, see
+ * gss_set_mech_config(), which exports a gss_mech_plugin_desc named
+ * by GSS_MECH_PLUGIN_SYMBOL.  The library owns the context and
+ * credential handles; the plugin keeps its own state behind a pointer
+ * in each handle, which the functions below receive instead of the
+ * handle.  A function that creates state stores the pointer through
+ * its void ** parameter.  The state of a context is freed by
+ * delete_sec_context, which is also called when establishing the
+ * context fails; acquire_cred frees its own state when it fails, and
+ * release_cred frees it otherwise.  The OID and SASL name of the
+ * mechanism come from the configuration file.  Functions that are
+ * NULL make the corresponding GSS-API call return GSS_S_UNAVAILABLE.
+ *
+ */
+
+#ifndef GSS_PLUGIN_H
+# define GSS_PLUGIN_H
+
+# include <gss.h>
+
+/* Version of gss_mech_plugin_desc.  The library refuses plugins of
+   another version. */
+# define GSS_MECH_PLUGIN_VERSION 1
+
+/* Name of the gss_mech_plugin_desc that a plugin exports. */
+# define GSS_MECH_PLUGIN_SYMBOL "gss_mech_plugin"
+
+/* Maximum number of name types of a mechanism. */
+# define GSS_MECH_PLUGIN_MAX_NT 5
+
+typedef struct gss_mech_plugin_struct
+{
+  /* GSS_MECH_PLUGIN_VERSION. */
+  unsigned int version;
+  const char *mech_name;
+  const char *mech_description;
+  /* Terminated by GSS_C_NO_OID, unless all are used. */
+  gss_OID name_types[GSS_MECH_PLUGIN_MAX_NT];
+
+  OM_uint32 (*init_sec_context) (OM_uint32 * minor_status,
+				 void *cred_data,
+				 void **context_data,
+				 const gss_name_t target_name,
+				 const gss_OID mech_type,
+				 OM_uint32 req_flags,
+				 OM_uint32 time_req,
+				 const gss_channel_bindings_t
+				 input_chan_bindings,
+				 const gss_buffer_t input_token,
+				 gss_OID * actual_mech_type,
+				 gss_buffer_t output_token,
+				 OM_uint32 * ret_flags,
+				 OM_uint32 * time_rec);
+  /* The initial token is passed without its mechanism-independent
+     header. */
+  OM_uint32 (*accept_sec_context) (OM_uint32 * minor_status,
+				   void **context_data,
+				   void *cred_data,
+				   const gss_buffer_t input_token_buffer,
+				   const gss_channel_bindings_t
+				   input_chan_bindings,
+				   gss_name_t * src_name,
+				   gss_OID * mech_type,
+				   gss_buffer_t output_token,
+				   OM_uint32 * ret_flags,
+				   OM_uint32 * time_rec);
+  OM_uint32 (*delete_sec_context) (OM_uint32 * minor_status,
+				   void *context_data,
+				   gss_buffer_t output_token);
+  OM_uint32 (*context_time) (OM_uint32 * minor_status,
+			     void *context_data, OM_uint32 * time_rec);
+  OM_uint32 (*wrap_size_limit) (OM_uint32 * minor_status,
+				void *context_data,
+				int conf_req_flag,
+				gss_qop_t qop_req,
+				OM_uint32 req_output_size,
+				OM_uint32 * max_input_size);
+  /* The context is deleted with delete_sec_context afterwards. */
+  OM_uint32 (*export_sec_context) (OM_uint32 * minor_status,
+				   void *context_data,
+				   gss_buffer_t interprocess_token);
+  OM_uint32 (*import_sec_context) (OM_uint32 * minor_status,
+				   const gss_buffer_t interprocess_token,
+				   void **context_data);
+  OM_uint32 (*init_sec_context_fd) (OM_uint32 * minor_status,
+				    void *context_data, int *fd);
+
+  OM_uint32 (*get_mic) (OM_uint32 * minor_status,
+			void *context_data,
+			gss_qop_t qop_req,
+			const gss_buffer_t message_buffer,
+			gss_buffer_t message_token);
+  OM_uint32 (*verify_mic) (OM_uint32 * minor_status,
+			   void *context_data,
+			   const gss_buffer_t message_buffer,
+			   const gss_buffer_t token_buffer,
+			   gss_qop_t * qop_state);
+  OM_uint32 (*wrap) (OM_uint32 * minor_status,
+		     void *context_data,
+		     int conf_req_flag,
+		     gss_qop_t qop_req,
+		     const gss_buffer_t input_message_buffer,
+		     int *conf_state, gss_buffer_t output_message_buffer);
+  OM_uint32 (*unwrap) (OM_uint32 * minor_status,
+		       void *context_data,
+		       const gss_buffer_t input_message_buffer,
+		       gss_buffer_t output_message_buffer,
+		       int *conf_state, gss_qop_t * qop_state);
+  OM_uint32 (*wrap_iov) (OM_uint32 * minor_status,
+			 void *context_data,
+			 int conf_req_flag,
+			 gss_qop_t qop_req,
+			 int *conf_state,
+			 gss_iov_buffer_desc * iov, int iov_count);
+  OM_uint32 (*unwrap_iov) (OM_uint32 * minor_status,
+			   void *context_data,
+			   int *conf_state,
+			   gss_qop_t * qop_state,
+			   gss_iov_buffer_desc * iov, int iov_count);
+  OM_uint32 (*wrap_iov_length) (OM_uint32 * minor_status,
+				void *context_data,
+				int conf_req_flag,
+				gss_qop_t qop_req,
+				int *conf_state,
+				gss_iov_buffer_desc * iov, int iov_count);
+  OM_uint32 (*wrap_into) (OM_uint32 * minor_status,
+			  void *context_data,
+			  int conf_req_flag,
+			  gss_qop_t qop_req,
+			  const gss_buffer_t input_message_buffer,
+			  int *conf_state,
+			  gss_buffer_t output_message_buffer);
+  OM_uint32 (*unwrap_into) (OM_uint32 * minor_status,
+			    void *context_data,
+			    const gss_buffer_t input_message_buffer,
+			    gss_buffer_t output_message_buffer,
+			    int *conf_state, gss_qop_t * qop_state);
+  OM_uint32 (*get_mic_into) (OM_uint32 * minor_status,
+			     void *context_data,
+			     gss_qop_t qop_req,
+			     const gss_buffer_t message_buffer,
+			     gss_buffer_t message_token);
+
+  OM_uint32 (*acquire_cred) (OM_uint32 * minor_status,
+			     const gss_name_t desired_name,
+			     OM_uint32 time_req,
+			     const gss_OID_set desired_mechs,
+			     gss_cred_usage_t cred_usage,
+			     void **cred_data,
+			     gss_OID_set * actual_mechs,
+			     OM_uint32 * time_rec);
+  OM_uint32 (*release_cred) (OM_uint32 * minor_status, void *cred_data);
+  OM_uint32 (*inquire_cred) (OM_uint32 * minor_status,
+			     void *cred_data,
+			     gss_name_t * name,
+			     OM_uint32 * lifetime,
+			     gss_cred_usage_t * cred_usage,
+			     gss_OID_set * mechanisms);
+  OM_uint32 (*inquire_cred_by_mech) (OM_uint32 * minor_status,
+				     void *cred_data,
+				     const gss_OID mech_type,
+				     gss_name_t * name,
+				     OM_uint32 * initiator_lifetime,
+				     OM_uint32 * acceptor_lifetime,
+				     gss_cred_usage_t * cred_usage);
+
+  OM_uint32 (*canonicalize_name) (OM_uint32 * minor_status,
+				  const gss_name_t input_name,
+				  const gss_OID mech_type,
+				  gss_name_t * output_name);
+  OM_uint32 (*export_name) (OM_uint32 * minor_status,
+			    const gss_name_t input_name,
+			    gss_buffer_t exported_name);
+  OM_uint32 (*display_status) (OM_uint32 * minor_status,
+			       OM_uint32 status_value,
+			       int status_type,
+			       const gss_OID mech_type,
+			       OM_uint32 * message_context,
+			       gss_buffer_t status_string);
+} gss_mech_plugin_desc;
+
+#endif /* GSS_PLUGIN_H */
@@ -32,6 +32,7 @@
 #include <string.h>
 #include <time.h>
 #include <errno.h>
+#include <stdint.h>
 
 /* Get i18n. */
 #include <gettext.h>
@@ -42,34 +43,171 @@
 /* Get specification. */
 #include <gss.h>
 
+/* Get mutexes for the process-wide caches.  Without threads, the
+   caches are simply used unlocked. */
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+# define _GSS_LOCK_DEFINE(name) \
+  static pthread_mutex_t name = PTHREAD_MUTEX_INITIALIZER
+# define _gss_lock(name) pthread_mutex_lock (&(name))
+# define _gss_unlock(name) pthread_mutex_unlock (&(name))
+#else
+# define _GSS_LOCK_DEFINE(name) static int name
+# define _gss_lock(name) ((void) (name))
+# define _gss_unlock(name) ((void) (name))
+#endif
+
+/* Loads and stores of words that are read without a lock. */
+#if defined __ATOMIC_ACQUIRE
+# define _gss_load(p) __atomic_load_n (p, __ATOMIC_ACQUIRE)
+# define _gss_store(p, v) __atomic_store_n (p, v, __ATOMIC_RELEASE)
+#elif defined __GNUC__
+# define _gss_load(p) __sync_fetch_and_add (p, 0)
+# define _gss_store(p, v) (__sync_synchronize (), *(p) = (v))
+#else
+# define _gss_load(p) (*(p))
+# define _gss_store(p, v) (*(p) = (v))
+#endif
+
+/* Atomic updates of reference counts. */
+#if defined __GNUC__
+# define _gss_add_fetch(p, v) __sync_add_and_fetch (p, v)
+# define _gss_cas(p, old, new) __sync_bool_compare_and_swap (p, old, new)
+#else
+# define _gss_add_fetch(p, v) (*(p) += (v))
+# define _gss_cas(p, old, new) (*(p) == (old) ? (*(p) = (new), 1) : 0)
+#endif
+
 typedef struct gss_name_struct
 {
   size_t length;
   char *value;
   gss_OID type;
+  /* Names are immutable and shared by all their handles, see name.c.
+     The value is zero terminated and stored after the struct. */
+  unsigned long refcount;
+  int interned;
+  uint64_t hash;
+  struct gss_name_struct *next;
 } gss_name_desc;
 
 typedef struct gss_cred_id_struct
 {
   gss_OID mech;
+  /* Entry of MECH in the registry, see meta.c. */
+  struct _gss_mech_api_struct *api;
 #ifdef USE_KERBEROS5
   struct _gss_krb5_cred_struct *krb5;
 #endif
+  /* State of a mechanism plugin, see gss/plugin.h. */
+  void *mech_data;
 } gss_cred_id_desc;
 
 typedef struct gss_ctx_id_struct
 {
   gss_OID mech;
+  /* Entry of MECH in the registry, see meta.c. */
+  struct _gss_mech_api_struct *api;
 #ifdef USE_KERBEROS5
   struct _gss_krb5_ctx_struct *krb5;
 #endif
+  /* State of a mechanism plugin, see gss/plugin.h. */
+  void *mech_data;
 } gss_ctx_id_desc;
 
 /* asn1.c */
+extern size_t
+_gss_encapsulate_token_header (const char *oid, size_t oidlen,
+			       size_t inlen, char *out);
+extern int
+_gss_decapsulate_token (const char *in, size_t inlen,
+			char **oid, size_t * oidlen,
+			char **out, size_t * outlen);
 extern OM_uint32
 _gss_encapsulate_token_prefix (const char *prefix, size_t prefixlen,
 			       const char *in, size_t inlen,
 			       const char *oid, OM_uint32 oidlen,
 			       void **out, size_t * outlen);
 
+/* error.c */
+extern void _gss_textdomain (void);
+
+/* misc.c */
+extern OM_uint32
+_gss_buffer_fits (OM_uint32 * minor_status, gss_buffer_t buffer,
+		  size_t len);
+extern int _gss_oid_set_member (const gss_OID_set set, const gss_OID oid);
+extern void _gss_oid_set_share (gss_OID_set set);
+
+/* msg.c */
+extern gss_iov_buffer_t
+_gss_iov_find (gss_iov_buffer_desc * iov, int iov_count, OM_uint32 type);
+extern size_t
+_gss_iov_data_length (const gss_iov_buffer_desc * iov, int iov_count);
+extern OM_uint32
+_gss_iov_reserve (OM_uint32 * minor_status, gss_iov_buffer_t buf,
+		  size_t len);
+
+/* name.c */
+extern OM_uint32
+_gss_name_new (OM_uint32 * minor_status, const char *value, size_t length,
+	       const gss_OID type, gss_name_t * output_name);
+
+/* rcache.c */
+typedef struct _gss_rcache_struct *_gss_rcache_t;
+#define _GSS_RCACHE_HASH_INIT UINT64_C (14695981039346656037)
+enum
+{
+  _GSS_RCACHE_OK,
+  _GSS_RCACHE_REPLAY,
+  _GSS_RCACHE_FULL
+};
+extern uint64_t _gss_rcache_hash (uint64_t h, const void *data, size_t len);
+extern int
+_gss_rcache_open (const char *file, size_t slots, _gss_rcache_t * out);
+extern void _gss_rcache_close (_gss_rcache_t rc);
+extern int
+_gss_rcache_insert (_gss_rcache_t rc, uint64_t hash,
+		    time_t expires, time_t now);
+extern int _gss_rcache_default (time_t lifetime, _gss_rcache_t * out);
+
+/* stats.c */
+/* The entry points counted, in the order of context.c, msg.c and
+   cred.c. */
+enum
+{
+  _GSS_STATS_INIT_SEC_CONTEXT,
+  _GSS_STATS_INIT_SEC_CONTEXT_FD,
+  _GSS_STATS_ACCEPT_SEC_CONTEXT,
+  _GSS_STATS_DELETE_SEC_CONTEXT,
+  _GSS_STATS_PROCESS_CONTEXT_TOKEN,
+  _GSS_STATS_CONTEXT_TIME,
+  _GSS_STATS_INQUIRE_CONTEXT,
+  _GSS_STATS_WRAP_SIZE_LIMIT,
+  _GSS_STATS_EXPORT_SEC_CONTEXT,
+  _GSS_STATS_IMPORT_SEC_CONTEXT,
+  _GSS_STATS_GET_MIC,
+  _GSS_STATS_VERIFY_MIC,
+  _GSS_STATS_WRAP,
+  _GSS_STATS_UNWRAP,
+  _GSS_STATS_WRAP_IOV,
+  _GSS_STATS_UNWRAP_IOV,
+  _GSS_STATS_WRAP_IOV_LENGTH,
+  _GSS_STATS_RELEASE_IOV_BUFFER,
+  _GSS_STATS_WRAP_INTO,
+  _GSS_STATS_UNWRAP_INTO,
+  _GSS_STATS_GET_MIC_INTO,
+  _GSS_STATS_ACQUIRE_CRED,
+  _GSS_STATS_ADD_CRED,
+  _GSS_STATS_INQUIRE_CRED,
+  _GSS_STATS_INQUIRE_CRED_BY_MECH,
+  _GSS_STATS_RELEASE_CRED,
+  _GSS_STATS_MAX
+};
+extern uint64_t _gss_stats_start (void);
+extern OM_uint32
+_gss_stats_end (int entry, uint64_t start, OM_uint32 maj_stat);
+extern void _gss_stats_context (int delta);
+extern void _gss_stats_cred (int delta);
+
 #endif /* _INTERNAL_H */
@@ -261,12 +261,20 @@ _gss_krb5_checksum_parse (OM_uint32 * minor_status,
       return GSS_S_FAILURE;
     }
 
-  if (memcmp (out, "\x10\x00\x00\x00", 4) != 0)
+  if (len < 24 || memcmp (out, "\x10\x00\x00\x00", 4) != 0)
     {
       free (out);
       return GSS_S_DEFECTIVE_TOKEN;
     }
 
+  /* The flags the initiator asked for, see _gss_krb5_checksum_pack. */
+  k5->flags = ((out[20] & 0xFF) | (out[21] & 0xFF) << 8
+	       | (out[22] & 0xFF) << 16 | (out[23] & 0xFFUL) << 24);
+  k5->flags &=			/* GSS_C_DELEG_FLAG | */
+    GSS_C_MUTUAL_FLAG |
+    GSS_C_REPLAY_FLAG | GSS_C_SEQUENCE_FLAG |
+    GSS_C_CONF_FLAG | GSS_C_INTEG_FLAG;
+
   if (input_chan_bindings != GSS_C_NO_CHANNEL_BINDINGS)
     {
       rc = hash_cb (minor_status, context_handle,
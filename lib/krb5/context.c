@@ -26,10 +26,260 @@
 /* Get checksum (un)packers. */
 #include "checksum.h"
 
+#ifdef HAVE_PTHREAD_H
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
 #define TOK_LEN 2
 #define TOK_AP_REQ "\x01\x00"
 #define TOK_AP_REP "\x02\x00"
 
+/* Maximum difference between the time in an authenticator and the
+   local time, in seconds. */
+#define CLOCK_SKEW 300
+
+/* Keep the service ticket K5->TKT for later contexts, or fail if
+   there is none. */
+static OM_uint32
+init_tkt_found (OM_uint32 * minor_status, _gss_krb5_ctx_t k5,
+		OM_uint32 time_req)
+{
+  if (!k5->tkt)
+    {
+      if (minor_status)
+	*minor_status = GSS_KRB5_S_KG_CCACHE_NOMATCH;
+      return GSS_S_NO_CRED;
+    }
+
+  if (time_req == 0)
+    _gss_krb5_pool_add_tkt (k5->sh, k5->peerptr->value, k5->tkt);
+
+  return GSS_S_COMPLETE;
+}
+
+#ifdef HAVE_PTHREAD_H
+
+/* With GSS_C_ASYNC_FLAG, a service ticket that has to be requested
+   from the KDC is requested by a helper thread, since Shishi only
+   talks to the KDC synchronously.  The context hands its Shishi
+   handle over to the thread, so that nothing else uses the handle
+   while the thread runs.  The thread writes a byte to a pipe when it
+   is done; the application polls the other end, and the next
+   gss_init_sec_context picks up the ticket and the handle.  A context
+   deleted before then leaves the thread to clean up after itself. */
+typedef struct _gss_krb5_pending_struct
+{
+  pthread_t thread;
+  int fds[2];
+  Shishi *sh;
+  Shishi_tkts_hint hint;
+  Shishi_tkt *tkt;
+  /* Protects DONE and ABANDONED. */
+  pthread_mutex_t lock;
+  int done;
+  int abandoned;
+} _gss_krb5_pending_desc, *_gss_krb5_pending_t;
+
+/* Free P, and give back its handle. */
+static void
+pending_free (_gss_krb5_pending_t p)
+{
+  _gss_krb5_pool_put (p->sh);
+  pthread_mutex_destroy (&p->lock);
+  close (p->fds[0]);
+  close (p->fds[1]);
+  free (p->hint.server);
+  free (p);
+}
+
+static void *
+pending_run (void *arg)
+{
+  _gss_krb5_pending_t p = arg;
+  int abandoned;
+  char c = 0;
+
+  p->tkt = shishi_tkts_get (shishi_tkts_default (p->sh), &p->hint);
+  if (p->tkt)
+    _gss_krb5_pool_save (p->sh);
+
+  while (write (p->fds[1], &c, 1) < 0 && errno == EINTR)
+    ;
+
+  pthread_mutex_lock (&p->lock);
+  p->done = 1;
+  abandoned = p->abandoned;
+  pthread_mutex_unlock (&p->lock);
+
+  /* The context no longer knows about P. */
+  if (abandoned)
+    pending_free (p);
+
+  return NULL;
+}
+
+/* Take the ticket and the handle back from the finished thread of
+   K5, and free its state. */
+static void
+pending_done (_gss_krb5_ctx_t k5)
+{
+  _gss_krb5_pending_t p = k5->pending;
+
+  /* The thread has written its byte, so it is about to exit. */
+  pthread_join (p->thread, NULL);
+  k5->sh = p->sh;
+  k5->tkt = p->tkt;
+  p->sh = NULL;
+  pending_free (p);
+  k5->pending = NULL;
+}
+
+/* Detach the thread of K5, if any, without waiting for it.  It frees
+   its state, and gives back the handle, when the KDC has answered. */
+static void
+pending_abandon (_gss_krb5_ctx_t k5)
+{
+  _gss_krb5_pending_t p = k5->pending;
+  int done;
+
+  if (p == NULL)
+    return;
+
+  /* Once the lock is released, the thread may free P. */
+  pthread_mutex_lock (&p->lock);
+  p->abandoned = 1;
+  done = p->done;
+  pthread_detach (p->thread);
+  pthread_mutex_unlock (&p->lock);
+
+  if (done)
+    pending_free (p);
+  k5->pending = NULL;
+}
+
+static OM_uint32
+pending_start (OM_uint32 * minor_status, _gss_krb5_ctx_t k5,
+	       const Shishi_tkts_hint * hint)
+{
+  _gss_krb5_pending_t p;
+  int err;
+
+  p = calloc (1, sizeof (*p));
+  if (!p)
+    {
+      if (minor_status)
+	*minor_status = ENOMEM;
+      return GSS_S_FAILURE;
+    }
+
+  p->hint = *hint;
+  p->hint.server = strdup (hint->server);
+  if (!p->hint.server)
+    {
+      free (p);
+      if (minor_status)
+	*minor_status = ENOMEM;
+      return GSS_S_FAILURE;
+    }
+
+  if (pipe (p->fds) != 0)
+    {
+      err = errno;
+      free (p->hint.server);
+      free (p);
+      if (minor_status)
+	*minor_status = err;
+      return GSS_S_FAILURE;
+    }
+  fcntl (p->fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl (p->fds[1], F_SETFD, FD_CLOEXEC);
+  fcntl (p->fds[0], F_SETFL, O_NONBLOCK);
+
+  pthread_mutex_init (&p->lock, NULL);
+  p->sh = k5->sh;
+
+  err = pthread_create (&p->thread, NULL, pending_run, p);
+  if (err != 0)
+    {
+      p->sh = NULL;
+      pending_free (p);
+      if (minor_status)
+	*minor_status = err;
+      return GSS_S_FAILURE;
+    }
+
+  k5->sh = NULL;
+  k5->pending = p;
+
+  return GSS_S_WOULD_BLOCK;
+}
+
+static OM_uint32
+pending_finish (OM_uint32 * minor_status, _gss_krb5_ctx_t k5,
+		OM_uint32 time_req)
+{
+  char c;
+
+  if (read (k5->pending->fds[0], &c, 1) != 1)
+    return GSS_S_WOULD_BLOCK;
+
+  pending_done (k5);
+
+  return init_tkt_found (minor_status, k5, time_req);
+}
+
+#endif
+
+/* Find the service ticket for TARGET_NAME, from the index of the
+   handle, the ticket set, or the KDC, in that order. */
+static OM_uint32
+init_tkt (OM_uint32 * minor_status, _gss_krb5_ctx_t k5,
+	  const gss_name_t target_name, OM_uint32 req_flags,
+	  OM_uint32 time_req)
+{
+  OM_uint32 maj_stat;
+  Shishi_tkts_hint hint;
+
+#ifdef HAVE_PTHREAD_H
+  if (k5->pending)
+    return pending_finish (minor_status, k5, time_req);
+#endif
+
+  maj_stat = gss_krb5_canonicalize_name (minor_status, target_name,
+					 GSS_C_NO_OID, &k5->peerptr);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  /* Look in the index of the handle first, see pool.c.  A requested
+     lifetime is passed on to Shishi. */
+  if (time_req == 0)
+    {
+      k5->tkt = _gss_krb5_pool_find_tkt (k5->sh, k5->peerptr->value);
+      if (k5->tkt)
+	return GSS_S_COMPLETE;
+    }
+
+  memset (&hint, 0, sizeof (hint));
+  hint.server = k5->peerptr->value;
+  hint.endtime = time_req;
+
+  k5->tkt = shishi_tkts_find (shishi_tkts_default (k5->sh), &hint);
+  if (!k5->tkt)
+    {
+#ifdef HAVE_PTHREAD_H
+      /* Only a request to the KDC is worth a thread. */
+      if (req_flags & GSS_C_ASYNC_FLAG)
+	return pending_start (minor_status, k5, &hint);
+#endif
+      k5->tkt = shishi_tkts_get (shishi_tkts_default (k5->sh), &hint);
+      if (k5->tkt)
+	_gss_krb5_pool_save (k5->sh);
+    }
+
+  return init_tkt_found (minor_status, k5, time_req);
+}
+
 /* Request part of gss_krb5_init_sec_context.  Assumes that
    context_handle is valid, and has krb5 specific structure, and that
    output_token is valid and cleared. */
@@ -53,25 +303,12 @@ init_request (OM_uint32 * minor_status,
   size_t cksumlen, derlen;
   int rc;
   OM_uint32 maj_stat;
-  Shishi_tkts_hint hint;
 
   /* Get service ticket. */
-  maj_stat = gss_krb5_canonicalize_name (minor_status, target_name,
-					 GSS_C_NO_OID, &k5->peerptr);
-  if (GSS_ERROR (maj_stat))
+  maj_stat = init_tkt (minor_status, k5, target_name, req_flags, time_req);
+  if (maj_stat != GSS_S_COMPLETE)
     return maj_stat;
-
-  memset (&hint, 0, sizeof (hint));
-  hint.server = k5->peerptr->value;
-  hint.endtime = time_req;
-
-  k5->tkt = shishi_tkts_get (shishi_tkts_default (k5->sh), &hint);
-  if (!k5->tkt)
-    {
-      if (minor_status)
-	*minor_status = GSS_KRB5_S_KG_CCACHE_NOMATCH;
-      return GSS_S_NO_CRED;
-    }
+  k5->endtime = shishi_tkt_endctime (k5->tkt);
 
   /* Create Authenticator checksum field. */
   maj_stat = _gss_krb5_checksum_pack (minor_status, initiator_cred_handle,
@@ -134,28 +371,21 @@ init_reply (OM_uint32 * minor_status,
 {
   gss_ctx_id_t ctx = *context_handle;
   _gss_krb5_ctx_t k5 = ctx->krb5;
-  OM_uint32 tmp_min_stat;
   gss_buffer_desc data;
   int rc;
 
-  if (gss_decapsulate_token (input_token, GSS_KRB5, &data) != GSS_S_COMPLETE)
+  if (gss_decapsulate_token_view (input_token, GSS_KRB5, &data)
+      != GSS_S_COMPLETE)
     return GSS_S_DEFECTIVE_TOKEN;
 
   if (data.length < TOK_LEN)
-    {
-      gss_release_buffer (&tmp_min_stat, &data);
-      return GSS_S_DEFECTIVE_TOKEN;
-    }
+    return GSS_S_DEFECTIVE_TOKEN;
 
   if (memcmp (data.value, TOK_AP_REP, TOK_LEN) != 0)
-    {
-      gss_release_buffer (&tmp_min_stat, &data);
-      return GSS_S_DEFECTIVE_TOKEN;
-    }
+    return GSS_S_DEFECTIVE_TOKEN;
 
   rc = shishi_ap_rep_der_set (k5->ap, (char *) data.value + TOK_LEN,
 			      data.length - TOK_LEN);
-  gss_release_buffer (&tmp_min_stat, &data);
   if (rc != SHISHI_OK)
     return GSS_S_DEFECTIVE_TOKEN;
 
@@ -223,7 +453,9 @@ gss_krb5_init_sec_context (OM_uint32 * minor_status,
 	  return GSS_S_FAILURE;
 	}
 
-      rc = shishi_init (&k5->sh);
+      /* Borrow a handle for the default ticket cache and
+         configuration, see pool.c. */
+      rc = _gss_krb5_pool_get (NULL, NULL, NULL, &k5->sh);
       if (rc != SHISHI_OK)
 	return GSS_S_FAILURE;
     }
@@ -241,7 +473,7 @@ gss_krb5_init_sec_context (OM_uint32 * minor_status,
 			       input_token,
 			       actual_mech_type,
 			       output_token, ret_flags, time_rec);
-      if (GSS_ERROR (maj_stat))
+      if (GSS_ERROR (maj_stat) || maj_stat == GSS_S_WOULD_BLOCK)
 	return maj_stat;
 
       k5->flags = req_flags & (	/* GSS_C_DELEG_FLAG | */
@@ -256,6 +488,8 @@ gss_krb5_init_sec_context (OM_uint32 * minor_status,
 	*ret_flags = k5->flags;
 
       k5->key = shishi_ap_key (k5->ap);
+      if (_gss_krb5_derive_keys (k5) != SHISHI_OK)
+	return GSS_S_FAILURE;
       k5->reqdone = 1;
     }
   else if (k5->reqdone && k5->flags & GSS_C_MUTUAL_FLAG && !k5->repdone)
@@ -283,14 +517,157 @@ gss_krb5_init_sec_context (OM_uint32 * minor_status,
     maj_stat = GSS_S_FAILURE;
 
   if (time_rec)
-    *time_rec = gss_krb5_tktlifetime (k5->tkt);
+    *time_rec = gss_krb5_lifetime (k5->endtime);
 
   return maj_stat;
 }
 
+/* Find the service key for the ticket in the AP-REQ of K5, for
+   accepting without a credential.  The key is looked up in the
+   default hostkeys file by the server name, realm, key version and
+   encryption type of the ticket, so no trial decryption is needed.
+   The key must be released with shishi_key_done. */
+static OM_uint32
+default_acceptor_key (OM_uint32 * minor_status, _gss_krb5_ctx_t k5,
+		      Shishi_key ** key)
+{
+  Shishi_asn1 ticket;
+  char *server = NULL, *realm = NULL;
+  size_t serverlen, realmlen;
+  int32_t etype;
+  uint32_t kvno;
+  int rc;
+
+  rc = shishi_apreq_get_ticket (k5->sh, shishi_ap_req (k5->ap), &ticket);
+  if (rc != SHISHI_OK)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  rc = shishi_ticket_server (k5->sh, ticket, &server, &serverlen);
+  if (rc == SHISHI_OK)
+    rc = shishi_ticket_realm_get (k5->sh, ticket, &realm, &realmlen);
+  if (rc == SHISHI_OK)
+    rc = shishi_ticket_get_enc_part_etype (k5->sh, ticket, &etype);
+  /* The key version is optional. */
+  if (rc == SHISHI_OK
+      && shishi_asn1_read_uint32 (k5->sh, ticket, "enc-part.kvno",
+				  &kvno) != SHISHI_OK)
+    kvno = UINT32_MAX;
+  shishi_asn1_done (k5->sh, ticket);
+
+  if (rc == SHISHI_OK)
+    rc = _gss_krb5_keytab_find (k5->sh,
+				shishi_hostkeys_default_file (k5->sh),
+				server, realm, kvno, etype, key);
+  free (server);
+  free (realm);
+
+  if (rc != SHISHI_OK)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  if (!*key)
+    {
+      if (minor_status)
+	*minor_status = GSS_KRB5_S_KG_KEYTAB_NOMATCH;
+      return GSS_S_NO_CRED;
+    }
+
+  return GSS_S_COMPLETE;
+}
+
+/* Reject the authenticator in the AP-REQ of K5 if it is outside the
+   clock skew, or if it was seen before.  It is identified by the
+   client, its time, and a hash of the encrypted authenticator, which
+   has a random confounder.  The ticket and the AP options are not
+   included, since they are not protected by the authenticator. */
+static OM_uint32
+check_replay (OM_uint32 * minor_status, _gss_krb5_ctx_t k5)
+{
+  Shishi_asn1 authenticator = shishi_ap_authenticator (k5->ap);
+  _gss_rcache_t rcache;
+  char *client = NULL, *ctime = NULL, *cipher = NULL;
+  size_t clientlen, cipherlen;
+  uint32_t cusec;
+  unsigned char buf[4];
+  uint64_t hash;
+  time_t t, now;
+  int rc;
+
+  rc = shishi_authenticator_clientrealm (k5->sh, authenticator,
+					 &client, &clientlen);
+  if (rc == SHISHI_OK)
+    rc = shishi_authenticator_ctime (k5->sh, authenticator, &ctime);
+  if (rc == SHISHI_OK)
+    rc = shishi_authenticator_cusec_get (k5->sh, authenticator, &cusec);
+  if (rc == SHISHI_OK)
+    rc = shishi_asn1_read (k5->sh, shishi_ap_req (k5->ap),
+			   "authenticator.cipher", &cipher, &cipherlen);
+  if (rc != SHISHI_OK)
+    {
+      free (client);
+      free (ctime);
+      return GSS_S_DEFECTIVE_TOKEN;
+    }
+
+  t = shishi_generalize_ctime (k5->sh, ctime);
+  now = time (NULL);
+
+  buf[0] = (cusec >> 24) & 0xFF;
+  buf[1] = (cusec >> 16) & 0xFF;
+  buf[2] = (cusec >> 8) & 0xFF;
+  buf[3] = cusec & 0xFF;
+
+  hash = _gss_rcache_hash (_GSS_RCACHE_HASH_INIT, client, clientlen);
+  hash = _gss_rcache_hash (hash, ctime, strlen (ctime));
+  hash = _gss_rcache_hash (hash, buf, sizeof (buf));
+  hash = _gss_rcache_hash (hash, cipher, cipherlen);
+
+  free (client);
+  free (ctime);
+  free (cipher);
+
+  if (t == (time_t) -1 || t < now - CLOCK_SKEW)
+    return GSS_S_FAILURE | GSS_S_OLD_TOKEN;
+
+  if (t > now + CLOCK_SKEW)
+    {
+      if (minor_status)
+	*minor_status = GSS_KRB5_S_G_VALIDATE_FAILED;
+      return GSS_S_FAILURE;
+    }
+
+  /* Entries are kept from up to CLOCK_SKEW before NOW until
+     CLOCK_SKEW after it. */
+  rc = _gss_rcache_default (2 * CLOCK_SKEW, &rcache);
+  if (rc != 0)
+    {
+      if (minor_status)
+	*minor_status = rc;
+      return GSS_S_FAILURE;
+    }
+
+  switch (_gss_rcache_insert (rcache, hash, t + CLOCK_SKEW, now))
+    {
+    case _GSS_RCACHE_OK:
+      return GSS_S_COMPLETE;
+
+    case _GSS_RCACHE_REPLAY:
+      return GSS_S_FAILURE | GSS_S_DUPLICATE_TOKEN;
+
+    default:
+      if (minor_status)
+	*minor_status = ENOSPC;
+      return GSS_S_FAILURE;
+    }
+}
+
 /* Allows a remotely initiated security context between the
    application and a remote peer to be established, using krb5.
-   Assumes context_handle is valid. */
+   Assumes context_handle is valid, and that the caller has allocated
+   a new context, without krb5 specific structure, on the first call.
+   INPUT_TOKEN_BUFFER is the inner token, without the
+   mechanism-independent header, which the caller has already
+   parsed.  Without a credential, any principal with a key in the
+   default hostkeys file is accepted. */
 OM_uint32
 gss_krb5_accept_sec_context (OM_uint32 * minor_status,
 			     gss_ctx_id_t * context_handle,
@@ -304,11 +681,12 @@ gss_krb5_accept_sec_context (OM_uint32 * minor_status,
 			     OM_uint32 * time_rec,
 			     gss_cred_id_t * delegated_cred_handle)
 {
-  gss_buffer_desc in;
-  gss_ctx_id_t cx;
+  const gss_buffer_t in = input_token_buffer;
+  gss_ctx_id_t cx = *context_handle;
   _gss_krb5_ctx_t cxk5;
-  _gss_krb5_cred_t crk5;
-  OM_uint32 tmp_min_stat;
+  _gss_krb5_cred_t crk5 = NULL;
+  Shishi *sh;
+  OM_uint32 maj_stat;
   int rc;
 
   if (minor_status)
@@ -317,68 +695,62 @@ gss_krb5_accept_sec_context (OM_uint32 * minor_status,
   if (ret_flags)
     *ret_flags = 0;
 
-  if (!acceptor_cred_handle)
-    /* XXX support GSS_C_NO_CREDENTIAL: acquire_cred() default server */
-    return GSS_S_NO_CRED;
-
-  if (*context_handle)
+  /* The context is established by the first token. */
+  if (cx->krb5)
     return GSS_S_FAILURE;
 
-  crk5 = acceptor_cred_handle->krb5;
-
-  cx = calloc (sizeof (*cx), 1);
-  if (!cx)
-    {
-      if (minor_status)
-	*minor_status = ENOMEM;
-      return GSS_S_FAILURE;
-    }
+  /* The credential only lends its key, as it may be used by other
+     threads. */
+  if (acceptor_cred_handle)
+    crk5 = acceptor_cred_handle->krb5;
+  if (_gss_krb5_pool_get_server (&sh) != SHISHI_OK)
+    return GSS_S_FAILURE;
 
   cxk5 = calloc (sizeof (*cxk5), 1);
   if (!cxk5)
     {
-      free (cx);
+      _gss_krb5_pool_put (sh);
       if (minor_status)
 	*minor_status = ENOMEM;
       return GSS_S_FAILURE;
     }
 
-  cx->mech = GSS_KRB5;
   cx->krb5 = cxk5;
   /* XXX cx->peer?? */
-  *context_handle = cx;
 
-  cxk5->sh = crk5->sh;
-  cxk5->key = crk5->key;
+  cxk5->sh = sh;
+  if (crk5)
+    cxk5->key = crk5->key;
   cxk5->acceptor = 1;
 
   rc = shishi_ap (cxk5->sh, &cxk5->ap);
   if (rc != SHISHI_OK)
     return GSS_S_FAILURE;
 
-  rc = gss_decapsulate_token (input_token_buffer, GSS_KRB5, &in);
-  if (rc != GSS_S_COMPLETE)
+  if (in->length < TOK_LEN)
     return GSS_S_BAD_MIC;
 
-  if (in.length < TOK_LEN)
-    {
-      gss_release_buffer (&tmp_min_stat, &in);
-      return GSS_S_BAD_MIC;
-    }
-
-  if (memcmp (in.value, TOK_AP_REQ, TOK_LEN) != 0)
-    {
-      gss_release_buffer (&tmp_min_stat, &in);
-      return GSS_S_BAD_MIC;
-    }
+  if (memcmp (in->value, TOK_AP_REQ, TOK_LEN) != 0)
+    return GSS_S_BAD_MIC;
 
-  rc = shishi_ap_req_der_set (cxk5->ap, (char *) in.value + TOK_LEN,
-			      in.length - TOK_LEN);
-  gss_release_buffer (&tmp_min_stat, &in);
+  rc = shishi_ap_req_der_set (cxk5->ap, (char *) in->value + TOK_LEN,
+			      in->length - TOK_LEN);
   if (rc != SHISHI_OK)
     return GSS_S_FAILURE;
 
-  rc = shishi_ap_req_process (cxk5->ap, crk5->key);
+  if (crk5)
+    rc = shishi_ap_req_process (cxk5->ap, crk5->key);
+  else
+    {
+      Shishi_key *key;
+
+      maj_stat = default_acceptor_key (minor_status, cxk5, &key);
+      if (GSS_ERROR (maj_stat))
+	return maj_stat;
+
+      rc = shishi_ap_req_process (cxk5->ap, key);
+      shishi_key_done (key);
+    }
   if (rc != SHISHI_OK)
     {
       if (minor_status)
@@ -386,6 +758,10 @@ gss_krb5_accept_sec_context (OM_uint32 * minor_status,
       return GSS_S_FAILURE;
     }
 
+  maj_stat = check_replay (minor_status, cxk5);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
   rc = shishi_authenticator_seqnumber_get (cxk5->sh,
 					   shishi_ap_authenticator (cxk5->ap),
 					   &cxk5->initseqnr);
@@ -398,9 +774,12 @@ gss_krb5_accept_sec_context (OM_uint32 * minor_status,
     return GSS_S_FAILURE;
 
   cxk5->tkt = shishi_ap_tkt (cxk5->ap);
+  cxk5->endtime = shishi_tkt_endctime (cxk5->tkt);
   cxk5->key = shishi_ap_key (cxk5->ap);
+  if (_gss_krb5_derive_keys (cxk5) != SHISHI_OK)
+    return GSS_S_FAILURE;
 
-  if (shishi_apreq_mutual_required_p (crk5->sh, shishi_ap_req (cxk5->ap)))
+  if (shishi_apreq_mutual_required_p (cxk5->sh, shishi_ap_req (cxk5->ap)))
     {
       Shishi_asn1 aprep;
       char *der;
@@ -424,7 +803,7 @@ gss_krb5_accept_sec_context (OM_uint32 * minor_status,
 	  cxk5->acceptseqnr = 0;
 	}
 
-      rc = shishi_asn1_to_der (crk5->sh, aprep, &der, &len);
+      rc = shishi_asn1_to_der (cxk5->sh, aprep, &der, &len);
       if (rc != SHISHI_OK)
 	{
 	  printf ("Error der encoding aprep: %s\n", shishi_strerror (rc));
@@ -440,8 +819,7 @@ gss_krb5_accept_sec_context (OM_uint32 * minor_status,
       if (rc != 0)
 	return GSS_S_FAILURE;
 
-      if (ret_flags)
-	*ret_flags = GSS_C_MUTUAL_FLAG;
+      cxk5->flags |= GSS_C_MUTUAL_FLAG;
     }
   else
     {
@@ -451,31 +829,28 @@ gss_krb5_accept_sec_context (OM_uint32 * minor_status,
 
   if (src_name)
     {
-      gss_name_t p;
-
-      p = malloc (sizeof (*p));
-      if (!p)
-	{
-	  if (minor_status)
-	    *minor_status = ENOMEM;
-	  return GSS_S_FAILURE;
-	}
+      char *client;
+      size_t clientlen;
 
       rc = shishi_encticketpart_client (cxk5->sh,
 					shishi_tkt_encticketpart (cxk5->tkt),
-					&p->value, &p->length);
+					&client, &clientlen);
       if (rc != SHISHI_OK)
 	return GSS_S_FAILURE;
 
-      p->type = GSS_KRB5_NT_PRINCIPAL_NAME;
-
-      *src_name = p;
+      maj_stat = _gss_name_new (minor_status, client, clientlen,
+				GSS_KRB5_NT_PRINCIPAL_NAME, src_name);
+      free (client);
+      if (GSS_ERROR (maj_stat))
+	return maj_stat;
     }
 
   /* PROT_READY is not mentioned in 1964/gssapi-cfx but we support
      it anyway. */
+  cxk5->flags |= GSS_C_PROT_READY_FLAG;
+
   if (ret_flags)
-    *ret_flags |= GSS_C_PROT_READY_FLAG;
+    *ret_flags = cxk5->flags;
 
   if (minor_status)
     *minor_status = 0;
@@ -491,21 +866,57 @@ gss_krb5_delete_sec_context (OM_uint32 * minor_status,
 {
   _gss_krb5_ctx_t k5 = (*context_handle)->krb5;
 
+  if (minor_status)
+    *minor_status = 0;
+
+  /* Establishing the context failed before it was set up. */
+  if (k5 == NULL)
+    return GSS_S_COMPLETE;
+
+#ifdef HAVE_PTHREAD_H
+  /* The ticket request owns the handle until the KDC answers. */
+  pending_abandon (k5);
+#endif
+
   if (k5->peerptr != GSS_C_NO_NAME)
     gss_release_name (NULL, &k5->peerptr);
 
+  _gss_krb5_done_keys (k5);
+
   if (k5->ap)
     shishi_ap_done (k5->ap);
+  if (k5->imported && k5->key)
+    shishi_key_done (k5->key);
 
-  if (!k5->acceptor)
-    shishi_done (k5->sh);
+  _gss_krb5_pool_put (k5->sh);
   free (k5);
+  (*context_handle)->krb5 = NULL;
 
   if (minor_status)
     *minor_status = 0;
   return GSS_S_COMPLETE;
 }
 
+/* Return the descriptor that becomes readable when the ticket request
+   started for GSS_C_ASYNC_FLAG is done.  Assumes context_handle and
+   fd are valid. */
+OM_uint32
+gss_krb5_init_sec_context_fd (OM_uint32 * minor_status,
+			      const gss_ctx_id_t context_handle, int *fd)
+{
+#ifdef HAVE_PTHREAD_H
+  _gss_krb5_ctx_t k5 = context_handle->krb5;
+
+  if (k5 && k5->pending)
+    {
+      *fd = k5->pending->fds[0];
+      return GSS_S_COMPLETE;
+    }
+#endif
+
+  return GSS_S_FAILURE;
+}
+
 /* Determines the number of seconds for which the specified krb5
    context will remain valid.  Assumes context_handle is valid. */
 OM_uint32
@@ -517,7 +928,7 @@ gss_krb5_context_time (OM_uint32 * minor_status,
 
   if (time_rec)
     {
-      *time_rec = gss_krb5_tktlifetime (k5->tkt);
+      *time_rec = gss_krb5_lifetime (k5->endtime);
 
       if (*time_rec == 0)
 	{
@@ -531,3 +942,188 @@ gss_krb5_context_time (OM_uint32 * minor_status,
     *minor_status = 0;
   return GSS_S_COMPLETE;
 }
+
+/* Interprocess tokens.  After the mechanism-independent header with
+   the Kerberos V5 OID, they hold, with integers in network byte
+   order:
+
+     version (1)  acceptor (1)  flags (4)  initseqnr (4)
+     acceptseqnr (4)  endtime (8)  key type (4)  key length (4)
+     key  peer name length (4)  peer name
+
+   The peer name is the principal name of the other party.  A version
+   change is needed for any change to this layout. */
+#define EXPORT_VERSION 1
+#define EXPORT_FIXED_LEN 34
+
+static char *
+put32 (char *p, uint32_t n)
+{
+  *p++ = (n >> 24) & 0xFF;
+  *p++ = (n >> 16) & 0xFF;
+  *p++ = (n >> 8) & 0xFF;
+  *p++ = n & 0xFF;
+  return p;
+}
+
+static uint32_t
+get32 (const char *p)
+{
+  const unsigned char *q = (const unsigned char *) p;
+
+  return ((uint32_t) q[0] << 24) | ((uint32_t) q[1] << 16)
+    | ((uint32_t) q[2] << 8) | q[3];
+}
+
+/* Serialize a fully established krb5 security context into an
+   interprocess token.  Assumes context_handle is valid.  The caller
+   deletes the context afterwards. */
+OM_uint32
+gss_krb5_export_sec_context (OM_uint32 * minor_status,
+			     gss_ctx_id_t * context_handle,
+			     gss_buffer_t interprocess_token)
+{
+  _gss_krb5_ctx_t k5 = (*context_handle)->krb5;
+  char *peer = NULL;
+  size_t peerlen = 0;
+  int freepeer = 0;
+  size_t keylen, toklen, hdrlen;
+  uint64_t endtime;
+  char *p;
+  int rc;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  /* Partially established contexts cannot be exported. */
+  if (!k5 || !k5->key
+      || (k5->acceptor && !k5->tkt && !k5->imported)
+      || (!k5->acceptor && (!k5->reqdone || ((k5->flags & GSS_C_MUTUAL_FLAG)
+					     && !k5->repdone))))
+    return GSS_S_UNAVAILABLE;
+
+  if (k5->peerptr)
+    {
+      peer = k5->peerptr->value;
+      peerlen = k5->peerptr->length;
+    }
+  else if (k5->tkt)
+    {
+      rc = shishi_encticketpart_client (k5->sh,
+					shishi_tkt_encticketpart (k5->tkt),
+					&peer, &peerlen);
+      if (rc != SHISHI_OK)
+	return GSS_S_FAILURE;
+      freepeer = 1;
+    }
+
+  keylen = shishi_key_length (k5->key);
+  toklen = EXPORT_FIXED_LEN + keylen + peerlen;
+  hdrlen = _gss_encapsulate_token_header (GSS_KRB5->elements,
+					  GSS_KRB5->length, toklen, NULL);
+
+  interprocess_token->value = malloc (hdrlen + toklen);
+  if (!interprocess_token->value)
+    {
+      if (freepeer)
+	free (peer);
+      if (minor_status)
+	*minor_status = ENOMEM;
+      return GSS_S_FAILURE;
+    }
+  interprocess_token->length = hdrlen + toklen;
+
+  p = interprocess_token->value;
+  p += _gss_encapsulate_token_header (GSS_KRB5->elements,
+				      GSS_KRB5->length, toklen, p);
+  *p++ = EXPORT_VERSION;
+  *p++ = k5->acceptor ? 1 : 0;
+  p = put32 (p, k5->flags);
+  p = put32 (p, k5->initseqnr);
+  p = put32 (p, k5->acceptseqnr);
+  endtime = k5->endtime;
+  p = put32 (p, endtime >> 32);
+  p = put32 (p, endtime & 0xFFFFFFFF);
+  p = put32 (p, shishi_key_type (k5->key));
+  p = put32 (p, keylen);
+  memcpy (p, shishi_key_value (k5->key), keylen);
+  p += keylen;
+  p = put32 (p, peerlen);
+  if (peerlen > 0)
+    memcpy (p, peer, peerlen);
+
+  if (freepeer)
+    free (peer);
+
+  return GSS_S_COMPLETE;
+}
+
+/* Rebuild a krb5 security context from an interprocess token made by
+   gss_krb5_export_sec_context into the new context allocated by the
+   caller.  Neither the ticket cache, the configuration files nor the
+   keytab are read. */
+OM_uint32
+gss_krb5_import_sec_context (OM_uint32 * minor_status,
+			     const gss_buffer_t interprocess_token,
+			     gss_ctx_id_t * context_handle)
+{
+  gss_buffer_desc tok;
+  _gss_krb5_ctx_t k5;
+  const char *p;
+  size_t keylen, peerlen;
+  int32_t keytype;
+  uint64_t endtime;
+  gss_name_t peer;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  if (gss_decapsulate_token_view (interprocess_token, GSS_KRB5, &tok)
+      != GSS_S_COMPLETE)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  p = tok.value;
+  if (tok.length < EXPORT_FIXED_LEN || p[0] != EXPORT_VERSION)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  keytype = get32 (p + 22);
+  keylen = get32 (p + 26);
+  if (keylen > tok.length - EXPORT_FIXED_LEN
+      || keylen != shishi_cipher_keylen (keytype))
+    return GSS_S_DEFECTIVE_TOKEN;
+  peerlen = get32 (p + 30 + keylen);
+  if (peerlen != tok.length - EXPORT_FIXED_LEN - keylen)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  k5 = calloc (sizeof (*k5), 1);
+  if (!k5)
+    {
+      if (minor_status)
+	*minor_status = ENOMEM;
+      return GSS_S_FAILURE;
+    }
+
+  (*context_handle)->krb5 = k5;
+
+  k5->imported = 1;
+  k5->reqdone = 1;
+  k5->repdone = 1;
+  k5->acceptor = p[1] != 0;
+  k5->flags = get32 (p + 2);
+  k5->initseqnr = get32 (p + 6);
+  k5->acceptseqnr = get32 (p + 10);
+  endtime = ((uint64_t) get32 (p + 14) << 32) | get32 (p + 18);
+  k5->endtime = endtime;
+
+  if (_gss_krb5_pool_get_bare (&k5->sh) != SHISHI_OK
+      || shishi_key_from_value (k5->sh, keytype, p + 30, &k5->key)
+      != SHISHI_OK || _gss_krb5_derive_keys (k5) != SHISHI_OK)
+    return GSS_S_FAILURE;
+
+  if (GSS_ERROR (_gss_name_new (minor_status, p + 34 + keylen, peerlen,
+				GSS_KRB5_NT_PRINCIPAL_NAME, &peer)))
+    return GSS_S_FAILURE;
+  k5->peerptr = peer;
+
+  return GSS_S_COMPLETE;
+}
@@ -35,6 +35,7 @@ acquire_cred1 (OM_uint32 * minor_status,
   gss_name_t name = desired_name;
   _gss_krb5_cred_t k5 = (*output_cred_handle)->krb5;
   OM_uint32 maj_stat;
+  int rc;
 
   if (desired_name == GSS_C_NO_NAME)
     {
@@ -58,7 +59,7 @@ acquire_cred1 (OM_uint32 * minor_status,
 	return maj_stat;
     }
 
-  if (shishi_init_server (&k5->sh) != SHISHI_OK)
+  if (_gss_krb5_pool_get_server (&k5->sh) != SHISHI_OK)
     return GSS_S_FAILURE;
 
   {
@@ -74,11 +75,20 @@ acquire_cred1 (OM_uint32 * minor_status,
     memcpy (p, k5->peerptr->value, k5->peerptr->length);
     p[k5->peerptr->length] = 0;
 
-    k5->key = shishi_hostkeys_for_serverrealm (k5->sh, p, NULL);
+    rc = _gss_krb5_keytab_find (k5->sh,
+				shishi_hostkeys_default_file (k5->sh),
+				p, NULL, UINT32_MAX, 0, &k5->key);
 
     free (p);
   }
 
+  if (rc != SHISHI_OK)
+    {
+      if (minor_status)
+	*minor_status = ENOMEM;
+      return GSS_S_FAILURE;
+    }
+
   if (!k5->key)
     {
       if (minor_status)
@@ -228,7 +238,7 @@ gss_krb5_release_cred (OM_uint32 * minor_status, gss_cred_id_t * cred_handle)
     gss_release_name (NULL, &k5->peerptr);
 
   shishi_key_done (k5->key);
-  shishi_done (k5->sh);
+  _gss_krb5_pool_put (k5->sh);
   free (k5);
 
   if (minor_status)
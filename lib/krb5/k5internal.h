@@ -25,6 +25,13 @@
 
 #include <shishi.h>
 
+/* The per-message functions checksum and encrypt in place with
+   Nettle, see msg.c. */
+#include <nettle/aes.h>
+#include <nettle/des.h>
+#include <nettle/hmac.h>
+#include <nettle/md5.h>
+
 typedef struct _gss_krb5_cred_struct
 {
   Shishi *sh;
@@ -33,19 +40,78 @@ typedef struct _gss_krb5_cred_struct
   Shishi_key *key;
 } _gss_krb5_cred_desc, *_gss_krb5_cred_t;
 
+/* Block cipher state for one key. */
+typedef union
+{
+  struct des_ctx des;
+  struct des3_ctx des3;
+  struct aes128_ctx aes128;
+  struct aes256_ctx aes256;
+} _gss_krb5_cipher_desc;
+
 typedef struct _gss_krb5_ctx_struct
 {
   Shishi *sh;
   Shishi_ap *ap;
   Shishi_tkt *tkt;
   Shishi_key *key;
+  /* Per-message keys, derived from KEY once when the context is
+     established, as keyed cipher and HMAC-SHA1 state.  See msg.c. */
+  _gss_krb5_cipher_desc cipher;
+  _gss_krb5_cipher_desc seal;
+  struct hmac_sha1_ctx send_kc;
+  struct hmac_sha1_ctx recv_kc;
+  _gss_krb5_cipher_desc send_ke;
+  struct hmac_sha1_ctx send_ki;
+  _gss_krb5_cipher_desc recv_ke;
+  struct hmac_sha1_ctx recv_ki;
   gss_name_t peerptr;
   int acceptor;
   uint32_t acceptseqnr;
   uint32_t initseqnr;
   OM_uint32 flags;
+  /* End time of the ticket, or 0 before there is one. */
+  time_t endtime;
   int reqdone;
   int repdone;
+  /* Set for contexts made by gss_krb5_import_sec_context.  They have
+     no AP exchange or ticket, and own KEY. */
+  int imported;
+  /* Service ticket request running in the background for
+     GSS_C_ASYNC_FLAG, or NULL.  See context.c. */
+  struct _gss_krb5_pending_struct *pending;
 } _gss_krb5_ctx_desc, *_gss_krb5_ctx_t;
 
-OM_uint32 gss_krb5_tktlifetime (Shishi_tkt * tkt);
+/* See utils.c. */
+OM_uint32 gss_krb5_lifetime (time_t endtime);
+size_t _gss_krb5_hash (const char *str);
+
+/* See msg.c. */
+int _gss_krb5_derive_keys (_gss_krb5_ctx_t k5);
+void _gss_krb5_done_keys (_gss_krb5_ctx_t k5);
+
+/* The nanoseconds of the modification time in struct stat ST, so
+   that pool.c and keytab.c notice files rewritten within a second, or
+   0 where they are not available. */
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+# define _GSS_KRB5_MTIME_NSEC(st) ((st)->st_mtim.tv_nsec)
+#else
+# define _GSS_KRB5_MTIME_NSEC(st) 0
+#endif
+
+/* See pool.c. */
+int _gss_krb5_pool_get (const char *tktsfile,
+			const char *systemcfgfile,
+			const char *usercfgfile, Shishi ** sh);
+void _gss_krb5_pool_put (Shishi * sh);
+void _gss_krb5_pool_save (Shishi * sh);
+int _gss_krb5_pool_get_bare (Shishi ** sh);
+int _gss_krb5_pool_get_server (Shishi ** sh);
+Shishi_tkt *_gss_krb5_pool_find_tkt (Shishi * sh, const char *server);
+void _gss_krb5_pool_add_tkt (Shishi * sh, const char *server,
+			     Shishi_tkt * tkt);
+
+/* See keytab.c. */
+int _gss_krb5_keytab_find (Shishi * sh, const char *file,
+			   const char *server, const char *realm,
+			   uint32_t kvno, int32_t etype, Shishi_key ** key);
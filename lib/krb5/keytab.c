@@ -0,0 +1,278 @@
+/* krb5/keytab.c --- Process-wide cache of acceptor keys.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+/* Get specification. */
+#include "k5internal.h"
+
+/* Get stat. */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* Acceptor credentials used to read the hostkeys file from scratch on
+   every gss_acquire_cred.  Instead, each file is parsed once into a
+   key set indexed by principal, and parsed again only when
+   the file changes on disk, so that key rotation is still noticed.
+   Keys are hashed by principal name only, as the realm is optional
+   in lookups.
+   Credentials get their own copy of the key, so a key set can be
+   replaced while credentials made from it are in use. */
+
+typedef struct _gss_krb5_keytab_entry_struct
+{
+  struct _gss_krb5_keytab_entry_struct *next;
+  size_t hash;
+  Shishi_key *key;
+} _gss_krb5_keytab_entry_desc, *_gss_krb5_keytab_entry_t;
+
+typedef struct _gss_krb5_keytab_struct
+{
+  struct _gss_krb5_keytab_struct *next;
+  char *file;
+  /* Identity of FILE when it was parsed. */
+  dev_t dev;
+  ino_t ino;
+  time_t mtime;
+  long mtime_nsec;
+  off_t size;
+  size_t nbuckets;
+  /* Chains are in file order, so the first match is the key that
+     Shishi itself would pick. */
+  _gss_krb5_keytab_entry_t *buckets;
+} _gss_krb5_keytab_desc, *_gss_krb5_keytab_t;
+
+_GSS_LOCK_DEFINE (keytab_lock);
+static _gss_krb5_keytab_t keytabs;
+
+static void
+keytab_free (_gss_krb5_keytab_t kt)
+{
+  _gss_krb5_keytab_entry_t e, next;
+  size_t i;
+
+  for (i = 0; i < kt->nbuckets; i++)
+    for (e = kt->buckets[i]; e; e = next)
+      {
+	next = e->next;
+	shishi_key_done (e->key);
+	free (e);
+      }
+  free (kt->buckets);
+  free (kt->file);
+  free (kt);
+}
+
+static int
+keytab_changed_p (_gss_krb5_keytab_t kt, const struct stat *st)
+{
+  return st->st_dev != kt->dev || st->st_ino != kt->ino
+    || st->st_mtime != kt->mtime
+    || _GSS_KRB5_MTIME_NSEC (st) != kt->mtime_nsec
+    || st->st_size != kt->size;
+}
+
+/* Parse FILE, whose identity is ST, into a new key set, using the
+   handle SH of the caller.  The keys are only read and copied
+   afterwards, which does not involve SH. */
+static _gss_krb5_keytab_t
+keytab_parse (Shishi * sh, const char *file, const struct stat *st)
+{
+  _gss_krb5_keytab_t kt;
+  _gss_krb5_keytab_entry_t e, *tail;
+  _gss_krb5_keytab_entry_t **tails = NULL;
+  Shishi_key *key;
+  FILE *fh;
+  size_t i;
+
+  kt = calloc (sizeof (*kt), 1);
+  if (!kt)
+    return NULL;
+
+  kt->file = strdup (file);
+  kt->nbuckets = 64;
+  kt->buckets = calloc (kt->nbuckets, sizeof (*kt->buckets));
+  tails = malloc (kt->nbuckets * sizeof (*tails));
+  if (!kt->file || !kt->buckets || !tails)
+    {
+      free (tails);
+      keytab_free (kt);
+      return NULL;
+    }
+  for (i = 0; i < kt->nbuckets; i++)
+    tails[i] = &kt->buckets[i];
+
+  kt->dev = st->st_dev;
+  kt->ino = st->st_ino;
+  kt->mtime = st->st_mtime;
+  kt->mtime_nsec = _GSS_KRB5_MTIME_NSEC (st);
+  kt->size = st->st_size;
+
+  fh = fopen (file, "r");
+  if (!fh)
+    {
+      free (tails);
+      keytab_free (kt);
+      return NULL;
+    }
+
+  while (!feof (fh))
+    {
+      if (shishi_key_parse (sh, fh, &key) != SHISHI_OK || key == NULL)
+	break;
+
+      if (!shishi_key_principal (key))
+	{
+	  shishi_key_done (key);
+	  continue;
+	}
+
+      e = malloc (sizeof (*e));
+      if (!e)
+	{
+	  shishi_key_done (key);
+	  fclose (fh);
+	  free (tails);
+	  keytab_free (kt);
+	  return NULL;
+	}
+      e->next = NULL;
+      e->key = key;
+      e->hash = _gss_krb5_hash (shishi_key_principal (key));
+
+      tail = tails[e->hash % kt->nbuckets];
+      *tail = e;
+      tails[e->hash % kt->nbuckets] = &e->next;
+    }
+
+  fclose (fh);
+  free (tails);
+
+  return kt;
+}
+
+/* Unlink and free KT.  Called with keytab_lock held. */
+static void
+keytab_remove (_gss_krb5_keytab_t kt)
+{
+  _gss_krb5_keytab_t *pp;
+
+  for (pp = &keytabs; *pp; pp = &(*pp)->next)
+    if (*pp == kt)
+      {
+	*pp = kt->next;
+	break;
+      }
+
+  keytab_free (kt);
+}
+
+/* Return the key set for FILE, parsing it with SH if it is new or has
+   changed on disk.  Called with keytab_lock held. */
+static _gss_krb5_keytab_t
+keytab_get (Shishi * sh, const char *file)
+{
+  _gss_krb5_keytab_t kt;
+  struct stat st;
+
+  for (kt = keytabs; kt; kt = kt->next)
+    if (strcmp (kt->file, file) == 0)
+      break;
+
+  if (stat (file, &st) != 0)
+    {
+      if (kt)
+	keytab_remove (kt);
+      return NULL;
+    }
+
+  if (kt && !keytab_changed_p (kt, &st))
+    return kt;
+
+  if (kt)
+    keytab_remove (kt);
+
+  kt = keytab_parse (sh, file, &st);
+  if (kt)
+    {
+      kt->next = keytabs;
+      keytabs = kt;
+    }
+
+  return kt;
+}
+
+/* Store in *KEY a copy, made with handle SH, of the first key for
+   SERVER in REALM, or in any realm if REALM is NULL, in the hostkeys
+   file FILE.  If ETYPE is not 0, only keys of that type are
+   considered.  If KVNO is not UINT32_MAX, a key of that version is
+   preferred, and otherwise a key without a version is used.  *KEY is
+   NULL if there is no such key.  Returns a Shishi error code. */
+int
+_gss_krb5_keytab_find (Shishi * sh, const char *file,
+		       const char *server, const char *realm,
+		       uint32_t kvno, int32_t etype, Shishi_key ** key)
+{
+  _gss_krb5_keytab_t kt;
+  _gss_krb5_keytab_entry_t e;
+  Shishi_key *found = NULL;
+  size_t hash = _gss_krb5_hash (server);
+  uint32_t version;
+  int rc = SHISHI_OK;
+
+  *key = NULL;
+
+  if (file == NULL)
+    return SHISHI_OK;
+
+  _gss_lock (keytab_lock);
+
+  kt = keytab_get (sh, file);
+  if (kt)
+    for (e = kt->buckets[hash % kt->nbuckets]; e; e = e->next)
+      {
+	if (e->hash != hash
+	    || strcmp (shishi_key_principal (e->key), server) != 0
+	    || (realm && (!shishi_key_realm (e->key)
+			  || strcmp (shishi_key_realm (e->key), realm) != 0))
+	    || (etype != 0 && shishi_key_type (e->key) != etype))
+	  continue;
+
+	version = shishi_key_version (e->key);
+	if (kvno == UINT32_MAX || version == kvno)
+	  {
+	    found = e->key;
+	    break;
+	  }
+	if (version == UINT32_MAX && !found)
+	  found = e->key;
+      }
+
+  if (found)
+    {
+      rc = shishi_key (sh, key);
+      if (rc == SHISHI_OK)
+	shishi_key_copy (*key, found);
+    }
+
+  _gss_unlock (keytab_lock);
+
+  return rc;
+}
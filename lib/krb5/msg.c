@@ -24,6 +24,7 @@
 #include "k5internal.h"
 
 #define TOK_LEN 2
+#define TOK_MIC    "\x01\x01"
 #define TOK_WRAP   "\x02\x01"
 
 #define C2I(buf) ((buf[0] & 0xFF) |		\
@@ -31,6 +32,1248 @@
 		  ((buf[2] & 0xFF) << 16) |	\
 		  ((buf[3] & 0xFF) << 24))
 
+/* RFC 4121 (CFX) tokens, used with the AES enctypes.  They carry no
+   ASN.1 framing. */
+#define TOK_CFX_MIC "\x04\x04"
+#define TOK_CFX_WRAP "\x05\x04"
+#define CFX_HEADER_LEN 16
+
+#define CFX_FLAG_SENT_BY_ACCEPTOR 0x01
+#define CFX_FLAG_SEALED 0x02
+#define CFX_FLAG_ACCEPTOR_SUBKEY 0x04
+
+#define KG_USAGE_ACCEPTOR_SEAL 22
+#define KG_USAGE_ACCEPTOR_SIGN 23
+#define KG_USAGE_INITIATOR_SEAL 24
+#define KG_USAGE_INITIATOR_SIGN 25
+
+/* The AES enctypes use HMAC-SHA1-96 and a one block confounder. */
+#define CFX_HMAC_LEN 12
+#define CFX_CONFOUNDER_LEN 16
+
+/* RFC 3961 key derivation constants, appended to the key usage. */
+#define DK_CHECKSUM 0x99
+#define DK_ENCRYPT 0xAA
+#define DK_INTEGRITY 0x55
+
+/* Derive the key for key usage USAGE and purpose KIND from the
+   context key, DK(key, usage | kind) in RFC 3961 terms. */
+static int
+derive_key (_gss_krb5_ctx_t k5, int usage, int kind, Shishi_key ** out)
+{
+  char constant[5];
+  int rc;
+
+  constant[0] = (usage >> 24) & 0xFF;
+  constant[1] = (usage >> 16) & 0xFF;
+  constant[2] = (usage >> 8) & 0xFF;
+  constant[3] = usage & 0xFF;
+  constant[4] = kind;
+
+  rc = shishi_key_from_value (k5->sh, shishi_key_type (k5->key), NULL, out);
+  if (rc != SHISHI_OK)
+    return rc;
+
+  rc = shishi_dk (k5->sh, k5->key, constant, sizeof (constant), *out);
+  if (rc != SHISHI_OK)
+    {
+      shishi_key_done (*out);
+      *out = NULL;
+    }
+
+  return rc;
+}
+
+/* Likewise, and key the HMAC-SHA1 state CTX with the derived key. */
+static int
+derive_hmac (_gss_krb5_ctx_t k5, int usage, int kind,
+	     struct hmac_sha1_ctx *ctx)
+{
+  Shishi_key *key;
+  int rc;
+
+  rc = derive_key (k5, usage, kind, &key);
+  if (rc != SHISHI_OK)
+    return rc;
+
+  hmac_sha1_set_key (ctx, shishi_key_length (key),
+		     (const uint8_t *) shishi_key_value (key));
+  shishi_key_done (key);
+
+  return SHISHI_OK;
+}
+
+/* Likewise, and set up the AES cipher state C with the derived key,
+   for decryption if DECRYPTP, else for encryption. */
+static int
+derive_aes (_gss_krb5_ctx_t k5, int usage, int kind, int decryptp,
+	    _gss_krb5_cipher_desc * c)
+{
+  Shishi_key *key;
+  const uint8_t *value;
+  int rc;
+
+  rc = derive_key (k5, usage, kind, &key);
+  if (rc != SHISHI_OK)
+    return rc;
+
+  value = (const uint8_t *) shishi_key_value (key);
+  if (shishi_key_type (key) == SHISHI_AES128_CTS_HMAC_SHA1_96)
+    {
+      if (decryptp)
+	aes128_set_decrypt_key (&c->aes128, value);
+      else
+	aes128_set_encrypt_key (&c->aes128, value);
+    }
+  else
+    {
+      if (decryptp)
+	aes256_set_decrypt_key (&c->aes256, value);
+      else
+	aes256_set_encrypt_key (&c->aes256, value);
+    }
+  shishi_key_done (key);
+
+  return SHISHI_OK;
+}
+
+/* Derive the keys used by the per-message functions, once the
+   context key is known, and set up the cipher and HMAC state for
+   them.  Shishi's checksum and encryption functions would otherwise
+   derive them again, and allocate, for every message.  Kerberos
+   session keys are never weak, so what des_set_key says about that
+   is ignored. */
+int
+_gss_krb5_derive_keys (_gss_krb5_ctx_t k5)
+{
+  int rc = SHISHI_OK;
+
+  if (!k5->key)
+    return SHISHI_OK;
+
+  switch (shishi_key_type (k5->key))
+    {
+    case SHISHI_DES_CBC_MD5:
+      {
+	/* The RFC 1964 sealing key is the session key XOR F0. */
+	const char *value = shishi_key_value (k5->key);
+	uint8_t key[DES_KEY_SIZE];
+	size_t i;
+
+	for (i = 0; i < sizeof (key); i++)
+	  key[i] = value[i] ^ 0xF0;
+
+	des_set_key (&k5->cipher.des, (const uint8_t *) value);
+	des_set_key (&k5->seal.des, key);
+      }
+      break;
+
+    case SHISHI_DES3_CBC_HMAC_SHA1_KD:
+      /* The session key seals and encrypts the sequence number. */
+      des3_set_key (&k5->cipher.des3,
+		    (const uint8_t *) shishi_key_value (k5->key));
+      /* Both directions sign with the same key usage. */
+      rc = derive_hmac (k5, SHISHI_KEYUSAGE_GSS_R2, DK_CHECKSUM,
+			&k5->send_kc);
+      if (rc == SHISHI_OK)
+	rc = derive_hmac (k5, SHISHI_KEYUSAGE_GSS_R2, DK_CHECKSUM,
+			  &k5->recv_kc);
+      break;
+
+    case SHISHI_AES128_CTS_HMAC_SHA1_96:
+    case SHISHI_AES256_CTS_HMAC_SHA1_96:
+      {
+	int send_sign = k5->acceptor ? KG_USAGE_ACCEPTOR_SIGN :
+	  KG_USAGE_INITIATOR_SIGN;
+	int recv_sign = k5->acceptor ? KG_USAGE_INITIATOR_SIGN :
+	  KG_USAGE_ACCEPTOR_SIGN;
+	int send_seal = k5->acceptor ? KG_USAGE_ACCEPTOR_SEAL :
+	  KG_USAGE_INITIATOR_SEAL;
+	int recv_seal = k5->acceptor ? KG_USAGE_INITIATOR_SEAL :
+	  KG_USAGE_ACCEPTOR_SEAL;
+
+	rc = derive_hmac (k5, send_sign, DK_CHECKSUM, &k5->send_kc);
+	if (rc == SHISHI_OK)
+	  rc = derive_hmac (k5, recv_sign, DK_CHECKSUM, &k5->recv_kc);
+	if (rc == SHISHI_OK)
+	  rc = derive_aes (k5, send_seal, DK_ENCRYPT, 0, &k5->send_ke);
+	if (rc == SHISHI_OK)
+	  rc = derive_hmac (k5, send_seal, DK_INTEGRITY, &k5->send_ki);
+	if (rc == SHISHI_OK)
+	  rc = derive_aes (k5, recv_seal, DK_ENCRYPT, 1, &k5->recv_ke);
+	if (rc == SHISHI_OK)
+	  rc = derive_hmac (k5, recv_seal, DK_INTEGRITY, &k5->recv_ki);
+      }
+      break;
+
+    default:
+      break;
+    }
+
+  if (rc != SHISHI_OK)
+    _gss_krb5_done_keys (k5);
+
+  return rc;
+}
+
+void
+_gss_krb5_done_keys (_gss_krb5_ctx_t k5)
+{
+  _gss_krb5_cipher_desc *ciphers[] = { &k5->cipher, &k5->seal,
+    &k5->send_ke, &k5->recv_ke
+  };
+  struct hmac_sha1_ctx *macs[] = { &k5->send_kc, &k5->recv_kc,
+    &k5->send_ki, &k5->recv_ki
+  };
+  size_t i;
+
+  for (i = 0; i < sizeof (ciphers) / sizeof (ciphers[0]); i++)
+    memset (ciphers[i], 0, sizeof (*ciphers[i]));
+
+  for (i = 0; i < sizeof (macs) / sizeof (macs[0]); i++)
+    memset (macs[i], 0, sizeof (*macs[i]));
+}
+
+/* A message that is protected in place, and need not be contiguous:
+   the HEADLEN octets at HEAD, then the DATA buffers of IOV, then the
+   TAILLEN octets at TAIL.  The IOV functions use all three, with the
+   token parts around the data at HEAD and TAIL, while the other
+   functions only have a HEAD. */
+typedef struct
+{
+  char *head;
+  size_t headlen;
+  gss_iov_buffer_desc *iov;
+  int iov_count;
+  char *tail;
+  size_t taillen;
+} span_desc;
+
+/* A position in a span, as the rest of the piece it is in.  Pieces
+   are numbered from 0 for HEAD, through the IOV buffers, to
+   IOV_COUNT + 1 for TAIL. */
+typedef struct
+{
+  const span_desc *s;
+  int i;
+  char *p;
+  size_t left;
+} span_pos;
+
+static void
+span_init (span_desc * s, char *data, size_t len)
+{
+  memset (s, 0, sizeof (*s));
+  s->head = data;
+  s->headlen = len;
+}
+
+static size_t
+span_length (const span_desc * s)
+{
+  return s->headlen + _gss_iov_data_length (s->iov, s->iov_count)
+    + s->taillen;
+}
+
+static void
+span_start (span_pos * pos, const span_desc * s)
+{
+  pos->s = s;
+  pos->i = 0;
+  pos->p = s->head;
+  pos->left = s->headlen;
+}
+
+/* Move POS to the start of the next piece that is not empty, if it
+   is at the end of one. */
+static void
+span_skip (span_pos * pos)
+{
+  const span_desc *s = pos->s;
+
+  while (pos->left == 0 && pos->i <= s->iov_count)
+    {
+      pos->i++;
+      if (pos->i > s->iov_count)
+	{
+	  pos->p = s->tail;
+	  pos->left = s->taillen;
+	}
+      else if (GSS_IOV_BUFFER_TYPE (s->iov[pos->i - 1].type)
+	       == GSS_IOV_BUFFER_TYPE_DATA)
+	{
+	  pos->p = s->iov[pos->i - 1].buffer.value;
+	  pos->left = s->iov[pos->i - 1].buffer.length;
+	}
+    }
+}
+
+/* Copy LEN octets at POS to BUF, or if PUT, from BUF to POS, and
+   advance POS past them.  A NULL BUF only advances POS. */
+static void
+span_copy (span_pos * pos, char *buf, size_t len, int put)
+{
+  while (len > 0)
+    {
+      size_t n;
+
+      span_skip (pos);
+      if (pos->left == 0)
+	break;
+
+      n = len < pos->left ? len : pos->left;
+      if (buf && put)
+	memcpy (pos->p, buf, n);
+      else if (buf)
+	memcpy (buf, pos->p, n);
+
+      pos->p += n;
+      pos->left -= n;
+      if (buf)
+	buf += n;
+      len -= n;
+    }
+}
+
+/* Return the LEN octets at POS, at most a cipher block, and advance
+   POS past them.  They are returned in place if they are all in one
+   piece, and else copied to TMP, for the caller to write back with
+   span_copy once done. */
+static uint8_t *
+span_block (span_pos * pos, uint8_t * tmp, size_t len)
+{
+  uint8_t *p;
+
+  span_skip (pos);
+  if (pos->left < len)
+    {
+      span_copy (pos, (char *) tmp, len, 0);
+      return tmp;
+    }
+
+  p = (uint8_t *) pos->p;
+  pos->p += len;
+  pos->left -= len;
+
+  return p;
+}
+
+/* Feed the octets of span S, in order, to the hash update function
+   UPDATE with state CTX. */
+static void
+span_hash (const span_desc * s, void *ctx, nettle_hash_update_func * update)
+{
+  span_pos pos;
+
+  span_start (&pos, s);
+  for (;;)
+    {
+      span_skip (&pos);
+      if (pos.left == 0)
+	break;
+      update (ctx, pos.left, (const uint8_t *) pos.p);
+      pos.left = 0;
+    }
+}
+
+/* Encrypt or decrypt, in place, the octets of span S, a multiple of
+   8, in CBC mode with the DES, or if DES3 the DES3, cipher state C.
+   IV is the 8 octet IV, and is updated. */
+static void
+des_cbc (const _gss_krb5_cipher_desc * c, int des3, int decryptp,
+	 uint8_t * iv, const span_desc * s)
+{
+  uint8_t tmp[DES_BLOCK_SIZE], save[DES_BLOCK_SIZE];
+  size_t len = span_length (s), i, j;
+  span_pos pos, at;
+  uint8_t *b;
+
+  span_start (&pos, s);
+  for (i = 0; i + DES_BLOCK_SIZE <= len; i += DES_BLOCK_SIZE)
+    {
+      at = pos;
+      b = span_block (&pos, tmp, DES_BLOCK_SIZE);
+
+      if (decryptp)
+	{
+	  memcpy (save, b, DES_BLOCK_SIZE);
+	  if (des3)
+	    des3_decrypt (&c->des3, DES_BLOCK_SIZE, b, b);
+	  else
+	    des_decrypt (&c->des, DES_BLOCK_SIZE, b, b);
+	  for (j = 0; j < DES_BLOCK_SIZE; j++)
+	    b[j] ^= iv[j];
+	  memcpy (iv, save, DES_BLOCK_SIZE);
+	}
+      else
+	{
+	  for (j = 0; j < DES_BLOCK_SIZE; j++)
+	    b[j] ^= iv[j];
+	  if (des3)
+	    des3_encrypt (&c->des3, DES_BLOCK_SIZE, b, b);
+	  else
+	    des_encrypt (&c->des, DES_BLOCK_SIZE, b, b);
+	  memcpy (iv, b, DES_BLOCK_SIZE);
+	}
+
+      if (b == tmp)
+	span_copy (&at, (char *) tmp, DES_BLOCK_SIZE, 1);
+    }
+}
+
+/* Likewise for LEN octets at DATA. */
+static void
+des_cbc_buf (const _gss_krb5_cipher_desc * c, int des3, int decryptp,
+	     uint8_t * iv, char *data, size_t len)
+{
+  span_desc s;
+
+  span_init (&s, data, len);
+  des_cbc (c, des3, decryptp, iv, &s);
+}
+
+/* Encrypt or decrypt one AES block at SRC to DST with the cipher
+   state C of the context key size. */
+static void
+aes_block (_gss_krb5_ctx_t k5, const _gss_krb5_cipher_desc * c,
+	   int decryptp, uint8_t * dst, const uint8_t * src)
+{
+  if (shishi_key_type (k5->key) == SHISHI_AES128_CTS_HMAC_SHA1_96)
+    {
+      if (decryptp)
+	aes128_decrypt (&c->aes128, AES_BLOCK_SIZE, dst, src);
+      else
+	aes128_encrypt (&c->aes128, AES_BLOCK_SIZE, dst, src);
+    }
+  else
+    {
+      if (decryptp)
+	aes256_decrypt (&c->aes256, AES_BLOCK_SIZE, dst, src);
+      else
+	aes256_encrypt (&c->aes256, AES_BLOCK_SIZE, dst, src);
+    }
+}
+
+/* AES in CBC mode with ciphertext stealing and a zero IV, as per RFC
+   3962, in place on the octets of span S, which must be at least one
+   block.  The last two ciphertext blocks are swapped and the final
+   one truncated, so the ciphertext is as long as the plaintext.  The
+   blocks before those two are plain CBC, and are done where they
+   are; the last two are done on a copy. */
+static void
+aes_cts (_gss_krb5_ctx_t k5, const _gss_krb5_cipher_desc * c,
+	 int decryptp, const span_desc * s)
+{
+  uint8_t chain[AES_BLOCK_SIZE], save[AES_BLOCK_SIZE];
+  uint8_t tmp[AES_BLOCK_SIZE], last[2 * AES_BLOCK_SIZE];
+  size_t len = span_length (s);
+  /* Offset of the second to last block, and size of the last. */
+  size_t n, r, i, j;
+  span_pos pos, at;
+  uint8_t *b;
+
+  span_start (&pos, s);
+
+  if (len <= AES_BLOCK_SIZE)
+    {
+      at = pos;
+      b = span_block (&pos, tmp, AES_BLOCK_SIZE);
+      aes_block (k5, c, decryptp, b, b);
+      if (b == tmp)
+	span_copy (&at, (char *) tmp, AES_BLOCK_SIZE, 1);
+      return;
+    }
+
+  n = (len - 1) / AES_BLOCK_SIZE * AES_BLOCK_SIZE - AES_BLOCK_SIZE;
+  r = len - n - AES_BLOCK_SIZE;
+
+  memset (chain, 0, sizeof (chain));
+  for (i = 0; i < n; i += AES_BLOCK_SIZE)
+    {
+      at = pos;
+      b = span_block (&pos, tmp, AES_BLOCK_SIZE);
+
+      if (decryptp)
+	{
+	  memcpy (save, b, AES_BLOCK_SIZE);
+	  aes_block (k5, c, 1, b, b);
+	  for (j = 0; j < AES_BLOCK_SIZE; j++)
+	    b[j] ^= chain[j];
+	  memcpy (chain, save, AES_BLOCK_SIZE);
+	}
+      else
+	{
+	  for (j = 0; j < AES_BLOCK_SIZE; j++)
+	    b[j] ^= chain[j];
+	  aes_block (k5, c, 0, b, b);
+	  memcpy (chain, b, AES_BLOCK_SIZE);
+	}
+
+      if (b == tmp)
+	span_copy (&at, (char *) tmp, AES_BLOCK_SIZE, 1);
+    }
+
+  at = pos;
+  span_copy (&pos, (char *) last, AES_BLOCK_SIZE + r, 0);
+
+  if (!decryptp)
+    {
+      /* The final, zero padded, block chains on the second to last
+	 one, and takes its place. */
+      for (j = 0; j < AES_BLOCK_SIZE; j++)
+	last[j] ^= chain[j];
+      aes_block (k5, c, 0, last, last);
+      memset (tmp, 0, sizeof (tmp));
+      memcpy (tmp, last + AES_BLOCK_SIZE, r);
+      for (j = 0; j < AES_BLOCK_SIZE; j++)
+	tmp[j] ^= last[j];
+      memcpy (last + AES_BLOCK_SIZE, last, r);
+      aes_block (k5, c, 0, last, tmp);
+    }
+  else
+    {
+      /* Decrypting the full final block gives the last plaintext
+	 block XOR the second to last ciphertext block, and the tail
+	 of that ciphertext block, which was stolen. */
+      aes_block (k5, c, 1, tmp, last);
+      memcpy (save, last + AES_BLOCK_SIZE, r);
+      memcpy (save + r, tmp + r, AES_BLOCK_SIZE - r);
+      for (j = 0; j < r; j++)
+	last[AES_BLOCK_SIZE + j] = tmp[j] ^ save[j];
+      aes_block (k5, c, 1, last, save);
+      for (j = 0; j < AES_BLOCK_SIZE; j++)
+	last[j] ^= chain[j];
+    }
+
+  span_copy (&at, (char *) last, AES_BLOCK_SIZE + r, 1);
+}
+
+/* HMAC-SHA1 over LEN octets at IN, keyed by CTX with a derived key,
+   truncated to OUTLEN octets at OUT.  This is the checksum of the RFC
+   3961 simplified profile, given the derived checksum key.  Callers
+   with the input in pieces feed them to CTX with hmac_sha1_update
+   instead, and pass the last one here; the digest leaves CTX ready
+   for the next message. */
+static void
+kd_hmac (struct hmac_sha1_ctx *ctx,
+	 const char *in, size_t len, char *out, size_t outlen)
+{
+  hmac_sha1_update (ctx, len, (const uint8_t *) in);
+  hmac_sha1_digest (ctx, outlen, (uint8_t *) out);
+}
+
+/* Encrypt, in place, the octets of span S with the cached sending
+   keys, RFC 3961 simplified profile for AES: the first
+   CFX_CONFOUNDER_LEN octets, which must be at HEAD, are overwritten
+   with the confounder, and the CFX_HMAC_LEN octets of HMAC over the
+   plaintext are written to MAC. */
+static int
+cfx_encrypt (_gss_krb5_ctx_t k5, const span_desc * s, char *mac)
+{
+  int rc;
+
+  rc = shishi_randomize (k5->sh, 0, s->head, CFX_CONFOUNDER_LEN);
+  if (rc != SHISHI_OK)
+    return rc;
+
+  span_hash (s, &k5->send_ki, (nettle_hash_update_func *) hmac_sha1_update);
+  hmac_sha1_digest (&k5->send_ki, CFX_HMAC_LEN, (uint8_t *) mac);
+  aes_cts (k5, &k5->send_ke, 0, s);
+
+  return SHISHI_OK;
+}
+
+/* Decrypt, in place, the octets of span S with the cached receiving
+   keys, and check the plaintext against the CFX_HMAC_LEN octets of
+   HMAC at MAC.  On success S holds the confounder and the
+   plaintext. */
+static int
+cfx_decrypt (_gss_krb5_ctx_t k5, const span_desc * s, const char *mac)
+{
+  char hmac[CFX_HMAC_LEN];
+
+  if (span_length (s) < CFX_CONFOUNDER_LEN)
+    return SHISHI_CRYPTO_ERROR;
+
+  aes_cts (k5, &k5->recv_ke, 1, s);
+
+  span_hash (s, &k5->recv_ki, (nettle_hash_update_func *) hmac_sha1_update);
+  hmac_sha1_digest (&k5->recv_ki, CFX_HMAC_LEN, (uint8_t *) hmac);
+  if (memcmp (hmac, mac, CFX_HMAC_LEN) != 0)
+    return SHISHI_VERIFY_FAILED;
+
+  return SHISHI_OK;
+}
+
+/* Write a CFX Wrap token header into HDR. */
+static void
+cfx_header (char *hdr, int flags, size_t ec, size_t rrc, uint32_t seqnr)
+{
+  memcpy (hdr, TOK_CFX_WRAP, TOK_LEN);
+  hdr[2] = flags;
+  hdr[3] = '\xFF';
+  hdr[4] = (ec >> 8) & 0xFF;
+  hdr[5] = ec & 0xFF;
+  hdr[6] = (rrc >> 8) & 0xFF;
+  hdr[7] = rrc & 0xFF;
+  /* We only keep 32 bit sequence numbers. */
+  memset (hdr + 8, 0, 4);
+  hdr[12] = (seqnr >> 24) & 0xFF;
+  hdr[13] = (seqnr >> 16) & 0xFF;
+  hdr[14] = (seqnr >> 8) & 0xFF;
+  hdr[15] = seqnr & 0xFF;
+}
+
+/* Size of the buffer cfx_wrap needs for a MSGLEN octet message. */
+static size_t
+cfx_wrap_size (int conf_req_flag, size_t msglen)
+{
+  /* header | E(confounder | plaintext | header) | HMAC */
+  if (conf_req_flag)
+    return CFX_HEADER_LEN + CFX_CONFOUNDER_LEN + msglen + CFX_HEADER_LEN
+      + CFX_HMAC_LEN;
+
+  /* header | plaintext | checksum */
+  return CFX_HEADER_LEN + msglen + CFX_HMAC_LEN;
+}
+
+/* Protect a CFX Wrap token with the header at HDR.  If CONF_REQ_FLAG,
+   span S is the confounder, the message and room for the header
+   copy, and is encrypted; else S is the message.  The checksum or
+   HMAC goes to MAC, and RRC is stored in the header. */
+static OM_uint32
+cfx_seal (_gss_krb5_ctx_t k5, int conf_req_flag, char *hdr,
+	  const span_desc * s, char *mac, size_t rrc)
+{
+  uint32_t seqnr = k5->acceptor ? k5->acceptseqnr : k5->initseqnr;
+  int flags = k5->acceptor ? CFX_FLAG_SENT_BY_ACCEPTOR : 0;
+  span_pos pos;
+  int rc;
+
+  if (conf_req_flag)
+    {
+      /* The encrypted header copy has RRC zero. */
+      cfx_header (hdr, flags | CFX_FLAG_SEALED, 0, 0, seqnr);
+      span_start (&pos, s);
+      span_copy (&pos, NULL, span_length (s) - CFX_HEADER_LEN, 0);
+      span_copy (&pos, hdr, CFX_HEADER_LEN, 1);
+
+      rc = cfx_encrypt (k5, s, mac);
+      if (rc != SHISHI_OK)
+	return GSS_S_FAILURE;
+
+      cfx_header (hdr, flags | CFX_FLAG_SEALED, 0, rrc, seqnr);
+    }
+  else
+    {
+      /* The checksum covers the plaintext and then the header with
+	 EC and RRC zero. */
+      cfx_header (hdr, flags, 0, 0, seqnr);
+      span_hash (s, &k5->send_kc,
+		 (nettle_hash_update_func *) hmac_sha1_update);
+      kd_hmac (&k5->send_kc, hdr, CFX_HEADER_LEN, mac, CFX_HMAC_LEN);
+
+      cfx_header (hdr, flags, CFX_HMAC_LEN, rrc, seqnr);
+    }
+
+  if (k5->acceptor)
+    k5->acceptseqnr++;
+  else
+    k5->initseqnr++;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Build a CFX Wrap token in OUT, of cfx_wrap_size octets, and store
+   its length in *OUTLEN. */
+static OM_uint32
+cfx_wrap (_gss_krb5_ctx_t k5,
+	  int conf_req_flag,
+	  const gss_buffer_t input_message_buffer,
+	  char *out, size_t * outlen)
+{
+  size_t msglen = input_message_buffer->length;
+  char *data = out + CFX_HEADER_LEN;
+  span_desc s;
+  OM_uint32 maj_stat;
+
+  if (conf_req_flag)
+    {
+      /* Lay out the plaintext where the ciphertext goes, and encrypt
+	 it there. */
+      memcpy (data + CFX_CONFOUNDER_LEN, input_message_buffer->value,
+	      msglen);
+      span_init (&s, data, CFX_CONFOUNDER_LEN + msglen + CFX_HEADER_LEN);
+      maj_stat = cfx_seal (k5, 1, out, &s, data + s.headlen, 0);
+    }
+  else
+    {
+      memcpy (data, input_message_buffer->value, msglen);
+      span_init (&s, data, msglen);
+      maj_stat = cfx_seal (k5, 0, out, &s, data + msglen, 0);
+    }
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  *outlen = cfx_wrap_size (conf_req_flag, msglen);
+
+  return GSS_S_COMPLETE;
+}
+
+/* Check the header of the CFX Wrap token at TOK, of at least
+   CFX_HEADER_LEN octets, and return its flags, EC and RRC. */
+static OM_uint32
+cfx_unwrap_header (_gss_krb5_ctx_t k5, const char *tok,
+		   int *flags, size_t * ec, size_t * rrc)
+{
+  if (memcmp (tok, TOK_CFX_WRAP, TOK_LEN) != 0)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  *flags = tok[2] & 0xFF;
+  if ((tok[3] & 0xFF) != 0xFF)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  /* The token must come from our peer, and we never assert an
+     acceptor subkey. */
+  if (!(*flags & CFX_FLAG_SENT_BY_ACCEPTOR) != !!k5->acceptor)
+    return GSS_S_BAD_MIC;
+  if (*flags & CFX_FLAG_ACCEPTOR_SUBKEY)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  *ec = (tok[4] & 0xFF) << 8 | (tok[5] & 0xFF);
+  *rrc = (tok[6] & 0xFF) << 8 | (tok[7] & 0xFF);
+
+  if (memcmp (tok + 8, "\x00\x00\x00\x00", 4) != 0
+      || (uint32_t) ((tok[12] & 0xFF) << 24 | (tok[13] & 0xFF) << 16
+		     | (tok[14] & 0xFF) << 8 | (tok[15] & 0xFF))
+      != (k5->acceptor ? k5->initseqnr : k5->acceptseqnr))
+    return GSS_S_BAD_MIC;
+
+  if (!(*flags & CFX_FLAG_SEALED) && *ec != CFX_HMAC_LEN)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Check, and if sealed decrypt in place, the body of the CFX Wrap
+   token with the header at TOK, checked by cfx_unwrap_header.  If
+   sealed, span S is the encrypted confounder, message, EC octets of
+   filler and header copy; else S is the message.  MAC is the HMAC or
+   checksum that follows. */
+static OM_uint32
+cfx_open (_gss_krb5_ctx_t k5, const char *tok, int flags, size_t ec,
+	  const span_desc * s, const char *mac)
+{
+  if (flags & CFX_FLAG_SEALED)
+    {
+      char hdr[CFX_HEADER_LEN];
+      span_pos pos;
+      size_t len = span_length (s);
+
+      if (len < CFX_CONFOUNDER_LEN + ec + CFX_HEADER_LEN)
+	return GSS_S_BAD_MIC;
+
+      if (cfx_decrypt (k5, s, mac) != SHISHI_OK)
+	return GSS_S_BAD_MIC;
+
+      /* Check the encrypted header copy, its RRC is zero. */
+      span_start (&pos, s);
+      span_copy (&pos, NULL, len - CFX_HEADER_LEN, 0);
+      span_copy (&pos, hdr, CFX_HEADER_LEN, 0);
+      if (memcmp (hdr, tok, 6) != 0
+	  || memcmp (hdr + 6, "\x00\x00", 2) != 0
+	  || memcmp (hdr + 8, tok + 8, 8) != 0)
+	return GSS_S_BAD_MIC;
+    }
+  else
+    {
+      char hdr[CFX_HEADER_LEN], expect[CFX_HMAC_LEN];
+
+      /* The checksum input is the plaintext followed by the header
+	 with EC and RRC zero. */
+      memcpy (hdr, tok, CFX_HEADER_LEN);
+      memset (hdr + 4, 0, 4);
+
+      span_hash (s, &k5->recv_kc,
+		 (nettle_hash_update_func *) hmac_sha1_update);
+      kd_hmac (&k5->recv_kc, hdr, CFX_HEADER_LEN, expect, CFX_HMAC_LEN);
+      if (memcmp (mac, expect, CFX_HMAC_LEN) != 0)
+	return GSS_S_BAD_MIC;
+    }
+
+  if (k5->acceptor)
+    k5->initseqnr++;
+  else
+    k5->acceptseqnr++;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Unwrap a CFX Wrap token into P, which must have room for as many
+   octets as the token, and store the message length in *PLEN. */
+static OM_uint32
+cfx_unwrap (_gss_krb5_ctx_t k5,
+	    const gss_buffer_t input_message_buffer,
+	    char *p, size_t * plen, int *conf_state)
+{
+  const char *tok = input_message_buffer->value;
+  const char *body = tok + CFX_HEADER_LEN;
+  size_t bodylen, ec, rrc, len;
+  OM_uint32 maj_stat;
+  span_desc s;
+  int flags;
+
+  if (input_message_buffer->length < CFX_HEADER_LEN)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  maj_stat = cfx_unwrap_header (k5, tok, &flags, &ec, &rrc);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  bodylen = input_message_buffer->length - CFX_HEADER_LEN;
+
+  /* Copy the data following the header, undoing a right rotation. */
+  rrc = bodylen > 0 ? rrc % bodylen : 0;
+  memcpy (p, body + rrc, bodylen - rrc);
+  memcpy (p + bodylen - rrc, body, rrc);
+
+  if (flags & CFX_FLAG_SEALED)
+    {
+      if (bodylen < CFX_HMAC_LEN)
+	return GSS_S_BAD_MIC;
+      len = bodylen - CFX_HMAC_LEN;
+    }
+  else
+    {
+      if (bodylen < ec)
+	return GSS_S_DEFECTIVE_TOKEN;
+      len = bodylen - ec;
+    }
+
+  span_init (&s, p, len);
+  maj_stat = cfx_open (k5, tok, flags, ec, &s, p + len);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  if (flags & CFX_FLAG_SEALED)
+    {
+      len -= CFX_CONFOUNDER_LEN + ec + CFX_HEADER_LEN;
+      memmove (p, p + CFX_CONFOUNDER_LEN, len);
+    }
+
+  *plen = len;
+
+  if (conf_state)
+    *conf_state = flags & CFX_FLAG_SEALED ? 1 : 0;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Fill in the SND_SEQ field of an RFC 1964 token at TOK, encrypted
+   with the context key and the first 8 bytes of the following
+   checksum as IV. */
+static void
+seqnr_1964 (_gss_krb5_ctx_t k5, int des3, char *tok, uint32_t seqnr)
+{
+  uint8_t iv[DES_BLOCK_SIZE];
+
+  tok[8] = seqnr & 0xFF;
+  tok[9] = seqnr >> 8 & 0xFF;
+  tok[10] = seqnr >> 16 & 0xFF;
+  tok[11] = seqnr >> 24 & 0xFF;
+  memset (tok + 12, k5->acceptor ? 0xFF : 0, 4);
+
+  memcpy (iv, tok + 16, sizeof (iv));
+  des_cbc_buf (&k5->cipher, des3, 0, iv, tok + 8, 8);
+}
+
+/* Whether the SND_SEQ field of the RFC 1964 token at TOK holds the
+   sequence number expected from the peer. */
+static int
+seqnr_1964_ok (_gss_krb5_ctx_t k5, int des3, const char *tok)
+{
+  uint8_t iv[DES_BLOCK_SIZE];
+  char seq[8];
+
+  memcpy (iv, tok + 16, sizeof (iv));
+  memcpy (seq, tok + 8, sizeof (seq));
+  des_cbc_buf (&k5->cipher, des3, 1, iv, seq, sizeof (seq));
+
+  return memcmp (seq + 4, k5->acceptor ? "\x00\x00\x00\x00" :
+		 "\xFF\xFF\xFF\xFF", 4) == 0
+    && C2I (seq) == (k5->acceptor ? k5->initseqnr : k5->acceptseqnr);
+}
+
+/* Encrypt or decrypt, in place, the octets of span S with the RFC
+   1964 sealing algorithm of the context key: DES-CBC keyed with the
+   session key XOR F0F0F0F0F0F0F0F0 (SEAL_ALG 0000), or DES3-CBC keyed
+   with the session key (SEAL_ALG 0200).  The IV is zero in both
+   cases. */
+static void
+seal_crypt (_gss_krb5_ctx_t k5, int decryptp, const span_desc * s)
+{
+  uint8_t iv[DES_BLOCK_SIZE];
+
+  memset (iv, 0, sizeof (iv));
+
+  if (shishi_key_type (k5->key) == SHISHI_DES_CBC_MD5)
+    des_cbc (&k5->seal, 0, decryptp, iv, s);
+  else
+    des_cbc (&k5->cipher, 1, decryptp, iv, s);
+}
+
+/* Write to OUT the RFC 1964 checksum of the 8 octet token header at
+   HDR followed by the octets of span S: DES-MAC-MD5 for DES, or HMAC
+   SHA1 DES3-KD keyed by KC for DES3.  The parts are hashed where they
+   are. */
+static void
+checksum_1964 (_gss_krb5_ctx_t k5, struct hmac_sha1_ctx *kc,
+	       const char *hdr, const span_desc * s, char *out)
+{
+  struct md5_ctx md5;
+  char digest[MD5_DIGEST_SIZE];
+  uint8_t iv[DES_BLOCK_SIZE];
+
+  if (shishi_key_type (k5->key) == SHISHI_DES3_CBC_HMAC_SHA1_KD)
+    {
+      hmac_sha1_update (kc, 8, (const uint8_t *) hdr);
+      span_hash (s, kc, (nettle_hash_update_func *) hmac_sha1_update);
+      hmac_sha1_digest (kc, 20, (uint8_t *) out);
+      return;
+    }
+
+  /* DES-CBC MAC of the MD5 hash, with the context key and a zero IV,
+     i.e., the last block of its DES-CBC encryption. */
+  md5_init (&md5);
+  md5_update (&md5, 8, (const uint8_t *) hdr);
+  span_hash (s, &md5, (nettle_hash_update_func *) md5_update);
+  md5_digest (&md5, sizeof (digest), (uint8_t *) digest);
+
+  memset (iv, 0, sizeof (iv));
+  des_cbc_buf (&k5->cipher, 0, 0, iv, digest, sizeof (digest));
+  memcpy (out, digest + sizeof (digest) - 8, 8);
+}
+
+/* Size of an RFC 1964 Wrap token for a MSGLEN octet message,
+   including the mechanism-independent header. */
+static size_t
+wrap_1964_size (int des3, size_t msglen)
+{
+  /* Header, sequence number, checksum, confounder, data and pad. */
+  size_t toklen = 8 + 8 + (des3 ? 20 : 8) + 8 + msglen + 8 - msglen % 8;
+
+  return _gss_encapsulate_token_header (GSS_KRB5->elements,
+					GSS_KRB5->length, toklen, NULL)
+    + toklen;
+}
+
+/* Protect an RFC 1964 Wrap token whose 8 + 8 + checksum octets are at
+   TOK.  Span S is the confounder, which must be at HEAD, the message
+   and the pad, all laid out by the caller.  The header, sequence
+   number and checksum are filled in, and S is encrypted if
+   CONF_REQ_FLAG. */
+static OM_uint32
+seal_1964 (_gss_krb5_ctx_t k5, int conf_req_flag, char *tok,
+	   const span_desc * s)
+{
+  int des3 = shishi_key_type (k5->key) == SHISHI_DES3_CBC_HMAC_SHA1_KD;
+  uint32_t seqnr = k5->acceptor ? k5->acceptseqnr : k5->initseqnr;
+  int rc;
+
+  memcpy (tok, TOK_WRAP, TOK_LEN);	/* TOK_ID: Wrap 0201 */
+  /* SGN_ALG: DES-MAC-MD5 or HMAC SHA1 DES3-KD */
+  memcpy (tok + 2, des3 ? "\x04\x00" : "\x00\x00", 2);
+  /* SEAL_ALG: DES, DES3-KD or none */
+  if (conf_req_flag)
+    memcpy (tok + 4, des3 ? "\x02\x00" : "\x00\x00", 2);
+  else
+    memcpy (tok + 4, "\xFF\xFF", 2);
+  memcpy (tok + 6, "\xFF\xFF", 2);	/* filler */
+
+  rc = shishi_randomize (k5->sh, 0, s->head, 8);
+  if (rc != SHISHI_OK)
+    return GSS_S_FAILURE;
+
+  /* The checksum covers the header followed by the plaintext
+     confounder, data and pad. */
+  checksum_1964 (k5, &k5->send_kc, tok, s, tok + 16);
+  seqnr_1964 (k5, des3, tok, seqnr);
+  if (conf_req_flag)
+    seal_crypt (k5, 0, s);
+
+  if (k5->acceptor)
+    k5->acceptseqnr++;
+  else
+    k5->initseqnr++;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Wrap tokens for the DES and DES3 keys, RFC 1964 and
+   draft-raeburn-cat-gssapi-krb5-3des.  The whole token, including the
+   mechanism-independent header, is built in OUT, of wrap_1964_size
+   octets. */
+static OM_uint32
+wrap_1964 (_gss_krb5_ctx_t k5,
+	   int conf_req_flag,
+	   const gss_buffer_t input_message_buffer,
+	   char *out, size_t * outlen)
+{
+  int des3 = shishi_key_type (k5->key) == SHISHI_DES3_CBC_HMAC_SHA1_KD;
+  size_t cksumlen = des3 ? 20 : 8;
+  size_t msglen = input_message_buffer->length;
+  size_t padlength = 8 - msglen % 8;
+  /* Confounder, data and pad. */
+  size_t datalen = 8 + msglen + padlength;
+  size_t toklen = 8 + 8 + cksumlen + datalen;
+  size_t hdrlen;
+  char *tok, *data;
+  span_desc s;
+  OM_uint32 maj_stat;
+
+  /* Typical DES data:
+     ;; 02 01 00 00 ff ff ff ff  0c 22 1f 79 59 3d 00 cb
+     ;; d5 78 2f fb 50 d2 b8 59  fb b4 e0 9b d0 a2 fa dc
+     ;; 01 00 20 00 04 04 04 04
+     Translates into:
+     ;;   HEADER                 ENCRYPTED SEQ.NUMBER
+     ;;   DES-MAC-MD5 CKSUM      CONFOUNDER
+     ;;   PADDED DATA
+     DES3 tokens have a 20 byte HMAC SHA1 DES3-KD checksum instead.
+   */
+
+  hdrlen = _gss_encapsulate_token_header (GSS_KRB5->elements,
+					  GSS_KRB5->length, toklen, out);
+  tok = out + hdrlen;
+  data = tok + 8 + 8 + cksumlen;
+
+  memcpy (data + 8, input_message_buffer->value, msglen);
+  memset (data + 8 + msglen, (int) padlength, padlength);
+
+  span_init (&s, data, datalen);
+  maj_stat = seal_1964 (k5, conf_req_flag, tok, &s);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  *outlen = hdrlen + toklen;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Size of an RFC 1964 MIC token, including the
+   mechanism-independent header. */
+static size_t
+mic_1964_size (int des3)
+{
+  size_t toklen = 8 + 8 + (des3 ? 20 : 8);
+
+  return _gss_encapsulate_token_header (GSS_KRB5->elements,
+					GSS_KRB5->length, toklen, NULL)
+    + toklen;
+}
+
+/* MIC tokens for the DES and DES3 keys, built in OUT, of
+   mic_1964_size octets.  The checksum covers the 8 byte header
+   followed by the message. */
+static OM_uint32
+get_mic_1964 (OM_uint32 * minor_status,
+	      _gss_krb5_ctx_t k5,
+	      const gss_buffer_t message_buffer,
+	      char *out, size_t * outlen)
+{
+  int des3 = shishi_key_type (k5->key) == SHISHI_DES3_CBC_HMAC_SHA1_KD;
+  size_t cksumlen = des3 ? 20 : 8;
+  size_t toklen = 8 + 8 + cksumlen;
+  uint32_t seqnr = k5->acceptor ? k5->acceptseqnr : k5->initseqnr;
+  size_t hdrlen;
+  span_desc s;
+  char *tok;
+
+  hdrlen = _gss_encapsulate_token_header (GSS_KRB5->elements,
+					  GSS_KRB5->length, toklen, out);
+  tok = out + hdrlen;
+
+  memcpy (tok, TOK_MIC, TOK_LEN);	/* TOK_ID: MIC 0101 */
+  /* SGN_ALG: DES-MAC-MD5 or HMAC SHA1 DES3-KD */
+  memcpy (tok + 2, des3 ? "\x04\x00" : "\x00\x00", 2);
+  memcpy (tok + 4, "\xFF\xFF\xFF\xFF", 4);	/* filler */
+
+  span_init (&s, message_buffer->value, message_buffer->length);
+  checksum_1964 (k5, &k5->send_kc, tok, &s, tok + 16);
+  seqnr_1964 (k5, des3, tok, seqnr);
+
+  *outlen = hdrlen + toklen;
+
+  if (k5->acceptor)
+    k5->acceptseqnr++;
+  else
+    k5->initseqnr++;
+
+  return GSS_S_COMPLETE;
+}
+
+static OM_uint32
+verify_mic_1964 (OM_uint32 * minor_status,
+		 _gss_krb5_ctx_t k5,
+		 const gss_buffer_t message_buffer,
+		 const gss_buffer_t token_buffer)
+{
+  gss_buffer_desc tok;
+  int des3 = shishi_key_type (k5->key) == SHISHI_DES3_CBC_HMAC_SHA1_KD;
+  size_t cksumlen = des3 ? 20 : 8;
+  char cksum[20];
+  span_desc s;
+  char *data;
+  int rc;
+
+  rc = gss_decapsulate_token_view (token_buffer, GSS_KRB5, &tok);
+  if (rc != GSS_S_COMPLETE)
+    return GSS_S_DEFECTIVE_TOKEN;
+  data = tok.value;
+
+  if (tok.length != 8 + 8 + cksumlen
+      || memcmp (data, TOK_MIC, TOK_LEN) != 0
+      || memcmp (data + 2, des3 ? "\x04\x00" : "\x00\x00", 2) != 0
+      || memcmp (data + 4, "\xFF\xFF\xFF\xFF", 4) != 0)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  span_init (&s, message_buffer->value, message_buffer->length);
+  checksum_1964 (k5, &k5->recv_kc, data, &s, cksum);
+  if (memcmp (cksum, data + 16, cksumlen) != 0)
+    return GSS_S_BAD_MIC;
+
+  if (!seqnr_1964_ok (k5, des3, data))
+    return GSS_S_BAD_MIC;
+
+  if (k5->acceptor)
+    k5->initseqnr++;
+  else
+    k5->acceptseqnr++;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Write a CFX MIC token header into HDR. */
+static void
+cfx_mic_header (char *hdr, int flags, uint32_t seqnr)
+{
+  memcpy (hdr, TOK_CFX_MIC, TOK_LEN);
+  hdr[2] = flags;
+  memset (hdr + 3, 0xFF, 5);
+  memset (hdr + 8, 0, 4);
+  hdr[12] = (seqnr >> 24) & 0xFF;
+  hdr[13] = (seqnr >> 16) & 0xFF;
+  hdr[14] = (seqnr >> 8) & 0xFF;
+  hdr[15] = seqnr & 0xFF;
+}
+
+/* RFC 4121 MIC tokens: the header followed by a checksum over the
+   message and the header, built in OUT. */
+static OM_uint32
+cfx_get_mic (OM_uint32 * minor_status,
+	     _gss_krb5_ctx_t k5,
+	     const gss_buffer_t message_buffer,
+	     char *out, size_t * outlen)
+{
+  uint32_t seqnr = k5->acceptor ? k5->acceptseqnr : k5->initseqnr;
+
+  cfx_mic_header (out, k5->acceptor ? CFX_FLAG_SENT_BY_ACCEPTOR : 0, seqnr);
+
+  hmac_sha1_update (&k5->send_kc, message_buffer->length,
+		    message_buffer->value);
+  kd_hmac (&k5->send_kc, out, CFX_HEADER_LEN, out + CFX_HEADER_LEN,
+	   CFX_HMAC_LEN);
+
+  *outlen = CFX_HEADER_LEN + CFX_HMAC_LEN;
+
+  if (k5->acceptor)
+    k5->acceptseqnr++;
+  else
+    k5->initseqnr++;
+
+  return GSS_S_COMPLETE;
+}
+
+static OM_uint32
+cfx_verify_mic (OM_uint32 * minor_status,
+		_gss_krb5_ctx_t k5,
+		const gss_buffer_t message_buffer,
+		const gss_buffer_t token_buffer)
+{
+  const char *tok = token_buffer->value;
+  char cksum[CFX_HMAC_LEN];
+  int flags;
+
+  if (token_buffer->length != CFX_HEADER_LEN + CFX_HMAC_LEN
+      || memcmp (tok, TOK_CFX_MIC, TOK_LEN) != 0
+      || memcmp (tok + 3, "\xFF\xFF\xFF\xFF\xFF", 5) != 0)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  flags = tok[2] & 0xFF;
+  if (!(flags & CFX_FLAG_SENT_BY_ACCEPTOR) != !!k5->acceptor)
+    return GSS_S_BAD_MIC;
+  if (flags & CFX_FLAG_ACCEPTOR_SUBKEY)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  if (memcmp (tok + 8, "\x00\x00\x00\x00", 4) != 0
+      || (uint32_t) ((tok[12] & 0xFF) << 24 | (tok[13] & 0xFF) << 16
+		     | (tok[14] & 0xFF) << 8 | (tok[15] & 0xFF))
+      != (k5->acceptor ? k5->initseqnr : k5->acceptseqnr))
+    return GSS_S_BAD_MIC;
+
+  hmac_sha1_update (&k5->recv_kc, message_buffer->length,
+		    message_buffer->value);
+  kd_hmac (&k5->recv_kc, tok, CFX_HEADER_LEN, cksum, CFX_HMAC_LEN);
+  if (memcmp (cksum, tok + CFX_HEADER_LEN, CFX_HMAC_LEN) != 0)
+    return GSS_S_BAD_MIC;
+
+  if (k5->acceptor)
+    k5->initseqnr++;
+  else
+    k5->acceptseqnr++;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Size of a MIC token for the context key, or 0 if the key type is
+   not supported. */
+static size_t
+mic_size (_gss_krb5_ctx_t k5)
+{
+  switch (shishi_key_type (k5->key))
+    {
+    case SHISHI_DES_CBC_MD5:
+      return mic_1964_size (0);
+
+    case SHISHI_DES3_CBC_HMAC_SHA1_KD:
+      return mic_1964_size (1);
+
+    case SHISHI_AES128_CTS_HMAC_SHA1_96:
+    case SHISHI_AES256_CTS_HMAC_SHA1_96:
+      return CFX_HEADER_LEN + CFX_HMAC_LEN;
+
+    default:
+      return 0;
+    }
+}
+
+/* Build a MIC token in OUT, of mic_size octets. */
+static OM_uint32
+mic_token (OM_uint32 * minor_status,
+	   _gss_krb5_ctx_t k5,
+	   const gss_buffer_t message_buffer, char *out, size_t * outlen)
+{
+  switch (shishi_key_type (k5->key))
+    {
+    case SHISHI_DES_CBC_MD5:
+    case SHISHI_DES3_CBC_HMAC_SHA1_KD:
+      return get_mic_1964 (minor_status, k5, message_buffer, out, outlen);
+
+    default:
+      return cfx_get_mic (minor_status, k5, message_buffer, out, outlen);
+    }
+}
+
 OM_uint32
 gss_krb5_get_mic (OM_uint32 * minor_status,
 		  const gss_ctx_id_t context_handle,
@@ -38,230 +1281,485 @@ gss_krb5_get_mic (OM_uint32 * minor_status,
 		  const gss_buffer_t message_buffer,
 		  gss_buffer_t message_token)
 {
-  return GSS_S_UNAVAILABLE;
+  _gss_krb5_ctx_t k5 = context_handle->krb5;
+  size_t len = mic_size (k5);
+  OM_uint32 maj_stat;
+  char *out;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  if (len == 0)
+    return GSS_S_FAILURE;
+
+  out = malloc (len);
+  if (!out)
+    {
+      if (minor_status)
+	*minor_status = ENOMEM;
+      return GSS_S_FAILURE;
+    }
+
+  maj_stat = mic_token (minor_status, k5, message_buffer, out, &len);
+  if (GSS_ERROR (maj_stat))
+    {
+      free (out);
+      return maj_stat;
+    }
+
+  message_token->value = out;
+  message_token->length = len;
+
+  return GSS_S_COMPLETE;
+}
+
+OM_uint32
+gss_krb5_get_mic_into (OM_uint32 * minor_status,
+		       const gss_ctx_id_t context_handle,
+		       gss_qop_t qop_req,
+		       const gss_buffer_t message_buffer,
+		       gss_buffer_t message_token)
+{
+  _gss_krb5_ctx_t k5 = context_handle->krb5;
+  size_t len = mic_size (k5);
+  OM_uint32 maj_stat;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  if (len == 0)
+    return GSS_S_FAILURE;
+
+  maj_stat = _gss_buffer_fits (minor_status, message_token, len);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  maj_stat = mic_token (minor_status, k5, message_buffer,
+			message_token->value, &len);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  message_token->length = len;
+
+  return GSS_S_COMPLETE;
+}
+
+OM_uint32
+gss_krb5_verify_mic (OM_uint32 * minor_status,
+		     const gss_ctx_id_t context_handle,
+		     const gss_buffer_t message_buffer,
+		     const gss_buffer_t token_buffer, gss_qop_t * qop_state)
+{
+  _gss_krb5_ctx_t k5 = context_handle->krb5;
+
+  if (minor_status)
+    *minor_status = 0;
+  if (qop_state)
+    *qop_state = GSS_C_QOP_DEFAULT;
+
+  /* The token format follows from the context key, never from the
+     token: only the keys of that format are derived. */
+  switch (shishi_key_type (k5->key))
+    {
+    case SHISHI_DES_CBC_MD5:
+    case SHISHI_DES3_CBC_HMAC_SHA1_KD:
+      return verify_mic_1964 (minor_status, k5, message_buffer,
+			      token_buffer);
+
+    case SHISHI_AES128_CTS_HMAC_SHA1_96:
+    case SHISHI_AES256_CTS_HMAC_SHA1_96:
+      return cfx_verify_mic (minor_status, k5, message_buffer, token_buffer);
+
+    default:
+      return GSS_S_DEFECTIVE_TOKEN;
+    }
+}
+
+/* Size of the buffer a Wrap token for a MSGLEN octet message is
+   built in, or 0 if the key type is not supported. */
+static size_t
+wrap_size (_gss_krb5_ctx_t k5, int conf_req_flag, size_t msglen)
+{
+  switch (shishi_key_type (k5->key))
+    {
+    case SHISHI_DES_CBC_MD5:
+      return wrap_1964_size (0, msglen);
+
+    case SHISHI_DES3_CBC_HMAC_SHA1_KD:
+      return wrap_1964_size (1, msglen);
+
+    case SHISHI_AES128_CTS_HMAC_SHA1_96:
+    case SHISHI_AES256_CTS_HMAC_SHA1_96:
+      return cfx_wrap_size (conf_req_flag, msglen);
+
+    default:
+      return 0;
+    }
+}
+
+/* Build a Wrap token in OUT, of wrap_size octets. */
+static OM_uint32
+wrap_token (_gss_krb5_ctx_t k5,
+	    int conf_req_flag,
+	    const gss_buffer_t input_message_buffer,
+	    char *out, size_t * outlen)
+{
+  switch (shishi_key_type (k5->key))
+    {
+    case SHISHI_DES_CBC_MD5:
+    case SHISHI_DES3_CBC_HMAC_SHA1_KD:
+      return wrap_1964 (k5, conf_req_flag, input_message_buffer,
+			out, outlen);
+
+    default:
+      return cfx_wrap (k5, conf_req_flag, input_message_buffer,
+		       out, outlen);
+    }
+}
+
+OM_uint32
+gss_krb5_wrap (OM_uint32 * minor_status,
+	       const gss_ctx_id_t context_handle,
+	       int conf_req_flag,
+	       gss_qop_t qop_req,
+	       const gss_buffer_t input_message_buffer,
+	       int *conf_state, gss_buffer_t output_message_buffer)
+{
+  _gss_krb5_ctx_t k5 = context_handle->krb5;
+  size_t len = wrap_size (k5, conf_req_flag, input_message_buffer->length);
+  OM_uint32 maj_stat;
+  char *out;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  if (len == 0)
+    return GSS_S_FAILURE;
+
+  /* The token is built in place, this is the only allocation. */
+  out = malloc (len);
+  if (!out)
+    {
+      if (minor_status)
+	*minor_status = ENOMEM;
+      return GSS_S_FAILURE;
+    }
+
+  maj_stat = wrap_token (k5, conf_req_flag, input_message_buffer, out, &len);
+  if (GSS_ERROR (maj_stat))
+    {
+      free (out);
+      return maj_stat;
+    }
+
+  output_message_buffer->value = out;
+  output_message_buffer->length = len;
+
+  if (conf_state)
+    *conf_state = conf_req_flag ? 1 : 0;
+
+  return GSS_S_COMPLETE;
+}
+
+OM_uint32
+gss_krb5_wrap_into (OM_uint32 * minor_status,
+		    const gss_ctx_id_t context_handle,
+		    int conf_req_flag,
+		    gss_qop_t qop_req,
+		    const gss_buffer_t input_message_buffer,
+		    int *conf_state, gss_buffer_t output_message_buffer)
+{
+  _gss_krb5_ctx_t k5 = context_handle->krb5;
+  size_t len = wrap_size (k5, conf_req_flag, input_message_buffer->length);
+  OM_uint32 maj_stat;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  if (len == 0)
+    return GSS_S_FAILURE;
+
+  maj_stat = _gss_buffer_fits (minor_status, output_message_buffer, len);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  maj_stat = wrap_token (k5, conf_req_flag, input_message_buffer,
+			 output_message_buffer->value, &len);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  output_message_buffer->length = len;
+
+  if (conf_state)
+    *conf_state = conf_req_flag ? 1 : 0;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Largest token body that fits in SIZE octets together with the
+   mechanism-independent header.  The header only grows with the
+   number of octets in the ASN.1 length, so this takes at most a few
+   steps. */
+static size_t
+max_1964_toklen (size_t size)
+{
+  size_t hdrlen = _gss_encapsulate_token_header (GSS_KRB5->elements,
+						 GSS_KRB5->length, 0, NULL);
+
+  while (hdrlen < size
+	 && _gss_encapsulate_token_header (GSS_KRB5->elements,
+					   GSS_KRB5->length,
+					   size - hdrlen, NULL) > hdrlen)
+    hdrlen++;
+
+  return hdrlen < size ? size - hdrlen : 0;
 }
 
-OM_uint32
-gss_krb5_verify_mic (OM_uint32 * minor_status,
-		     const gss_ctx_id_t context_handle,
-		     const gss_buffer_t message_buffer,
-		     const gss_buffer_t token_buffer, gss_qop_t * qop_state)
+/* Largest message whose RFC 1964 Wrap token fits in SIZE octets.  The
+   message is always padded with 1 to 8 octets to a multiple of 8. */
+static size_t
+wrap_1964_limit (int des3, size_t size)
+{
+  size_t fixed = 8 + 8 + (des3 ? 20 : 8) + 8;
+  size_t toklen = max_1964_toklen (size);
+
+  if (toklen < fixed + 8)
+    return 0;
+
+  return (toklen - fixed) / 8 * 8 - 1;
+}
+
+/* Largest message whose CFX Wrap token fits in SIZE octets. */
+static size_t
+cfx_wrap_limit (int conf_req_flag, size_t size)
 {
-  return GSS_S_UNAVAILABLE;
+  size_t overhead = conf_req_flag
+    ? CFX_HEADER_LEN + CFX_CONFOUNDER_LEN + CFX_HEADER_LEN + CFX_HMAC_LEN
+    : CFX_HEADER_LEN + CFX_HMAC_LEN;
+
+  return size > overhead ? size - overhead : 0;
 }
 
 OM_uint32
-gss_krb5_wrap (OM_uint32 * minor_status,
-	       const gss_ctx_id_t context_handle,
-	       int conf_req_flag,
-	       gss_qop_t qop_req,
-	       const gss_buffer_t input_message_buffer,
-	       int *conf_state, gss_buffer_t output_message_buffer)
+gss_krb5_wrap_size_limit (OM_uint32 * minor_status,
+			  const gss_ctx_id_t context_handle,
+			  int conf_req_flag,
+			  gss_qop_t qop_req,
+			  OM_uint32 req_output_size,
+			  OM_uint32 * max_input_size)
 {
   _gss_krb5_ctx_t k5 = context_handle->krb5;
-  size_t padlength;
-  gss_buffer_desc data;
-  char *p;
-  size_t tmplen;
-  int rc;
+
+  if (minor_status)
+    *minor_status = 0;
 
   switch (shishi_key_type (k5->key))
     {
-      /* XXX implement other checksums */
-
     case SHISHI_DES_CBC_MD5:
-      {
-	char header[8];
-	char seqno[8];
-	char *eseqno;
-	char *cksum;
-	char confounder[8];
-
-	/* Typical data:
-	   ;; 02 01 00 00 ff ff ff ff  0c 22 1f 79 59 3d 00 cb
-	   ;; d5 78 2f fb 50 d2 b8 59  fb b4 e0 9b d0 a2 fa dc
-	   ;; 01 00 20 00 04 04 04 04
-	   Translates into:
-	   ;;   HEADER                 ENCRYPTED SEQ.NUMBER
-	   ;;   DES-MAC-MD5 CKSUM      CONFOUNDER
-	   ;;   PADDED DATA
-	 */
-	padlength = 8 - input_message_buffer->length % 8;
-	data.length = 4 * 8 + input_message_buffer->length + padlength;
-	p = malloc (data.length);
-	if (!p)
-	  {
-	    if (minor_status)
-	      *minor_status = ENOMEM;
-	    return GSS_S_FAILURE;
-	  }
-
-	/* XXX encrypt data iff confidential option chosen */
-
-	/* Setup header and confounder */
-	memcpy (header, TOK_WRAP, 2);	/* TOK_ID: Wrap 0201 */
-	memcpy (header + 2, "\x00\x00", 2);	/* SGN_ALG: DES-MAC-MD5 */
-	memcpy (header + 4, "\xFF\xFF", 2);	/* SEAL_ALG: none */
-	memcpy (header + 6, "\xFF\xFF", 2);	/* filler */
-	rc = shishi_randomize (k5->sh, 0, confounder, 8);
-	if (rc != SHISHI_OK)
-	  return GSS_S_FAILURE;
-
-	/* Compute checksum over header, confounder, input string, and pad */
-	memcpy (p, header, 8);
-	memcpy (p + 8, confounder, 8);
-	memcpy (p + 16, input_message_buffer->value,
-		input_message_buffer->length);
-	memset (p + 16 + input_message_buffer->length,
-		(int) padlength, padlength);
-
-	rc = shishi_checksum (k5->sh,
-			      k5->key,
-			      0, SHISHI_RSA_MD5_DES_GSS,
-			      p,
-			      16 + input_message_buffer->length + padlength,
-			      &cksum, &tmplen);
-	if (rc != SHISHI_OK || tmplen != 8)
-	  return GSS_S_FAILURE;
+      *max_input_size = wrap_1964_limit (0, req_output_size);
+      break;
 
-	/* seq_nr */
-	if (k5->acceptor)
-	  {
-	    seqno[0] = k5->acceptseqnr & 0xFF;
-	    seqno[1] = k5->acceptseqnr >> 8 & 0xFF;
-	    seqno[2] = k5->acceptseqnr >> 16 & 0xFF;
-	    seqno[3] = k5->acceptseqnr >> 24 & 0xFF;
-	    memset (seqno + 4, 0xFF, 4);
-	  }
-	else
-	  {
-	    seqno[0] = k5->initseqnr & 0xFF;
-	    seqno[1] = k5->initseqnr >> 8 & 0xFF;
-	    seqno[2] = k5->initseqnr >> 16 & 0xFF;
-	    seqno[3] = k5->initseqnr >> 24 & 0xFF;
-	    memset (seqno + 4, 0, 4);
-	  }
-
-	rc = shishi_encrypt_iv_etype (k5->sh, k5->key, 0,
-				      SHISHI_DES_CBC_NONE, cksum, 8,
-				      seqno, 8, &eseqno, &tmplen);
-	if (rc != SHISHI_OK || tmplen != 8)
-	  return GSS_S_FAILURE;
+    case SHISHI_DES3_CBC_HMAC_SHA1_KD:
+      *max_input_size = wrap_1964_limit (1, req_output_size);
+      break;
 
-	/* put things in place */
-	memcpy (p, header, 8);
-	memcpy (p + 8, eseqno, 8);
-	free (eseqno);
-	memcpy (p + 16, cksum, 8);
-	free (cksum);
-	memcpy (p + 24, confounder, 8);
-	memcpy (p + 32, input_message_buffer->value,
-		input_message_buffer->length);
-	memset (p + 32 + input_message_buffer->length,
-		(int) padlength, padlength);
-
-	data.value = p;
-
-	rc = gss_encapsulate_token (&data, GSS_KRB5, output_message_buffer);
-	if (rc != GSS_S_COMPLETE)
-	  return GSS_S_FAILURE;
-	if (k5->acceptor)
-	  k5->acceptseqnr++;
-	else
-	  k5->initseqnr++;
-      }
+    case SHISHI_AES128_CTS_HMAC_SHA1_96:
+    case SHISHI_AES256_CTS_HMAC_SHA1_96:
+      *max_input_size = cfx_wrap_limit (conf_req_flag, req_output_size);
       break;
 
-    case SHISHI_DES3_CBC_HMAC_SHA1_KD:
-      {
-	char *tmp;
-
-	padlength = 8 - input_message_buffer->length % 8;
-	data.length = 8 + 8 + 20 + 8 + input_message_buffer->length
-	  + padlength;
-	p = malloc (data.length);
-	if (!p)
-	  {
-	    if (minor_status)
-	      *minor_status = ENOMEM;
-	    return GSS_S_FAILURE;
-	  }
-
-	/* XXX encrypt data iff confidential option chosen */
-
-	/* Compute checksum over header, confounder, input string, and pad */
-
-	memcpy (p, TOK_WRAP, 2);	/* TOK_ID: Wrap */
-	memcpy (p + 2, "\x04\x00", 2);	/* SGN_ALG: 3DES */
-	memcpy (p + 4, "\xFF\xFF", 2);	/* SEAL_ALG: none */
-	memcpy (p + 6, "\xFF\xFF", 2);	/* filler */
-	rc = shishi_randomize (k5->sh, 0, p + 8, 8);
-	if (rc != SHISHI_OK)
-	  return GSS_S_FAILURE;
-	memcpy (p + 16, input_message_buffer->value,
-		input_message_buffer->length);
-	memset (p + 16 + input_message_buffer->length,
-		(int) padlength, padlength);
-
-	rc = shishi_checksum (k5->sh,
-			      k5->key,
-			      SHISHI_KEYUSAGE_GSS_R2,
-			      SHISHI_HMAC_SHA1_DES3_KD, p,
-			      16 + input_message_buffer->length + padlength,
-			      &tmp, &tmplen);
-	if (rc != SHISHI_OK || tmplen != 20)
-	  return GSS_S_FAILURE;
+    default:
+      return GSS_S_FAILURE;
+    }
 
-	memcpy (p + 16, tmp, tmplen);
-	memcpy (p + 36, p + 8, 8);
-
-	/* seq_nr */
-	if (k5->acceptor)
-	  {
-	    (p + 8)[0] = k5->acceptseqnr & 0xFF;
-	    (p + 8)[1] = k5->acceptseqnr >> 8 & 0xFF;
-	    (p + 8)[2] = k5->acceptseqnr >> 16 & 0xFF;
-	    (p + 8)[3] = k5->acceptseqnr >> 24 & 0xFF;
-	    memset (p + 8 + 4, 0xFF, 4);
-	  }
-	else
-	  {
-	    (p + 8)[0] = k5->initseqnr & 0xFF;
-	    (p + 8)[1] = k5->initseqnr >> 8 & 0xFF;
-	    (p + 8)[2] = k5->initseqnr >> 16 & 0xFF;
-	    (p + 8)[3] = k5->initseqnr >> 24 & 0xFF;
-	    memset (p + 8 + 4, 0, 4);
-	  }
-
-	rc = shishi_encrypt_iv_etype (k5->sh, k5->key, 0, SHISHI_DES3_CBC_NONE, p + 16, 8,	/* cksum */
-				      p + 8, 8, &tmp, &tmplen);
-	if (rc != SHISHI_OK || tmplen != 8)
-	  return GSS_S_FAILURE;
+  return GSS_S_COMPLETE;
+}
 
-	memcpy (p + 8, tmp, tmplen);
-	free (tmp);
-	memcpy (p + 8 + 8 + 20 + 8, input_message_buffer->value,
-		input_message_buffer->length);
-	memset (p + 8 + 8 + 20 + 8 + input_message_buffer->length,
-		(int) padlength, padlength);
+/* Check the 8 + 8 + checksum octets of the RFC 1964 Wrap token at
+   TOK, and whether it is sealed.  DATALEN is the length of the
+   confounder, data and pad that follow. */
+static OM_uint32
+unwrap_1964_header (_gss_krb5_ctx_t k5, const char *tok, size_t datalen,
+		    int *sealed)
+{
+  int des3 = shishi_key_type (k5->key) == SHISHI_DES3_CBC_HMAC_SHA1_KD;
+  OM_uint32 sgn_alg, seal_alg;
 
-	data.value = p;
+  /* Typical data:
+     ;; 02 01 00 00 ff ff ff ff  0c 22 1f 79 59 3d 00 cb
+     ;; d5 78 2f fb 50 d2 b8 59  fb b4 e0 9b d0 a2 fa dc
+     ;; 01 00 20 00 04 04 04 04
+     Translates into:
+     ;;   HEADER                 ENCRYPTED SEQ.NUMBER
+     ;;   DES-MAC-MD5 CKSUM      CONFOUNDER
+     ;;   PADDED DATA
+   */
+
+  if (memcmp (tok, TOK_WRAP, TOK_LEN) != 0)
+    return GSS_S_BAD_MIC;
 
-	rc = gss_encapsulate_token (&data, GSS_KRB5, output_message_buffer);
-	if (rc != GSS_S_COMPLETE)
-	  return GSS_S_FAILURE;
-	if (k5->acceptor)
-	  k5->acceptseqnr++;
-	else
-	  k5->initseqnr++;
-	break;
-      }
+  if (datalen < 8 + 8)
+    return GSS_S_BAD_MIC;
+
+  sgn_alg = tok[2] & 0xFF;
+  sgn_alg |= tok[3] << 8 & 0xFF00;
+
+  seal_alg = tok[4] & 0xFF;
+  seal_alg |= tok[5] << 8 & 0xFF00;
+
+  /* SGN_ALG 0 is DES-MAC-MD5, 4 is HMAC SHA1 DES3-KD. */
+  if (sgn_alg != (des3 ? 4 : 0))
+    return GSS_S_FAILURE;
+
+  if (memcmp (tok + 6, "\xFF\xFF", 2) != 0)
+    return GSS_S_BAD_MIC;
+
+  /* SEAL_ALG 0 is DES, 0x0200 (little endian) is DES3-KD. */
+  if (seal_alg != 0xFFFF && seal_alg != (des3 ? 0x0002 : 0))
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  if (seal_alg != 0xFFFF && datalen % 8 != 0)
+    return GSS_S_BAD_MIC;
+
+  if (!seqnr_1964_ok (k5, des3, tok))
+    return GSS_S_BAD_MIC;
+
+  *sealed = seal_alg != 0xFFFF;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Check, and if SEALED decrypt in place, span S, the confounder, data
+   and pad of the RFC 1964 Wrap token whose header, checked by
+   unwrap_1964_header, is at TOK.  The pad length is stored in
+   *PADLEN. */
+static OM_uint32
+open_1964 (_gss_krb5_ctx_t k5, const char *tok, int sealed,
+	   const span_desc * s, size_t * padlen)
+{
+  int des3 = shishi_key_type (k5->key) == SHISHI_DES3_CBC_HMAC_SHA1_KD;
+  size_t cksumlen = des3 ? 20 : 8;
+  size_t datalen = span_length (s), i;
+  char cksum[20], pad[8];
+  span_pos pos;
+
+  if (sealed)
+    seal_crypt (k5, 1, s);
+
+  /* Check pad */
+  span_start (&pos, s);
+  span_copy (&pos, NULL, datalen - 1, 0);
+  span_copy (&pos, pad, 1, 0);
+  *padlen = pad[0] & 0xFF;
+  if (*padlen > 8 || *padlen > datalen - 8)
+    return GSS_S_BAD_MIC;
+
+  span_start (&pos, s);
+  span_copy (&pos, NULL, datalen - *padlen, 0);
+  span_copy (&pos, pad, *padlen, 0);
+  for (i = 0; i < *padlen; i++)
+    if ((pad[i] & 0xFF) != *padlen)
+      return GSS_S_BAD_MIC;
+
+  /* Checksum header + confounder + data + pad */
+  checksum_1964 (k5, &k5->recv_kc, tok, s, cksum);
+  if (memcmp (cksum, tok + 16, cksumlen) != 0)
+    return GSS_S_BAD_MIC;
+
+  if (k5->acceptor)
+    k5->initseqnr++;
+  else
+    k5->acceptseqnr++;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Unwrap DES and DES3 tokens.  TOK points into the caller's buffer,
+   which is left untouched; the confounder, data and pad are decrypted
+   in P, which must have room for TOKLEN octets, and the message is
+   moved to its start at the end.  The message length is stored in
+   *PLEN. */
+static OM_uint32
+unwrap_1964 (_gss_krb5_ctx_t k5,
+	     const char *tok, size_t toklen,
+	     char *p, size_t * plen, int *conf_state)
+{
+  int des3 = shishi_key_type (k5->key) == SHISHI_DES3_CBC_HMAC_SHA1_KD;
+  size_t cksumlen = des3 ? 20 : 8;
+  size_t datalen, padlen;
+  OM_uint32 maj_stat;
+  span_desc s;
+  int sealed;
+
+  if (toklen < 8 + 8 + cksumlen)
+    return GSS_S_BAD_MIC;
+
+  /* Confounder, data and pad. */
+  datalen = toklen - 8 - 8 - cksumlen;
+
+  maj_stat = unwrap_1964_header (k5, tok, datalen, &sealed);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  memcpy (p, tok + 16 + cksumlen, datalen);
+
+  span_init (&s, p, datalen);
+  maj_stat = open_1964 (k5, tok, sealed, &s, &padlen);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  *plen = datalen - 8 - padlen;
+  memmove (p, p + 8, *plen);
+
+  if (conf_state != NULL)
+    *conf_state = sealed;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Unwrap a token into P, which must have room for as many octets
+   as the token, and store the message length in *PLEN. */
+static OM_uint32
+unwrap_token (_gss_krb5_ctx_t k5,
+	      const gss_buffer_t input_message_buffer,
+	      char *p, size_t * plen, int *conf_state)
+{
+  int cfx = input_message_buffer->length >= TOK_LEN
+    && memcmp (input_message_buffer->value, TOK_CFX_WRAP, TOK_LEN) == 0;
+  gss_buffer_desc tok;
+  OM_uint32 maj_stat;
+
+  /* As for MIC tokens, the context key decides the token format. */
+  switch (shishi_key_type (k5->key))
+    {
+    case SHISHI_DES_CBC_MD5:
+    case SHISHI_DES3_CBC_HMAC_SHA1_KD:
+      if (cfx)
+	return GSS_S_DEFECTIVE_TOKEN;
+      break;
+
+    case SHISHI_AES128_CTS_HMAC_SHA1_96:
+    case SHISHI_AES256_CTS_HMAC_SHA1_96:
+      if (!cfx)
+	return GSS_S_DEFECTIVE_TOKEN;
+      return cfx_unwrap (k5, input_message_buffer, p, plen, conf_state);
 
     default:
       return GSS_S_FAILURE;
     }
 
-  return GSS_S_COMPLETE;
+  maj_stat = gss_decapsulate_token_view (input_message_buffer, GSS_KRB5,
+					 &tok);
+  if (maj_stat != GSS_S_COMPLETE)
+    return GSS_S_BAD_MIC;
+
+  if (tok.length < 8)
+    return GSS_S_BAD_MIC;
+
+  if (memcmp (tok.value, TOK_WRAP, TOK_LEN) != 0)
+    return GSS_S_BAD_MIC;
+
+  return unwrap_1964 (k5, tok.value, tok.length, p, plen, conf_state);
 }
 
 OM_uint32
@@ -272,216 +1770,371 @@ gss_krb5_unwrap (OM_uint32 * minor_status,
 		 int *conf_state, gss_qop_t * qop_state)
 {
   _gss_krb5_ctx_t k5 = context_handle->krb5;
-  gss_buffer_desc tok;
-  char *data;
-  OM_uint32 sgn_alg, seal_alg;
-  size_t tmplen;
-  int rc;
+  size_t len = input_message_buffer->length;
+  OM_uint32 maj_stat;
+  char *p;
 
-  rc = gss_decapsulate_token (input_message_buffer, GSS_KRB5, &tok);
-  if (rc != GSS_S_COMPLETE)
-    return GSS_S_BAD_MIC;
+  if (minor_status)
+    *minor_status = 0;
 
-  if (tok.length < 8)
+  if (len < TOK_LEN)
     return GSS_S_BAD_MIC;
 
-  if (memcmp (tok.value, TOK_WRAP, TOK_LEN) != 0)
-    return GSS_S_BAD_MIC;
+  /* The message is recovered in place in the output buffer, which is
+     never larger than the token; this is the only allocation. */
+  p = malloc (len);
+  if (!p)
+    {
+      if (minor_status)
+	*minor_status = ENOMEM;
+      return GSS_S_FAILURE;
+    }
 
-  data = tok.value;
+  maj_stat = unwrap_token (k5, input_message_buffer, p, &len, conf_state);
+  if (GSS_ERROR (maj_stat))
+    {
+      free (p);
+      return maj_stat;
+    }
 
-  sgn_alg = data[2] & 0xFF;
-  sgn_alg |= data[3] << 8 & 0xFF00;
+  output_message_buffer->value = p;
+  output_message_buffer->length = len;
 
-  seal_alg = data[4] & 0xFF;
-  seal_alg |= data[5] << 8 & 0xFF00;
+  if (qop_state)
+    *qop_state = GSS_C_QOP_DEFAULT;
 
-  if (conf_state != NULL)
-    *conf_state = seal_alg == 0xFFFF;
+  return GSS_S_COMPLETE;
+}
+
+OM_uint32
+gss_krb5_unwrap_into (OM_uint32 * minor_status,
+		      const gss_ctx_id_t context_handle,
+		      const gss_buffer_t input_message_buffer,
+		      gss_buffer_t output_message_buffer,
+		      int *conf_state, gss_qop_t * qop_state)
+{
+  _gss_krb5_ctx_t k5 = context_handle->krb5;
+  size_t len = input_message_buffer->length;
+  OM_uint32 maj_stat;
 
-  if (memcmp (data + 6, "\xFF\xFF", 2) != 0)
+  if (minor_status)
+    *minor_status = 0;
+
+  if (len < TOK_LEN)
     return GSS_S_BAD_MIC;
 
-  switch (sgn_alg)
-    {
-      /* XXX implement other checksums */
+  /* The message is recovered in place, which needs room for the
+     whole token. */
+  maj_stat = _gss_buffer_fits (minor_status, output_message_buffer, len);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
 
-    case 0:			/* DES-MD5 */
-      {
-	size_t padlen;
-	char *pt;
-	char header[8];
-	char encseqno[8];
-	char seqno[8];
-	char cksum[8];
-	char confounder[8];
-	char *tmp;
-	uint32_t seqnr;
-	size_t outlen, i;
-
-	/* Typical data:
-	   ;; 02 01 00 00 ff ff ff ff  0c 22 1f 79 59 3d 00 cb
-	   ;; d5 78 2f fb 50 d2 b8 59  fb b4 e0 9b d0 a2 fa dc
-	   ;; 01 00 20 00 04 04 04 04
-	   Translates into:
-	   ;;   HEADER                 ENCRYPTED SEQ.NUMBER
-	   ;;   DES-MAC-MD5 CKSUM      CONFOUNDER
-	   ;;   PADDED DATA
-	 */
-
-	if (tok.length < 5 * 8)
-	  return GSS_S_BAD_MIC;
+  maj_stat = unwrap_token (k5, input_message_buffer,
+			   output_message_buffer->value, &len, conf_state);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
 
-	memcpy (header, data, 8);
-	memcpy (encseqno, data + 8, 8);
-	memcpy (cksum, data + 16, 8);
-	memcpy (confounder, data + 24, 8);
-	pt = data + 32;
+  output_message_buffer->length = len;
 
-	/* XXX decrypt data iff confidential option chosen */
+  if (qop_state)
+    *qop_state = GSS_C_QOP_DEFAULT;
 
-	rc = shishi_decrypt_iv_etype (k5->sh,
-				      k5->key,
-				      0, SHISHI_DES_CBC_NONE,
-				      cksum, 8, encseqno, 8, &tmp, &outlen);
-	if (rc != SHISHI_OK)
-	  return GSS_S_FAILURE;
-	if (outlen != 8)
-	  return GSS_S_BAD_MIC;
-	memcpy (seqno, tmp, 8);
-	free (tmp);
+  return GSS_S_COMPLETE;
+}
 
-	if (memcmp (seqno + 4, k5->acceptor ? "\x00\x00\x00\x00" :
-		    "\xFF\xFF\xFF\xFF", 4) != 0)
-	  return GSS_S_BAD_MIC;
+/* How a wrap token maps onto the buffers passed to the IOV
+   functions. */
+typedef struct
+{
+  gss_iov_buffer_t header;
+  gss_iov_buffer_t padding;
+  gss_iov_buffer_t trailer;
+  /* Sizes of the token parts before the data, the RFC 1964 pad after
+     it, and the CFX trailer after that. */
+  size_t headerlen;
+  size_t datalen;
+  size_t padlen;
+  size_t trailerlen;
+  /* Set when a CFX token without TRAILER buffer keeps its trailer in
+     the header, rotated as per RFC 4121 RRC. */
+  int rotate;
+} iov_layout_desc;
+
+static OM_uint32
+iov_layout (_gss_krb5_ctx_t k5, int conf_req_flag,
+	    gss_iov_buffer_desc * iov, int iov_count, iov_layout_desc * l)
+{
+  int keytype = shishi_key_type (k5->key);
 
-	seqnr = C2I (seqno);
-	if (seqnr != (k5->acceptor ? k5->initseqnr : k5->acceptseqnr))
-	  return GSS_S_BAD_MIC;
+  /* Buffers that are checksummed but not encrypted are not
+     supported. */
+  if (_gss_iov_find (iov, iov_count, GSS_IOV_BUFFER_TYPE_SIGN_ONLY)
+      || _gss_iov_find (iov, iov_count, GSS_IOV_BUFFER_TYPE_MECH_PARAMS))
+    return GSS_S_UNAVAILABLE;
 
-	if (k5->acceptor)
-	  k5->initseqnr++;
-	else
-	  k5->acceptseqnr++;
+  l->header = _gss_iov_find (iov, iov_count, GSS_IOV_BUFFER_TYPE_HEADER);
+  l->padding = _gss_iov_find (iov, iov_count, GSS_IOV_BUFFER_TYPE_PADDING);
+  l->trailer = _gss_iov_find (iov, iov_count, GSS_IOV_BUFFER_TYPE_TRAILER);
+  l->datalen = _gss_iov_data_length (iov, iov_count);
+  l->rotate = 0;
 
-	/* Check pad */
-	padlen = data[tok.length - 1];
-	if (padlen > 8)
-	  return GSS_S_BAD_MIC;
-	for (i = 1; i <= padlen; i++)
-	  if (data[tok.length - i] != (int) padlen)
-	    return GSS_S_BAD_MIC;
-
-	/* Write header and confounder next to data */
-	memcpy (data + 16, header, 8);
-	memcpy (data + 24, confounder, 8);
-
-	/* Checksum header + confounder + data + pad */
-	rc = shishi_checksum (k5->sh,
-			      k5->key,
-			      0, SHISHI_RSA_MD5_DES_GSS,
-			      data + 16, tok.length - 16, &tmp, &tmplen);
-	if (rc != SHISHI_OK || tmplen != 8)
+  if (!l->header)
+    return GSS_S_FAILURE;
+
+  switch (keytype)
+    {
+    case SHISHI_DES_CBC_MD5:
+    case SHISHI_DES3_CBC_HMAC_SHA1_KD:
+      {
+	size_t cksumlen = keytype == SHISHI_DES_CBC_MD5 ? 8 : 20;
+	size_t toklen;
+
+	l->padlen = 8 - l->datalen % 8;
+	l->trailerlen = 0;
+	toklen = 8 + 8 + cksumlen + 8 + l->datalen + l->padlen;
+	l->headerlen = _gss_encapsulate_token_header (GSS_KRB5->elements,
+						      GSS_KRB5->length,
+						      toklen, NULL)
+	  + 8 + 8 + cksumlen + 8;
+
+	if (!l->padding && !l->trailer)
 	  return GSS_S_FAILURE;
+      }
+      break;
 
-	memcpy (data + 8, tmp, tmplen);
+    case SHISHI_AES128_CTS_HMAC_SHA1_96:
+    case SHISHI_AES256_CTS_HMAC_SHA1_96:
+      l->headerlen = CFX_HEADER_LEN;
+      l->padlen = 0;
+      l->trailerlen = CFX_HMAC_LEN;
+      if (conf_req_flag)
+	{
+	  l->headerlen += CFX_CONFOUNDER_LEN;
+	  l->trailerlen += CFX_HEADER_LEN;
+	}
+      l->rotate = !l->trailer;
+      break;
 
-	/* Compare checksum */
-	if (tmplen != 8 || memcmp (cksum, data + 8, 8) != 0)
-	  return GSS_S_BAD_MIC;
+    default:
+      return GSS_S_FAILURE;
+    }
+
+  return GSS_S_COMPLETE;
+}
+
+OM_uint32
+gss_krb5_wrap_iov_length (OM_uint32 * minor_status,
+			  const gss_ctx_id_t context_handle,
+			  int conf_req_flag,
+			  gss_qop_t qop_req,
+			  int *conf_state,
+			  gss_iov_buffer_desc * iov, int iov_count)
+{
+  _gss_krb5_ctx_t k5 = context_handle->krb5;
+  iov_layout_desc l;
+  OM_uint32 maj_stat;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  maj_stat = iov_layout (k5, conf_req_flag, iov, iov_count, &l);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  l.header->buffer.length = l.headerlen + (l.rotate ? l.trailerlen : 0);
+  if (l.padding)
+    l.padding->buffer.length = l.padlen;
+  if (l.trailer)
+    l.trailer->buffer.length = l.trailerlen + (l.padding ? 0 : l.padlen);
+
+  if (conf_state)
+    *conf_state = conf_req_flag ? 1 : 0;
+
+  return GSS_S_COMPLETE;
+}
 
-	/* Copy output data */
-	output_message_buffer->length = tok.length - 8 - 8 - 8 - 8 - padlen;
-	output_message_buffer->value = malloc (output_message_buffer->length);
-	if (!output_message_buffer->value)
-	  {
-	    if (minor_status)
-	      *minor_status = ENOMEM;
-	    return GSS_S_FAILURE;
-	  }
-
-	memcpy (output_message_buffer->value, pt,
-		tok.length - 4 * 8 - padlen);
+/* The token is built in place: the parts before the data go in the
+   HEADER buffer, the RFC 1964 pad in the PADDING buffer, and the CFX
+   trailer in the TRAILER buffer, or rotated into the HEADER buffer
+   without one.  The DATA buffers are checksummed and encrypted where
+   they are.  Concatenating the buffers gives a regular Wrap token. */
+OM_uint32
+gss_krb5_wrap_iov (OM_uint32 * minor_status,
+		   const gss_ctx_id_t context_handle,
+		   int conf_req_flag,
+		   gss_qop_t qop_req,
+		   int *conf_state, gss_iov_buffer_desc * iov, int iov_count)
+{
+  _gss_krb5_ctx_t k5 = context_handle->krb5;
+  int keytype = shishi_key_type (k5->key);
+  iov_layout_desc l;
+  OM_uint32 maj_stat;
+  span_desc s;
+  char *h, *t;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  maj_stat = iov_layout (k5, conf_req_flag, iov, iov_count, &l);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  maj_stat = _gss_iov_reserve (minor_status, l.header,
+			       l.headerlen + (l.rotate ? l.trailerlen : 0));
+  if (!GSS_ERROR (maj_stat) && l.padding)
+    maj_stat = _gss_iov_reserve (minor_status, l.padding, l.padlen);
+  if (!GSS_ERROR (maj_stat) && l.trailer)
+    maj_stat = _gss_iov_reserve (minor_status, l.trailer,
+				 l.trailerlen + (l.padding ? 0 : l.padlen));
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  memset (&s, 0, sizeof (s));
+  s.iov = iov;
+  s.iov_count = iov_count;
+  h = l.header->buffer.value;
+
+  if (keytype == SHISHI_DES_CBC_MD5
+      || keytype == SHISHI_DES3_CBC_HMAC_SHA1_KD)
+    {
+      /* Header, sequence number, checksum and confounder, then the
+	 data and pad. */
+      size_t cksumlen = keytype == SHISHI_DES_CBC_MD5 ? 8 : 20;
+      size_t toklen = 8 + 8 + cksumlen + 8 + l.datalen + l.padlen;
+      char *tok;
+
+      tok = h + _gss_encapsulate_token_header (GSS_KRB5->elements,
+					       GSS_KRB5->length, toklen, h);
+      t = l.padding ? l.padding->buffer.value : l.trailer->buffer.value;
+      memset (t, (int) l.padlen, l.padlen);
+
+      s.head = tok + 8 + 8 + cksumlen;
+      s.headlen = 8;
+      s.tail = t;
+      s.taillen = l.padlen;
+      maj_stat = seal_1964 (k5, conf_req_flag, tok, &s);
+    }
+  else
+    {
+      /* The trailer is the encrypted header copy and the HMAC, or
+	 the checksum.  Rotated, it follows the header, as per RRC. */
+      t = l.rotate ? h + CFX_HEADER_LEN : (char *) l.trailer->buffer.value;
+      if (conf_req_flag)
+	{
+	  s.head = h + CFX_HEADER_LEN + (l.rotate ? l.trailerlen : 0);
+	  s.headlen = CFX_CONFOUNDER_LEN;
+	  s.tail = t;
+	  s.taillen = CFX_HEADER_LEN;
+	  t += CFX_HEADER_LEN;
+	}
+      maj_stat = cfx_seal (k5, conf_req_flag, h, &s, t,
+			   l.rotate ? l.trailerlen : 0);
+    }
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  if (conf_state)
+    *conf_state = conf_req_flag ? 1 : 0;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Rotate the LEN octets at DATA left by N octets, in place, by
+   reversing both parts and then the whole. */
+static void
+rotate_left (char *data, size_t len, size_t n)
+{
+  size_t parts[3][2] = { {0, n}, {n, len}, {0, len} };
+  size_t i, a, b;
+  char c;
+
+  for (i = 0; i < 3; i++)
+    for (a = parts[i][0], b = parts[i][1]; a + 1 < b; a++, b--)
+      {
+	c = data[a];
+	data[a] = data[b - 1];
+	data[b - 1] = c;
       }
-      break;
+}
+
+/* Unwrap the token in the STREAM buffer in place, and point DATA at
+   the message within it, or copy it to DATA if the caller asked for
+   it to be allocated. */
+static OM_uint32
+unwrap_iov_stream (OM_uint32 * minor_status, _gss_krb5_ctx_t k5,
+		   gss_iov_buffer_t stream, gss_iov_buffer_t data,
+		   int *conf_state)
+{
+  char *p = stream->buffer.value;
+  size_t len = stream->buffer.length;
+  char *msg;
+  size_t msglen;
+  OM_uint32 maj_stat;
+  span_desc s;
+  int sealed;
 
-    case 4:			/* 3DES */
+  switch (shishi_key_type (k5->key))
+    {
+    case SHISHI_DES_CBC_MD5:
+    case SHISHI_DES3_CBC_HMAC_SHA1_KD:
       {
+	size_t cksumlen =
+	  shishi_key_type (k5->key) == SHISHI_DES_CBC_MD5 ? 8 : 20;
+	gss_buffer_desc tok;
 	size_t padlen;
-	char *p;
-	char *t;
-	char cksum[20];
-	size_t outlen, i;
-	uint32_t seqnr;
 
-	if (tok.length < 8 + 8 + 20 + 8 + 8)
+	maj_stat = gss_decapsulate_token_view (&stream->buffer, GSS_KRB5,
+					       &tok);
+	if (maj_stat != GSS_S_COMPLETE || tok.length < 8 + 8 + cksumlen)
 	  return GSS_S_BAD_MIC;
+	p = tok.value;
+	len = tok.length - 8 - 8 - cksumlen;
 
-	memcpy (cksum, data + 8 + 8, 20);
-
-	/* XXX decrypt data iff confidential option chosen */
+	maj_stat = unwrap_1964_header (k5, p, len, &sealed);
+	if (GSS_ERROR (maj_stat))
+	  return maj_stat;
 
-	p = data + 8;
-	rc = shishi_decrypt_iv_etype (k5->sh,
-				      k5->key,
-				      0, SHISHI_DES3_CBC_NONE,
-				      cksum, 8, p, 8, &t, &outlen);
-	if (rc != SHISHI_OK || outlen != 8)
-	  return GSS_S_FAILURE;
+	span_init (&s, p + 8 + 8 + cksumlen, len);
+	maj_stat = open_1964 (k5, p, sealed, &s, &padlen);
+	if (GSS_ERROR (maj_stat))
+	  return maj_stat;
 
-	memcpy (p, t, 8);
-	free (t);
+	msg = s.head + 8;
+	msglen = len - 8 - padlen;
+      }
+      break;
 
-	if (memcmp (p + 4, k5->acceptor ? "\x00\x00\x00\x00" :
-		    "\xFF\xFF\xFF\xFF", 4) != 0)
-	  return GSS_S_BAD_MIC;
-	seqnr = C2I (p);
-	if (seqnr != (k5->acceptor ? k5->initseqnr : k5->acceptseqnr))
-	  return GSS_S_BAD_MIC;
+    case SHISHI_AES128_CTS_HMAC_SHA1_96:
+    case SHISHI_AES256_CTS_HMAC_SHA1_96:
+      {
+	char *body = p + CFX_HEADER_LEN;
+	size_t bodylen, ec, rrc;
+	int flags;
 
-	if (k5->acceptor)
-	  k5->initseqnr++;
-	else
-	  k5->acceptseqnr++;
+	if (len < CFX_HEADER_LEN)
+	  return GSS_S_DEFECTIVE_TOKEN;
 
-	/* Check pad */
-	padlen = data[tok.length - 1];
-	if (padlen > 8)
-	  return GSS_S_BAD_MIC;
-	for (i = 1; i <= padlen; i++)
-	  if (data[tok.length - i] != (int) padlen)
-	    return GSS_S_BAD_MIC;
-
-	/* Write header next to confounder */
-	memcpy (data + 8 + 20, data, 8);
-
-	/* Checksum header + confounder + data + pad */
-	rc = shishi_checksum (k5->sh,
-			      k5->key,
-			      SHISHI_KEYUSAGE_GSS_R2,
-			      SHISHI_HMAC_SHA1_DES3_KD, data + 20 + 8,
-			      tok.length - 20 - 8, &t, &tmplen);
-	if (rc != SHISHI_OK || tmplen != 20)
-	  return GSS_S_FAILURE;
+	maj_stat = cfx_unwrap_header (k5, p, &flags, &ec, &rrc);
+	if (GSS_ERROR (maj_stat))
+	  return maj_stat;
+	sealed = flags & CFX_FLAG_SEALED ? 1 : 0;
 
-	memcpy (data + 8 + 8, t, tmplen);
-	free (t);
+	bodylen = len - CFX_HEADER_LEN;
+	rotate_left (body, bodylen, bodylen > 0 ? rrc % bodylen : 0);
 
-	/* Compare checksum */
-	if (tmplen != 20 || memcmp (cksum, data + 8 + 8, 20) != 0)
+	if (sealed && bodylen < CFX_HMAC_LEN)
 	  return GSS_S_BAD_MIC;
+	if (!sealed && bodylen < ec)
+	  return GSS_S_DEFECTIVE_TOKEN;
+	len = bodylen - (sealed ? CFX_HMAC_LEN : ec);
 
-	/* Copy output data */
-	output_message_buffer->length = tok.length - 8 - 20 - 8 - 8 - padlen;
-	output_message_buffer->value = malloc (output_message_buffer->length);
-	if (!output_message_buffer->value)
-	  {
-	    if (minor_status)
-	      *minor_status = ENOMEM;
-	    return GSS_S_FAILURE;
-	  }
-	memcpy (output_message_buffer->value, data + 20 + 8 + 8 + 8,
-		tok.length - 20 - 8 - 8 - 8 - padlen);
+	span_init (&s, body, len);
+	maj_stat = cfx_open (k5, p, flags, ec, &s, body + len);
+	if (GSS_ERROR (maj_stat))
+	  return maj_stat;
+
+	msg = sealed ? body + CFX_CONFOUNDER_LEN : body;
+	msglen = sealed ? len - CFX_CONFOUNDER_LEN - ec - CFX_HEADER_LEN : len;
       }
       break;
 
@@ -489,5 +2142,221 @@ gss_krb5_unwrap (OM_uint32 * minor_status,
       return GSS_S_FAILURE;
     }
 
+  if (data->type & GSS_IOV_BUFFER_FLAG_ALLOCATE)
+    {
+      maj_stat = _gss_iov_reserve (minor_status, data, msglen);
+      if (GSS_ERROR (maj_stat))
+	return maj_stat;
+      memcpy (data->buffer.value, msg, msglen);
+    }
+  else
+    {
+      data->buffer.value = msg;
+      data->buffer.length = msglen;
+    }
+
+  if (conf_state)
+    *conf_state = sealed;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Unwrap an RFC 1964 token in place.  TAIL is the buffer with the
+   pad, which must hold all of it. */
+static OM_uint32
+unwrap_iov_1964 (_gss_krb5_ctx_t k5, gss_iov_buffer_t header,
+		 gss_iov_buffer_t tail, span_desc * s, int *conf_state)
+{
+  size_t cksumlen =
+    shishi_key_type (k5->key) == SHISHI_DES_CBC_MD5 ? 8 : 20;
+  char mech[32];
+  size_t datalen, toklen, hdrlen, padlen;
+  OM_uint32 maj_stat;
+  char *tok;
+  int sealed;
+
+  if (!tail)
+    return GSS_S_FAILURE;
+  if (tail->buffer.length == 0 || tail->buffer.length > 8)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  /* Confounder, data and pad. */
+  datalen = 8 + _gss_iov_data_length (s->iov, s->iov_count)
+    + tail->buffer.length;
+  toklen = 8 + 8 + cksumlen + datalen;
+
+  /* The mechanism-independent header is known from the length. */
+  hdrlen = _gss_encapsulate_token_header (GSS_KRB5->elements,
+					  GSS_KRB5->length, toklen, NULL);
+  if (hdrlen > sizeof (mech)
+      || header->buffer.length != hdrlen + 8 + 8 + cksumlen + 8)
+    return GSS_S_DEFECTIVE_TOKEN;
+  _gss_encapsulate_token_header (GSS_KRB5->elements, GSS_KRB5->length,
+				 toklen, mech);
+  if (memcmp (header->buffer.value, mech, hdrlen) != 0)
+    return GSS_S_DEFECTIVE_TOKEN;
+  tok = (char *) header->buffer.value + hdrlen;
+
+  maj_stat = unwrap_1964_header (k5, tok, datalen, &sealed);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  s->head = tok + 8 + 8 + cksumlen;
+  s->headlen = 8;
+  s->tail = tail->buffer.value;
+  s->taillen = tail->buffer.length;
+  maj_stat = open_1964 (k5, tok, sealed, s, &padlen);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  /* Else some of the message would be in TAIL. */
+  if (padlen != tail->buffer.length)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  if (conf_state)
+    *conf_state = sealed;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Unwrap a CFX token in place.  The trailer is in the TRAILER buffer
+   with RRC zero, or else rotated into the HEADER buffer with RRC its
+   length, as gss_krb5_wrap_iov makes them. */
+static OM_uint32
+unwrap_iov_cfx (_gss_krb5_ctx_t k5, gss_iov_buffer_t header,
+		gss_iov_buffer_t padding, gss_iov_buffer_t trailer,
+		span_desc * s, int *conf_state)
+{
+  char *h = header->buffer.value;
+  size_t ec, rrc, trailerlen, confounderlen;
+  OM_uint32 maj_stat;
+  char *t;
+  int flags;
+
+  if (header->buffer.length < CFX_HEADER_LEN)
+    return GSS_S_DEFECTIVE_TOKEN;
+  if (padding && padding->buffer.length > 0)
+    return GSS_S_DEFECTIVE_TOKEN;
+
+  maj_stat = cfx_unwrap_header (k5, h, &flags, &ec, &rrc);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  /* Filler, header copy and HMAC, or the checksum. */
+  if (flags & CFX_FLAG_SEALED)
+    {
+      trailerlen = ec + CFX_HEADER_LEN + CFX_HMAC_LEN;
+      confounderlen = CFX_CONFOUNDER_LEN;
+    }
+  else
+    {
+      trailerlen = CFX_HMAC_LEN;
+      confounderlen = 0;
+    }
+
+  if (trailer)
+    {
+      if (rrc != 0 || trailer->buffer.length != trailerlen
+	  || header->buffer.length != CFX_HEADER_LEN + confounderlen)
+	return GSS_S_DEFECTIVE_TOKEN;
+      t = trailer->buffer.value;
+    }
+  else
+    {
+      if (rrc != trailerlen
+	  || header->buffer.length != CFX_HEADER_LEN + trailerlen
+	  + confounderlen)
+	return GSS_S_DEFECTIVE_TOKEN;
+      t = h + CFX_HEADER_LEN;
+    }
+
+  if (flags & CFX_FLAG_SEALED)
+    {
+      s->head = h + header->buffer.length - CFX_CONFOUNDER_LEN;
+      s->headlen = CFX_CONFOUNDER_LEN;
+      s->tail = t;
+      s->taillen = ec + CFX_HEADER_LEN;
+      t += s->taillen;
+    }
+
+  maj_stat = cfx_open (k5, h, flags, ec, s, t);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  if (conf_state)
+    *conf_state = flags & CFX_FLAG_SEALED ? 1 : 0;
+
+  return GSS_S_COMPLETE;
+}
+
+/* Like gss_krb5_wrap_iov, the token is processed where it is, and
+   the DATA buffers are decrypted in place. */
+OM_uint32
+gss_krb5_unwrap_iov (OM_uint32 * minor_status,
+		     const gss_ctx_id_t context_handle,
+		     int *conf_state,
+		     gss_qop_t * qop_state,
+		     gss_iov_buffer_desc * iov, int iov_count)
+{
+  _gss_krb5_ctx_t k5 = context_handle->krb5;
+  gss_iov_buffer_t stream, header, padding, trailer, data;
+  OM_uint32 maj_stat;
+  span_desc s;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  if (_gss_iov_find (iov, iov_count, GSS_IOV_BUFFER_TYPE_SIGN_ONLY))
+    return GSS_S_UNAVAILABLE;
+
+  stream = _gss_iov_find (iov, iov_count, GSS_IOV_BUFFER_TYPE_STREAM);
+  if (stream)
+    {
+      data = _gss_iov_find (iov, iov_count, GSS_IOV_BUFFER_TYPE_DATA);
+      if (!data)
+	return GSS_S_FAILURE;
+
+      maj_stat = unwrap_iov_stream (minor_status, k5, stream, data,
+				    conf_state);
+    }
+  else
+    {
+      header = _gss_iov_find (iov, iov_count, GSS_IOV_BUFFER_TYPE_HEADER);
+      padding = _gss_iov_find (iov, iov_count,
+			       GSS_IOV_BUFFER_TYPE_PADDING);
+      trailer = _gss_iov_find (iov, iov_count,
+			       GSS_IOV_BUFFER_TYPE_TRAILER);
+      if (!header)
+	return GSS_S_FAILURE;
+
+      memset (&s, 0, sizeof (s));
+      s.iov = iov;
+      s.iov_count = iov_count;
+
+      switch (shishi_key_type (k5->key))
+	{
+	case SHISHI_DES_CBC_MD5:
+	case SHISHI_DES3_CBC_HMAC_SHA1_KD:
+	  maj_stat = unwrap_iov_1964 (k5, header, padding ? padding : trailer,
+				      &s, conf_state);
+	  break;
+
+	case SHISHI_AES128_CTS_HMAC_SHA1_96:
+	case SHISHI_AES256_CTS_HMAC_SHA1_96:
+	  maj_stat = unwrap_iov_cfx (k5, header, padding, trailer, &s,
+				     conf_state);
+	  break;
+
+	default:
+	  maj_stat = GSS_S_FAILURE;
+	  break;
+	}
+    }
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  if (qop_state)
+    *qop_state = GSS_C_QOP_DEFAULT;
+
   return GSS_S_COMPLETE;
 }
@@ -23,10 +23,168 @@
 /* Get specification. */
 #include "k5internal.h"
 
+/* Canonical names of recently canonicalized names.  The cache holds a
+   reference to both names of each entry.  Since the input names are
+   interned, equal names are the same pointer, and the name's own hash
+   can be used.  Canonicalization does not depend on anything but the
+   name, so entries never go stale; the least recently used entry is
+   replaced when the cache is full. */
+
+#define NAME_CACHE_SIZE 256
+#define NAME_CACHE_BUCKETS 512
+
+struct name_cache_entry
+{
+  gss_name_t in;
+  gss_name_t out;
+  struct name_cache_entry *chain;
+  struct name_cache_entry *newer;
+  struct name_cache_entry *older;
+};
+
+_GSS_LOCK_DEFINE (name_cache_lock);
+static struct name_cache_entry name_cache[NAME_CACHE_SIZE];
+static struct name_cache_entry *name_cache_bucket[NAME_CACHE_BUCKETS];
+static struct name_cache_entry *name_cache_newest;
+static struct name_cache_entry *name_cache_oldest;
+static size_t name_cache_used;
+static size_t name_cache_hits;
+static size_t name_cache_misses;
+
+static void
+name_cache_unlink (struct name_cache_entry *e)
+{
+  if (e->newer)
+    e->newer->older = e->older;
+  else
+    name_cache_newest = e->older;
+  if (e->older)
+    e->older->newer = e->newer;
+  else
+    name_cache_oldest = e->newer;
+}
+
+static void
+name_cache_push (struct name_cache_entry *e)
+{
+  e->newer = NULL;
+  e->older = name_cache_newest;
+  if (name_cache_newest)
+    name_cache_newest->newer = e;
+  else
+    name_cache_oldest = e;
+  name_cache_newest = e;
+}
+
+/* Called with name_cache_lock held. */
+static struct name_cache_entry *
+name_cache_lookup (const gss_name_t in)
+{
+  struct name_cache_entry *e;
+
+  for (e = name_cache_bucket[in->hash % NAME_CACHE_BUCKETS]; e; e = e->chain)
+    if (e->in == in)
+      return e;
+
+  return NULL;
+}
+
+/* Store a new reference to the cached canonical name of IN in *OUT,
+   and return non-zero, or return zero if IN is not cached. */
+static int
+name_cache_find (const gss_name_t in, gss_name_t * out)
+{
+  struct name_cache_entry *e;
+
+  _gss_lock (name_cache_lock);
+  e = name_cache_lookup (in);
+  if (e)
+    {
+      name_cache_unlink (e);
+      name_cache_push (e);
+      gss_duplicate_name (NULL, e->out, out);
+      name_cache_hits++;
+    }
+  else
+    name_cache_misses++;
+  _gss_unlock (name_cache_lock);
+
+  return e != NULL;
+}
+
+static void
+name_cache_add (const gss_name_t in, const gss_name_t out)
+{
+  struct name_cache_entry *e, **p;
+
+  _gss_lock (name_cache_lock);
+  if (!name_cache_lookup (in))
+    {
+      if (name_cache_used < NAME_CACHE_SIZE)
+	e = &name_cache[name_cache_used++];
+      else
+	{
+	  e = name_cache_oldest;
+	  name_cache_unlink (e);
+	  for (p = &name_cache_bucket[e->in->hash % NAME_CACHE_BUCKETS];
+	       *p != e; p = &(*p)->chain)
+	    ;
+	  *p = e->chain;
+	  gss_release_name (NULL, &e->in);
+	  gss_release_name (NULL, &e->out);
+	}
+
+      gss_duplicate_name (NULL, in, &e->in);
+      gss_duplicate_name (NULL, out, &e->out);
+      e->chain = name_cache_bucket[in->hash % NAME_CACHE_BUCKETS];
+      name_cache_bucket[in->hash % NAME_CACHE_BUCKETS] = e;
+      name_cache_push (e);
+    }
+  _gss_unlock (name_cache_lock);
+}
+
+/**
+ * gss_krb5_name_cache_stats:
+ * @minor_status: (Integer, modify) Mechanism specific status code.
+ * @hits: (size_t, modify, optional) Number of names canonicalized
+ *   from the cache.
+ * @misses: (size_t, modify, optional) Number of names that were
+ *   looked up in the cache but not found.
+ *
+ * Report how well the cache of canonical Kerberos 5 names is doing.
+ * It is used by gss_canonicalize_name() and by
+ * gss_init_sec_context() for target names of the hostbased service
+ * and exported name types.  Names that already are Kerberos 5
+ * principal names are not cached, and not counted.
+ *
+ * WARNING: This function is a GNU GSS specific extension, and is not
+ * part of the official GSS API.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * Since: 1.0.3
+ **/
 OM_uint32
-gss_krb5_canonicalize_name (OM_uint32 * minor_status,
-			    const gss_name_t input_name,
-			    const gss_OID mech_type, gss_name_t * output_name)
+gss_krb5_name_cache_stats (OM_uint32 * minor_status,
+			   size_t * hits, size_t * misses)
+{
+  _gss_lock (name_cache_lock);
+  if (hits)
+    *hits = name_cache_hits;
+  if (misses)
+    *misses = name_cache_misses;
+  _gss_unlock (name_cache_lock);
+
+  if (minor_status)
+    *minor_status = 0;
+  return GSS_S_COMPLETE;
+}
+
+static OM_uint32
+canonicalize (OM_uint32 * minor_status,
+	      const gss_name_t input_name, gss_name_t * output_name)
 {
   OM_uint32 maj_stat;
 
@@ -39,28 +197,9 @@ gss_krb5_canonicalize_name (OM_uint32 * minor_status,
   if (gss_oid_equal (input_name->type, GSS_C_NT_EXPORT_NAME))
     {
       if (input_name->length > 15)
-	{
-	  *output_name = malloc (sizeof (**output_name));
-	  if (!*output_name)
-	    {
-	      if (minor_status)
-		*minor_status = ENOMEM;
-	      return GSS_S_FAILURE;
-	    }
-	  (*output_name)->type = GSS_KRB5_NT_PRINCIPAL_NAME;
-	  (*output_name)->length = input_name->length - 15;
-	  (*output_name)->value = malloc ((*output_name)->length + 1);
-	  if (!(*output_name)->value)
-	    {
-	      free (*output_name);
-	      if (minor_status)
-		*minor_status = ENOMEM;
-	      return GSS_S_FAILURE;
-	    }
-	  memcpy ((*output_name)->value, input_name->value + 15,
-		  (*output_name)->length);
-	  (*output_name)->value[(*output_name)->length] = '\0';
-	}
+	return _gss_name_new (minor_status, input_name->value + 15,
+			      input_name->length - 15,
+			      GSS_KRB5_NT_PRINCIPAL_NAME, output_name);
       else
 	{
 	  return GSS_S_BAD_NAME;
@@ -68,7 +207,7 @@ gss_krb5_canonicalize_name (OM_uint32 * minor_status,
     }
   else if (gss_oid_equal (input_name->type, GSS_C_NT_HOSTBASED_SERVICE))
     {
-      char *p;
+      char *value, *p;
 
       /* We don't support service-names without hostname part because
          we can't compute a canonicalized name of the local host.
@@ -82,15 +221,25 @@ gss_krb5_canonicalize_name (OM_uint32 * minor_status,
       /* We don't do DNS name canoncalization since that is
          insecure. */
 
-      maj_stat = gss_duplicate_name (minor_status, input_name, output_name);
-      if (GSS_ERROR (maj_stat))
-	return maj_stat;
-
-      (*output_name)->type = GSS_KRB5_NT_PRINCIPAL_NAME;
+      /* Names are immutable, so build the principal separately. */
+      value = malloc (input_name->length);
+      if (!value)
+	{
+	  if (minor_status)
+	    *minor_status = ENOMEM;
+	  return GSS_S_FAILURE;
+	}
+      memcpy (value, input_name->value, input_name->length);
 
-      p = memchr ((*output_name)->value, '@', (*output_name)->length);
+      p = memchr (value, '@', input_name->length);
       if (p)
 	*p = '/';
+
+      maj_stat = _gss_name_new (minor_status, value, input_name->length,
+				GSS_KRB5_NT_PRINCIPAL_NAME, output_name);
+      free (value);
+      if (GSS_ERROR (maj_stat))
+	return maj_stat;
     }
   else if (gss_oid_equal (input_name->type, GSS_KRB5_NT_PRINCIPAL_NAME))
     {
@@ -107,6 +256,35 @@ gss_krb5_canonicalize_name (OM_uint32 * minor_status,
   return GSS_S_COMPLETE;
 }
 
+OM_uint32
+gss_krb5_canonicalize_name (OM_uint32 * minor_status,
+			    const gss_name_t input_name,
+			    const gss_OID mech_type, gss_name_t * output_name)
+{
+  OM_uint32 maj_stat;
+  int cached;
+
+  *output_name = GSS_C_NO_NAME;
+
+  /* Principal names are returned as they are, which is cheaper than
+     looking them up. */
+  cached = input_name->interned
+    && !gss_oid_equal (input_name->type, GSS_KRB5_NT_PRINCIPAL_NAME);
+
+  if (cached && name_cache_find (input_name, output_name))
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_COMPLETE;
+    }
+
+  maj_stat = canonicalize (minor_status, input_name, output_name);
+  if (cached && !GSS_ERROR (maj_stat) && *output_name != GSS_C_NO_NAME)
+    name_cache_add (input_name, *output_name);
+
+  return maj_stat;
+}
+
 #define TOK_LEN 2
 #define MECH_OID_LEN_LEN 2
 #define MECH_OID_ASN1_LEN_LEN 2
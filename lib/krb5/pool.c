@@ -0,0 +1,549 @@
+/* krb5/pool.c --- Process-wide pool of reusable Shishi handles.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+/* Get specification. */
+#include "k5internal.h"
+
+/* Get stat. */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* Initializing a Shishi handle reads the configuration files and the
+   ticket cache from disk, which is far more expensive than the rest
+   of the context establishment.  Contexts therefore borrow handles
+   from this pool, keyed by the files the handle was initialized
+   from.  Shishi handles are not thread-safe, so a handle is lent to
+   one context at a time, and a new one is initialized when no idle
+   one is at hand.  Up to POOL_MAX_IDLE idle handles per key are kept
+   around for the next contexts; handles returned beyond that, after
+   a burst of concurrent contexts, are closed.  A handle is retired
+   when its ticket cache changes on disk, so that new contexts see new
+   tickets.  Acceptors borrow handles initialized from the server
+   configuration instead, and imported contexts bare handles that read
+   no files at all.  Neither kind has a ticket cache.
+
+   Shishi only writes the ticket set of a handle to the ticket cache
+   when the handle is closed, which for a pooled handle may be at
+   process exit.  Contexts therefore call _gss_krb5_pool_save when
+   they obtain a new ticket.  Several handles may have the same ticket
+   cache, so the tickets that another handle wrote meanwhile are
+   merged in before the set is written, here as well as before
+   shishi_done writes it.
+
+   Each handle also indexes the service tickets that contexts have
+   used, by server name, so that another context to the same server
+   need not scan the ticket set.  The client is implied by the handle,
+   which is always for the default principal.  Tickets belong to the
+   ticket set of the handle and live as long as it does. */
+
+/* Number of idle handles kept for each set of files. */
+#define POOL_MAX_IDLE 4
+
+/* Number of buckets in the service ticket index of a handle. */
+#define POOL_TKT_BUCKETS 64
+
+/* Seconds before its end time that a ticket is no longer taken from
+   the index, so that a fresh one is looked for in time. */
+#define POOL_TKT_REFRESH 60
+
+typedef struct _gss_krb5_pool_tkt_struct
+{
+  struct _gss_krb5_pool_tkt_struct *next;
+  size_t hash;
+  char *server;
+  Shishi_tkt *tkt;
+} _gss_krb5_pool_tkt_desc, *_gss_krb5_pool_tkt_t;
+
+/* How a handle was initialized. */
+enum
+{
+  POOL_USER,
+  POOL_SERVER,
+  POOL_BARE
+};
+
+typedef struct _gss_krb5_pool_struct
+{
+  struct _gss_krb5_pool_struct *next;
+  int kind;
+  char *tktsfile;
+  char *systemcfgfile;
+  char *usercfgfile;
+  Shishi *sh;
+  int busy;
+  /* Identity of the ticket cache when SH last read or wrote it. */
+  dev_t tkts_dev;
+  ino_t tkts_ino;
+  time_t tkts_mtime;
+  long tkts_mtime_nsec;
+  off_t tkts_size;
+  /* Service ticket index, or NULL before the first ticket. */
+  _gss_krb5_pool_tkt_t *tkts;
+} _gss_krb5_pool_desc, *_gss_krb5_pool_t;
+
+_GSS_LOCK_DEFINE (pool_lock);
+static _gss_krb5_pool_t pool;
+
+static int
+streq (const char *a, const char *b)
+{
+  if (a == NULL || b == NULL)
+    return a == b;
+  return strcmp (a, b) == 0;
+}
+
+static int
+strdup_or_null (const char *in, char **out)
+{
+  *out = NULL;
+  if (in == NULL)
+    return 0;
+  *out = strdup (in);
+  return *out == NULL;
+}
+
+/* Whether P is a handle of KIND initialized from the given files. */
+static int
+pool_match_p (_gss_krb5_pool_t p, int kind, const char *tktsfile,
+	      const char *systemcfgfile, const char *usercfgfile)
+{
+  return p->kind == kind && streq (p->tktsfile, tktsfile)
+    && streq (p->systemcfgfile, systemcfgfile)
+    && streq (p->usercfgfile, usercfgfile);
+}
+
+/* Record the identity of the ticket cache of P->SH.  A missing file
+   is recorded as all zeros, so that its later creation is noticed.
+   Server and bare handles are recorded as having none. */
+static void
+pool_stat (_gss_krb5_pool_t p, struct stat *st)
+{
+  const char *file = NULL;
+
+  if (p->kind == POOL_USER)
+    file = shishi_tkts_default_file (p->sh);
+  if (file == NULL || stat (file, st) != 0)
+    memset (st, 0, sizeof (*st));
+}
+
+static void
+pool_record (_gss_krb5_pool_t p)
+{
+  struct stat st;
+
+  pool_stat (p, &st);
+  p->tkts_dev = st.st_dev;
+  p->tkts_ino = st.st_ino;
+  p->tkts_mtime = st.st_mtime;
+  p->tkts_mtime_nsec = _GSS_KRB5_MTIME_NSEC (&st);
+  p->tkts_size = st.st_size;
+}
+
+static int
+pool_changed_p (_gss_krb5_pool_t p)
+{
+  struct stat st;
+
+  pool_stat (p, &st);
+
+  return st.st_dev != p->tkts_dev || st.st_ino != p->tkts_ino
+    || st.st_mtime != p->tkts_mtime
+    || _GSS_KRB5_MTIME_NSEC (&st) != p->tkts_mtime_nsec
+    || st.st_size != p->tkts_size;
+}
+
+/* Whether TKTS has a valid ticket for the client and server of
+   TKT. */
+static int
+pool_has_tkt (Shishi_tkts * tkts, Shishi_tkt * tkt)
+{
+  Shishi_tkts_hint hint;
+  size_t len;
+  int found;
+
+  memset (&hint, 0, sizeof (hint));
+  if (shishi_tkt_client (tkt, &hint.client, &len) != SHISHI_OK)
+    return 1;
+  if (shishi_tkt_server (tkt, &hint.server, &len) != SHISHI_OK)
+    {
+      free (hint.client);
+      return 1;
+    }
+
+  found = shishi_tkts_find (tkts, &hint) != NULL;
+
+  free (hint.client);
+  free (hint.server);
+
+  return found;
+}
+
+/* Add to the ticket set of P->SH the valid tickets in its ticket
+   cache that it has nothing equivalent to, i.e., those written by
+   other handles since P->SH last read or wrote the cache.  Called
+   with pool_lock held, which all writers in this process take. */
+static void
+pool_merge (_gss_krb5_pool_t p)
+{
+  Shishi_tkts *tkts = shishi_tkts_default (p->sh);
+  const char *file = shishi_tkts_default_file (p->sh);
+  Shishi_tkts *disk;
+  Shishi_tkt *tkt;
+  int i;
+
+  if (tkts == NULL || file == NULL
+      || shishi_tkts (p->sh, &disk) != SHISHI_OK)
+    return;
+
+  if (shishi_tkts_from_file (disk, file) == SHISHI_OK)
+    for (i = 0; i < shishi_tkts_size (disk);)
+      {
+	tkt = shishi_tkts_nth (disk, i);
+	if (shishi_tkt_valid_now_p (tkt) && !pool_has_tkt (tkts, tkt)
+	    && shishi_tkts_add (tkts, tkt) == SHISHI_OK)
+	  /* Now owned by TKTS. */
+	  shishi_tkts_remove (disk, i);
+	else
+	  i++;
+      }
+
+  shishi_tkts_done (&disk);
+}
+
+/* Find the pool entry of SH.  Called with pool_lock held. */
+static _gss_krb5_pool_t
+pool_find (Shishi * sh)
+{
+  _gss_krb5_pool_t p;
+
+  for (p = pool; p; p = p->next)
+    if (p->sh == sh)
+      return p;
+
+  return NULL;
+}
+
+static void
+pool_free (_gss_krb5_pool_t p)
+{
+  _gss_krb5_pool_tkt_t t, next;
+  size_t i;
+
+  if (p->tkts)
+    {
+      for (i = 0; i < POOL_TKT_BUCKETS; i++)
+	for (t = p->tkts[i]; t; t = next)
+	  {
+	    next = t->next;
+	    free (t->server);
+	    free (t);
+	  }
+      free (p->tkts);
+    }
+  if (p->sh)
+    shishi_done (p->sh);
+  free (p->tktsfile);
+  free (p->systemcfgfile);
+  free (p->usercfgfile);
+  free (p);
+}
+
+/* Unlink and free P, which must be idle.  Called with pool_lock
+   held. */
+static void
+pool_remove (_gss_krb5_pool_t p)
+{
+  _gss_krb5_pool_t *pp;
+
+  for (pp = &pool; *pp; pp = &(*pp)->next)
+    if (*pp == p)
+      {
+	*pp = p->next;
+	break;
+      }
+
+  /* Do not let shishi_done write over tickets of other handles. */
+  if (pool_changed_p (p))
+    pool_merge (p);
+
+  pool_free (p);
+}
+
+static _gss_krb5_pool_t
+pool_new (int kind, const char *tktsfile, const char *systemcfgfile,
+	  const char *usercfgfile)
+{
+  _gss_krb5_pool_t p;
+  int rc;
+
+  p = calloc (sizeof (*p), 1);
+  if (!p)
+    return NULL;
+
+  if (strdup_or_null (tktsfile, &p->tktsfile)
+      || strdup_or_null (systemcfgfile, &p->systemcfgfile)
+      || strdup_or_null (usercfgfile, &p->usercfgfile))
+    {
+      pool_free (p);
+      return NULL;
+    }
+
+  p->kind = kind;
+  if (kind == POOL_SERVER)
+    rc = shishi_init_server (&p->sh);
+  else if (kind == POOL_BARE)
+    rc = (p->sh = shishi ()) ? SHISHI_OK : SHISHI_MALLOC_ERROR;
+  else if (tktsfile == NULL && systemcfgfile == NULL && usercfgfile == NULL)
+    rc = shishi_init (&p->sh);
+  else
+    rc = shishi_init_with_paths (&p->sh, tktsfile,
+				 systemcfgfile, usercfgfile);
+  if (rc != SHISHI_OK)
+    {
+      pool_free (p);
+      return NULL;
+    }
+
+  pool_record (p);
+
+  return p;
+}
+
+static int
+pool_get (int kind, const char *tktsfile, const char *systemcfgfile,
+	  const char *usercfgfile, Shishi ** sh)
+{
+  _gss_krb5_pool_t p, next;
+
+  _gss_lock (pool_lock);
+
+  for (p = pool; p; p = next)
+    {
+      next = p->next;
+
+      if (p->busy
+	  || !pool_match_p (p, kind, tktsfile, systemcfgfile, usercfgfile))
+	continue;
+
+      if (pool_changed_p (p))
+	{
+	  pool_remove (p);
+	  continue;
+	}
+
+      p->busy = 1;
+      *sh = p->sh;
+      _gss_unlock (pool_lock);
+      return SHISHI_OK;
+    }
+
+  p = pool_new (kind, tktsfile, systemcfgfile, usercfgfile);
+  if (!p)
+    {
+      _gss_unlock (pool_lock);
+      return SHISHI_MALLOC_ERROR;
+    }
+
+  p->busy = 1;
+  p->next = pool;
+  pool = p;
+  *sh = p->sh;
+
+  _gss_unlock (pool_lock);
+
+  return SHISHI_OK;
+}
+
+/* Borrow a Shishi handle initialized from the given ticket cache and
+   configuration files, where NULL denotes the Shishi default.  The
+   handle is for the exclusive use of the caller until it is returned
+   with _gss_krb5_pool_put.  Returns a Shishi error code. */
+int
+_gss_krb5_pool_get (const char *tktsfile,
+		    const char *systemcfgfile,
+		    const char *usercfgfile, Shishi ** sh)
+{
+  return pool_get (POOL_USER, tktsfile, systemcfgfile, usercfgfile, sh);
+}
+
+/* Borrow a Shishi handle for contexts that only need the
+   cryptographic functions, i.e., those imported from another process,
+   to be returned with _gss_krb5_pool_put like the others.  Returns a
+   Shishi error code. */
+int
+_gss_krb5_pool_get_bare (Shishi ** sh)
+{
+  return pool_get (POOL_BARE, NULL, NULL, NULL, sh);
+}
+
+/* Borrow a Shishi handle initialized from the server configuration,
+   which also names the hostkeys file, to be returned with
+   _gss_krb5_pool_put like the others.  Returns a Shishi error
+   code. */
+int
+_gss_krb5_pool_get_server (Shishi ** sh)
+{
+  return pool_get (POOL_SERVER, NULL, NULL, NULL, sh);
+}
+
+/* Return a handle obtained from _gss_krb5_pool_get.  The handle stays
+   in the pool for the next borrower, unless POOL_MAX_IDLE handles of
+   the same files are idle already, in which case it is closed. */
+void
+_gss_krb5_pool_put (Shishi * sh)
+{
+  _gss_krb5_pool_t p, q;
+  size_t idle = 0;
+
+  if (sh == NULL)
+    return;
+
+  _gss_lock (pool_lock);
+
+  p = pool_find (sh);
+  if (p)
+    {
+      p->busy = 0;
+
+      for (q = pool; q; q = q->next)
+	if (q != p && !q->busy
+	    && pool_match_p (q, p->kind, p->tktsfile, p->systemcfgfile,
+			     p->usercfgfile))
+	  idle++;
+
+      if (idle >= POOL_MAX_IDLE)
+	pool_remove (p);
+    }
+
+  _gss_unlock (pool_lock);
+}
+
+/* Write the ticket set of SH, which has a new ticket, to its ticket
+   cache, together with the tickets other handles wrote there.  SH
+   keeps its own view of the cache, while idle handles are retired as
+   the cache changes.  Handles that are not in the pool, or have no
+   ticket cache, are ignored. */
+void
+_gss_krb5_pool_save (Shishi * sh)
+{
+  _gss_krb5_pool_t p;
+  const char *file;
+
+  _gss_lock (pool_lock);
+
+  p = pool_find (sh);
+  file = p && p->kind == POOL_USER ? shishi_tkts_default_file (p->sh)
+    : NULL;
+  if (file)
+    {
+      if (pool_changed_p (p))
+	pool_merge (p);
+      if (shishi_tkts_to_file (shishi_tkts_default (p->sh), file)
+	  == SHISHI_OK)
+	pool_record (p);
+    }
+
+  _gss_unlock (pool_lock);
+}
+
+/* Return the service ticket for SERVER recorded for SH with
+   _gss_krb5_pool_add_tkt, or NULL if there is none or it is about to
+   expire. */
+Shishi_tkt *
+_gss_krb5_pool_find_tkt (Shishi * sh, const char *server)
+{
+  _gss_krb5_pool_t p;
+  _gss_krb5_pool_tkt_t t;
+  Shishi_tkt *tkt = NULL;
+  size_t hash = _gss_krb5_hash (server);
+
+  _gss_lock (pool_lock);
+
+  p = pool_find (sh);
+  if (p && p->tkts)
+    for (t = p->tkts[hash % POOL_TKT_BUCKETS]; t; t = t->next)
+      if (t->hash == hash && strcmp (t->server, server) == 0)
+	{
+	  tkt = t->tkt;
+	  break;
+	}
+
+  _gss_unlock (pool_lock);
+
+  if (tkt && (!shishi_tkt_valid_now_p (tkt)
+	      || shishi_tkt_endctime (tkt) - POOL_TKT_REFRESH < time (NULL)))
+    tkt = NULL;
+
+  return tkt;
+}
+
+/* Record TKT, which belongs to the ticket set of SH, as the service
+   ticket for SERVER.  Handles that are not in the pool, and tickets
+   about to expire, are ignored.  Failure to allocate is not an error,
+   the ticket is simply not indexed. */
+void
+_gss_krb5_pool_add_tkt (Shishi * sh, const char *server, Shishi_tkt * tkt)
+{
+  _gss_krb5_pool_t p;
+  _gss_krb5_pool_tkt_t t;
+  size_t hash = _gss_krb5_hash (server);
+
+  if (shishi_tkt_endctime (tkt) - POOL_TKT_REFRESH < time (NULL))
+    return;
+
+  _gss_lock (pool_lock);
+
+  p = pool_find (sh);
+  if (p == NULL)
+    goto out;
+
+  if (p->tkts == NULL)
+    {
+      p->tkts = calloc (POOL_TKT_BUCKETS, sizeof (*p->tkts));
+      if (p->tkts == NULL)
+	goto out;
+    }
+
+  for (t = p->tkts[hash % POOL_TKT_BUCKETS]; t; t = t->next)
+    if (t->hash == hash && strcmp (t->server, server) == 0)
+      {
+	t->tkt = tkt;
+	goto out;
+      }
+
+  t = malloc (sizeof (*t));
+  if (t == NULL)
+    goto out;
+  t->server = strdup (server);
+  if (t->server == NULL)
+    {
+      free (t);
+      goto out;
+    }
+  t->hash = hash;
+  t->tkt = tkt;
+  t->next = p->tkts[hash % POOL_TKT_BUCKETS];
+  p->tkts[hash % POOL_TKT_BUCKETS] = t;
+
+out:
+  _gss_unlock (pool_lock);
+}
@@ -54,6 +54,17 @@ extern OM_uint32
 gss_krb5_context_time (OM_uint32 * minor_status,
 		       const gss_ctx_id_t context_handle,
 		       OM_uint32 * time_rec);
+extern OM_uint32
+gss_krb5_export_sec_context (OM_uint32 * minor_status,
+			     gss_ctx_id_t * context_handle,
+			     gss_buffer_t interprocess_token);
+extern OM_uint32
+gss_krb5_import_sec_context (OM_uint32 * minor_status,
+			     const gss_buffer_t interprocess_token,
+			     gss_ctx_id_t * context_handle);
+extern OM_uint32
+gss_krb5_init_sec_context_fd (OM_uint32 * minor_status,
+			      const gss_ctx_id_t context_handle, int *fd);
 
 /* See cred.c. */
 extern OM_uint32
@@ -116,6 +127,51 @@ gss_krb5_wrap (OM_uint32 * minor_status,
 	       gss_qop_t qop_req,
 	       const gss_buffer_t input_message_buffer,
 	       int *conf_state, gss_buffer_t output_message_buffer);
+extern OM_uint32
+gss_krb5_wrap_iov (OM_uint32 * minor_status,
+		   const gss_ctx_id_t context_handle,
+		   int conf_req_flag,
+		   gss_qop_t qop_req,
+		   int *conf_state, gss_iov_buffer_desc * iov, int iov_count);
+extern OM_uint32
+gss_krb5_unwrap_iov (OM_uint32 * minor_status,
+		     const gss_ctx_id_t context_handle,
+		     int *conf_state,
+		     gss_qop_t * qop_state,
+		     gss_iov_buffer_desc * iov, int iov_count);
+extern OM_uint32
+gss_krb5_wrap_iov_length (OM_uint32 * minor_status,
+			  const gss_ctx_id_t context_handle,
+			  int conf_req_flag,
+			  gss_qop_t qop_req,
+			  int *conf_state,
+			  gss_iov_buffer_desc * iov, int iov_count);
+extern OM_uint32
+gss_krb5_wrap_into (OM_uint32 * minor_status,
+		    const gss_ctx_id_t context_handle,
+		    int conf_req_flag,
+		    gss_qop_t qop_req,
+		    const gss_buffer_t input_message_buffer,
+		    int *conf_state, gss_buffer_t output_message_buffer);
+extern OM_uint32
+gss_krb5_unwrap_into (OM_uint32 * minor_status,
+		      const gss_ctx_id_t context_handle,
+		      const gss_buffer_t input_message_buffer,
+		      gss_buffer_t output_message_buffer,
+		      int *conf_state, gss_qop_t * qop_state);
+extern OM_uint32
+gss_krb5_get_mic_into (OM_uint32 * minor_status,
+		       const gss_ctx_id_t context_handle,
+		       gss_qop_t qop_req,
+		       const gss_buffer_t message_buffer,
+		       gss_buffer_t message_token);
+extern OM_uint32
+gss_krb5_wrap_size_limit (OM_uint32 * minor_status,
+			  const gss_ctx_id_t context_handle,
+			  int conf_req_flag,
+			  gss_qop_t qop_req,
+			  OM_uint32 req_output_size,
+			  OM_uint32 * max_input_size);
 
 /* See name.c. */
 extern OM_uint32
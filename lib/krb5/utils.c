@@ -23,21 +23,33 @@
 /* Get specification. */
 #include "k5internal.h"
 
-/* Return number of seconds left of ticket lifetime, or 0 if ticket
-   has expired, or GSS_C_INDEFINITE if ticket is NULL. */
+/* Return number of seconds left until the ticket end time ENDTIME,
+   or 0 if the ticket has expired, or GSS_C_INDEFINITE if ENDTIME is 0
+   because there is no ticket yet. */
 OM_uint32
-gss_krb5_tktlifetime (Shishi_tkt * tkt)
+gss_krb5_lifetime (time_t endtime)
 {
-  time_t now, end;
+  time_t now;
 
-  if (!tkt)
+  if (endtime == 0)
     return GSS_C_INDEFINITE;
 
-  if (!shishi_tkt_valid_now_p (tkt))
+  now = time (NULL);
+  if (now >= endtime)
     return 0;
 
-  now = time (NULL);
-  end = shishi_tkt_endctime (tkt);
+  return endtime - now;
+}
+
+/* FNV-1a of the string STR, for hashing principal names. */
+size_t
+_gss_krb5_hash (const char *str)
+{
+  size_t h = 2166136261U;
+  const char *p;
+
+  for (p = str; *p; p++)
+    h = (h ^ (unsigned char) *p) * 16777619U;
 
-  return end - now;
+  return h;
 }
@@ -47,14 +47,26 @@ static _gss_mech_api_desc _gss_mech_apis[] = {
    gss_krb5_unwrap,
    gss_krb5_get_mic,
    gss_krb5_verify_mic,
+   gss_krb5_wrap_iov,
+   gss_krb5_unwrap_iov,
+   gss_krb5_wrap_iov_length,
+   gss_krb5_wrap_into,
+   gss_krb5_unwrap_into,
+   gss_krb5_get_mic_into,
+   gss_krb5_wrap_size_limit,
    gss_krb5_display_status,
    gss_krb5_acquire_cred,
    gss_krb5_release_cred,
    gss_krb5_accept_sec_context,
    gss_krb5_delete_sec_context,
    gss_krb5_context_time,
+   gss_krb5_export_sec_context,
+   gss_krb5_import_sec_context,
+   gss_krb5_init_sec_context_fd,
    gss_krb5_inquire_cred,
-   gss_krb5_inquire_cred_by_mech},
+   gss_krb5_inquire_cred_by_mech,
+   NULL,
+   NULL},
 #endif
   {
    NULL,
@@ -79,66 +91,275 @@ static _gss_mech_api_desc _gss_mech_apis[] = {
    NULL,
    NULL,
    NULL,
+   NULL,
+   NULL,
+   NULL,
+   NULL,
+   NULL,
+   NULL,
+   NULL,
+   NULL,
+   NULL,
+   NULL,
+   NULL,
+   NULL,
    NULL}
 };
 
-_gss_mech_api_t
-_gss_find_mech_no_default (const gss_OID oid)
+/* The registry.  Mechanisms are found by hashing their OID or SASL
+   name into open addressed tables, so that a lookup does not depend
+   on how many mechanisms there are.  Entries are only ever added, and
+   each slot is written once, so lookups take no lock; registration is
+   serialized by mech_lock.  The built-in mechanisms are registered
+   on first use, ahead of any others, followed by the mechanisms from
+   the configuration file, see plugin.c. */
+
+#define MECH_MAX 32
+#define MECH_BUCKETS 64		/* Power of two, at least 2 * MECH_MAX. */
+
+static _gss_mech_api_t mech_list[MECH_MAX];
+static size_t mech_count;
+static _gss_mech_api_t mech_by_oid[MECH_BUCKETS];
+static _gss_mech_api_t mech_by_saslname[MECH_BUCKETS];
+/* Used when no OID is given: the mechanism named by the "default"
+   line of the configuration file, or else the first one registered.
+   Set before mech_ready, so that lookups need not look at the
+   configuration again. */
+static _gss_mech_api_t mech_default;
+static int mech_ready;
+_GSS_LOCK_DEFINE (mech_lock);
+
+/* FNV-1a. */
+static size_t
+mech_hash (const void *data, size_t len)
+{
+  const unsigned char *p = data;
+  uint32_t h = 2166136261U;
+
+  while (len-- > 0)
+    h = (h ^ *p++) * 16777619U;
+
+  return h;
+}
+
+static _gss_mech_api_t *
+mech_oid_slot (const char *oid, size_t len)
+{
+  size_t i = mech_hash (oid, len);
+  _gss_mech_api_t *slot, p;
+
+  for (;; i++)
+    {
+      slot = &mech_by_oid[i & (MECH_BUCKETS - 1)];
+      p = _gss_load (slot);
+      if (p == NULL
+	  || (p->mech->length == len && memcmp (p->mech->elements, oid,
+						len) == 0))
+	return slot;
+    }
+}
+
+static _gss_mech_api_t *
+mech_saslname_slot (const char *name, size_t len)
+{
+  size_t i = mech_hash (name, len);
+  _gss_mech_api_t *slot, p;
+
+  for (;; i++)
+    {
+      slot = &mech_by_saslname[i & (MECH_BUCKETS - 1)];
+      p = _gss_load (slot);
+      if (p == NULL
+	  || (strlen (p->sasl_name) == len
+	      && memcmp (p->sasl_name, name, len) == 0))
+	return slot;
+    }
+}
+
+/* Add MECH with mech_lock held.  Plugins are bound only when looked
+   up by OID. */
+static int
+mech_add (_gss_mech_api_t mech)
+{
+  _gss_mech_api_t *oidslot, *saslslot = NULL;
+
+  if (mech->mech == GSS_C_NO_OID || mech->mech->length == 0)
+    return EINVAL;
+
+  if (mech_count == MECH_MAX)
+    return ENOSPC;
+
+  oidslot = mech_oid_slot (mech->mech->elements, mech->mech->length);
+  if (*oidslot)
+    return EEXIST;
+
+  if (mech->sasl_name)
+    {
+      saslslot = mech_saslname_slot (mech->sasl_name,
+				     strlen (mech->sasl_name));
+      if (*saslslot)
+	return EEXIST;
+    }
+
+  mech_list[mech_count] = mech;
+  _gss_store (&mech_count, mech_count + 1);
+  _gss_store (oidslot, mech);
+  if (saslslot)
+    _gss_store (saslslot, mech);
+  if (!mech_default)
+    _gss_store (&mech_default, mech);
+
+  return 0;
+}
+
+/* Find the mechanism named by SPEC, a dotted OID or a SASL name, with
+   mech_lock held. */
+static _gss_mech_api_t
+mech_resolve (const char *spec)
+{
+  char oid[_GSS_PLUGIN_MAX_OID];
+  size_t len;
+
+  len = _gss_plugin_oid (spec, oid);
+  if (len > 0)
+    return *mech_oid_slot (oid, len);
+
+  return *mech_saslname_slot (spec, strlen (spec));
+}
+
+static void
+mech_init (void)
 {
+  _gss_mech_api_t p;
+  char *spec = NULL;
   size_t i;
 
-  for (i = 0; _gss_mech_apis[i].mech; i++)
-    if (gss_oid_equal (oid, _gss_mech_apis[i].mech))
-      return &_gss_mech_apis[i];
+  if (_gss_load (&mech_ready))
+    return;
+
+  _gss_lock (mech_lock);
+  if (!mech_ready)
+    {
+      for (i = 0; _gss_mech_apis[i].mech; i++)
+	mech_add (&_gss_mech_apis[i]);
+      _gss_plugin_config (mech_add, &spec);
+      if (spec && (p = mech_resolve (spec)) != NULL)
+	_gss_store (&mech_default, p);
+      free (spec);
+      _gss_store (&mech_ready, 1);
+    }
+  _gss_unlock (mech_lock);
+}
+
+/* Return MECH, or NULL if it is a plugin that cannot be loaded. */
+static _gss_mech_api_t
+mech_bind (_gss_mech_api_t mech)
+{
+  if (mech && mech->plugin)
+    return _gss_plugin_load (mech);
+
+  return mech;
+}
+
+/* Make MECH available to the rest of the library.  MECH must stay
+   valid until the process exits, as there is no way to remove it.
+   Returns 0 on success, EEXIST if its OID or SASL name is taken,
+   ENOSPC if there is no more room, or EINVAL if it has no OID. */
+int
+_gss_mech_register (_gss_mech_api_t mech)
+{
+  int rc;
+
+  mech_init ();
+
+  _gss_lock (mech_lock);
+  rc = mech_add (mech);
+  _gss_unlock (mech_lock);
+
+  return rc;
+}
+
+static _gss_mech_api_t
+mech_lookup (const gss_OID oid)
+{
+  mech_init ();
+
+  if (oid == GSS_C_NO_OID || oid->length == 0)
+    return NULL;
+
+  return _gss_load (mech_oid_slot (oid->elements, oid->length));
+}
 
-  return NULL;
+_gss_mech_api_t
+_gss_find_mech_no_default (const gss_OID oid)
+{
+  return mech_bind (mech_lookup (oid));
 }
 
 _gss_mech_api_t
 _gss_find_mech (const gss_OID oid)
 {
-  _gss_mech_api_t p = _gss_find_mech_no_default (oid);
+  _gss_mech_api_t p = mech_lookup (oid);
 
-  if (!p && _gss_mech_apis[0].mech)
-    /* FIXME.  When we support more than one mechanism, make it possible
-       to configure the default mechanism. */
-    return &_gss_mech_apis[0];
+  if (!p)
+    p = _gss_load (&mech_default);
 
-  return p;
+  return mech_bind (p);
 }
 
 _gss_mech_api_t
 _gss_find_mech_by_saslname (const gss_buffer_t sasl_mech_name)
 {
-  size_t i;
-
   if (sasl_mech_name == NULL
       || sasl_mech_name->value == NULL || sasl_mech_name->length == 0)
     return NULL;
 
-  for (i = 0; _gss_mech_apis[i].mech; i++)
-    if (strlen (_gss_mech_apis[i].sasl_name) == sasl_mech_name->length &&
-	memcmp (_gss_mech_apis[i].sasl_name, sasl_mech_name->value,
-		sasl_mech_name->length) == 0)
-      return &_gss_mech_apis[i];
+  mech_init ();
 
-  return NULL;
+  return _gss_load (mech_saslname_slot (sasl_mech_name->value,
+					sasl_mech_name->length));
 }
 
+/* The set of registered mechanisms, made again when one is added.
+   The old set is not freed, as callers may still be using it. */
+static gss_OID_set mech_set;
+
 OM_uint32
-_gss_indicate_mechs1 (OM_uint32 * minor_status, gss_OID_set * mech_set)
+_gss_indicate_mechs1 (OM_uint32 * minor_status, gss_OID_set * out)
 {
-  OM_uint32 maj_stat;
-  int i;
+  OM_uint32 maj_stat = GSS_S_COMPLETE;
+  gss_OID_set set;
+  size_t i;
 
-  for (i = 0; _gss_mech_apis[i].mech; i++)
+  mech_init ();
+
+  set = _gss_load (&mech_set);
+  if (!set || set->count != _gss_load (&mech_count))
     {
-      maj_stat = gss_add_oid_set_member (minor_status,
-					 _gss_mech_apis[i].mech, mech_set);
+      _gss_lock (mech_lock);
+      set = mech_set;
+      if (!set || set->count != mech_count)
+	{
+	  set = GSS_C_NO_OID_SET;
+	  maj_stat = gss_create_empty_oid_set (minor_status, &set);
+	  for (i = 0; !GSS_ERROR (maj_stat) && i < mech_count; i++)
+	    maj_stat = gss_add_oid_set_member (minor_status,
+					       mech_list[i]->mech, &set);
+	  if (GSS_ERROR (maj_stat))
+	    gss_release_oid_set (NULL, &set);
+	  else
+	    {
+	      _gss_oid_set_share (set);
+	      _gss_store (&mech_set, set);
+	    }
+	}
+      _gss_unlock (mech_lock);
       if (GSS_ERROR (maj_stat))
 	return maj_stat;
     }
 
+  *out = set;
+
   if (minor_status)
     *minor_status = 0;
   return GSS_S_COMPLETE;
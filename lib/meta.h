@@ -24,6 +24,7 @@
 #define META_H
 
 #include <gss/api.h>
+#include <gss/ext.h>
 
 #define MAX_NT 5
 
@@ -75,6 +76,42 @@ typedef struct _gss_mech_api_struct
      const gss_ctx_id_t context_handle,
      const gss_buffer_t message_buffer,
      const gss_buffer_t token_buffer, gss_qop_t * qop_state);
+    OM_uint32 (*wrap_iov)
+    (OM_uint32 * minor_status,
+     const gss_ctx_id_t context_handle, int conf_req_flag,
+     gss_qop_t qop_req, int *conf_state,
+     gss_iov_buffer_desc * iov, int iov_count);
+    OM_uint32 (*unwrap_iov)
+    (OM_uint32 * minor_status,
+     const gss_ctx_id_t context_handle, int *conf_state,
+     gss_qop_t * qop_state, gss_iov_buffer_desc * iov, int iov_count);
+    OM_uint32 (*wrap_iov_length)
+    (OM_uint32 * minor_status,
+     const gss_ctx_id_t context_handle, int conf_req_flag,
+     gss_qop_t qop_req, int *conf_state,
+     gss_iov_buffer_desc * iov, int iov_count);
+    OM_uint32 (*wrap_into)
+    (OM_uint32 * minor_status,
+     const gss_ctx_id_t context_handle, int conf_req_flag,
+     gss_qop_t qop_req,
+     const gss_buffer_t input_message_buffer,
+     int *conf_state, gss_buffer_t output_message_buffer);
+    OM_uint32 (*unwrap_into)
+    (OM_uint32 * minor_status,
+     const gss_ctx_id_t context_handle,
+     const gss_buffer_t input_message_buffer,
+     gss_buffer_t output_message_buffer, int *conf_state,
+     gss_qop_t * qop_state);
+    OM_uint32 (*get_mic_into)
+    (OM_uint32 * minor_status,
+     const gss_ctx_id_t context_handle,
+     gss_qop_t qop_req,
+     const gss_buffer_t message_buffer, gss_buffer_t message_token);
+    OM_uint32 (*wrap_size_limit)
+    (OM_uint32 * minor_status,
+     const gss_ctx_id_t context_handle, int conf_req_flag,
+     gss_qop_t qop_req, OM_uint32 req_output_size,
+     OM_uint32 * max_input_size);
     OM_uint32 (*display_status)
     (OM_uint32 * minor_status,
      OM_uint32 status_value, int status_type,
@@ -90,6 +127,9 @@ typedef struct _gss_mech_api_struct
      gss_OID_set * actual_mechs, OM_uint32 * time_rec);
     OM_uint32 (*release_cred)
     (OM_uint32 * minor_status, gss_cred_id_t * cred_handle);
+    /* The initial token is passed without its mechanism-independent
+       header, which gss_accept_sec_context parses to find the
+       mechanism. */
     OM_uint32 (*accept_sec_context)
     (OM_uint32 * minor_status,
      gss_ctx_id_t * context_handle,
@@ -107,6 +147,15 @@ typedef struct _gss_mech_api_struct
     OM_uint32 (*context_time)
     (OM_uint32 * minor_status,
      const gss_ctx_id_t context_handle, OM_uint32 * time_rec);
+    OM_uint32 (*export_sec_context)
+    (OM_uint32 * minor_status,
+     gss_ctx_id_t * context_handle, gss_buffer_t interprocess_token);
+    OM_uint32 (*import_sec_context)
+    (OM_uint32 * minor_status,
+     const gss_buffer_t interprocess_token, gss_ctx_id_t * context_handle);
+    OM_uint32 (*init_sec_context_fd)
+    (OM_uint32 * minor_status,
+     const gss_ctx_id_t context_handle, int *fd);
     OM_uint32 (*inquire_cred)
     (OM_uint32 * minor_status,
      const gss_cred_id_t cred_handle,
@@ -119,13 +168,33 @@ typedef struct _gss_mech_api_struct
      gss_name_t * name,
      OM_uint32 * initiator_lifetime,
      OM_uint32 * acceptor_lifetime, gss_cred_usage_t * cred_usage);
+  /* Set for mechanisms from the configuration file, whose functions
+     are bound on first use, see plugin.c. */
+  struct _gss_mech_plugin_struct *plugin;
+  /* The name_types as a shared OID set, made on first use by
+     gss_inquire_names_for_mech. */
+  gss_OID_set name_type_set;
 } _gss_mech_api_desc, *_gss_mech_api_t;
 
+/* The mechanism of a context or credential, looked up only if the
+   handle was made without it. */
+#define _gss_ctx_mech(ctx) \
+  ((ctx)->api ? (ctx)->api : _gss_find_mech ((ctx)->mech))
+#define _gss_cred_mech(cred) \
+  ((cred)->api ? (cred)->api : _gss_find_mech ((cred)->mech))
+
+int _gss_mech_register (_gss_mech_api_t mech);
 _gss_mech_api_t _gss_find_mech (const gss_OID oid);
 _gss_mech_api_t _gss_find_mech_no_default (const gss_OID oid);
 _gss_mech_api_t _gss_find_mech_by_saslname (const gss_buffer_t
 					    sasl_mech_name);
 OM_uint32 _gss_indicate_mechs1 (OM_uint32 * minor_status,
-				gss_OID_set * mech_set);
+				gss_OID_set * out);
+
+/* plugin.c */
+#define _GSS_PLUGIN_MAX_OID 32
+size_t _gss_plugin_oid (const char *str, char *out);
+void _gss_plugin_config (int (*add) (_gss_mech_api_t mech), char **dflt);
+_gss_mech_api_t _gss_plugin_load (_gss_mech_api_t mech);
 
 #endif /* META_H */
@@ -25,6 +25,141 @@
 /* _gss_indicate_mechs1 */
 #include "meta.h"
 
+#ifdef USE_KERBEROS5
+/* GSS_KRB5_static etc */
+# include <gss/krb5-ext.h>
+#endif
+
+/* OID sets made by the library are kept sorted, by length and then
+   contents, so that membership is a binary search.  The
+   gss_OID_set_desc that applications see is the first member of a
+   larger struct, which holds the size of the elements array and room
+   for a few elements, so that small sets need one allocation.  OIDs
+   the library defines are not copied, since their storage is static.
+   Shared sets, such as those returned by gss_indicate_mechs, live
+   until the process exits: releasing one only clears the handle, and
+   adding to one replaces it with a private copy. */
+
+#define OID_SET_INLINE 4
+
+struct _gss_oid_set_struct
+{
+  gss_OID_set_desc set;
+  size_t alloc;
+  int shared;
+  gss_OID_desc inline_elements[OID_SET_INLINE];
+};
+
+static gss_OID_desc *const static_oids[] = {
+  &GSS_C_NT_USER_NAME_static,
+  &GSS_C_NT_MACHINE_UID_NAME_static,
+  &GSS_C_NT_STRING_UID_NAME_static,
+  &GSS_C_NT_HOSTBASED_SERVICE_X_static,
+  &GSS_C_NT_HOSTBASED_SERVICE_static,
+  &GSS_C_NT_ANONYMOUS_static,
+  &GSS_C_NT_EXPORT_NAME_static,
+#ifdef USE_KERBEROS5
+  &GSS_KRB5_static,
+  &GSS_KRB5_NT_USER_NAME_static,
+  &GSS_KRB5_NT_PRINCIPAL_NAME_static,
+  &GSS_KRB5_NT_MACHINE_UID_NAME_static,
+  &GSS_KRB5_NT_STRING_UID_NAME_static,
+#endif
+};
+
+#define STATIC_OIDS (sizeof (static_oids) / sizeof (static_oids[0]))
+
+/* Return the static OID equal to OID, or NULL. */
+static gss_OID
+oid_static (const gss_OID oid)
+{
+  size_t i;
+
+  for (i = 0; i < STATIC_OIDS; i++)
+    if (gss_oid_equal (oid, static_oids[i]))
+      return static_oids[i];
+
+  return NULL;
+}
+
+static int
+oid_static_p (const gss_OID oid)
+{
+  size_t i;
+
+  for (i = 0; i < STATIC_OIDS; i++)
+    if (oid->elements == static_oids[i]->elements)
+      return 1;
+
+  return 0;
+}
+
+static int
+oid_cmp (const gss_OID a, const gss_OID b)
+{
+  if (a->length != b->length)
+    return a->length < b->length ? -1 : 1;
+
+  return memcmp (a->elements, b->elements, a->length);
+}
+
+/* Return non-zero if OID is in SET, a set made by the library.  In
+   any case, store in *POS where OID is or would be inserted. */
+static int
+oid_set_find (const gss_OID_set set, const gss_OID oid, size_t * pos)
+{
+  size_t lo = 0, hi = set->count, mid;
+  int cmp;
+
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+      cmp = oid_cmp (oid, set->elements + mid);
+      if (cmp == 0)
+	{
+	  *pos = mid;
+	  return 1;
+	}
+      if (cmp < 0)
+	hi = mid;
+      else
+	lo = mid + 1;
+    }
+
+  *pos = lo;
+  return 0;
+}
+
+int
+_gss_oid_set_member (const gss_OID_set set, const gss_OID oid)
+{
+  size_t pos;
+
+  return oid != GSS_C_NO_OID && oid_set_find (set, oid, &pos);
+}
+
+/* Mark SET, made by the library, as shared: it is never modified or
+   freed again. */
+void
+_gss_oid_set_share (gss_OID_set set)
+{
+  ((struct _gss_oid_set_struct *) set)->shared = 1;
+}
+
+static void
+oid_set_free (gss_OID_set set)
+{
+  struct _gss_oid_set_struct *s = (struct _gss_oid_set_struct *) set;
+  size_t i;
+
+  for (i = 0; i < set->count; i++)
+    if (!oid_static_p (set->elements + i))
+      free (set->elements[i].elements);
+  if (set->elements != s->inline_elements)
+    free (set->elements);
+  free (s);
+}
+
 /**
  * gss_create_empty_oid_set:
  * @minor_status: (integer, modify) Mechanism specific status code.
@@ -46,18 +181,23 @@
 OM_uint32
 gss_create_empty_oid_set (OM_uint32 * minor_status, gss_OID_set * oid_set)
 {
+  struct _gss_oid_set_struct *s;
+
   if (minor_status)
     *minor_status = 0;
 
-  *oid_set = malloc (sizeof (**oid_set));
-  if (!*oid_set)
+  s = malloc (sizeof (*s));
+  if (!s)
     {
       if (minor_status)
 	*minor_status = ENOMEM;
       return GSS_S_FAILURE;
     }
-  (*oid_set)->count = 0;
-  (*oid_set)->elements = NULL;
+  s->set.count = 0;
+  s->set.elements = s->inline_elements;
+  s->alloc = OID_SET_INLINE;
+  s->shared = 0;
+  *oid_set = &s->set;
 
   return GSS_S_COMPLETE;
 }
@@ -72,7 +212,7 @@ gss_create_empty_oid_set (OM_uint32 * minor_status, gss_OID_set * oid_set)
  *   deallocate the oid structure itself too.
  *
  * Make an exact copy of the given OID, that shares no memory areas
- * with the original.
+ * with the original, unless the OID is one the library defines.
  *
  * WARNING: This function is a GNU GSS specific extension, and is not
  * part of the official GSS API.
@@ -95,6 +235,12 @@ _gss_copy_oid (OM_uint32 * minor_status,
     return GSS_S_FAILURE | GSS_S_CALL_BAD_STRUCTURE;
 
   dest_oid->length = src_oid->length;
+  if (oid_static (src_oid))
+    {
+      dest_oid->elements = oid_static (src_oid)->elements;
+      return GSS_S_COMPLETE;
+    }
+
   dest_oid->elements = malloc (src_oid->length);
   if (!dest_oid->elements)
     {
@@ -136,8 +282,10 @@ OM_uint32
 gss_add_oid_set_member (OM_uint32 * minor_status,
 			const gss_OID member_oid, gss_OID_set * oid_set)
 {
+  struct _gss_oid_set_struct *s = (struct _gss_oid_set_struct *) *oid_set;
   OM_uint32 major_stat;
-  int present;
+  gss_OID_desc oid;
+  size_t pos, i;
 
   if (!member_oid || member_oid->length == 0 || member_oid->elements == NULL)
     {
@@ -146,46 +294,74 @@ gss_add_oid_set_member (OM_uint32 * minor_status,
       return GSS_S_FAILURE;
     }
 
-  major_stat = gss_test_oid_set_member (minor_status, member_oid,
-					*oid_set, &present);
-  if (GSS_ERROR (major_stat))
-    return major_stat;
-
-  if (present)
+  if (oid_set_find (*oid_set, member_oid, &pos))
     {
       if (minor_status)
 	*minor_status = 0;
       return GSS_S_COMPLETE;
     }
 
-  if ((*oid_set)->count + 1 == 0)	/* integer overflow */
+  if (s->shared)
     {
-      if (minor_status)
-	*minor_status = 0;
-      return GSS_S_FAILURE;
+      gss_OID_set copy;
+
+      major_stat = gss_create_empty_oid_set (minor_status, &copy);
+      if (GSS_ERROR (major_stat))
+	return major_stat;
+      for (i = 0; i < s->set.count; i++)
+	{
+	  major_stat = gss_add_oid_set_member (minor_status,
+					       s->set.elements + i, &copy);
+	  if (GSS_ERROR (major_stat))
+	    {
+	      gss_release_oid_set (NULL, &copy);
+	      return major_stat;
+	    }
+	}
+      *oid_set = copy;
+      s = (struct _gss_oid_set_struct *) copy;
     }
 
-  (*oid_set)->count++;
-  {
-    gss_OID tmp;
+  if (s->set.count == s->alloc)
+    {
+      size_t n = s->alloc * 2;
+      gss_OID tmp;
 
-    tmp = realloc ((*oid_set)->elements, (*oid_set)->count *
-		   sizeof (*(*oid_set)->elements));
-    if (!tmp)
-      {
-	if (minor_status)
-	  *minor_status = ENOMEM;
-	return GSS_S_FAILURE;
-      }
+      if (n < s->alloc || n * sizeof (*tmp) / sizeof (*tmp) != n)
+	{
+	  if (minor_status)
+	    *minor_status = ENOMEM;
+	  return GSS_S_FAILURE;
+	}
 
-    (*oid_set)->elements = tmp;
-  }
+      if (s->set.elements == s->inline_elements)
+	{
+	  tmp = malloc (n * sizeof (*tmp));
+	  if (tmp)
+	    memcpy (tmp, s->inline_elements, sizeof (s->inline_elements));
+	}
+      else
+	tmp = realloc (s->set.elements, n * sizeof (*tmp));
+      if (!tmp)
+	{
+	  if (minor_status)
+	    *minor_status = ENOMEM;
+	  return GSS_S_FAILURE;
+	}
+
+      s->set.elements = tmp;
+      s->alloc = n;
+    }
 
-  major_stat = _gss_copy_oid (minor_status, member_oid,
-			      (*oid_set)->elements + ((*oid_set)->count - 1));
+  major_stat = _gss_copy_oid (minor_status, member_oid, &oid);
   if (GSS_ERROR (major_stat))
     return major_stat;
 
+  memmove (s->set.elements + pos + 1, s->set.elements + pos,
+	   (s->set.count - pos) * sizeof (*s->set.elements));
+  s->set.elements[pos] = oid;
+  s->set.count++;
+
   return GSS_S_COMPLETE;
 }
 
@@ -224,6 +400,15 @@ gss_test_oid_set_member (OM_uint32 * minor_status,
   if (member == GSS_C_NO_OID)
     return GSS_S_COMPLETE;
 
+  /* Sets made by the library are sorted, but the set may have been
+     made by the application, so look further if the OID is not where
+     it would be in a sorted set. */
+  if (oid_set_find (set, member, &i))
+    {
+      *present = 1;
+      return GSS_S_COMPLETE;
+    }
+
   for (i = 0, cur = set->elements; i < set->count; i++, cur++)
     {
       if (cur->length == member->length &&
@@ -259,19 +444,14 @@ gss_test_oid_set_member (OM_uint32 * minor_status,
 OM_uint32
 gss_release_oid_set (OM_uint32 * minor_status, gss_OID_set * set)
 {
-  gss_OID cur;
-  size_t i;
-
   if (minor_status)
     *minor_status = 0;
 
   if (!set || *set == GSS_C_NO_OID_SET)
     return GSS_S_COMPLETE;
 
-  for (i = 0, cur = (*set)->elements; i < (*set)->count; i++, cur++)
-    free (cur->elements);
-  free ((*set)->elements);
-  free (*set);
+  if (!((struct _gss_oid_set_struct *) *set)->shared)
+    oid_set_free (*set);
   *set = GSS_C_NO_OID_SET;
 
   return GSS_S_COMPLETE;
@@ -282,12 +462,13 @@ gss_release_oid_set (OM_uint32 * minor_status, gss_OID_set * set)
  * @minor_status: (integer, modify) Mechanism specific status code.
  * @mech_set: (set of Object IDs, modify) Set of
  *   implementation-supported mechanisms.  The returned gss_OID_set
- *   value will be a dynamically-allocated OID set, that should be
- *   released by the caller after use with a call to
+ *   value should be released by the caller after use with a call to
  *   gss_release_oid_set().
  *
  * Allows an application to determine which underlying security
- * mechanisms are available.
+ * mechanisms are available.  The returned set is shared between
+ * callers and must not be modified other than through
+ * gss_add_oid_set_member(), which gives the caller a private copy.
  *
  * Return value:
  *
@@ -296,22 +477,7 @@ gss_release_oid_set (OM_uint32 * minor_status, gss_OID_set * set)
 OM_uint32
 gss_indicate_mechs (OM_uint32 * minor_status, gss_OID_set * mech_set)
 {
-  OM_uint32 maj_stat;
-
-  maj_stat = gss_create_empty_oid_set (minor_status, mech_set);
-  if (GSS_ERROR (maj_stat))
-    return maj_stat;
-
-  maj_stat = _gss_indicate_mechs1 (minor_status, mech_set);
-  if (GSS_ERROR (maj_stat))
-    {
-      gss_release_oid_set (NULL, mech_set);
-      return maj_stat;
-    }
-
-  if (minor_status)
-    *minor_status = 0;
-  return GSS_S_COMPLETE;
+  return _gss_indicate_mechs1 (minor_status, mech_set);
 }
 
 /**
@@ -349,3 +515,28 @@ gss_release_buffer (OM_uint32 * minor_status, gss_buffer_t buffer)
 
   return GSS_S_COMPLETE;
 }
+
+/* Check that BUFFER, whose length is the size of the storage it
+   points to, can hold LEN octets.  If not, store LEN as the length
+   and fail with ERANGE as the minor status, so that the caller can
+   retry with enough storage. */
+OM_uint32
+_gss_buffer_fits (OM_uint32 * minor_status, gss_buffer_t buffer, size_t len)
+{
+  if (buffer == GSS_C_NO_BUFFER)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_CALL_INACCESSIBLE_WRITE;
+    }
+
+  if (buffer->length < len || (len > 0 && buffer->value == NULL))
+    {
+      buffer->length = len;
+      if (minor_status)
+	*minor_status = ERANGE;
+      return GSS_S_FAILURE;
+    }
+
+  return GSS_S_COMPLETE;
+}
@@ -25,6 +25,33 @@
 /* _gss_find_mech */
 #include "meta.h"
 
+static OM_uint32
+_gss_get_mic1 (OM_uint32 * minor_status,
+	       const gss_ctx_id_t context_handle,
+	       gss_qop_t qop_req,
+	       const gss_buffer_t message_buffer, gss_buffer_t message_token)
+{
+  _gss_mech_api_t mech;
+
+  if (!context_handle)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_NO_CONTEXT;
+    }
+
+  mech = _gss_ctx_mech (context_handle);
+  if (mech == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
+    }
+
+  return mech->get_mic (minor_status, context_handle, qop_req,
+			message_buffer, message_token);
+}
+
 /**
  * gss_get_mic:
  * @minor_status: (Integer, modify) Mechanism specific status code.
@@ -68,6 +95,21 @@ gss_get_mic (OM_uint32 * minor_status,
 	     const gss_ctx_id_t context_handle,
 	     gss_qop_t qop_req,
 	     const gss_buffer_t message_buffer, gss_buffer_t message_token)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_get_mic1 (minor_status, context_handle, qop_req,
+			    message_buffer, message_token);
+
+  return _gss_stats_end (_GSS_STATS_GET_MIC, start, maj_stat);
+}
+
+static OM_uint32
+_gss_verify_mic1 (OM_uint32 * minor_status,
+		  const gss_ctx_id_t context_handle,
+		  const gss_buffer_t message_buffer,
+		  const gss_buffer_t token_buffer, gss_qop_t * qop_state)
 {
   _gss_mech_api_t mech;
 
@@ -78,7 +120,7 @@ gss_get_mic (OM_uint32 * minor_status,
       return GSS_S_NO_CONTEXT;
     }
 
-  mech = _gss_find_mech (context_handle->mech);
+  mech = _gss_ctx_mech (context_handle);
   if (mech == NULL)
     {
       if (minor_status)
@@ -86,8 +128,8 @@ gss_get_mic (OM_uint32 * minor_status,
       return GSS_S_BAD_MECH;
     }
 
-  return mech->get_mic (minor_status, context_handle, qop_req,
-			message_buffer, message_token);
+  return mech->verify_mic (minor_status, context_handle,
+			   message_buffer, token_buffer, qop_state);
 }
 
 /**
@@ -143,6 +185,23 @@ gss_verify_mic (OM_uint32 * minor_status,
 		const gss_ctx_id_t context_handle,
 		const gss_buffer_t message_buffer,
 		const gss_buffer_t token_buffer, gss_qop_t * qop_state)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_verify_mic1 (minor_status, context_handle, message_buffer,
+			       token_buffer, qop_state);
+
+  return _gss_stats_end (_GSS_STATS_VERIFY_MIC, start, maj_stat);
+}
+
+static OM_uint32
+_gss_wrap1 (OM_uint32 * minor_status,
+	    const gss_ctx_id_t context_handle,
+	    int conf_req_flag,
+	    gss_qop_t qop_req,
+	    const gss_buffer_t input_message_buffer,
+	    int *conf_state, gss_buffer_t output_message_buffer)
 {
   _gss_mech_api_t mech;
 
@@ -153,7 +212,7 @@ gss_verify_mic (OM_uint32 * minor_status,
       return GSS_S_NO_CONTEXT;
     }
 
-  mech = _gss_find_mech (context_handle->mech);
+  mech = _gss_ctx_mech (context_handle);
   if (mech == NULL)
     {
       if (minor_status)
@@ -161,8 +220,8 @@ gss_verify_mic (OM_uint32 * minor_status,
       return GSS_S_BAD_MECH;
     }
 
-  return mech->verify_mic (minor_status, context_handle,
-			   message_buffer, token_buffer, qop_state);
+  return mech->wrap (minor_status, context_handle, conf_req_flag, qop_req,
+		     input_message_buffer, conf_state, output_message_buffer);
 }
 
 /**
@@ -217,6 +276,23 @@ gss_wrap (OM_uint32 * minor_status,
 	  gss_qop_t qop_req,
 	  const gss_buffer_t input_message_buffer,
 	  int *conf_state, gss_buffer_t output_message_buffer)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_wrap1 (minor_status, context_handle, conf_req_flag, qop_req,
+			 input_message_buffer, conf_state,
+			 output_message_buffer);
+
+  return _gss_stats_end (_GSS_STATS_WRAP, start, maj_stat);
+}
+
+static OM_uint32
+_gss_unwrap1 (OM_uint32 * minor_status,
+	      const gss_ctx_id_t context_handle,
+	      const gss_buffer_t input_message_buffer,
+	      gss_buffer_t output_message_buffer,
+	      int *conf_state, gss_qop_t * qop_state)
 {
   _gss_mech_api_t mech;
 
@@ -227,7 +303,7 @@ gss_wrap (OM_uint32 * minor_status,
       return GSS_S_NO_CONTEXT;
     }
 
-  mech = _gss_find_mech (context_handle->mech);
+  mech = _gss_ctx_mech (context_handle);
   if (mech == NULL)
     {
       if (minor_status)
@@ -235,8 +311,8 @@ gss_wrap (OM_uint32 * minor_status,
       return GSS_S_BAD_MECH;
     }
 
-  return mech->wrap (minor_status, context_handle, conf_req_flag, qop_req,
-		     input_message_buffer, conf_state, output_message_buffer);
+  return mech->unwrap (minor_status, context_handle, input_message_buffer,
+		       output_message_buffer, conf_state, qop_state);
 }
 
 /**
@@ -298,6 +374,81 @@ gss_unwrap (OM_uint32 * minor_status,
 	    const gss_buffer_t input_message_buffer,
 	    gss_buffer_t output_message_buffer,
 	    int *conf_state, gss_qop_t * qop_state)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_unwrap1 (minor_status, context_handle, input_message_buffer,
+			   output_message_buffer, conf_state, qop_state);
+
+  return _gss_stats_end (_GSS_STATS_UNWRAP, start, maj_stat);
+}
+
+/* Return the first buffer of the given type in IOV, or NULL. */
+gss_iov_buffer_t
+_gss_iov_find (gss_iov_buffer_desc * iov, int iov_count, OM_uint32 type)
+{
+  int i;
+
+  for (i = 0; i < iov_count; i++)
+    if (GSS_IOV_BUFFER_TYPE (iov[i].type) == type)
+      return &iov[i];
+
+  return NULL;
+}
+
+/* Return the total length of the DATA buffers in IOV. */
+size_t
+_gss_iov_data_length (const gss_iov_buffer_desc * iov, int iov_count)
+{
+  size_t len = 0;
+  int i;
+
+  for (i = 0; i < iov_count; i++)
+    if (GSS_IOV_BUFFER_TYPE (iov[i].type) == GSS_IOV_BUFFER_TYPE_DATA)
+      len += iov[i].buffer.length;
+
+  return len;
+}
+
+/* Make BUF hold LEN octets.  If the caller asked for it, the storage
+   is allocated here, otherwise the caller supplied buffer must be
+   large enough. */
+OM_uint32
+_gss_iov_reserve (OM_uint32 * minor_status, gss_iov_buffer_t buf, size_t len)
+{
+  if (buf->type & GSS_IOV_BUFFER_FLAG_ALLOCATE)
+    {
+      if (buf->type & GSS_IOV_BUFFER_FLAG_ALLOCATED)
+	free (buf->buffer.value);
+      buf->buffer.value = malloc (len > 0 ? len : 1);
+      if (!buf->buffer.value)
+	{
+	  buf->type &= ~GSS_IOV_BUFFER_FLAG_ALLOCATED;
+	  if (minor_status)
+	    *minor_status = ENOMEM;
+	  return GSS_S_FAILURE;
+	}
+      buf->type |= GSS_IOV_BUFFER_FLAG_ALLOCATED;
+    }
+  else if (buf->buffer.length < len)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_FAILURE;
+    }
+
+  buf->buffer.length = len;
+
+  return GSS_S_COMPLETE;
+}
+
+static OM_uint32
+_gss_wrap_iov1 (OM_uint32 * minor_status,
+		gss_ctx_id_t context_handle,
+		int conf_req_flag,
+		gss_qop_t qop_req,
+		int *conf_state, gss_iov_buffer_desc * iov, int iov_count)
 {
   _gss_mech_api_t mech;
 
@@ -308,7 +459,7 @@ gss_unwrap (OM_uint32 * minor_status,
       return GSS_S_NO_CONTEXT;
     }
 
-  mech = _gss_find_mech (context_handle->mech);
+  mech = _gss_ctx_mech (context_handle);
   if (mech == NULL)
     {
       if (minor_status)
@@ -316,6 +467,611 @@ gss_unwrap (OM_uint32 * minor_status,
       return GSS_S_BAD_MECH;
     }
 
-  return mech->unwrap (minor_status, context_handle, input_message_buffer,
-		       output_message_buffer, conf_state, qop_state);
+  if (mech->wrap_iov == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_UNAVAILABLE;
+    }
+
+  return mech->wrap_iov (minor_status, context_handle, conf_req_flag,
+			 qop_req, conf_state, iov, iov_count);
+}
+
+/**
+ * gss_wrap_iov:
+ * @minor_status: (Integer, modify) Mechanism specific status code.
+ * @context_handle: (gss_ctx_id_t, read) Identifies the context on
+ *   which the message will be sent.
+ * @conf_req_flag: (boolean, read) Non-zero - Both confidentiality and
+ *   integrity services are requested. Zero - Only integrity service is
+ *   requested.
+ * @qop_req: (gss_qop_t, read, optional) Specifies required quality of
+ *   protection.  A mechanism-specific default may be requested by
+ *   setting qop_req to GSS_C_QOP_DEFAULT.
+ * @conf_state: (boolean, modify, optional) Non-zero -
+ *   Confidentiality, data origin authentication and integrity
+ *   services have been applied. Zero - Integrity and data origin
+ *   services only has been applied.  Specify NULL if not required.
+ * @iov: (gss_iov_buffer_desc array, modify) Buffers making up the
+ *   message and the token.
+ * @iov_count: (Integer, read) Number of elements in @iov.
+ *
+ * Like gss_wrap(), but the message is protected in place in the
+ * caller's buffers.  The DATA buffers hold the message and are
+ * overwritten by its protected form.  The HEADER buffer, and the
+ * TRAILER and PADDING buffers if the mechanism needs them, receive
+ * the rest of the token.  Concatenating HEADER, DATA, PADDING and
+ * TRAILER, in that order, gives the token gss_wrap() would have
+ * produced, so the result can be handed to writev() directly.
+ *
+ * The HEADER, TRAILER and PADDING buffers must be large enough, see
+ * gss_wrap_iov_length(), or have the GSS_IOV_BUFFER_FLAG_ALLOCATE
+ * flag set, in which case they are allocated here and must be
+ * released with gss_release_iov_buffer().
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * `GSS_S_CONTEXT_EXPIRED`: The context has already expired.
+ *
+ * `GSS_S_NO_CONTEXT`: The context_handle parameter did not identify a
+ *  valid context.
+ *
+ * `GSS_S_BAD_QOP`: The specified QOP is not supported by the
+ * mechanism.
+ *
+ * `GSS_S_UNAVAILABLE`: The mechanism does not support this
+ * operation, or the requested buffer layout.
+ *
+ * `GSS_S_FAILURE`: A buffer was too small or missing.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_wrap_iov (OM_uint32 * minor_status,
+	      gss_ctx_id_t context_handle,
+	      int conf_req_flag,
+	      gss_qop_t qop_req,
+	      int *conf_state, gss_iov_buffer_desc * iov, int iov_count)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_wrap_iov1 (minor_status, context_handle, conf_req_flag,
+			     qop_req, conf_state, iov, iov_count);
+
+  return _gss_stats_end (_GSS_STATS_WRAP_IOV, start, maj_stat);
+}
+
+static OM_uint32
+_gss_unwrap_iov1 (OM_uint32 * minor_status, gss_ctx_id_t context_handle,
+		  int *conf_state, gss_qop_t * qop_state,
+		  gss_iov_buffer_desc * iov, int iov_count)
+{
+  _gss_mech_api_t mech;
+
+  if (!context_handle)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_NO_CONTEXT;
+    }
+
+  mech = _gss_ctx_mech (context_handle);
+  if (mech == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
+    }
+
+  if (mech->unwrap_iov == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_UNAVAILABLE;
+    }
+
+  return mech->unwrap_iov (minor_status, context_handle, conf_state,
+			   qop_state, iov, iov_count);
+}
+
+/**
+ * gss_unwrap_iov:
+ * @minor_status: (Integer, modify) Mechanism specific status code.
+ * @context_handle: (gss_ctx_id_t, read) Identifies the context on
+ *   which the message arrived.
+ * @conf_state: (boolean, modify, optional) Non-zero - Confidentiality
+ *   and integrity protection were used. Zero - Integrity service only
+ *   was used.  Specify NULL if not required.
+ * @qop_state: (gss_qop_t, modify, optional) Quality of protection
+ *   provided.  Specify NULL if not required.
+ * @iov: (gss_iov_buffer_desc array, modify) Buffers making up the
+ *   token and the message.
+ * @iov_count: (Integer, read) Number of elements in @iov.
+ *
+ * Like gss_unwrap(), but the token is unprotected in place in the
+ * caller's buffers.  Either the token is split over HEADER, DATA and
+ * optional PADDING and TRAILER buffers as laid out by gss_wrap_iov(),
+ * in which case the DATA buffers are overwritten with the message, or
+ * the whole token is in a STREAM buffer, in which case the single
+ * DATA buffer is set to point to the message inside the STREAM
+ * buffer, or to allocated storage if it has the
+ * GSS_IOV_BUFFER_FLAG_ALLOCATE flag set.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * `GSS_S_DEFECTIVE_TOKEN`: The token failed consistency checks.
+ *
+ * `GSS_S_BAD_SIG`: The MIC was incorrect.
+ *
+ * `GSS_S_CONTEXT_EXPIRED`: The context has already expired.
+ *
+ * `GSS_S_NO_CONTEXT`: The context_handle parameter did not identify a
+ * valid context.
+ *
+ * `GSS_S_UNAVAILABLE`: The mechanism does not support this
+ * operation, or the requested buffer layout.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_unwrap_iov (OM_uint32 * minor_status,
+		gss_ctx_id_t context_handle,
+		int *conf_state,
+		gss_qop_t * qop_state, gss_iov_buffer_desc * iov, int iov_count)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_unwrap_iov1 (minor_status, context_handle, conf_state,
+			       qop_state, iov, iov_count);
+
+  return _gss_stats_end (_GSS_STATS_UNWRAP_IOV, start, maj_stat);
+}
+
+static OM_uint32
+_gss_wrap_iov_length1 (OM_uint32 * minor_status, gss_ctx_id_t context_handle,
+		       int conf_req_flag, gss_qop_t qop_req, int *conf_state,
+		       gss_iov_buffer_desc * iov, int iov_count)
+{
+  _gss_mech_api_t mech;
+
+  if (!context_handle)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_NO_CONTEXT;
+    }
+
+  mech = _gss_ctx_mech (context_handle);
+  if (mech == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
+    }
+
+  if (mech->wrap_iov_length == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_UNAVAILABLE;
+    }
+
+  return mech->wrap_iov_length (minor_status, context_handle,
+				conf_req_flag, qop_req, conf_state,
+				iov, iov_count);
+}
+
+/**
+ * gss_wrap_iov_length:
+ * @minor_status: (Integer, modify) Mechanism specific status code.
+ * @context_handle: (gss_ctx_id_t, read) Identifies the context on
+ *   which the message will be sent.
+ * @conf_req_flag: (boolean, read) Whether confidentiality will be
+ *   requested from gss_wrap_iov().
+ * @qop_req: (gss_qop_t, read, optional) Quality of protection that
+ *   will be requested from gss_wrap_iov().
+ * @conf_state: (boolean, modify, optional) Whether gss_wrap_iov()
+ *   would apply confidentiality.  Specify NULL if not required.
+ * @iov: (gss_iov_buffer_desc array, modify) Buffers as they will be
+ *   passed to gss_wrap_iov().
+ * @iov_count: (Integer, read) Number of elements in @iov.
+ *
+ * Set the length of the HEADER, TRAILER and PADDING buffers in @iov
+ * to what gss_wrap_iov() needs for the DATA buffers in @iov.  No
+ * storage is allocated and the buffer values are left alone.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * `GSS_S_NO_CONTEXT`: The context_handle parameter did not identify a
+ * valid context.
+ *
+ * `GSS_S_UNAVAILABLE`: The mechanism does not support this
+ * operation, or the requested buffer layout.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_wrap_iov_length (OM_uint32 * minor_status,
+		     gss_ctx_id_t context_handle,
+		     int conf_req_flag,
+		     gss_qop_t qop_req,
+		     int *conf_state, gss_iov_buffer_desc * iov, int iov_count)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_wrap_iov_length1 (minor_status, context_handle,
+				    conf_req_flag, qop_req, conf_state, iov,
+				    iov_count);
+
+  return _gss_stats_end (_GSS_STATS_WRAP_IOV_LENGTH, start, maj_stat);
+}
+
+static OM_uint32
+_gss_release_iov_buffer1 (OM_uint32 * minor_status,
+			  gss_iov_buffer_desc * iov, int iov_count)
+{
+  int i;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  if (iov == GSS_C_NO_IOV_BUFFER)
+    return GSS_S_COMPLETE;
+
+  for (i = 0; i < iov_count; i++)
+    if (iov[i].type & GSS_IOV_BUFFER_FLAG_ALLOCATED)
+      {
+	free (iov[i].buffer.value);
+	iov[i].buffer.value = NULL;
+	iov[i].buffer.length = 0;
+	iov[i].type &= ~GSS_IOV_BUFFER_FLAG_ALLOCATED;
+      }
+
+  return GSS_S_COMPLETE;
+}
+
+/**
+ * gss_release_iov_buffer:
+ * @minor_status: (Integer, modify) Mechanism specific status code.
+ * @iov: (gss_iov_buffer_desc array, modify) Buffers to release.
+ * @iov_count: (Integer, read) Number of elements in @iov.
+ *
+ * Free the storage of the buffers in @iov that were allocated by
+ * gss_wrap_iov() or gss_unwrap_iov(), that is, those with the
+ * GSS_IOV_BUFFER_FLAG_ALLOCATED flag set.  Other buffers are not
+ * touched.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_release_iov_buffer (OM_uint32 * minor_status,
+			gss_iov_buffer_desc * iov, int iov_count)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_release_iov_buffer1 (minor_status, iov, iov_count);
+
+  return _gss_stats_end (_GSS_STATS_RELEASE_IOV_BUFFER, start, maj_stat);
+}
+
+static OM_uint32
+_gss_wrap_into1 (OM_uint32 * minor_status,
+		 const gss_ctx_id_t context_handle,
+		 int conf_req_flag,
+		 gss_qop_t qop_req,
+		 const gss_buffer_t input_message_buffer,
+		 int *conf_state, gss_buffer_t output_message_buffer)
+{
+  _gss_mech_api_t mech;
+
+  if (!context_handle)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_NO_CONTEXT;
+    }
+
+  mech = _gss_ctx_mech (context_handle);
+  if (mech == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
+    }
+
+  if (mech->wrap_into == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_UNAVAILABLE;
+    }
+
+  return mech->wrap_into (minor_status, context_handle, conf_req_flag,
+			  qop_req, input_message_buffer, conf_state,
+			  output_message_buffer);
+}
+
+/**
+ * gss_wrap_into:
+ * @minor_status: (Integer, modify) Mechanism specific status code.
+ * @context_handle: (gss_ctx_id_t, read) Identifies the context on
+ *   which the message will be sent.
+ * @conf_req_flag: (boolean, read) Non-zero - Both confidentiality and
+ *   integrity services are requested. Zero - Only integrity service is
+ *   requested.
+ * @qop_req: (gss_qop_t, read, optional) Specifies required quality of
+ *   protection.  A mechanism-specific default may be requested by
+ *   setting qop_req to GSS_C_QOP_DEFAULT.
+ * @input_message_buffer: (buffer, opaque, read) Message to be
+ *   protected.
+ * @conf_state: (boolean, modify, optional) Non-zero -
+ *   Confidentiality, data origin authentication and integrity
+ *   services have been applied. Zero - Integrity and data origin
+ *   services only has been applied.  Specify NULL if not required.
+ * @output_message_buffer: (buffer, opaque, modify) Caller storage for
+ *   the protected message, and its size.
+ *
+ * Like gss_wrap(), but the token is written to the storage that
+ * @output_message_buffer points to, whose length field holds the
+ * size of that storage on input and the length of the token on
+ * output.  No storage is allocated for the token, and it must not be
+ * released with gss_release_buffer().
+ *
+ * If the storage is too small, `GSS_S_FAILURE` is returned with
+ * @minor_status set to ERANGE, and the length field is set to the
+ * size needed.  The storage needed for a message of a given size
+ * does not change over the life of the context, so it can be
+ * computed once and reused.
+ *
+ * WARNING: This function is a GNU GSS specific extension, and is not
+ * part of the official GSS API.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * `GSS_S_CONTEXT_EXPIRED`: The context has already expired.
+ *
+ * `GSS_S_NO_CONTEXT`: The context_handle parameter did not identify a
+ *  valid context.
+ *
+ * `GSS_S_BAD_QOP`: The specified QOP is not supported by the
+ * mechanism.
+ *
+ * `GSS_S_UNAVAILABLE`: The mechanism does not support this
+ * operation.
+ *
+ * `GSS_S_FAILURE`: The storage is too small, or another failure.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_wrap_into (OM_uint32 * minor_status,
+	       const gss_ctx_id_t context_handle,
+	       int conf_req_flag,
+	       gss_qop_t qop_req,
+	       const gss_buffer_t input_message_buffer,
+	       int *conf_state, gss_buffer_t output_message_buffer)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_wrap_into1 (minor_status, context_handle, conf_req_flag,
+			      qop_req, input_message_buffer, conf_state,
+			      output_message_buffer);
+
+  return _gss_stats_end (_GSS_STATS_WRAP_INTO, start, maj_stat);
+}
+
+static OM_uint32
+_gss_unwrap_into1 (OM_uint32 * minor_status,
+		   const gss_ctx_id_t context_handle,
+		   const gss_buffer_t input_message_buffer,
+		   gss_buffer_t output_message_buffer,
+		   int *conf_state, gss_qop_t * qop_state)
+{
+  _gss_mech_api_t mech;
+
+  if (!context_handle)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_NO_CONTEXT;
+    }
+
+  mech = _gss_ctx_mech (context_handle);
+  if (mech == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
+    }
+
+  if (mech->unwrap_into == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_UNAVAILABLE;
+    }
+
+  return mech->unwrap_into (minor_status, context_handle,
+			    input_message_buffer, output_message_buffer,
+			    conf_state, qop_state);
+}
+
+/**
+ * gss_unwrap_into:
+ * @minor_status: (Integer, modify) Mechanism specific status code.
+ * @context_handle: (gss_ctx_id_t, read) Identifies the context on
+ *   which the message arrived.
+ * @input_message_buffer: (buffer, opaque, read) Protected message.
+ * @output_message_buffer: (buffer, opaque, modify) Caller storage for
+ *   the unwrapped message, and its size.
+ * @conf_state: (boolean, modify, optional) Non-zero - Confidentiality
+ *   and integrity protection were used. Zero - Integrity service only
+ *   was used.  Specify NULL if not required.
+ * @qop_state: (gss_qop_t, modify, optional) Quality of protection
+ *   provided.  Specify NULL if not required.
+ *
+ * Like gss_unwrap(), but the message is written to the storage that
+ * @output_message_buffer points to, whose length field holds the
+ * size of that storage on input and the length of the message on
+ * output.  The message may be recovered in place, so the storage
+ * must not overlap the token, and the mechanism may need more room
+ * than the message itself; storage as large as the token always
+ * suffices for the Kerberos V5 mechanism.
+ *
+ * If the storage is too small, `GSS_S_FAILURE` is returned with
+ * @minor_status set to ERANGE, and the length field is set to the
+ * size needed.
+ *
+ * WARNING: This function is a GNU GSS specific extension, and is not
+ * part of the official GSS API.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * `GSS_S_DEFECTIVE_TOKEN`: The token failed consistency checks.
+ *
+ * `GSS_S_BAD_SIG`: The MIC was incorrect.
+ *
+ * `GSS_S_CONTEXT_EXPIRED`: The context has already expired.
+ *
+ * `GSS_S_NO_CONTEXT`: The context_handle parameter did not identify a
+ *  valid context.
+ *
+ * `GSS_S_UNAVAILABLE`: The mechanism does not support this
+ * operation.
+ *
+ * `GSS_S_FAILURE`: The storage is too small, or another failure.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_unwrap_into (OM_uint32 * minor_status,
+		 const gss_ctx_id_t context_handle,
+		 const gss_buffer_t input_message_buffer,
+		 gss_buffer_t output_message_buffer,
+		 int *conf_state, gss_qop_t * qop_state)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_unwrap_into1 (minor_status, context_handle,
+				input_message_buffer, output_message_buffer,
+				conf_state, qop_state);
+
+  return _gss_stats_end (_GSS_STATS_UNWRAP_INTO, start, maj_stat);
+}
+
+static OM_uint32
+_gss_get_mic_into1 (OM_uint32 * minor_status,
+		    const gss_ctx_id_t context_handle,
+		    gss_qop_t qop_req,
+		    const gss_buffer_t message_buffer,
+		    gss_buffer_t message_token)
+{
+  _gss_mech_api_t mech;
+
+  if (!context_handle)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_NO_CONTEXT;
+    }
+
+  mech = _gss_ctx_mech (context_handle);
+  if (mech == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
+    }
+
+  if (mech->get_mic_into == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_UNAVAILABLE;
+    }
+
+  return mech->get_mic_into (minor_status, context_handle, qop_req,
+			     message_buffer, message_token);
+}
+
+/**
+ * gss_get_mic_into:
+ * @minor_status: (Integer, modify) Mechanism specific status code.
+ * @context_handle: (gss_ctx_id_t, read) Identifies the context on
+ *   which the message will be sent.
+ * @qop_req: (gss_qop_t, read, optional) Specifies requested quality
+ *   of protection.  Callers are encouraged, on portability grounds,
+ *   to accept the default quality of protection offered by the
+ *   chosen mechanism, which may be requested by specifying
+ *   GSS_C_QOP_DEFAULT for this parameter.
+ * @message_buffer: (buffer, opaque, read) Message to be protected.
+ * @message_token: (buffer, opaque, modify) Caller storage for the
+ *   token, and its size.
+ *
+ * Like gss_get_mic(), but the token is written to the storage that
+ * @message_token points to, whose length field holds the size of
+ * that storage on input and the length of the token on output.
+ *
+ * If the storage is too small, `GSS_S_FAILURE` is returned with
+ * @minor_status set to ERANGE, and the length field is set to the
+ * size needed.  MIC tokens have the same size for all messages on a
+ * context.
+ *
+ * WARNING: This function is a GNU GSS specific extension, and is not
+ * part of the official GSS API.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * `GSS_S_CONTEXT_EXPIRED`: The context has already expired.
+ *
+ * `GSS_S_NO_CONTEXT`: The context_handle parameter did not identify a
+ *  valid context.
+ *
+ * `GSS_S_BAD_QOP`: The specified QOP is not supported by the
+ * mechanism.
+ *
+ * `GSS_S_UNAVAILABLE`: The mechanism does not support this
+ * operation.
+ *
+ * `GSS_S_FAILURE`: The storage is too small, or another failure.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_get_mic_into (OM_uint32 * minor_status,
+		  const gss_ctx_id_t context_handle,
+		  gss_qop_t qop_req,
+		  const gss_buffer_t message_buffer,
+		  gss_buffer_t message_token)
+{
+  uint64_t start = _gss_stats_start ();
+  OM_uint32 maj_stat;
+
+  maj_stat = _gss_get_mic_into1 (minor_status, context_handle, qop_req,
+				 message_buffer, message_token);
+
+  return _gss_stats_end (_GSS_STATS_GET_MIC_INTO, start, maj_stat);
 }
@@ -25,6 +25,212 @@
 /* _gss_find_mech */
 #include "meta.h"
 
+#ifdef USE_KERBEROS5
+/* GSS_KRB5_NT_PRINCIPAL_NAME_static etc */
+# include <gss/krb5-ext.h>
+#endif
+
+/* Names are immutable, so gss_duplicate_name hands out another
+   reference to the same name.  Names of the types below, which are
+   the ones the library itself knows about, are moreover interned:
+   there is at most one name with a given type and value, so
+   gss_compare_name on two of them only needs to compare the
+   pointers.  Names of other types keep the OID the application
+   passed, which may not outlive the name's first handle, and are not
+   shared between gss_import_name calls. */
+
+static gss_OID_desc *const name_types[] = {
+  &GSS_C_NT_USER_NAME_static,
+  &GSS_C_NT_MACHINE_UID_NAME_static,
+  &GSS_C_NT_STRING_UID_NAME_static,
+  &GSS_C_NT_HOSTBASED_SERVICE_X_static,
+  &GSS_C_NT_HOSTBASED_SERVICE_static,
+  &GSS_C_NT_ANONYMOUS_static,
+  &GSS_C_NT_EXPORT_NAME_static,
+#ifdef USE_KERBEROS5
+  &GSS_KRB5_NT_USER_NAME_static,
+  &GSS_KRB5_NT_PRINCIPAL_NAME_static,
+  &GSS_KRB5_NT_MACHINE_UID_NAME_static,
+  &GSS_KRB5_NT_STRING_UID_NAME_static,
+#endif
+};
+
+#define NAME_TYPES (sizeof (name_types) / sizeof (name_types[0]))
+#define NAME_MIN_BUCKETS 64
+
+_GSS_LOCK_DEFINE (name_lock);
+/* Serializes making the sets for gss_inquire_names_for_mech. */
+_GSS_LOCK_DEFINE (name_type_lock);
+static gss_name_t *name_table;
+static size_t name_buckets;
+static size_t name_count;
+
+/* Return the index of TYPE in name_types, or NAME_TYPES if it is not
+   one of them. */
+static size_t
+name_type_index (const gss_OID type)
+{
+  size_t i;
+
+  for (i = 0; i < NAME_TYPES; i++)
+    if (type == name_types[i])
+      return i;
+  for (i = 0; i < NAME_TYPES; i++)
+    if (gss_oid_equal (type, name_types[i]))
+      return i;
+
+  return NAME_TYPES;
+}
+
+static gss_name_t
+name_alloc (const char *value, size_t length, gss_OID type)
+{
+  gss_name_t name;
+
+  name = malloc (sizeof (*name) + length + 1);
+  if (!name)
+    return NULL;
+
+  name->value = (char *) (name + 1);
+  if (length > 0)
+    memcpy (name->value, value, length);
+  name->value[length] = '\0';
+  name->length = length;
+  name->type = type;
+  name->refcount = 1;
+  name->interned = 0;
+  name->hash = 0;
+  name->next = NULL;
+
+  return name;
+}
+
+/* Double the number of buckets in the intern table, when it is empty
+   or getting crowded.  Called with name_lock held.  Failure leaves
+   the table as it is. */
+static void
+name_grow (void)
+{
+  size_t n = name_buckets ? name_buckets * 2 : NAME_MIN_BUCKETS;
+  gss_name_t *table, name, next;
+  size_t i;
+
+  table = calloc (n, sizeof (*table));
+  if (!table)
+    return;
+
+  for (i = 0; i < name_buckets; i++)
+    for (name = name_table[i]; name; name = next)
+      {
+	next = name->next;
+	name->next = table[name->hash % n];
+	table[name->hash % n] = name;
+      }
+
+  free (name_table);
+  name_table = table;
+  name_buckets = n;
+}
+
+/* Return the interned name with type name_types[INDEX] and the given
+   value, with a new reference, creating it if needed. */
+static gss_name_t
+name_intern (const char *value, size_t length, size_t index)
+{
+  uint64_t hash;
+  gss_name_t name;
+
+  hash = _gss_rcache_hash (_GSS_RCACHE_HASH_INIT, value, length) ^ index;
+
+  _gss_lock (name_lock);
+
+  if (name_count >= name_buckets)
+    name_grow ();
+
+  name = NULL;
+  if (name_buckets > 0)
+    for (name = name_table[hash % name_buckets]; name; name = name->next)
+      if (name->hash == hash && name->type == name_types[index]
+	  && name->length == length
+	  && memcmp (name->value, value, length) == 0)
+	break;
+
+  if (name)
+    /* Not zero, since the last reference is dropped under the lock. */
+    _gss_add_fetch (&name->refcount, 1);
+  else if (name_buckets > 0
+	   && (name = name_alloc (value, length, name_types[index])))
+    {
+      name->interned = 1;
+      name->hash = hash;
+      name->next = name_table[hash % name_buckets];
+      name_table[hash % name_buckets] = name;
+      name_count++;
+    }
+
+  _gss_unlock (name_lock);
+
+  return name;
+}
+
+/* Drop a reference to NAME, freeing it after the last one. */
+static void
+name_unref (gss_name_t name)
+{
+  unsigned long n;
+  gss_name_t *p;
+
+  if (!name->interned)
+    {
+      if (_gss_add_fetch (&name->refcount, -1) == 0)
+	free (name);
+      return;
+    }
+
+  /* Only the last reference needs the lock, so that name_intern
+     cannot find the name while it is being freed. */
+  while ((n = _gss_load (&name->refcount)) > 1)
+    if (_gss_cas (&name->refcount, n, n - 1))
+      return;
+
+  _gss_lock (name_lock);
+  if (_gss_add_fetch (&name->refcount, -1) == 0)
+    {
+      for (p = &name_table[name->hash % name_buckets]; *p != name;
+	   p = &(*p)->next)
+	;
+      *p = name->next;
+      name_count--;
+      free (name);
+    }
+  _gss_unlock (name_lock);
+}
+
+/* Store in *OUTPUT_NAME a name with the LENGTH bytes at VALUE and
+   name type TYPE.  All names are created through this function. */
+OM_uint32
+_gss_name_new (OM_uint32 * minor_status, const char *value, size_t length,
+	       const gss_OID type, gss_name_t * output_name)
+{
+  size_t index = name_type_index (type);
+
+  if (index < NAME_TYPES)
+    *output_name = name_intern (value, length, index);
+  else
+    *output_name = name_alloc (value, length, type);
+
+  if (!*output_name)
+    {
+      if (minor_status)
+	*minor_status = ENOMEM;
+      return GSS_S_FAILURE;
+    }
+
+  if (minor_status)
+    *minor_status = 0;
+  return GSS_S_COMPLETE;
+}
+
 /**
  * gss_import_name:
  * @minor_status: (Integer, modify) Mechanism specific status code.
@@ -71,30 +277,9 @@ gss_import_name (OM_uint32 * minor_status,
       return GSS_S_BAD_NAME | GSS_S_CALL_INACCESSIBLE_WRITE;
     }
 
-  *output_name = malloc (sizeof (**output_name));
-  if (!*output_name)
-    {
-      if (minor_status)
-	*minor_status = ENOMEM;
-      return GSS_S_FAILURE;
-    }
-  (*output_name)->length = input_name_buffer->length;
-  (*output_name)->value = malloc (input_name_buffer->length);
-  if (!(*output_name)->value)
-    {
-      free (*output_name);
-      if (minor_status)
-	*minor_status = ENOMEM;
-      return GSS_S_FAILURE;
-    }
-  memcpy ((*output_name)->value,
-	  input_name_buffer->value, input_name_buffer->length);
-
-  (*output_name)->type = input_name_type;
-
-  if (minor_status)
-    *minor_status = 0;
-  return GSS_S_COMPLETE;
+  return _gss_name_new (minor_status, input_name_buffer->value,
+			input_name_buffer->length, input_name_type,
+			output_name);
 }
 
 /**
@@ -197,12 +382,24 @@ gss_compare_name (OM_uint32 * minor_status,
   if (!name1 || !name2)
     return GSS_S_BAD_NAME | GSS_S_CALL_INACCESSIBLE_READ;
 
-  if (!gss_oid_equal (name1->type, name2->type))
+  if (name1 == name2)
+    {
+      if (name_equal)
+	*name_equal = 1;
+      return GSS_S_COMPLETE;
+    }
+
+  if (name1->type != name2->type && !gss_oid_equal (name1->type, name2->type))
     return GSS_S_BAD_NAMETYPE;
 
   if (name_equal)
-    *name_equal = (name1->length == name2->length) &&
-      memcmp (name1->value, name2->value, name1->length) == 0;
+    {
+      if (name1->interned && name2->interned)
+	*name_equal = 0;
+      else
+	*name_equal = (name1->length == name2->length) &&
+	  memcmp (name1->value, name2->value, name1->length) == 0;
+    }
 
   return GSS_S_COMPLETE;
 }
@@ -233,10 +430,7 @@ gss_release_name (OM_uint32 * minor_status, gss_name_t * name)
 
   if (*name != GSS_C_NO_NAME)
     {
-      if ((*name)->value)
-	free ((*name)->value);
-
-      free (*name);
+      name_unref (*name);
       *name = GSS_C_NO_NAME;
     }
 
@@ -252,36 +446,58 @@ gss_release_name (OM_uint32 * minor_status, gss_name_t * name)
  *   the application after use with a call to gss_release_oid_set().
  *
  * Returns the set of nametypes supported by the specified mechanism.
+ * The returned set is shared between callers, like the one from
+ * gss_indicate_mechs().
  *
  * Return value:
  *
  * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * `GSS_S_BAD_MECH`: The requested mechanism is not available.
  **/
 OM_uint32
 gss_inquire_names_for_mech (OM_uint32 * minor_status,
 			    const gss_OID mechanism, gss_OID_set * name_types)
 {
-  OM_uint32 maj_stat;
+  OM_uint32 maj_stat = GSS_S_COMPLETE;
   _gss_mech_api_t mech;
+  gss_OID_set set;
   int i;
 
   mech = _gss_find_mech (mechanism);
+  if (mech == NULL)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_BAD_MECH;
+    }
 
-  maj_stat = gss_create_empty_oid_set (minor_status, name_types);
-  if (maj_stat != GSS_S_COMPLETE)
-    return maj_stat;
-
-  for (i = 0; mech->name_types[i]; i++)
+  set = _gss_load (&mech->name_type_set);
+  if (!set)
     {
-      maj_stat = gss_add_oid_set_member (minor_status, mech->name_types[i],
-					 name_types);
-      if (maj_stat != GSS_S_COMPLETE)
+      _gss_lock (name_type_lock);
+      set = mech->name_type_set;
+      if (!set)
 	{
-	  gss_release_oid_set (minor_status, name_types);
-	  return maj_stat;
+	  maj_stat = gss_create_empty_oid_set (minor_status, &set);
+	  for (i = 0; !GSS_ERROR (maj_stat) && mech->name_types[i]; i++)
+	    maj_stat = gss_add_oid_set_member (minor_status,
+					       mech->name_types[i], &set);
+	  if (GSS_ERROR (maj_stat))
+	    gss_release_oid_set (NULL, &set);
+	  else
+	    {
+	      _gss_oid_set_share (set);
+	      _gss_store (&mech->name_type_set, set);
+	    }
 	}
+      _gss_unlock (name_type_lock);
+      if (GSS_ERROR (maj_stat))
+	return maj_stat;
     }
 
+  *name_types = set;
+
   if (minor_status)
     *minor_status = 0;
   return GSS_S_COMPLETE;
@@ -302,11 +518,8 @@ _gss_inquire_mechs_for_name3 (OM_uint32 * minor_status,
   if (GSS_ERROR (maj_stat))
     return maj_stat;
 
-  maj_stat = gss_test_oid_set_member (minor_status, name_type,
-				      oids, &supported);
+  supported = _gss_oid_set_member (oids, name_type);
   gss_release_oid_set (minor_status, &oids);
-  if (GSS_ERROR (maj_stat))
-    return maj_stat;
 
   if (supported)
     {
@@ -579,25 +792,9 @@ gss_duplicate_name (OM_uint32 * minor_status,
       return GSS_S_FAILURE | GSS_S_CALL_INACCESSIBLE_WRITE;
     }
 
-  *dest_name = malloc (sizeof (**dest_name));
-  if (!*dest_name)
-    {
-      if (minor_status)
-	*minor_status = ENOMEM;
-      return GSS_S_FAILURE;
-    }
-  (*dest_name)->type = src_name->type;
-  (*dest_name)->length = src_name->length;
-  (*dest_name)->value = malloc (src_name->length + 1);
-  if (!(*dest_name)->value)
-    {
-      free (*dest_name);
-      if (minor_status)
-	*minor_status = ENOMEM;
-      return GSS_S_FAILURE;
-    }
-  memcpy ((*dest_name)->value, src_name->value, src_name->length);
-  (*dest_name)->value[src_name->length] = '\0';
+  /* The caller holds a reference, so the name cannot go away. */
+  _gss_add_fetch (&src_name->refcount, 1);
+  *dest_name = src_name;
 
   if (minor_status)
     *minor_status = 0;
@@ -0,0 +1,817 @@
+/* plugin.c --- Mechanisms loaded from shared objects on first use.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "internal.h"
+
+/* _gss_mech_api_desc */
+#include "meta.h"
+
+/* gss_mech_plugin_desc */
+#include <gss/plugin.h>
+
+#ifdef HAVE_DLOPEN
+# include <dlfcn.h>
+#endif
+
+/* The mechanism configuration file lists one mechanism per line: its
+   OID in dotted form, its SASL name, and the shared object
+   implementing it.  For example:
+
+     1.3.6.1.4.1.11591.4.99  GS2-EXAMPLE  /usr/lib/gss/example.so
+
+   A line "default SPEC" makes the mechanism with the dotted OID or
+   SASL name SPEC the one used when the application does not name a
+   mechanism.  Empty lines, lines starting with '#' and malformed lines
+   are ignored.  The mechanisms are registered when the file is read,
+   but the shared object is not opened until the mechanism is first
+   looked up by its OID.  It must export a gss_mech_plugin_desc named
+   by GSS_MECH_PLUGIN_SYMBOL, see gss/plugin.h. */
+
+#ifndef GSS_MECH_CONFIG
+# define GSS_MECH_CONFIG "/etc/gss/mech.conf"
+#endif
+
+#define PLUGIN_MAX_LINE 1024
+
+enum
+{
+  PLUGIN_UNLOADED,
+  PLUGIN_LOADED,
+  PLUGIN_FAILED
+};
+
+struct _gss_mech_plugin_struct
+{
+  _gss_mech_api_desc desc;
+  /* What the shared object exports, once loaded. */
+  const gss_mech_plugin_desc *table;
+  gss_OID_desc oid;
+  char oidbuf[_GSS_PLUGIN_MAX_OID];
+  char *sasl_name;
+  char *path;
+  int state;
+};
+
+_GSS_LOCK_DEFINE (plugin_lock);
+static char *plugin_config;
+static int plugin_config_set;
+static int plugin_config_read;
+
+/* Split off the next whitespace separated field of *LINE. */
+static char *
+plugin_field (char **line)
+{
+  char *start;
+
+  *line += strspn (*line, " \t\r\n");
+  if (**line == '\0')
+    return NULL;
+
+  start = *line;
+  *line += strcspn (*line, " \t\r\n");
+  if (**line != '\0')
+    *(*line)++ = '\0';
+
+  return start;
+}
+
+/* Encode the dotted OID STR in DER into OUT, which has room for
+   _GSS_PLUGIN_MAX_OID bytes.  Returns the length, or 0 if STR is not
+   a valid OID. */
+size_t
+_gss_plugin_oid (const char *str, char *out)
+{
+  unsigned char tmp[sizeof (unsigned long) * 8 / 7 + 1];
+  unsigned long arc, first = 0;
+  size_t n = 0, i, narcs;
+  char *end;
+
+  for (narcs = 0;; narcs++)
+    {
+      if (!isdigit ((unsigned char) *str))
+	return 0;
+      arc = strtoul (str, &end, 10);
+      str = end;
+
+      if (narcs == 0)
+	{
+	  if (arc > 2)
+	    return 0;
+	  first = arc;
+	}
+      else
+	{
+	  if (narcs == 1)
+	    {
+	      if (first < 2 && arc >= 40)
+		return 0;
+	      arc += first * 40;
+	    }
+
+	  i = 0;
+	  do
+	    {
+	      tmp[i++] = arc & 0x7f;
+	      arc >>= 7;
+	    }
+	  while (arc);
+	  if (n + i > _GSS_PLUGIN_MAX_OID)
+	    return 0;
+	  while (i-- > 0)
+	    out[n++] = tmp[i] | (i ? 0x80 : 0);
+	}
+
+      if (*str == '\0')
+	break;
+      if (*str++ != '.')
+	return 0;
+    }
+
+  return narcs > 0 ? n : 0;
+}
+
+static void
+plugin_free (struct _gss_mech_plugin_struct *p)
+{
+  free (p->sasl_name);
+  free (p->path);
+  free (p);
+}
+
+/* Register the mechanism on LINE through ADD, or store the default
+   mechanism it names in *DFLT. */
+static void
+plugin_line (char *line, int (*add) (_gss_mech_api_t mech), char **dflt)
+{
+  struct _gss_mech_plugin_struct *p;
+  char *oid, *sasl_name, *path;
+
+  oid = plugin_field (&line);
+  if (oid == NULL || *oid == '#')
+    return;
+  sasl_name = plugin_field (&line);
+  path = plugin_field (&line);
+
+  if (strcmp (oid, "default") == 0)
+    {
+      if (sasl_name != NULL && path == NULL)
+	{
+	  free (*dflt);
+	  *dflt = strdup (sasl_name);
+	}
+      return;
+    }
+
+  if (path == NULL || plugin_field (&line) != NULL)
+    return;
+
+#ifndef HAVE_DLOPEN
+  /* The mechanism could never be used. */
+  return;
+#endif
+
+  p = calloc (1, sizeof (*p));
+  if (!p)
+    return;
+
+  p->oid.elements = p->oidbuf;
+  p->oid.length = _gss_plugin_oid (oid, p->oidbuf);
+  p->sasl_name = strdup (sasl_name);
+  p->path = strdup (path);
+  if (p->oid.length == 0 || !p->sasl_name || !p->path)
+    {
+      plugin_free (p);
+      return;
+    }
+
+  p->desc.mech = &p->oid;
+  p->desc.sasl_name = p->sasl_name;
+  p->desc.plugin = p;
+
+  if (add (&p->desc) != 0)
+    plugin_free (p);
+}
+
+/* Register the mechanisms from the configuration file through ADD,
+   and store the default mechanism it names, if any, in *DFLT, which
+   the caller frees.  Called once, when the mechanism registry is set
+   up. */
+void
+_gss_plugin_config (int (*add) (_gss_mech_api_t mech), char **dflt)
+{
+  char line[PLUGIN_MAX_LINE];
+  const char *file;
+  FILE *fh;
+
+  _gss_lock (plugin_lock);
+  plugin_config_read = 1;
+  file = plugin_config_set ? plugin_config : GSS_MECH_CONFIG;
+  _gss_unlock (plugin_lock);
+
+  if (file == NULL)
+    return;
+
+  fh = fopen (file, "r");
+  if (!fh)
+    return;
+
+  while (fgets (line, sizeof (line), fh))
+    plugin_line (line, add, dflt);
+
+  fclose (fh);
+}
+
+/* The functions below pass the state that a plugin keeps in the
+   handles of the generic layer.  Those the generic layer calls without
+   checking are bound even if the plugin lacks them, and then fail. */
+
+#define PLUGIN_TABLE(mech) ((mech)->plugin->table)
+
+static OM_uint32
+plugin_unavailable (OM_uint32 * minor_status)
+{
+  if (minor_status)
+    *minor_status = 0;
+  return GSS_S_UNAVAILABLE;
+}
+
+/* The state of CRED, if it belongs to MECH. */
+static void *
+plugin_cred_data (_gss_mech_api_t mech, const gss_cred_id_t cred)
+{
+  if (cred == GSS_C_NO_CREDENTIAL || _gss_cred_mech (cred) != mech)
+    return NULL;
+
+  return cred->mech_data;
+}
+
+static OM_uint32
+plugin_init_sec_context (OM_uint32 * minor_status,
+			 const gss_cred_id_t initiator_cred_handle,
+			 gss_ctx_id_t * context_handle,
+			 const gss_name_t target_name,
+			 const gss_OID mech_type,
+			 OM_uint32 req_flags,
+			 OM_uint32 time_req,
+			 const gss_channel_bindings_t input_chan_bindings,
+			 const gss_buffer_t input_token,
+			 gss_OID * actual_mech_type,
+			 gss_buffer_t output_token,
+			 OM_uint32 * ret_flags, OM_uint32 * time_rec)
+{
+  _gss_mech_api_t mech = (*context_handle)->api;
+  const gss_mech_plugin_desc *table = PLUGIN_TABLE (mech);
+
+  if (table->init_sec_context == NULL)
+    return plugin_unavailable (minor_status);
+
+  return table->init_sec_context (minor_status,
+				  plugin_cred_data (mech,
+						    initiator_cred_handle),
+				  &(*context_handle)->mech_data,
+				  target_name, mech_type, req_flags,
+				  time_req, input_chan_bindings,
+				  input_token, actual_mech_type,
+				  output_token, ret_flags, time_rec);
+}
+
+static OM_uint32
+plugin_accept_sec_context (OM_uint32 * minor_status,
+			   gss_ctx_id_t * context_handle,
+			   const gss_cred_id_t acceptor_cred_handle,
+			   const gss_buffer_t input_token_buffer,
+			   const gss_channel_bindings_t input_chan_bindings,
+			   gss_name_t * src_name,
+			   gss_OID * mech_type,
+			   gss_buffer_t output_token,
+			   OM_uint32 * ret_flags,
+			   OM_uint32 * time_rec,
+			   gss_cred_id_t * delegated_cred_handle)
+{
+  _gss_mech_api_t mech = (*context_handle)->api;
+  const gss_mech_plugin_desc *table = PLUGIN_TABLE (mech);
+
+  /* Plugins cannot delegate credentials. */
+  if (delegated_cred_handle)
+    *delegated_cred_handle = GSS_C_NO_CREDENTIAL;
+
+  if (table->accept_sec_context == NULL)
+    return plugin_unavailable (minor_status);
+
+  return table->accept_sec_context (minor_status,
+				    &(*context_handle)->mech_data,
+				    plugin_cred_data (mech,
+						      acceptor_cred_handle),
+				    input_token_buffer, input_chan_bindings,
+				    src_name, mech_type, output_token,
+				    ret_flags, time_rec);
+}
+
+static OM_uint32
+plugin_delete_sec_context (OM_uint32 * minor_status,
+			   gss_ctx_id_t * context_handle,
+			   gss_buffer_t output_token)
+{
+  gss_ctx_id_t ctx = *context_handle;
+  const gss_mech_plugin_desc *table = PLUGIN_TABLE (ctx->api);
+  OM_uint32 maj_stat = GSS_S_COMPLETE;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  if (ctx->mech_data && table->delete_sec_context)
+    maj_stat = table->delete_sec_context (minor_status, ctx->mech_data,
+					  output_token);
+  ctx->mech_data = NULL;
+
+  return maj_stat;
+}
+
+static OM_uint32
+plugin_context_time (OM_uint32 * minor_status,
+		     const gss_ctx_id_t context_handle, OM_uint32 * time_rec)
+{
+  const gss_mech_plugin_desc *table = PLUGIN_TABLE (context_handle->api);
+
+  if (table->context_time == NULL)
+    return plugin_unavailable (minor_status);
+
+  return table->context_time (minor_status, context_handle->mech_data,
+			      time_rec);
+}
+
+static OM_uint32
+plugin_wrap_size_limit (OM_uint32 * minor_status,
+			const gss_ctx_id_t context_handle,
+			int conf_req_flag,
+			gss_qop_t qop_req,
+			OM_uint32 req_output_size, OM_uint32 * max_input_size)
+{
+  return PLUGIN_TABLE (context_handle->api)->wrap_size_limit
+    (minor_status, context_handle->mech_data, conf_req_flag, qop_req,
+     req_output_size, max_input_size);
+}
+
+static OM_uint32
+plugin_export_sec_context (OM_uint32 * minor_status,
+			   gss_ctx_id_t * context_handle,
+			   gss_buffer_t interprocess_token)
+{
+  return PLUGIN_TABLE ((*context_handle)->api)->export_sec_context
+    (minor_status, (*context_handle)->mech_data, interprocess_token);
+}
+
+static OM_uint32
+plugin_import_sec_context (OM_uint32 * minor_status,
+			   const gss_buffer_t interprocess_token,
+			   gss_ctx_id_t * context_handle)
+{
+  return PLUGIN_TABLE ((*context_handle)->api)->import_sec_context
+    (minor_status, interprocess_token, &(*context_handle)->mech_data);
+}
+
+static OM_uint32
+plugin_init_sec_context_fd (OM_uint32 * minor_status,
+			    const gss_ctx_id_t context_handle, int *fd)
+{
+  return PLUGIN_TABLE (context_handle->api)->init_sec_context_fd
+    (minor_status, context_handle->mech_data, fd);
+}
+
+static OM_uint32
+plugin_get_mic (OM_uint32 * minor_status,
+		const gss_ctx_id_t context_handle,
+		gss_qop_t qop_req,
+		const gss_buffer_t message_buffer, gss_buffer_t message_token)
+{
+  const gss_mech_plugin_desc *table = PLUGIN_TABLE (context_handle->api);
+
+  if (table->get_mic == NULL)
+    return plugin_unavailable (minor_status);
+
+  return table->get_mic (minor_status, context_handle->mech_data, qop_req,
+			 message_buffer, message_token);
+}
+
+static OM_uint32
+plugin_verify_mic (OM_uint32 * minor_status,
+		   const gss_ctx_id_t context_handle,
+		   const gss_buffer_t message_buffer,
+		   const gss_buffer_t token_buffer, gss_qop_t * qop_state)
+{
+  const gss_mech_plugin_desc *table = PLUGIN_TABLE (context_handle->api);
+
+  if (table->verify_mic == NULL)
+    return plugin_unavailable (minor_status);
+
+  return table->verify_mic (minor_status, context_handle->mech_data,
+			    message_buffer, token_buffer, qop_state);
+}
+
+static OM_uint32
+plugin_wrap (OM_uint32 * minor_status,
+	     const gss_ctx_id_t context_handle,
+	     int conf_req_flag,
+	     gss_qop_t qop_req,
+	     const gss_buffer_t input_message_buffer,
+	     int *conf_state, gss_buffer_t output_message_buffer)
+{
+  const gss_mech_plugin_desc *table = PLUGIN_TABLE (context_handle->api);
+
+  if (table->wrap == NULL)
+    return plugin_unavailable (minor_status);
+
+  return table->wrap (minor_status, context_handle->mech_data,
+		      conf_req_flag, qop_req, input_message_buffer,
+		      conf_state, output_message_buffer);
+}
+
+static OM_uint32
+plugin_unwrap (OM_uint32 * minor_status,
+	       const gss_ctx_id_t context_handle,
+	       const gss_buffer_t input_message_buffer,
+	       gss_buffer_t output_message_buffer,
+	       int *conf_state, gss_qop_t * qop_state)
+{
+  const gss_mech_plugin_desc *table = PLUGIN_TABLE (context_handle->api);
+
+  if (table->unwrap == NULL)
+    return plugin_unavailable (minor_status);
+
+  return table->unwrap (minor_status, context_handle->mech_data,
+			input_message_buffer, output_message_buffer,
+			conf_state, qop_state);
+}
+
+static OM_uint32
+plugin_wrap_iov (OM_uint32 * minor_status,
+		 const gss_ctx_id_t context_handle,
+		 int conf_req_flag,
+		 gss_qop_t qop_req,
+		 int *conf_state, gss_iov_buffer_desc * iov, int iov_count)
+{
+  return PLUGIN_TABLE (context_handle->api)->wrap_iov
+    (minor_status, context_handle->mech_data, conf_req_flag, qop_req,
+     conf_state, iov, iov_count);
+}
+
+static OM_uint32
+plugin_unwrap_iov (OM_uint32 * minor_status,
+		   const gss_ctx_id_t context_handle,
+		   int *conf_state,
+		   gss_qop_t * qop_state,
+		   gss_iov_buffer_desc * iov, int iov_count)
+{
+  return PLUGIN_TABLE (context_handle->api)->unwrap_iov
+    (minor_status, context_handle->mech_data, conf_state, qop_state,
+     iov, iov_count);
+}
+
+static OM_uint32
+plugin_wrap_iov_length (OM_uint32 * minor_status,
+			const gss_ctx_id_t context_handle,
+			int conf_req_flag,
+			gss_qop_t qop_req,
+			int *conf_state,
+			gss_iov_buffer_desc * iov, int iov_count)
+{
+  return PLUGIN_TABLE (context_handle->api)->wrap_iov_length
+    (minor_status, context_handle->mech_data, conf_req_flag, qop_req,
+     conf_state, iov, iov_count);
+}
+
+static OM_uint32
+plugin_wrap_into (OM_uint32 * minor_status,
+		  const gss_ctx_id_t context_handle,
+		  int conf_req_flag,
+		  gss_qop_t qop_req,
+		  const gss_buffer_t input_message_buffer,
+		  int *conf_state, gss_buffer_t output_message_buffer)
+{
+  return PLUGIN_TABLE (context_handle->api)->wrap_into
+    (minor_status, context_handle->mech_data, conf_req_flag, qop_req,
+     input_message_buffer, conf_state, output_message_buffer);
+}
+
+static OM_uint32
+plugin_unwrap_into (OM_uint32 * minor_status,
+		    const gss_ctx_id_t context_handle,
+		    const gss_buffer_t input_message_buffer,
+		    gss_buffer_t output_message_buffer,
+		    int *conf_state, gss_qop_t * qop_state)
+{
+  return PLUGIN_TABLE (context_handle->api)->unwrap_into
+    (minor_status, context_handle->mech_data, input_message_buffer,
+     output_message_buffer, conf_state, qop_state);
+}
+
+static OM_uint32
+plugin_get_mic_into (OM_uint32 * minor_status,
+		     const gss_ctx_id_t context_handle,
+		     gss_qop_t qop_req,
+		     const gss_buffer_t message_buffer,
+		     gss_buffer_t message_token)
+{
+  return PLUGIN_TABLE (context_handle->api)->get_mic_into
+    (minor_status, context_handle->mech_data, qop_req, message_buffer,
+     message_token);
+}
+
+static OM_uint32
+plugin_acquire_cred (OM_uint32 * minor_status,
+		     const gss_name_t desired_name,
+		     OM_uint32 time_req,
+		     const gss_OID_set desired_mechs,
+		     gss_cred_usage_t cred_usage,
+		     gss_cred_id_t * output_cred_handle,
+		     gss_OID_set * actual_mechs, OM_uint32 * time_rec)
+{
+  const gss_mech_plugin_desc *table =
+    PLUGIN_TABLE ((*output_cred_handle)->api);
+
+  if (table->acquire_cred == NULL)
+    return plugin_unavailable (minor_status);
+
+  return table->acquire_cred (minor_status, desired_name, time_req,
+			      desired_mechs, cred_usage,
+			      &(*output_cred_handle)->mech_data,
+			      actual_mechs, time_rec);
+}
+
+static OM_uint32
+plugin_release_cred (OM_uint32 * minor_status, gss_cred_id_t * cred_handle)
+{
+  gss_cred_id_t cred = *cred_handle;
+  const gss_mech_plugin_desc *table = PLUGIN_TABLE (cred->api);
+  OM_uint32 maj_stat = GSS_S_COMPLETE;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  if (cred->mech_data && table->release_cred)
+    maj_stat = table->release_cred (minor_status, cred->mech_data);
+  cred->mech_data = NULL;
+
+  return maj_stat;
+}
+
+static OM_uint32
+plugin_inquire_cred (OM_uint32 * minor_status,
+		     const gss_cred_id_t cred_handle,
+		     gss_name_t * name,
+		     OM_uint32 * lifetime,
+		     gss_cred_usage_t * cred_usage, gss_OID_set * mechanisms)
+{
+  const gss_mech_plugin_desc *table = PLUGIN_TABLE (cred_handle->api);
+
+  if (table->inquire_cred == NULL)
+    return plugin_unavailable (minor_status);
+
+  return table->inquire_cred (minor_status, cred_handle->mech_data, name,
+			      lifetime, cred_usage, mechanisms);
+}
+
+static OM_uint32
+plugin_inquire_cred_by_mech (OM_uint32 * minor_status,
+			     const gss_cred_id_t cred_handle,
+			     const gss_OID mech_type,
+			     gss_name_t * name,
+			     OM_uint32 * initiator_lifetime,
+			     OM_uint32 * acceptor_lifetime,
+			     gss_cred_usage_t * cred_usage)
+{
+  /* The credential may be for another mechanism. */
+  _gss_mech_api_t mech = _gss_find_mech (mech_type);
+  const gss_mech_plugin_desc *table = PLUGIN_TABLE (mech);
+
+  if (table->inquire_cred_by_mech == NULL)
+    return plugin_unavailable (minor_status);
+
+  return table->inquire_cred_by_mech (minor_status,
+				      plugin_cred_data (mech, cred_handle),
+				      mech_type, name, initiator_lifetime,
+				      acceptor_lifetime, cred_usage);
+}
+
+/* Stand-ins for the functions without handles that a plugin lacks. */
+
+static OM_uint32
+plugin_no_canonicalize_name (OM_uint32 * minor_status,
+			     const gss_name_t input_name,
+			     const gss_OID mech_type, gss_name_t * output_name)
+{
+  return plugin_unavailable (minor_status);
+}
+
+static OM_uint32
+plugin_no_export_name (OM_uint32 * minor_status,
+		       const gss_name_t input_name,
+		       gss_buffer_t exported_name)
+{
+  return plugin_unavailable (minor_status);
+}
+
+static OM_uint32
+plugin_no_display_status (OM_uint32 * minor_status,
+			  OM_uint32 status_value,
+			  int status_type,
+			  const gss_OID mech_type,
+			  OM_uint32 * message_context,
+			  gss_buffer_t status_string)
+{
+  return plugin_unavailable (minor_status);
+}
+
+/* Bind the functions of MECH to TABLE.  Those left NULL make the
+   generic layer return GSS_S_UNAVAILABLE. */
+static void
+plugin_bind (_gss_mech_api_t mech, const gss_mech_plugin_desc * table)
+{
+  size_t i;
+
+  mech->mech_name = table->mech_name;
+  mech->mech_description = table->mech_description;
+  for (i = 0; i < MAX_NT && i < GSS_MECH_PLUGIN_MAX_NT; i++)
+    mech->name_types[i] = table->name_types[i];
+
+  mech->init_sec_context = plugin_init_sec_context;
+  mech->accept_sec_context = plugin_accept_sec_context;
+  mech->delete_sec_context = plugin_delete_sec_context;
+  mech->context_time = plugin_context_time;
+  if (table->wrap_size_limit)
+    mech->wrap_size_limit = plugin_wrap_size_limit;
+  if (table->export_sec_context)
+    mech->export_sec_context = plugin_export_sec_context;
+  if (table->import_sec_context)
+    mech->import_sec_context = plugin_import_sec_context;
+  if (table->init_sec_context_fd)
+    mech->init_sec_context_fd = plugin_init_sec_context_fd;
+
+  mech->get_mic = plugin_get_mic;
+  mech->verify_mic = plugin_verify_mic;
+  mech->wrap = plugin_wrap;
+  mech->unwrap = plugin_unwrap;
+  if (table->wrap_iov)
+    mech->wrap_iov = plugin_wrap_iov;
+  if (table->unwrap_iov)
+    mech->unwrap_iov = plugin_unwrap_iov;
+  if (table->wrap_iov_length)
+    mech->wrap_iov_length = plugin_wrap_iov_length;
+  if (table->wrap_into)
+    mech->wrap_into = plugin_wrap_into;
+  if (table->unwrap_into)
+    mech->unwrap_into = plugin_unwrap_into;
+  if (table->get_mic_into)
+    mech->get_mic_into = plugin_get_mic_into;
+
+  mech->acquire_cred = plugin_acquire_cred;
+  mech->release_cred = plugin_release_cred;
+  mech->inquire_cred = plugin_inquire_cred;
+  mech->inquire_cred_by_mech = plugin_inquire_cred_by_mech;
+
+  /* These take no handles. */
+  mech->canonicalize_name = table->canonicalize_name
+    ? table->canonicalize_name : plugin_no_canonicalize_name;
+  mech->export_name = table->export_name
+    ? table->export_name : plugin_no_export_name;
+  mech->display_status = table->display_status
+    ? table->display_status : plugin_no_display_status;
+}
+
+static int
+plugin_open (struct _gss_mech_plugin_struct *p)
+{
+#ifdef HAVE_DLOPEN
+  const gss_mech_plugin_desc *table;
+  void *handle;
+
+  handle = dlopen (p->path, RTLD_NOW | RTLD_LOCAL);
+  if (!handle)
+    return -1;
+
+  table = dlsym (handle, GSS_MECH_PLUGIN_SYMBOL);
+  if (!table || table->version != GSS_MECH_PLUGIN_VERSION)
+    {
+      dlclose (handle);
+      return -1;
+    }
+
+  /* Lookups may be reading the identity fields concurrently, which
+     are not touched.  The handle is never closed, as contexts may use
+     the functions until the process exits. */
+  p->table = table;
+  plugin_bind (&p->desc, table);
+
+  return 0;
+#else
+  (void) p;
+  return -1;
+#endif
+}
+
+/* Return MECH, a mechanism from the configuration file, with its
+   functions bound, or NULL if its shared object cannot be loaded.
+   Loading is attempted only once. */
+_gss_mech_api_t
+_gss_plugin_load (_gss_mech_api_t mech)
+{
+  struct _gss_mech_plugin_struct *p = mech->plugin;
+  int state = _gss_load (&p->state);
+
+  if (state == PLUGIN_UNLOADED)
+    {
+      _gss_lock (plugin_lock);
+      state = p->state;
+      if (state == PLUGIN_UNLOADED)
+	{
+	  state = plugin_open (p) == 0 ? PLUGIN_LOADED : PLUGIN_FAILED;
+	  _gss_store (&p->state, state);
+	}
+      _gss_unlock (plugin_lock);
+    }
+
+  return state == PLUGIN_LOADED ? mech : NULL;
+}
+
+/**
+ * gss_set_mech_config:
+ * @minor_status: (Integer, modify) Mechanism specific status code.
+ * @filename: (string, read) Mechanism configuration file, or NULL
+ *   to not load any mechanism plugins.
+ *
+ * Read the mechanism plugins from @filename instead of the default
+ * configuration file, which is gss/mech.conf in the system
+ * configuration directory.  Each line of the file holds the OID of a
+ * mechanism in dotted form, its SASL name, and the shared object
+ * implementing it, which is only loaded the first time the mechanism
+ * is used.  A line "default" followed by an OID or SASL name selects
+ * the mechanism used when the application does not name one; without
+ * it, the first built-in mechanism is used.  The file is read when a
+ * mechanism is first looked up, so this function must be called
+ * before any other function that selects a mechanism.
+ *
+ * WARNING: This function is a GNU GSS specific extension, and is not
+ * part of the official GSS API.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * `GSS_S_FAILURE`: The configuration file was already read, in which
+ * case @minor_status is EBUSY, or memory allocation failed.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_set_mech_config (OM_uint32 * minor_status, const char *filename)
+{
+  char *copy = NULL;
+  int err = 0;
+
+  if (filename && !(copy = strdup (filename)))
+    err = ENOMEM;
+  else
+    {
+      _gss_lock (plugin_lock);
+      if (plugin_config_read)
+	err = EBUSY;
+      else
+	{
+	  free (plugin_config);
+	  plugin_config = copy;
+	  plugin_config_set = 1;
+	}
+      _gss_unlock (plugin_lock);
+    }
+
+  if (err)
+    {
+      free (copy);
+      if (minor_status)
+	*minor_status = err;
+      return GSS_S_FAILURE;
+    }
+
+  if (minor_status)
+    *minor_status = 0;
+  return GSS_S_COMPLETE;
+}
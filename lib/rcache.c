@@ -0,0 +1,471 @@
+/* rcache.c --- Replay cache for context establishment tokens.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "internal.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _POSIX_MAPPED_FILES
+# include <sys/mman.h>
+#endif
+
+/* The replay cache remembers the tokens an acceptor has seen until
+   they are too old to be accepted anyway.  Mechanisms reduce a token
+   to a 64-bit hash of whatever identifies it, and an expiry time.
+
+   The cache is an open addressing hash table of 64-bit slots, so that
+   acceptor threads never wait for each other: a slot holds the upper
+   40 bits of the hash as a fingerprint and the lower 24 bits of the
+   expiry time in seconds, and is claimed with a compare-and-swap.
+   Expired slots are reused in place, so the table never needs to be
+   swept.  The expiry time wraps after 194 days; a slot that has not
+   been reused for half of that looks live again, which only costs a
+   slot.
+
+   A lookup probes at most RCACHE_PROBES slots from the home slot of
+   the hash, up to the first empty one.  After claiming a slot, the
+   probe sequence is scanned again, so that of two threads inserting
+   the same hash at the same time, at least one sees the other.
+
+   The slots may live in a shared mapping of a file, which makes the
+   cache survive restarts and lets several processes share it.  The
+   file uses the native byte order. */
+
+#define RCACHE_MAGIC "GNU GSS rcache1\n"
+#define RCACHE_HEADER 64
+#define RCACHE_PROBES 64
+#define RCACHE_STAMP_BITS 24
+#define RCACHE_STAMP_MASK ((UINT64_C (1) << RCACHE_STAMP_BITS) - 1)
+#define RCACHE_MIN_SLOTS 1024
+#define RCACHE_MAX_SLOTS (1UL << RCACHE_STAMP_BITS)
+#define RCACHE_DEFAULT_SLOTS (1UL << 18)
+/* Tokens per second the default cache has room for, at most half
+   full so that probe sequences stay short. */
+#define RCACHE_DEFAULT_RATE 400
+
+struct _gss_rcache_struct
+{
+  uint64_t *slots;
+  size_t mask;
+  /* Mapping of the backing file, or NULL. */
+  void *map;
+  size_t maplen;
+};
+
+_GSS_LOCK_DEFINE (rcache_lock);
+static _gss_rcache_t rcache_default;
+
+#if defined __ATOMIC_ACQUIRE
+# define rcache_load(p) __atomic_load_n (p, __ATOMIC_ACQUIRE)
+# define rcache_store(p, v) __atomic_store_n (p, v, __ATOMIC_RELEASE)
+# define rcache_cas(p, old, new) \
+  __atomic_compare_exchange_n (p, &(old), new, 0, \
+			       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#elif defined __GNUC__
+# define rcache_load(p) __sync_fetch_and_add (p, 0)
+# define rcache_store(p, v) (__sync_synchronize (), *(p) = (v))
+# define rcache_cas(p, old, new) __sync_bool_compare_and_swap (p, old, new)
+#else
+/* Without atomic operations, insertions are serialized instead. */
+# define RCACHE_LOCKED 1
+# define rcache_load(p) (*(p))
+# define rcache_store(p, v) (*(p) = (v))
+# define rcache_cas(p, old, new) (*(p) = (new), 1)
+#endif
+
+/* Chain LEN bytes of DATA to the hash H, which should start out as
+   _GSS_RCACHE_HASH_INIT.  This is FNV-1a. */
+uint64_t
+_gss_rcache_hash (uint64_t h, const void *data, size_t len)
+{
+  const unsigned char *p = data;
+
+  while (len--)
+    h = (h ^ *p++) * UINT64_C (1099511628211);
+
+  return h;
+}
+
+/* Spread the bits of H, since both the low bits (the home slot) and
+   the high bits (the fingerprint) are used. */
+static uint64_t
+rcache_mix (uint64_t h)
+{
+  h ^= h >> 33;
+  h *= UINT64_C (0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  h *= UINT64_C (0xc4ceb9fe1a85ec53);
+  h ^= h >> 33;
+
+  return h;
+}
+
+static int
+rcache_live_p (uint64_t slot, time_t now)
+{
+  return ((slot - (uint64_t) now) & RCACHE_STAMP_MASK)
+    < (RCACHE_STAMP_MASK >> 1);
+}
+
+static int
+rcache_same_p (uint64_t a, uint64_t b)
+{
+  return ((a ^ b) >> RCACHE_STAMP_BITS) == 0;
+}
+
+/* Round SLOTS up to a power of two within bounds. */
+static size_t
+rcache_slots (size_t slots)
+{
+  size_t n = RCACHE_MIN_SLOTS;
+
+  if (slots == 0)
+    return RCACHE_DEFAULT_SLOTS;
+
+  while (n < slots && n < RCACHE_MAX_SLOTS)
+    n <<= 1;
+
+  return n;
+}
+
+static int
+rcache_map (const char *file, size_t slots, _gss_rcache_t rc)
+{
+#ifdef _POSIX_MAPPED_FILES
+  struct stat st;
+  char *map;
+  size_t maplen;
+  int fd, flags = O_RDWR | O_CREAT;
+
+# ifdef O_CLOEXEC
+  flags |= O_CLOEXEC;
+# endif
+
+  fd = open (file, flags, 0600);
+  if (fd < 0)
+    return errno;
+
+  if (fstat (fd, &st) != 0)
+    {
+      int err = errno;
+      close (fd);
+      return err;
+    }
+
+  /* An existing file keeps its size.  Two processes creating the file
+     at the same time write the same header, and one that finds the
+     header still empty writes it too. */
+  if (st.st_size == 0)
+    {
+      maplen = RCACHE_HEADER + slots * sizeof (uint64_t);
+      if (ftruncate (fd, maplen) != 0)
+	{
+	  int err = errno;
+	  close (fd);
+	  return err;
+	}
+    }
+  else
+    maplen = st.st_size;
+
+  if (maplen <= RCACHE_HEADER
+      || (maplen - RCACHE_HEADER) % sizeof (uint64_t) != 0)
+    {
+      close (fd);
+      return EINVAL;
+    }
+
+  map = mmap (NULL, maplen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return errno;
+
+  slots = (maplen - RCACHE_HEADER) / sizeof (uint64_t);
+  if (st.st_size == 0 || *map == '\0')
+    memcpy (map, RCACHE_MAGIC, sizeof (RCACHE_MAGIC));
+  if (memcmp (map, RCACHE_MAGIC, sizeof (RCACHE_MAGIC)) != 0
+      || rcache_slots (slots) != slots)
+    {
+      munmap (map, maplen);
+      return EINVAL;
+    }
+
+  rc->map = map;
+  rc->maplen = maplen;
+  rc->slots = (uint64_t *) (map + RCACHE_HEADER);
+  rc->mask = slots - 1;
+
+  return 0;
+#else
+  return ENOSYS;
+#endif
+}
+
+/* Create a replay cache with room for about SLOTS tokens, or a
+   default number if SLOTS is 0.  If FILE is not NULL, the cache is
+   kept in that file, which is created if needed; an existing file
+   keeps the size it was created with.  Returns 0 or an errno
+   value. */
+int
+_gss_rcache_open (const char *file, size_t slots, _gss_rcache_t * out)
+{
+  _gss_rcache_t rc;
+  int err;
+
+  rc = calloc (1, sizeof (*rc));
+  if (!rc)
+    return ENOMEM;
+
+  slots = rcache_slots (slots);
+
+  if (file)
+    {
+      err = rcache_map (file, slots, rc);
+      if (err)
+	{
+	  free (rc);
+	  return err;
+	}
+    }
+  else
+    {
+      rc->slots = calloc (slots, sizeof (*rc->slots));
+      if (!rc->slots)
+	{
+	  free (rc);
+	  return ENOMEM;
+	}
+      rc->mask = slots - 1;
+    }
+
+  *out = rc;
+
+  return 0;
+}
+
+void
+_gss_rcache_close (_gss_rcache_t rc)
+{
+  if (rc == NULL)
+    return;
+
+#ifdef _POSIX_MAPPED_FILES
+  if (rc->map)
+    munmap (rc->map, rc->maplen);
+  else
+#endif
+    free (rc->slots);
+  free (rc);
+}
+
+/* Scan the probe sequence of ENTRY for a live slot with the same
+   fingerprint, other than the slot at SKIP. */
+static int
+rcache_find (_gss_rcache_t rc, size_t home, uint64_t entry, size_t skip,
+	     time_t now)
+{
+  size_t i, n;
+  uint64_t cur;
+
+  for (n = 0, i = home; n < RCACHE_PROBES; n++, i = (i + 1) & rc->mask)
+    {
+      cur = rcache_load (&rc->slots[i]);
+      if (cur == 0)
+	break;
+      if (i != skip && rcache_live_p (cur, now) && rcache_same_p (cur, entry))
+	return 1;
+    }
+
+  return 0;
+}
+
+static int
+rcache_insert (_gss_rcache_t rc, uint64_t hash, time_t expires, time_t now)
+{
+  uint64_t entry, cur, old = 0;
+  size_t home, i, n, claim;
+
+  hash = rcache_mix (hash);
+  home = hash & rc->mask;
+  entry = (hash & ~RCACHE_STAMP_MASK) | ((uint64_t) expires
+					 & RCACHE_STAMP_MASK);
+  /* Zero marks an empty slot. */
+  if (entry == 0)
+    entry = RCACHE_STAMP_MASK + 1;
+
+  for (;;)
+    {
+      claim = (size_t) -1;
+
+      for (n = 0, i = home; n < RCACHE_PROBES; n++, i = (i + 1) & rc->mask)
+	{
+	  cur = rcache_load (&rc->slots[i]);
+	  if (cur == 0 || !rcache_live_p (cur, now))
+	    {
+	      if (claim == (size_t) -1)
+		{
+		  claim = i;
+		  old = cur;
+		}
+	      if (cur == 0)
+		break;
+	    }
+	  else if (rcache_same_p (cur, entry))
+	    return _GSS_RCACHE_REPLAY;
+	}
+
+      if (claim == (size_t) -1)
+	return _GSS_RCACHE_FULL;
+
+      if (rcache_cas (&rc->slots[claim], old, entry))
+	break;
+    }
+
+  if (rcache_find (rc, home, entry, claim, now))
+    return _GSS_RCACHE_REPLAY;
+
+  return _GSS_RCACHE_OK;
+}
+
+/* Record a token with hash HASH, as computed with _gss_rcache_hash,
+   that is accepted until EXPIRES.  NOW is the current time.  Returns
+   _GSS_RCACHE_OK for a new token, _GSS_RCACHE_REPLAY for one that was
+   recorded before, and _GSS_RCACHE_FULL when the token could not be
+   recorded, in which case it must be rejected. */
+int
+_gss_rcache_insert (_gss_rcache_t rc, uint64_t hash,
+		    time_t expires, time_t now)
+{
+#ifdef RCACHE_LOCKED
+  int res;
+
+  _gss_lock (rcache_lock);
+  res = rcache_insert (rc, hash, expires, now);
+  _gss_unlock (rcache_lock);
+
+  return res;
+#else
+  return rcache_insert (rc, hash, expires, now);
+#endif
+}
+
+/* Return the process-wide replay cache, creating an in-memory one
+   unless gss_set_replay_cache was called.  The in-memory cache is
+   sized for tokens that are kept for LIFETIME seconds, which is the
+   whole clock skew window of the mechanism, arriving at
+   RCACHE_DEFAULT_RATE per second.  Returns 0 or an errno value. */
+int
+_gss_rcache_default (time_t lifetime, _gss_rcache_t * out)
+{
+  int err = 0;
+
+  *out = rcache_load (&rcache_default);
+  if (*out)
+    return 0;
+
+  _gss_lock (rcache_lock);
+  if (rcache_default == NULL)
+    {
+      _gss_rcache_t rc;
+
+      err = _gss_rcache_open (NULL,
+			      2 * RCACHE_DEFAULT_RATE * (size_t) lifetime,
+			      &rc);
+      if (err == 0)
+	rcache_store (&rcache_default, rc);
+    }
+  *out = rcache_default;
+  _gss_unlock (rcache_lock);
+
+  return err;
+}
+
+/**
+ * gss_set_replay_cache:
+ * @minor_status: (Integer, modify) Mechanism specific status code.
+ * @filename: (string, read) File to keep the replay cache in, or
+ *   NULL to keep it in memory.
+ * @slots: (size_t, read) Number of tokens the cache has room for, or
+ *   0 for a default.
+ *
+ * Configure the replay cache that acceptors use to detect replayed
+ * context establishment tokens.  By default, the cache is kept in
+ * memory and is lost when the process exits.  When @filename is
+ * given, the cache is kept in a memory-mapped file, which is created
+ * if needed, so that it survives restarts and is shared with other
+ * processes using the same file.  An existing file keeps the size it
+ * was created with.  The cache must be configured before the first
+ * security context is accepted.
+ *
+ * The cache needs room for all tokens accepted within twice the
+ * allowed clock skew.  Expired tokens are forgotten, but when the
+ * cache is full of tokens that are still valid, new ones are
+ * rejected.  The default in-memory cache is sized from the clock
+ * skew window for 400 tokens per second.
+ *
+ * WARNING: This function is a GNU GSS specific extension, and is not
+ * part of the official GSS API.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * `GSS_S_FAILURE`: The cache could not be created, or a security
+ * context was already accepted.  @minor_status holds an errno value.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_set_replay_cache (OM_uint32 * minor_status,
+		      const char *filename, size_t slots)
+{
+  _gss_rcache_t rc;
+  int err;
+
+  if (minor_status)
+    *minor_status = 0;
+
+  err = _gss_rcache_open (filename, slots, &rc);
+  if (err == 0)
+    {
+      _gss_lock (rcache_lock);
+      if (rcache_default == NULL)
+	rcache_store (&rcache_default, rc);
+      else
+	err = EBUSY;
+      _gss_unlock (rcache_lock);
+
+      if (err)
+	_gss_rcache_close (rc);
+    }
+
+  if (err)
+    {
+      if (minor_status)
+	*minor_status = err;
+      return GSS_S_FAILURE;
+    }
+
+  return GSS_S_COMPLETE;
+}
@@ -0,0 +1,379 @@
+/* stats.c --- Call counters and latency histograms of the entry points.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "internal.h"
+
+/* Every thread counts into a block of its own, so that the counters
+   are never shared between processors and are updated without atomic
+   read-modify-write instructions.  Only the owning thread writes a
+   block; gss_stats_snapshot() sums the blocks of the live threads
+   and the totals of the threads that have exited, which are folded
+   into stats_total when the thread goes away.  Without threads, the
+   counting is done in stats_total directly. */
+
+struct stats_entry
+{
+  uint64_t calls;
+  uint64_t failures;
+  uint64_t total_ns;
+  uint64_t latency[GSS_STATS_BUCKETS];
+};
+
+/* Only uint64_t members, so that blocks can be summed as arrays. */
+struct stats_counters
+{
+  struct stats_entry entry[_GSS_STATS_MAX];
+  /* Created and destroyed. */
+  uint64_t contexts[2];
+  uint64_t credentials[2];
+};
+
+struct stats_block
+{
+  struct stats_counters c;
+  struct stats_block *next;
+};
+
+#define STATS_WORDS (sizeof (struct stats_counters) / sizeof (uint64_t))
+
+/* In the order of the entry points in internal.h. */
+static const char *const stats_names[_GSS_STATS_MAX] = {
+  "gss_init_sec_context",
+  "gss_init_sec_context_fd",
+  "gss_accept_sec_context",
+  "gss_delete_sec_context",
+  "gss_process_context_token",
+  "gss_context_time",
+  "gss_inquire_context",
+  "gss_wrap_size_limit",
+  "gss_export_sec_context",
+  "gss_import_sec_context",
+  "gss_get_mic",
+  "gss_verify_mic",
+  "gss_wrap",
+  "gss_unwrap",
+  "gss_wrap_iov",
+  "gss_unwrap_iov",
+  "gss_wrap_iov_length",
+  "gss_release_iov_buffer",
+  "gss_wrap_into",
+  "gss_unwrap_into",
+  "gss_get_mic_into",
+  "gss_acquire_cred",
+  "gss_add_cred",
+  "gss_inquire_cred",
+  "gss_inquire_cred_by_mech",
+  "gss_release_cred"
+};
+
+_GSS_LOCK_DEFINE (stats_lock);
+static struct stats_block stats_total;
+
+#ifdef HAVE_PTHREAD_H
+static struct stats_block *stats_threads;
+static pthread_key_t stats_key;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static int stats_key_ok;
+
+static void
+stats_add (uint64_t * to, const uint64_t * from)
+{
+  size_t i;
+
+  for (i = 0; i < STATS_WORDS; i++)
+    to[i] += _gss_load (&from[i]);
+}
+
+static void
+stats_thread_exit (void *arg)
+{
+  struct stats_block *b = arg, **p;
+
+  _gss_lock (stats_lock);
+  for (p = &stats_threads; *p; p = &(*p)->next)
+    if (*p == b)
+      {
+	*p = b->next;
+	break;
+      }
+  stats_add ((uint64_t *) &stats_total.c, (const uint64_t *) &b->c);
+  _gss_unlock (stats_lock);
+
+  free (b);
+}
+
+static void
+stats_key_init (void)
+{
+  stats_key_ok = pthread_key_create (&stats_key, stats_thread_exit) == 0;
+}
+
+/* Return the block of the calling thread, or NULL if it cannot be
+   allocated, in which case the call is not counted. */
+static struct stats_block *
+stats_block (void)
+{
+  struct stats_block *b;
+
+  pthread_once (&stats_once, stats_key_init);
+  if (!stats_key_ok)
+    return NULL;
+
+  b = pthread_getspecific (stats_key);
+  if (b)
+    return b;
+
+  b = calloc (1, sizeof (*b));
+  if (!b)
+    return NULL;
+  if (pthread_setspecific (stats_key, b) != 0)
+    {
+      free (b);
+      return NULL;
+    }
+
+  _gss_lock (stats_lock);
+  b->next = stats_threads;
+  stats_threads = b;
+  _gss_unlock (stats_lock);
+
+  return b;
+}
+#else
+# define stats_block() (&stats_total)
+#endif
+
+/* Count one more in *P, which only the calling thread writes. */
+#define stats_bump(p, v) _gss_store (p, *(p) + (v))
+
+/* Return a timestamp in nanoseconds for _gss_stats_end(), from a
+   monotonic clock if there is one.  Without clock_gettime, the
+   latencies have a resolution of a second. */
+uint64_t
+_gss_stats_start (void)
+{
+#if defined HAVE_CLOCK_GETTIME && defined CLOCK_MONOTONIC
+  struct timespec ts;
+
+  if (clock_gettime (CLOCK_MONOTONIC, &ts) != 0)
+    return 0;
+
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+  return (uint64_t) time (NULL) * 1000000000;
+#endif
+}
+
+static unsigned
+stats_bucket (uint64_t ns)
+{
+  unsigned i;
+
+#if defined __GNUC__
+  i = ns ? 64 - __builtin_clzll (ns) : 0;
+#else
+  for (i = 0; ns; i++)
+    ns >>= 1;
+#endif
+
+  return i < GSS_STATS_BUCKETS ? i : GSS_STATS_BUCKETS - 1;
+}
+
+/* Count a call of the entry point ENTRY that started at START and
+   returned MAJ_STAT, which is returned. */
+OM_uint32
+_gss_stats_end (int entry, uint64_t start, OM_uint32 maj_stat)
+{
+  struct stats_block *b = stats_block ();
+  struct stats_entry *e;
+  uint64_t now, ns;
+
+  if (!b)
+    return maj_stat;
+
+  e = &b->c.entry[entry];
+  now = _gss_stats_start ();
+  ns = now > start ? now - start : 0;
+
+  stats_bump (&e->calls, 1);
+  if (GSS_ERROR (maj_stat))
+    stats_bump (&e->failures, 1);
+  stats_bump (&e->total_ns, ns);
+  stats_bump (&e->latency[stats_bucket (ns)], 1);
+
+  return maj_stat;
+}
+
+/* Count a context that was created, if DELTA is positive, or
+   destroyed. */
+void
+_gss_stats_context (int delta)
+{
+  struct stats_block *b = stats_block ();
+
+  if (b)
+    stats_bump (&b->c.contexts[delta > 0 ? 0 : 1], 1);
+}
+
+/* Likewise for credentials. */
+void
+_gss_stats_cred (int delta)
+{
+  struct stats_block *b = stats_block ();
+
+  if (b)
+    stats_bump (&b->c.credentials[delta > 0 ? 0 : 1], 1);
+}
+
+static unsigned long long
+stats_live (const uint64_t * count)
+{
+  return count[0] > count[1] ? count[0] - count[1] : 0;
+}
+
+/**
+ * gss_stats_snapshot:
+ * @minor_status: (Integer, modify) Mechanism specific status code.
+ * @stats: (gss_stats_t, modify) Newly allocated statistics.  Storage
+ *   associated with them must be freed by the application after use
+ *   with a call to gss_release_stats().
+ *
+ * Report how often each entry point for security contexts,
+ * per-message protection and credentials was called by any thread of
+ * the process, how many of the calls failed, and how long they took.
+ * The entries of @stats appear in a fixed order, and each holds the
+ * name of the function, the number of calls, the number of calls
+ * returning an error, the total time spent in nanoseconds, and a
+ * latency histogram: the count at index I of the latency field is
+ * the number of calls that took less than 2^I nanoseconds, but not
+ * less than 2^(I-1), except that the last count has all the slower
+ * calls.  The contexts and credentials fields give the number of
+ * contexts and credentials currently allocated.
+ *
+ * The counters are kept per thread and only added up here, so the
+ * snapshot is not atomic with respect to calls in progress.
+ *
+ * WARNING: This function is a GNU GSS specific extension, and is not
+ * part of the official GSS API.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * `GSS_S_FAILURE`: Memory allocation failed, in which case
+ * @minor_status is ENOMEM.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_stats_snapshot (OM_uint32 * minor_status, gss_stats_t * stats)
+{
+  struct stats_counters *sum;
+  gss_stats_t out;
+  size_t i, j;
+
+  if (!stats)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_FAILURE | GSS_S_CALL_INACCESSIBLE_WRITE;
+    }
+
+  sum = malloc (sizeof (*sum));
+  out = malloc (sizeof (*out) + _GSS_STATS_MAX * sizeof (*out->entries));
+  if (!sum || !out)
+    {
+      free (sum);
+      free (out);
+      if (minor_status)
+	*minor_status = ENOMEM;
+      return GSS_S_FAILURE;
+    }
+
+  _gss_lock (stats_lock);
+  memcpy (sum, &stats_total.c, sizeof (*sum));
+#ifdef HAVE_PTHREAD_H
+  {
+    struct stats_block *b;
+
+    for (b = stats_threads; b; b = b->next)
+      stats_add ((uint64_t *) sum, (const uint64_t *) &b->c);
+  }
+#endif
+  _gss_unlock (stats_lock);
+
+  out->contexts = stats_live (sum->contexts);
+  out->credentials = stats_live (sum->credentials);
+  out->count = _GSS_STATS_MAX;
+  out->entries = (gss_stats_entry_desc *) (out + 1);
+  for (i = 0; i < _GSS_STATS_MAX; i++)
+    {
+      gss_stats_entry_desc *e = &out->entries[i];
+
+      e->name = stats_names[i];
+      e->calls = sum->entry[i].calls;
+      e->failures = sum->entry[i].failures;
+      e->total_ns = sum->entry[i].total_ns;
+      for (j = 0; j < GSS_STATS_BUCKETS; j++)
+	e->latency[j] = sum->entry[i].latency[j];
+    }
+
+  free (sum);
+
+  *stats = out;
+
+  if (minor_status)
+    *minor_status = 0;
+  return GSS_S_COMPLETE;
+}
+
+/**
+ * gss_release_stats:
+ * @minor_status: (Integer, modify) Mechanism specific status code.
+ * @stats: (gss_stats_t, modify) The statistics to be deleted.
+ *
+ * Free storage associated with statistics returned by
+ * gss_stats_snapshot().  The @stats parameter is set to
+ * GSS_C_NO_STATS on return.
+ *
+ * WARNING: This function is a GNU GSS specific extension, and is not
+ * part of the official GSS API.
+ *
+ * Return value:
+ *
+ * `GSS_S_COMPLETE`: Successful completion.
+ *
+ * Since: 1.0.3
+ **/
+OM_uint32
+gss_release_stats (OM_uint32 * minor_status, gss_stats_t * stats)
+{
+  if (stats)
+    {
+      free (*stats);
+      *stats = GSS_C_NO_STATS;
+    }
+
+  if (minor_status)
+    *minor_status = 0;
+  return GSS_S_COMPLETE;
+}
@@ -83,6 +83,8 @@ Mandatory arguments to long options are mandatory for short options too.\n\
                     List information about supported mechanisms\n\
                     in a human readable format.\n\
   -m, --major=LONG  Describe a `major status' error code value.\n\
+  -s, --stats       Print how often the library functions were called,\n\
+                    and how long they took, before exiting.\n\
 "), stdout);
       fputs (_("\
   -q, --quiet       Silent operation (default=off).\n\
@@ -263,7 +265,7 @@ list_mechanisms (unsigned quiet)
     {
       printf ("\nMechanism %lu:\n", (unsigned long) i);
 
-      maj = gss_inquire_saslname_for_mech (&min, mech_set->elements++,
+      maj = gss_inquire_saslname_for_mech (&min, &mech_set->elements[i],
 					   &sasl_mech_name, &mech_name,
 					   &mech_description);
       if (GSS_ERROR (maj))
@@ -284,6 +286,47 @@ list_mechanisms (unsigned quiet)
   return 0;
 }
 
+static int
+print_stats (unsigned quiet)
+{
+  gss_stats_t stats;
+  OM_uint32 maj, min;
+  size_t i, j;
+
+  maj = gss_stats_snapshot (&min, &stats);
+  if (GSS_ERROR (maj))
+    {
+      error (0, 0, _("taking statistics failed (%d)"), maj);
+      return 1;
+    }
+
+  printf ("Live contexts: %llu\n", stats->contexts);
+  printf ("Live credentials: %llu\n", stats->credentials);
+
+  for (i = 0; i < stats->count; i++)
+    {
+      gss_stats_entry_desc *e = &stats->entries[i];
+
+      if (e->calls == 0)
+	continue;
+
+      printf ("\n%s: %llu calls, %llu failures, %llu ns mean\n",
+	      e->name, e->calls, e->failures, e->total_ns / e->calls);
+
+      for (j = 0; j < GSS_STATS_BUCKETS && !quiet; j++)
+	if (e->latency[j] == 0)
+	  continue;
+	else if (j < GSS_STATS_BUCKETS - 1)
+	  printf ("\t< %llu ns: %llu\n", 1ULL << j, e->latency[j]);
+	else
+	  printf ("\t>= %llu ns: %llu\n", 1ULL << (j - 1), e->latency[j]);
+    }
+
+  gss_release_stats (&min, &stats);
+
+  return 0;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -311,8 +354,11 @@ main (int argc, char *argv[])
     rc = describe_major (args.quiet_given, args.major_arg);
   else if (args.list_mechanisms_given)
     rc = list_mechanisms (args.quiet_given);
-  else
+  else if (!args.stats_given)
     usage (EXIT_SUCCESS);
 
+  if (args.stats_given)
+    rc |= print_stats (args.quiet_given);
+
   return rc;
 }
@@ -38,6 +38,7 @@ const char *gengetopt_args_info_help[] = {
   "  -V, --version          Print version and exit",
   "  -m, --major=LONG       See gss.c for doc string",
   "  -l, --list-mechanisms  See gss.c for doc string",
+  "  -s, --stats            See gss.c for doc string",
   "  -q, --quiet            Silent operation  (default=off)",
     0
 };
@@ -67,6 +68,7 @@ void clear_given (struct gengetopt_args_info *args_info)
   args_info->version_given = 0 ;
   args_info->major_given = 0 ;
   args_info->list_mechanisms_given = 0 ;
+  args_info->stats_given = 0 ;
   args_info->quiet_given = 0 ;
 }
 
@@ -88,7 +90,8 @@ void init_args_info(struct gengetopt_args_info *args_info)
   args_info->version_help = gengetopt_args_info_help[1] ;
   args_info->major_help = gengetopt_args_info_help[2] ;
   args_info->list_mechanisms_help = gengetopt_args_info_help[3] ;
-  args_info->quiet_help = gengetopt_args_info_help[4] ;
+  args_info->stats_help = gengetopt_args_info_help[4] ;
+  args_info->quiet_help = gengetopt_args_info_help[5] ;
   
 }
 
@@ -211,6 +214,8 @@ cmdline_parser_dump(FILE *outfile, struct gengetopt_args_info *args_info)
     write_into_file(outfile, "major", args_info->major_orig, 0);
   if (args_info->list_mechanisms_given)
     write_into_file(outfile, "list-mechanisms", 0, 0 );
+  if (args_info->stats_given)
+    write_into_file(outfile, "stats", 0, 0 );
   if (args_info->quiet_given)
     write_into_file(outfile, "quiet", 0, 0 );
   
@@ -462,11 +467,12 @@ cmdline_parser_internal (
         { "version",	0, NULL, 'V' },
         { "major",	1, NULL, 'm' },
         { "list-mechanisms",	0, NULL, 'l' },
+        { "stats",	0, NULL, 's' },
         { "quiet",	0, NULL, 'q' },
         { 0,  0, 0, 0 }
       };
 
-      c = getopt_long (argc, argv, "hVm:lq", long_options, &option_index);
+      c = getopt_long (argc, argv, "hVm:lsq", long_options, &option_index);
 
       if (c == -1) break;	/* Exit from `while (1)' loop.  */
 
@@ -523,6 +529,18 @@ cmdline_parser_internal (
               additional_error))
             goto failure;
         
+          break;
+        case 's':	/* See gss.c for doc string.  */
+        
+        
+          if (update_arg( 0 , 
+               0 , &(args_info->stats_given),
+              &(local_args_info.stats_given), optarg, 0, 0, ARG_NO,
+              check_ambiguity, override, 0, 0,
+              "stats", 's',
+              additional_error))
+            goto failure;
+        
           break;
         case 'q':	/* Silent operation.  */
         
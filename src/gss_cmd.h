@@ -47,6 +47,7 @@ struct gengetopt_args_info
   char * major_orig;	/**< @brief See gss.c for doc string original value given at command line.  */
   const char *major_help; /**< @brief See gss.c for doc string help description.  */
   const char *list_mechanisms_help; /**< @brief See gss.c for doc string help description.  */
+  const char *stats_help; /**< @brief See gss.c for doc string help description.  */
   int quiet_flag;	/**< @brief Silent operation (default=off).  */
   const char *quiet_help; /**< @brief Silent operation help description.  */
   
@@ -54,6 +55,7 @@ struct gengetopt_args_info
   unsigned int version_given ;	/**< @brief Whether version was given.  */
   unsigned int major_given ;	/**< @brief Whether major was given.  */
   unsigned int list_mechanisms_given ;	/**< @brief Whether list-mechanisms was given.  */
+  unsigned int stats_given ;	/**< @brief Whether stats was given.  */
   unsigned int quiet_given ;	/**< @brief Whether quiet was given.  */
 
 } ;
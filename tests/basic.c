@@ -27,6 +27,7 @@
 #include <stdarg.h>
 #include <ctype.h>
 #include <string.h>
+#include <errno.h>
 
 /* Get GSS prototypes. */
 #include <gss.h>
@@ -38,7 +39,8 @@ main (int argc, char *argv[])
 {
   gss_uint32 maj_stat, min_stat, msgctx;
   gss_buffer_desc bufdesc, bufdesc2;
-  gss_name_t service;
+  gss_name_t service, name1, name2;
+  gss_OID_desc usertype;
   gss_OID_set oids;
   int n;
 
@@ -260,6 +262,82 @@ main (int argc, char *argv[])
     fail ("gss_release_oid_set() failed (%d,%d)\n", maj_stat, min_stat);
 #endif
 
+  /* OID sets stay sorted and free of duplicates. */
+  maj_stat = gss_create_empty_oid_set (&min_stat, &oids);
+  if (maj_stat != GSS_S_COMPLETE)
+    fail ("gss_create_empty_oid_set() failed (%d,%d)\n", maj_stat, min_stat);
+  else
+    {
+      char bytes[3] = { 0x2a, 0x03, 0x00 };
+      gss_OID_desc oid = { sizeof (bytes), bytes };
+      size_t i;
+
+      for (i = 0; i < 100; i++)
+	{
+	  bytes[2] = (i * 37) % 50;
+	  maj_stat = gss_add_oid_set_member (&min_stat, &oid, &oids);
+	  if (maj_stat != GSS_S_COMPLETE)
+	    fail ("gss_add_oid_set_member() failed (%d,%d)\n", maj_stat,
+		  min_stat);
+	}
+      maj_stat = gss_add_oid_set_member (&min_stat, GSS_C_NT_USER_NAME, &oids);
+      if (maj_stat != GSS_S_COMPLETE)
+	fail ("gss_add_oid_set_member() failed (%d,%d)\n", maj_stat,
+	      min_stat);
+
+      if (oids->count != 51)
+	fail ("OID set has %lu members\n", (unsigned long) oids->count);
+      for (i = 0; i + 1 < oids->count; i++)
+	if (oids->elements[i].length > oids->elements[i + 1].length
+	    || (oids->elements[i].length == oids->elements[i + 1].length
+		&& memcmp (oids->elements[i].elements,
+			   oids->elements[i + 1].elements,
+			   oids->elements[i].length) >= 0))
+	  fail ("OID set not sorted at %lu\n", (unsigned long) i);
+
+      bytes[2] = 49;
+      if (gss_test_oid_set_member (&min_stat, &oid, oids, &n)
+	  != GSS_S_COMPLETE || !n)
+	fail ("gss_test_oid_set_member() missed a member\n");
+      bytes[2] = 50;
+      if (gss_test_oid_set_member (&min_stat, &oid, oids, &n)
+	  != GSS_S_COMPLETE || n)
+	fail ("gss_test_oid_set_member() found a non-member\n");
+      if (gss_test_oid_set_member (&min_stat, GSS_C_NT_USER_NAME, oids, &n)
+	  != GSS_S_COMPLETE || !n)
+	fail ("gss_test_oid_set_member() missed a name type\n");
+
+      maj_stat = gss_release_oid_set (&min_stat, &oids);
+      if (maj_stat == GSS_S_COMPLETE && oids == GSS_C_NO_OID_SET)
+	success ("OID set OK\n");
+      else
+	fail ("gss_release_oid_set() failed (%d,%d)\n", maj_stat, min_stat);
+    }
+
+  /* The mechanism set is shared, and copied when added to. */
+  maj_stat = gss_indicate_mechs (&min_stat, &oids);
+  if (maj_stat != GSS_S_COMPLETE)
+    fail ("gss_indicate_mechs() failed (%d,%d)\n", maj_stat, min_stat);
+  else
+    {
+      gss_OID_set oids2, shared = oids;
+
+      gss_release_oid_set (&min_stat, &oids);
+      maj_stat = gss_indicate_mechs (&min_stat, &oids2);
+      if (maj_stat != GSS_S_COMPLETE || oids2 != shared)
+	fail ("gss_indicate_mechs() not shared (%d,%d)\n", maj_stat,
+	      min_stat);
+      maj_stat = gss_add_oid_set_member (&min_stat, GSS_C_NT_ANONYMOUS,
+					 &oids2);
+      if (maj_stat != GSS_S_COMPLETE || oids2 == shared
+	  || oids2->count != shared->count + 1)
+	fail ("gss_add_oid_set_member() to shared set (%d,%d)\n", maj_stat,
+	      min_stat);
+      else
+	success ("gss_indicate_mechs() OK\n");
+      gss_release_oid_set (&min_stat, &oids2);
+    }
+
   /* Check name */
   service = NULL;
   bufdesc.value = (char *) "imap@server.example.org@FOO";
@@ -288,6 +366,82 @@ main (int argc, char *argv[])
   else
     fail ("gss_release_buffer() failed (%d,%d)\n", maj_stat, min_stat);
 
+  /* Equal names are shared, and duplicating one returns it again. */
+  maj_stat = gss_import_name (&min_stat, &bufdesc, GSS_C_NT_HOSTBASED_SERVICE,
+			      &name1);
+  if (maj_stat != GSS_S_COMPLETE || name1 != service)
+    fail ("gss_import_name() not interned (%d,%d)\n", maj_stat, min_stat);
+  else
+    {
+      maj_stat = gss_compare_name (&min_stat, service, name1, &n);
+      if (maj_stat != GSS_S_COMPLETE || !n)
+	fail ("gss_compare_name() equal (%d,%d)\n", maj_stat, min_stat);
+      gss_release_name (&min_stat, &name1);
+    }
+
+  maj_stat = gss_duplicate_name (&min_stat, service, &name1);
+  if (maj_stat != GSS_S_COMPLETE || name1 != service)
+    fail ("gss_duplicate_name() (%d,%d)\n", maj_stat, min_stat);
+  else
+    success ("gss_duplicate_name() OK\n");
+
+  bufdesc.value = (char *) "imap@server.example.org@BAR";
+  maj_stat = gss_import_name (&min_stat, &bufdesc, GSS_C_NT_HOSTBASED_SERVICE,
+			      &name2);
+  if (maj_stat != GSS_S_COMPLETE)
+    fail ("gss_import_name() failed (%d,%d)\n", maj_stat, min_stat);
+  else
+    {
+      maj_stat = gss_compare_name (&min_stat, name1, name2, &n);
+      if (maj_stat != GSS_S_COMPLETE || n)
+	fail ("gss_compare_name() different (%d,%d)\n", maj_stat, min_stat);
+      else
+	success ("gss_compare_name() OK\n");
+      gss_release_name (&min_stat, &name2);
+    }
+
+  /* The duplicate outlives the original. */
+  gss_release_name (&min_stat, &service);
+  maj_stat = gss_display_name (&min_stat, name1, &bufdesc2, NULL);
+  if (maj_stat != GSS_S_COMPLETE || bufdesc2.length != bufdesc.length
+      || memcmp (bufdesc2.value, "imap@server.example.org@FOO",
+		 bufdesc2.length) != 0)
+    fail ("gss_display_name() of duplicate (%d,%d)\n", maj_stat, min_stat);
+  else
+    gss_release_buffer (&min_stat, &bufdesc2);
+  service = name1;
+
+  /* A copy of a name type is the same type, and names of types the
+     library does not know are compared by value. */
+  usertype.length = GSS_C_NT_USER_NAME->length;
+  usertype.elements = malloc (usertype.length);
+  if (!usertype.elements)
+    fail ("malloc failed\n");
+  memcpy (usertype.elements, GSS_C_NT_USER_NAME->elements, usertype.length);
+  bufdesc.value = (char *) "jas";
+  bufdesc.length = strlen (bufdesc.value);
+  for (n = 0; n < 2; n++)
+    {
+      int equal = 0;
+
+      maj_stat = gss_import_name (&min_stat, &bufdesc,
+				  n == 0 ? GSS_C_NT_USER_NAME : &usertype,
+				  &name1);
+      if (maj_stat == GSS_S_COMPLETE)
+	maj_stat = gss_import_name (&min_stat, &bufdesc, &usertype, &name2);
+      if (maj_stat == GSS_S_COMPLETE)
+	maj_stat = gss_compare_name (&min_stat, name1, name2, &equal);
+      if (maj_stat != GSS_S_COMPLETE || !equal || (n == 0) != (name1 == name2))
+	fail ("gss_compare_name() of user names %d (%d,%d)\n", n,
+	      maj_stat, min_stat);
+      gss_release_name (&min_stat, &name1);
+      gss_release_name (&min_stat, &name2);
+
+      /* Some OID that is not a name type. */
+      ((char *) usertype.elements)[usertype.length - 1] ^= 0x40;
+    }
+  free (usertype.elements);
+
 #ifdef USE_KERBEROS5
   /* NB: "service" resused from previous test */
   maj_stat = gss_inquire_mechs_for_name (&min_stat, service, &oids);
@@ -333,6 +487,41 @@ main (int argc, char *argv[])
     success ("gss_release_oid_set() OK\n");
   else
     fail ("gss_release_oid_set() failed (%d,%d)\n", maj_stat, min_stat);
+
+  /* The second canonicalization comes from the cache. */
+  {
+    size_t hits, misses, hits2, misses2;
+
+    gss_krb5_name_cache_stats (&min_stat, &hits, &misses);
+    for (n = 0; n < 2; n++)
+      {
+	maj_stat = gss_canonicalize_name (&min_stat, service, GSS_KRB5,
+					  n == 0 ? &name1 : &name2);
+	if (maj_stat != GSS_S_COMPLETE)
+	  fail ("gss_canonicalize_name() failed (%d,%d)\n", maj_stat,
+		min_stat);
+      }
+    gss_krb5_name_cache_stats (&min_stat, &hits2, &misses2);
+    if (maj_stat == GSS_S_COMPLETE)
+      {
+	maj_stat = gss_display_name (&min_stat, name1, &bufdesc2, NULL);
+	if (maj_stat != GSS_S_COMPLETE || name1 != name2
+	    || bufdesc2.length != strlen ("imap/server.example.org@FOO")
+	    || memcmp (bufdesc2.value, "imap/server.example.org@FOO",
+		       bufdesc2.length) != 0)
+	  fail ("gss_canonicalize_name() result\n");
+	if (maj_stat == GSS_S_COMPLETE)
+	  gss_release_buffer (&min_stat, &bufdesc2);
+	if (hits2 != hits + 1 || misses2 != misses + 1)
+	  fail ("gss_krb5_name_cache_stats() (%lu,%lu)\n",
+		(unsigned long) (hits2 - hits),
+		(unsigned long) (misses2 - misses));
+	else
+	  success ("gss_krb5_name_cache_stats() OK\n");
+	gss_release_name (&min_stat, &name1);
+	gss_release_name (&min_stat, &name2);
+      }
+  }
 #endif
 
   /* Release service allocated earlier. */
@@ -361,6 +550,256 @@ main (int argc, char *argv[])
   else
     fail ("gss_release_buffer() failed (%d,%d)\n", maj_stat, min_stat);
 
+  {
+    OM_uint32 status = GSS_S_CALL_INACCESSIBLE_READ | GSS_S_FAILURE;
+    char text[100];
+
+    /* Compare against the allocated text, which may be translated. */
+    msgctx = 0;
+    maj_stat = gss_display_status (&min_stat, status, GSS_C_GSS_CODE,
+				   GSS_C_NO_OID, &msgctx, &bufdesc2);
+    if (maj_stat != GSS_S_COMPLETE || msgctx == 0
+	|| bufdesc2.length > sizeof (text))
+      fail ("gss_display_status() failed (%d,%d)\n", maj_stat, min_stat);
+
+    msgctx = 0;
+    bufdesc.value = text;
+    bufdesc.length = 5;
+    maj_stat = gss_display_status_into (&min_stat, status, GSS_C_GSS_CODE,
+					GSS_C_NO_OID, &msgctx, &bufdesc);
+    if (maj_stat == GSS_S_FAILURE && min_stat == ERANGE && msgctx == 0
+	&& bufdesc.length == bufdesc2.length)
+      success ("gss_display_status_into(short) OK\n");
+    else
+      fail ("gss_display_status_into(short) failed (%d,%d)\n",
+	    maj_stat, min_stat);
+
+    bufdesc.length = sizeof (text);
+    maj_stat = gss_display_status_into (&min_stat, status, GSS_C_GSS_CODE,
+					GSS_C_NO_OID, &msgctx, &bufdesc);
+    if (maj_stat == GSS_S_COMPLETE && msgctx != 0
+	&& bufdesc.value == text
+	&& bufdesc.length == bufdesc2.length
+	&& memcmp (text, bufdesc2.value, bufdesc.length) == 0)
+      success ("gss_display_status_into() OK\n");
+    else
+      fail ("gss_display_status_into() failed (%d,%d)\n",
+	    maj_stat, min_stat);
+    gss_release_buffer (&min_stat, &bufdesc2);
+
+    bufdesc.length = sizeof (text);
+    maj_stat = gss_display_status_into (&min_stat, status, GSS_C_GSS_CODE,
+					GSS_C_NO_OID, &msgctx, &bufdesc);
+    if (maj_stat == GSS_S_COMPLETE && msgctx == 0 && bufdesc.length > 0)
+      success ("gss_display_status_into(second) OK\n");
+    else
+      fail ("gss_display_status_into(second) failed (%d,%d)\n",
+	    maj_stat, min_stat);
+
+    /* The borrowed text walks the same conditions, and is the same
+       string every time. */
+    {
+      const char *first, *second, *again;
+      OM_uint32 msgctx2 = 0;
+
+      msgctx = 0;
+      maj_stat = gss_display_status (&min_stat, status, GSS_C_GSS_CODE,
+				     GSS_C_NO_OID, &msgctx, &bufdesc2);
+      if (maj_stat == GSS_S_COMPLETE)
+	maj_stat = gss_display_status_text (&min_stat, status, &msgctx2,
+					    &first);
+      if (maj_stat == GSS_S_COMPLETE)
+	maj_stat = gss_display_status_text (&min_stat, status, &msgctx2,
+					    &second);
+      if (maj_stat == GSS_S_COMPLETE)
+	maj_stat = gss_display_status_text (&min_stat, status, NULL, &again);
+      if (maj_stat == GSS_S_COMPLETE && msgctx2 == 0 && again == first
+	  && first != second && strlen (first) == bufdesc2.length
+	  && memcmp (first, bufdesc2.value, bufdesc2.length) == 0)
+	success ("gss_display_status_text() OK\n");
+      else
+	fail ("gss_display_status_text() failed (%d,%d)\n",
+	      maj_stat, min_stat);
+      if (bufdesc2.value)
+	gss_release_buffer (&min_stat, &bufdesc2);
+
+      maj_stat = gss_display_status_text (&min_stat, 0xffffffff, NULL,
+					  &first);
+      if (maj_stat != GSS_S_BAD_STATUS)
+	fail ("gss_display_status_text(bad) failed (%d,%d)\n",
+	      maj_stat, min_stat);
+    }
+
+    bufdesc.value = (char *) "foo";
+    bufdesc.length = 3;
+    bufdesc2.value = text;
+    bufdesc2.length = sizeof (text);
+    maj_stat = gss_wrap_into (&min_stat, GSS_C_NO_CONTEXT, 0, 0, &bufdesc,
+			      NULL, &bufdesc2);
+    if (maj_stat == GSS_S_NO_CONTEXT)
+      success ("gss_wrap_into(no context) OK\n");
+    else
+      fail ("gss_wrap_into(no context) failed (%d,%d)\n",
+	    maj_stat, min_stat);
+
+    maj_stat = gss_unwrap_into (&min_stat, GSS_C_NO_CONTEXT, &bufdesc,
+				&bufdesc2, NULL, NULL);
+    if (maj_stat == GSS_S_NO_CONTEXT)
+      success ("gss_unwrap_into(no context) OK\n");
+    else
+      fail ("gss_unwrap_into(no context) failed (%d,%d)\n",
+	    maj_stat, min_stat);
+
+    maj_stat = gss_get_mic_into (&min_stat, GSS_C_NO_CONTEXT, 0, &bufdesc,
+				 &bufdesc2);
+    if (maj_stat == GSS_S_NO_CONTEXT)
+      success ("gss_get_mic_into(no context) OK\n");
+    else
+      fail ("gss_get_mic_into(no context) failed (%d,%d)\n",
+	    maj_stat, min_stat);
+
+    maj_stat = gss_wrap_size_limit (&min_stat, GSS_C_NO_CONTEXT, 0, 0,
+				    1000, &msgctx);
+    if (maj_stat == GSS_S_NO_CONTEXT)
+      success ("gss_wrap_size_limit(no context) OK\n");
+    else
+      fail ("gss_wrap_size_limit(no context) failed (%d,%d)\n",
+	    maj_stat, min_stat);
+  }
+
+  {
+    gss_ctx_id_t ctx = GSS_C_NO_CONTEXT;
+
+    maj_stat = gss_export_sec_context (&min_stat, &ctx, &bufdesc);
+    if (maj_stat == GSS_S_NO_CONTEXT)
+      success ("gss_export_sec_context(no context) OK\n");
+    else
+      fail ("gss_export_sec_context(no context) failed (%d,%d)\n",
+	    maj_stat, min_stat);
+
+    bufdesc.value = (char *) "foo";
+    bufdesc.length = 3;
+    maj_stat = gss_import_sec_context (&min_stat, &bufdesc, &ctx);
+    if (maj_stat == GSS_S_DEFECTIVE_TOKEN && ctx == GSS_C_NO_CONTEXT)
+      success ("gss_import_sec_context(bad token) OK\n");
+    else
+      fail ("gss_import_sec_context(bad token) failed (%d,%d)\n",
+	    maj_stat, min_stat);
+
+    maj_stat = gss_encapsulate_token (&bufdesc, GSS_C_NT_USER_NAME,
+				      &bufdesc2);
+    if (maj_stat != GSS_S_COMPLETE)
+      fail ("gss_encapsulate_token() failed (%d)\n", maj_stat);
+
+    maj_stat = gss_import_sec_context (&min_stat, &bufdesc2, &ctx);
+    if (maj_stat == GSS_S_BAD_MECH && ctx == GSS_C_NO_CONTEXT)
+      success ("gss_import_sec_context(bad mech) OK\n");
+    else
+      fail ("gss_import_sec_context(bad mech) failed (%d,%d)\n",
+	    maj_stat, min_stat);
+
+    gss_release_buffer (&min_stat, &bufdesc2);
+  }
+
+  {
+    gss_ctx_id_t ctx = GSS_C_NO_CONTEXT;
+
+    bufdesc.value = (char *) "foo";
+    bufdesc.length = 3;
+    maj_stat = gss_accept_sec_context (&min_stat, &ctx, GSS_C_NO_CREDENTIAL,
+				       &bufdesc, GSS_C_NO_CHANNEL_BINDINGS,
+				       NULL, NULL, &bufdesc2, NULL, NULL,
+				       NULL);
+    if (maj_stat == GSS_S_DEFECTIVE_TOKEN && ctx == GSS_C_NO_CONTEXT)
+      success ("gss_accept_sec_context(bad token) OK\n");
+    else
+      fail ("gss_accept_sec_context(bad token) failed (%d,%d)\n",
+	    maj_stat, min_stat);
+
+    maj_stat = gss_encapsulate_token (&bufdesc, GSS_C_NT_USER_NAME,
+				      &bufdesc2);
+    if (maj_stat != GSS_S_COMPLETE)
+      fail ("gss_encapsulate_token() failed (%d)\n", maj_stat);
+
+    maj_stat = gss_accept_sec_context (&min_stat, &ctx, GSS_C_NO_CREDENTIAL,
+				       &bufdesc2, GSS_C_NO_CHANNEL_BINDINGS,
+				       NULL, NULL, &bufdesc, NULL, NULL,
+				       NULL);
+    if (maj_stat == GSS_S_BAD_MECH && ctx == GSS_C_NO_CONTEXT)
+      success ("gss_accept_sec_context(bad mech) OK\n");
+    else
+      fail ("gss_accept_sec_context(bad mech) failed (%d,%d)\n",
+	    maj_stat, min_stat);
+
+    gss_release_buffer (&min_stat, &bufdesc2);
+  }
+
+  {
+    int fd = 0;
+
+    maj_stat = gss_init_sec_context_fd (&min_stat, GSS_C_NO_CONTEXT, &fd);
+    if (maj_stat == GSS_S_NO_CONTEXT && fd == -1)
+      success ("gss_init_sec_context_fd(no context) OK\n");
+    else
+      fail ("gss_init_sec_context_fd(no context) failed (%d,%d)\n",
+	    maj_stat, min_stat);
+
+    msgctx = 0;
+    maj_stat = gss_display_status (&min_stat, GSS_S_WOULD_BLOCK,
+				   GSS_C_GSS_CODE, GSS_C_NO_OID, &msgctx,
+				   &bufdesc);
+    if (maj_stat == GSS_S_COMPLETE && msgctx == 0)
+      {
+	success ("gss_display_status(GSS_S_WOULD_BLOCK) OK: %.*s\n",
+		 (int) bufdesc.length, (char *) bufdesc.value);
+	gss_release_buffer (&min_stat, &bufdesc);
+      }
+    else
+      fail ("gss_display_status(GSS_S_WOULD_BLOCK) failed (%d,%d)\n",
+	    maj_stat, min_stat);
+  }
+
+  {
+    gss_stats_t before = GSS_C_NO_STATS, after = GSS_C_NO_STATS;
+    unsigned long long total;
+    size_t i, j;
+
+    maj_stat = gss_stats_snapshot (&min_stat, &before);
+    if (maj_stat != GSS_S_COMPLETE)
+      fail ("gss_stats_snapshot() failed (%d,%d)\n", maj_stat, min_stat);
+
+    bufdesc.value = (char *) "foo";
+    bufdesc.length = 3;
+    gss_wrap (&min_stat, GSS_C_NO_CONTEXT, 0, 0, &bufdesc, NULL, &bufdesc2);
+
+    maj_stat = gss_stats_snapshot (&min_stat, &after);
+    if (maj_stat != GSS_S_COMPLETE)
+      fail ("gss_stats_snapshot() failed (%d,%d)\n", maj_stat, min_stat);
+
+    if (before && after)
+      {
+	for (i = 0; i < after->count; i++)
+	  if (strcmp (after->entries[i].name, "gss_wrap") == 0)
+	    break;
+
+	for (j = 0, total = 0; i < after->count && j < GSS_STATS_BUCKETS; j++)
+	  total += after->entries[i].latency[j];
+
+	if (i < after->count && before->count == after->count
+	    && after->entries[i].calls == before->entries[i].calls + 1
+	    && after->entries[i].failures == before->entries[i].failures + 1
+	    && total == after->entries[i].calls)
+	  success ("gss_stats_snapshot() OK\n");
+	else
+	  fail ("gss_stats_snapshot() did not count gss_wrap\n");
+      }
+
+    gss_release_stats (&min_stat, &before);
+    maj_stat = gss_release_stats (&min_stat, &after);
+    if (maj_stat != GSS_S_COMPLETE || after != GSS_C_NO_STATS)
+      fail ("gss_release_stats() failed (%d,%d)\n", maj_stat, min_stat);
+  }
+
   /* Encapsulate. */
   bufdesc.value = (char *) "context token";
   bufdesc.length = strlen (bufdesc.value);
@@ -397,12 +836,59 @@ main (int argc, char *argv[])
   else
     fail ("gss_release_buffer() failed (%d,%d)\n", maj_stat, min_stat);
 
+  maj_stat = gss_decapsulate_token_view (&bufdesc2, GSS_C_NT_ANONYMOUS,
+					 &bufdesc);
+  if (maj_stat == GSS_S_DEFECTIVE_TOKEN)
+    success ("gss_decapsulate_token_view(bad oid) OK\n");
+  else
+    fail ("gss_decapsulate_token_view() failed (%d)\n", maj_stat);
+
+  maj_stat = gss_decapsulate_token_view (&bufdesc2, GSS_C_NT_USER_NAME,
+					 &bufdesc);
+  if (maj_stat == GSS_S_COMPLETE
+      && bufdesc.length == strlen ("context token")
+      && (char *) bufdesc.value + bufdesc.length
+      == (char *) bufdesc2.value + bufdesc2.length
+      && memcmp (bufdesc.value, "context token", bufdesc.length) == 0)
+    success ("gss_decapsulate_token_view() OK\n");
+  else
+    fail ("gss_decapsulate_token_view() failed (%d)\n", maj_stat);
+
   maj_stat = gss_release_buffer (&min_stat, &bufdesc2);
   if (maj_stat == GSS_S_COMPLETE)
     success ("gss_release_buffer() OK\n");
   else
     fail ("gss_release_buffer() failed (%d,%d)\n", maj_stat, min_stat);
 
+  {
+    gss_iov_buffer_desc iov[2];
+
+    iov[0].type = GSS_IOV_BUFFER_TYPE_HEADER | GSS_IOV_BUFFER_FLAG_ALLOCATE;
+    iov[0].buffer.length = 0;
+    iov[0].buffer.value = NULL;
+    iov[1].type = GSS_IOV_BUFFER_TYPE_DATA;
+    iov[1].buffer.length = 3;
+    iov[1].buffer.value = (char *) "foo";
+
+    maj_stat = gss_wrap_iov (&min_stat, GSS_C_NO_CONTEXT, 0, 0, NULL, iov, 2);
+    if (maj_stat == GSS_S_NO_CONTEXT)
+      success ("gss_wrap_iov(no context) OK\n");
+    else
+      fail ("gss_wrap_iov(no context) failed (%d,%d)\n", maj_stat, min_stat);
+
+    iov[0].type |= GSS_IOV_BUFFER_FLAG_ALLOCATED;
+    iov[0].buffer.value = malloc (16);
+    iov[0].buffer.length = 16;
+    maj_stat = gss_release_iov_buffer (&min_stat, iov, 2);
+    if (maj_stat == GSS_S_COMPLETE
+	&& iov[0].buffer.value == NULL
+	&& !(iov[0].type & GSS_IOV_BUFFER_FLAG_ALLOCATED)
+	&& iov[1].buffer.length == 3)
+      success ("gss_release_iov_buffer() OK\n");
+    else
+      fail ("gss_release_iov_buffer() failed (%d,%d)\n", maj_stat, min_stat);
+  }
+
   if (debug)
     printf ("Basic self tests done with %d errors\n", error_count);
 
@@ -0,0 +1,243 @@
+/* krb5alloc.c --- Count allocations in the Kerberos V5 per-message path.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <string.h>
+
+/* Get GSS prototypes. */
+#include <gss.h>
+
+#include "utils.c"
+
+/* Steady-state gss_wrap and gss_unwrap must allocate the output
+   buffer and nothing else.  Allocations are counted by replacing
+   malloc, calloc and realloc in this program, which sees every
+   allocation made during the call, whether by the library itself or
+   by Shishi, Nettle or the C library on its behalf.  This needs
+   glibc; the test is skipped otherwise. */
+
+#if defined __GLIBC__
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static int counting;
+static size_t allocations;
+
+void *
+malloc (size_t size)
+{
+  allocations += counting;
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+  allocations += counting;
+  return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  allocations += counting;
+  return __libc_realloc (ptr, size);
+}
+
+#define MSGSIZE 1000
+
+static gss_name_t servername;
+static gss_cred_id_t server_creds;
+
+static int
+handshake (gss_ctx_id_t * cctx, gss_ctx_id_t * sctx)
+{
+  OM_uint32 maj_stat, min_stat;
+  gss_buffer_desc itok, otok;
+
+  maj_stat = gss_init_sec_context (&min_stat, GSS_C_NO_CREDENTIAL, cctx,
+				   servername, GSS_KRB5,
+				   GSS_C_REPLAY_FLAG | GSS_C_SEQUENCE_FLAG |
+				   GSS_C_CONF_FLAG | GSS_C_INTEG_FLAG,
+				   0, GSS_C_NO_CHANNEL_BINDINGS,
+				   GSS_C_NO_BUFFER, NULL, &itok, NULL, NULL);
+  if (maj_stat != GSS_S_COMPLETE)
+    {
+      fail ("gss_init_sec_context (%d, %d)\n", maj_stat, min_stat);
+      return 1;
+    }
+
+  maj_stat = gss_accept_sec_context (&min_stat, sctx, server_creds, &itok,
+				     GSS_C_NO_CHANNEL_BINDINGS, NULL, NULL,
+				     &otok, NULL, NULL, NULL);
+  gss_release_buffer (&min_stat, &itok);
+  gss_release_buffer (&min_stat, &otok);
+  if (maj_stat != GSS_S_COMPLETE)
+    {
+      fail ("gss_accept_sec_context (%d, %d)\n", maj_stat, min_stat);
+      return 1;
+    }
+
+  return 0;
+}
+
+/* Wrap and unwrap a message, and store the number of allocations
+   made during each call.  Returns non-zero on failure. */
+static int
+roundtrip (gss_ctx_id_t cctx, gss_ctx_id_t sctx, int conf_req_flag,
+	   size_t * wrapallocs, size_t * unwrapallocs)
+{
+  OM_uint32 maj_stat, min_stat;
+  gss_buffer_desc pt, ct, out;
+  char msg[MSGSIZE];
+  int conf_state;
+
+  memset (msg, 'x', sizeof (msg));
+  pt.value = msg;
+  pt.length = sizeof (msg);
+
+  allocations = 0;
+  counting = 1;
+  maj_stat = gss_wrap (&min_stat, cctx, conf_req_flag, 0, &pt,
+		       &conf_state, &ct);
+  counting = 0;
+  *wrapallocs = allocations;
+  if (maj_stat != GSS_S_COMPLETE)
+    {
+      fail ("gss_wrap (%d, %d)\n", maj_stat, min_stat);
+      return 1;
+    }
+
+  allocations = 0;
+  counting = 1;
+  maj_stat = gss_unwrap (&min_stat, sctx, &ct, &out, &conf_state, NULL);
+  counting = 0;
+  *unwrapallocs = allocations;
+  gss_release_buffer (&min_stat, &ct);
+  if (maj_stat != GSS_S_COMPLETE)
+    {
+      fail ("gss_unwrap (%d, %d)\n", maj_stat, min_stat);
+      return 1;
+    }
+
+  if (out.length != pt.length || memcmp (out.value, pt.value, pt.length))
+    fail ("gss_unwrap output mismatch\n");
+  gss_release_buffer (&min_stat, &out);
+
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gss_ctx_id_t cctx = GSS_C_NO_CONTEXT, sctx = GSS_C_NO_CONTEXT;
+  OM_uint32 maj_stat, min_stat;
+  gss_buffer_desc bufdesc;
+  size_t wrapallocs, unwrapallocs;
+  int conf, i;
+
+  do
+    if (strcmp (argv[argc - 1], "-v") == 0 ||
+	strcmp (argv[argc - 1], "--verbose") == 0)
+      debug = 1;
+    else if (strcmp (argv[argc - 1], "-b") == 0 ||
+	     strcmp (argv[argc - 1], "--break-on-error") == 0)
+      break_on_error = 1;
+    else if (strcmp (argv[argc - 1], "-h") == 0 ||
+	     strcmp (argv[argc - 1], "-?") == 0 ||
+	     strcmp (argv[argc - 1], "--help") == 0)
+      {
+	printf ("Usage: %s [-vbh?] [--verbose] [--break-on-error] [--help]\n",
+		argv[0]);
+	return 1;
+      }
+  while (argc-- > 1);
+
+  bufdesc.value = (char *) "host@latte.josefsson.org";
+  bufdesc.length = strlen (bufdesc.value);
+
+  maj_stat = gss_import_name (&min_stat, &bufdesc,
+			      GSS_C_NT_HOSTBASED_SERVICE, &servername);
+  if (GSS_ERROR (maj_stat))
+    fail ("gss_import_name (host/server)\n");
+
+  maj_stat = gss_acquire_cred (&min_stat, servername, 0,
+			       GSS_C_NULL_OID_SET, GSS_C_ACCEPT,
+			       &server_creds, NULL, NULL);
+  if (GSS_ERROR (maj_stat))
+    fail ("gss_acquire_cred\n");
+
+  if (!error_count && !handshake (&cctx, &sctx))
+    for (conf = 0; conf <= 1 && !error_count; conf++)
+      for (i = 0; i < 3; i++)
+	{
+	  if (roundtrip (cctx, sctx, conf, &wrapallocs, &unwrapallocs))
+	    break;
+
+	  /* The output buffer itself must be seen, or the replacement
+	     malloc is not in effect, as under valgrind. */
+	  if (wrapallocs == 0 || unwrapallocs == 0)
+	    {
+	      printf ("allocations are not visible, skipping\n");
+	      return 77;
+	    }
+
+	  if (wrapallocs != 1)
+	    fail ("gss_wrap conf %d made %lu allocations\n",
+		  conf, (unsigned long) wrapallocs);
+	  if (unwrapallocs != 1)
+	    fail ("gss_unwrap conf %d made %lu allocations\n",
+		  conf, (unsigned long) unwrapallocs);
+
+	  success ("conf %d: wrap %lu, unwrap %lu allocations\n", conf,
+		   (unsigned long) wrapallocs, (unsigned long) unwrapallocs);
+	}
+
+  gss_delete_sec_context (&min_stat, &cctx, GSS_C_NO_BUFFER);
+  gss_delete_sec_context (&min_stat, &sctx, GSS_C_NO_BUFFER);
+  gss_release_cred (&min_stat, &server_creds);
+  gss_release_name (&min_stat, &servername);
+
+  if (debug)
+    printf ("Kerberos 5 allocation self tests done with %d errors\n",
+	    error_count);
+
+  return error_count ? 1 : 0;
+}
+
+#else
+
+int
+main (void)
+{
+  printf ("Allocation counting needs glibc, skipping\n");
+  return 77;
+}
+
+#endif
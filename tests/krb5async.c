@@ -0,0 +1,302 @@
+/* krb5async.c --- Asynchronous Kerberos V5 context initiation.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <string.h>
+
+/* Get GSS prototypes. */
+#include <gss.h>
+
+#include "utils.c"
+
+/* A context to a server without a ticket in the cache needs a KDC
+   exchange.  The KDC is played by this program on a local UDP port,
+   so it can check that gss_init_sec_context returns while the request
+   is outstanding, and that the descriptor becomes readable only once
+   the KDC has answered.  The answer is not a valid KDC reply, so the
+   context then fails.  A second context is deleted while its request
+   is outstanding, which must not wait for the KDC. */
+
+#ifdef HAVE_PTHREAD_H
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define CONFIG_FILE "krb5async.conf"
+
+/* Seconds to wait for the library. */
+#define TIMEOUT 30
+
+/* Seconds Shishi waits for the KDC. */
+#define KDC_TIMEOUT 5
+
+static int
+readable_p (int fd, int seconds)
+{
+  struct pollfd pfd;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+  return poll (&pfd, 1, seconds * 1000) == 1 && (pfd.revents & POLLIN);
+}
+
+/* Bind a UDP socket to a free port on the loopback address, and point
+   the Shishi configuration at it.  Returns the socket, or -1. */
+static int
+stand_in_kdc (void)
+{
+  struct sockaddr_in sin;
+  socklen_t len = sizeof (sin);
+  FILE *fh;
+  int sock;
+
+  sock = socket (AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0)
+    return -1;
+
+  memset (&sin, 0, sizeof (sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  sin.sin_port = 0;
+  if (bind (sock, (struct sockaddr *) &sin, sizeof (sin)) != 0
+      || getsockname (sock, (struct sockaddr *) &sin, &len) != 0)
+    {
+      close (sock);
+      return -1;
+    }
+
+  fh = fopen (CONFIG_FILE, "w");
+  if (!fh)
+    {
+      close (sock);
+      return -1;
+    }
+  fprintf (fh, "quick-random\n");
+  fprintf (fh, "default-realm JOSEFSSON.ORG\n");
+  fprintf (fh, "realm-kdc JOSEFSSON.ORG,127.0.0.1:%d\n",
+	   ntohs (sin.sin_port));
+  fprintf (fh, "kdc-timeout %d\n", KDC_TIMEOUT);
+  fprintf (fh, "kdc-retries 1\n");
+  if (fclose (fh) != 0)
+    {
+      close (sock);
+      return -1;
+    }
+
+  return sock;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gss_ctx_id_t ctx = GSS_C_NO_CONTEXT;
+  OM_uint32 maj_stat, min_stat;
+  gss_buffer_desc bufdesc, token;
+  gss_name_t servername;
+  struct sockaddr_in from;
+  socklen_t fromlen = sizeof (from);
+  struct timeval start, end;
+  char request[4096];
+  ssize_t n;
+  int sock, fd;
+
+  do
+    if (strcmp (argv[argc - 1], "-v") == 0 ||
+	strcmp (argv[argc - 1], "--verbose") == 0)
+      debug = 1;
+    else if (strcmp (argv[argc - 1], "-b") == 0 ||
+	     strcmp (argv[argc - 1], "--break-on-error") == 0)
+      break_on_error = 1;
+    else if (strcmp (argv[argc - 1], "-h") == 0 ||
+	     strcmp (argv[argc - 1], "-?") == 0 ||
+	     strcmp (argv[argc - 1], "--help") == 0)
+      {
+	printf ("Usage: %s [-vbh?] [--verbose] [--break-on-error] [--help]\n",
+		argv[0]);
+	return 1;
+      }
+  while (argc-- > 1);
+
+  sock = stand_in_kdc ();
+  if (sock < 0)
+    {
+      printf ("Cannot set up a local KDC, skipping\n");
+      return 77;
+    }
+
+  /* Before the library reads the configuration. */
+  setenv ("SHISHI_CONFIG", CONFIG_FILE, 1);
+
+  bufdesc.value = (char *) "host@nokdc.josefsson.org";
+  bufdesc.length = strlen (bufdesc.value);
+
+  maj_stat = gss_import_name (&min_stat, &bufdesc,
+			      GSS_C_NT_HOSTBASED_SERVICE, &servername);
+  if (GSS_ERROR (maj_stat))
+    fail ("gss_import_name (%d, %d)\n", maj_stat, min_stat);
+
+  maj_stat = gss_init_sec_context (&min_stat, GSS_C_NO_CREDENTIAL, &ctx,
+				   servername, GSS_KRB5,
+				   GSS_C_ASYNC_FLAG | GSS_C_MUTUAL_FLAG,
+				   0, GSS_C_NO_CHANNEL_BINDINGS,
+				   GSS_C_NO_BUFFER, NULL, &token, NULL, NULL);
+  if (maj_stat != GSS_S_WOULD_BLOCK)
+    fail ("gss_init_sec_context did not block (%d, %d)\n",
+	  maj_stat, min_stat);
+  else if (token.length != 0)
+    fail ("gss_init_sec_context token while blocked\n");
+  else
+    success ("gss_init_sec_context would block\n");
+
+  if (error_count)
+    goto done;
+
+  maj_stat = gss_init_sec_context_fd (&min_stat, ctx, &fd);
+  if (maj_stat != GSS_S_COMPLETE || fd < 0)
+    {
+      fail ("gss_init_sec_context_fd (%d, %d)\n", maj_stat, min_stat);
+      goto done;
+    }
+
+  /* The library is now talking to the KDC. */
+  if (!readable_p (sock, TIMEOUT))
+    {
+      fail ("no request reached the KDC\n");
+      goto done;
+    }
+  n = recvfrom (sock, request, sizeof (request), 0,
+		(struct sockaddr *) &from, &fromlen);
+  if (n <= 0)
+    {
+      fail ("recvfrom\n");
+      goto done;
+    }
+  success ("KDC got %ld bytes\n", (long) n);
+
+  if (readable_p (fd, 0))
+    fail ("descriptor readable before the KDC answered\n");
+
+  maj_stat = gss_init_sec_context (&min_stat, GSS_C_NO_CREDENTIAL, &ctx,
+				   servername, GSS_KRB5,
+				   GSS_C_ASYNC_FLAG | GSS_C_MUTUAL_FLAG,
+				   0, GSS_C_NO_CHANNEL_BINDINGS,
+				   GSS_C_NO_BUFFER, NULL, &token, NULL, NULL);
+  if (maj_stat != GSS_S_WOULD_BLOCK)
+    fail ("gss_init_sec_context did not block again (%d)\n", maj_stat);
+
+  /* Answer with something that is not a KDC reply. */
+  if (sendto (sock, "\x30\x00", 2, 0, (struct sockaddr *) &from,
+	      fromlen) != 2)
+    {
+      fail ("sendto\n");
+      goto done;
+    }
+
+  if (!readable_p (fd, TIMEOUT))
+    {
+      fail ("descriptor not readable after the KDC answered\n");
+      goto done;
+    }
+
+  maj_stat = gss_init_sec_context (&min_stat, GSS_C_NO_CREDENTIAL, &ctx,
+				   servername, GSS_KRB5,
+				   GSS_C_ASYNC_FLAG | GSS_C_MUTUAL_FLAG,
+				   0, GSS_C_NO_CHANNEL_BINDINGS,
+				   GSS_C_NO_BUFFER, NULL, &token, NULL, NULL);
+  if (maj_stat != GSS_S_NO_CRED)
+    fail ("gss_init_sec_context after KDC answer (%d, %d)\n",
+	  maj_stat, min_stat);
+  else
+    success ("gss_init_sec_context resumed\n");
+
+  gss_delete_sec_context (&min_stat, &ctx, GSS_C_NO_BUFFER);
+
+  maj_stat = gss_init_sec_context (&min_stat, GSS_C_NO_CREDENTIAL, &ctx,
+				   servername, GSS_KRB5,
+				   GSS_C_ASYNC_FLAG | GSS_C_MUTUAL_FLAG,
+				   0, GSS_C_NO_CHANNEL_BINDINGS,
+				   GSS_C_NO_BUFFER, NULL, &token, NULL, NULL);
+  if (maj_stat != GSS_S_WOULD_BLOCK)
+    {
+      fail ("second gss_init_sec_context did not block (%d)\n", maj_stat);
+      goto done;
+    }
+  if (!readable_p (sock, TIMEOUT))
+    {
+      fail ("no second request reached the KDC\n");
+      goto done;
+    }
+  fromlen = sizeof (from);
+  n = recvfrom (sock, request, sizeof (request), 0,
+		(struct sockaddr *) &from, &fromlen);
+  if (n <= 0)
+    {
+      fail ("recvfrom\n");
+      goto done;
+    }
+
+  gettimeofday (&start, NULL);
+  gss_delete_sec_context (&min_stat, &ctx, GSS_C_NO_BUFFER);
+  gettimeofday (&end, NULL);
+  if (end.tv_sec - start.tv_sec >= KDC_TIMEOUT)
+    fail ("gss_delete_sec_context waited for the KDC\n");
+  else
+    success ("gss_delete_sec_context did not wait for the KDC\n");
+
+  /* Let the abandoned request finish. */
+  sendto (sock, "\x30\x00", 2, 0, (struct sockaddr *) &from, fromlen);
+
+done:
+  gss_delete_sec_context (&min_stat, &ctx, GSS_C_NO_BUFFER);
+  gss_release_name (&min_stat, &servername);
+  close (sock);
+  remove (CONFIG_FILE);
+
+  if (debug)
+    printf ("Kerberos 5 asynchronous self tests done with %d errors\n",
+	    error_count);
+
+  return error_count ? 1 : 0;
+}
+
+#else
+
+int
+main (void)
+{
+  printf ("Asynchronous initiation needs threads, skipping\n");
+  return 77;
+}
+
+#endif
@@ -0,0 +1,480 @@
+/* krb5bench.c --- Kerberos V5 GSS-API mechanism benchmarks.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+/* Get GSS prototypes. */
+#include <gss.h>
+
+/* Get Shishi prototypes. */
+#include <shishi.h>
+
+#include "utils.c"
+
+/* Number of iterations of each benchmark.  The default is small so
+   that the benchmarks double as self tests; pass a larger count on
+   the command line to get stable numbers. */
+static size_t iterations = 50;
+
+static gss_name_t servername;
+static gss_cred_id_t server_creds;
+
+static double
+now (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* Establish a client and a server context without mutual
+   authentication, that is, one round trip. */
+static int
+handshake (gss_ctx_id_t * cctx, gss_ctx_id_t * sctx)
+{
+  OM_uint32 maj_stat, min_stat;
+  gss_buffer_desc itok, otok;
+
+  maj_stat = gss_init_sec_context (&min_stat, GSS_C_NO_CREDENTIAL, cctx,
+				   servername, GSS_KRB5,
+				   GSS_C_REPLAY_FLAG | GSS_C_SEQUENCE_FLAG |
+				   GSS_C_CONF_FLAG | GSS_C_INTEG_FLAG,
+				   0, GSS_C_NO_CHANNEL_BINDINGS,
+				   GSS_C_NO_BUFFER, NULL, &itok, NULL, NULL);
+  if (maj_stat != GSS_S_COMPLETE)
+    {
+      fail ("gss_init_sec_context (%d, %d)\n", maj_stat, min_stat);
+      return 1;
+    }
+
+  maj_stat = gss_accept_sec_context (&min_stat, sctx, server_creds, &itok,
+				     GSS_C_NO_CHANNEL_BINDINGS, NULL, NULL,
+				     &otok, NULL, NULL, NULL);
+  gss_release_buffer (&min_stat, &itok);
+  gss_release_buffer (&min_stat, &otok);
+  if (maj_stat != GSS_S_COMPLETE)
+    {
+      fail ("gss_accept_sec_context (%d, %d)\n", maj_stat, min_stat);
+      return 1;
+    }
+
+  return 0;
+}
+
+static void
+teardown (gss_ctx_id_t * cctx, gss_ctx_id_t * sctx)
+{
+  OM_uint32 min_stat;
+
+  gss_delete_sec_context (&min_stat, cctx, GSS_C_NO_BUFFER);
+  gss_delete_sec_context (&min_stat, sctx, GSS_C_NO_BUFFER);
+}
+
+/* Handshakes per second.  Contexts borrow their Shishi handle from
+   the library's pool; the second run adds the shishi_init and
+   shishi_done per context that the library did before the pool
+   existed. */
+static void
+bench_handshake (void)
+{
+  gss_ctx_id_t cctx = GSS_C_NO_CONTEXT, sctx = GSS_C_NO_CONTEXT;
+  double start, pooled, unpooled;
+  Shishi *h;
+  size_t i;
+
+  start = now ();
+  for (i = 0; i < iterations; i++)
+    {
+      if (handshake (&cctx, &sctx))
+	return;
+      teardown (&cctx, &sctx);
+    }
+  pooled = now () - start;
+
+  start = now ();
+  for (i = 0; i < iterations; i++)
+    {
+      if (shishi_init (&h) != SHISHI_OK)
+	{
+	  fail ("shishi_init\n");
+	  return;
+	}
+      if (handshake (&cctx, &sctx))
+	return;
+      teardown (&cctx, &sctx);
+      shishi_done (h);
+    }
+  unpooled = now () - start;
+
+  success ("handshake: %.0f/s with handle pool, %.0f/s without\n",
+	   pooled > 0 ? iterations / pooled : 0.0,
+	   unpooled > 0 ? iterations / unpooled : 0.0);
+}
+
+#define MSGSIZE 16384
+
+/* Wrap and unwrap throughput, in MB/s, with or without
+   confidentiality. */
+static void
+bench_wrap (int conf_req_flag)
+{
+  gss_ctx_id_t cctx = GSS_C_NO_CONTEXT, sctx = GSS_C_NO_CONTEXT;
+  OM_uint32 maj_stat, min_stat;
+  gss_buffer_desc pt, ct, out;
+  double start, wrap = 0, unwrap = 0;
+  int conf_state;
+  size_t i;
+
+  if (handshake (&cctx, &sctx))
+    return;
+
+  pt.length = MSGSIZE;
+  pt.value = malloc (pt.length);
+  if (!pt.value)
+    {
+      fail ("malloc\n");
+      teardown (&cctx, &sctx);
+      return;
+    }
+  memset (pt.value, 'x', pt.length);
+
+  for (i = 0; i < iterations; i++)
+    {
+      start = now ();
+      maj_stat = gss_wrap (&min_stat, cctx, conf_req_flag, 0, &pt,
+			   &conf_state, &ct);
+      wrap += now () - start;
+      if (maj_stat != GSS_S_COMPLETE || !conf_state != !conf_req_flag)
+	{
+	  fail ("gss_wrap (%d, %d)\n", maj_stat, min_stat);
+	  break;
+	}
+
+      start = now ();
+      maj_stat = gss_unwrap (&min_stat, sctx, &ct, &out, &conf_state, NULL);
+      unwrap += now () - start;
+      gss_release_buffer (&min_stat, &ct);
+      if (maj_stat != GSS_S_COMPLETE || !conf_state != !conf_req_flag
+	  || out.length != pt.length
+	  || memcmp (out.value, pt.value, pt.length) != 0)
+	{
+	  fail ("gss_unwrap (%d, %d)\n", maj_stat, min_stat);
+	  gss_release_buffer (&min_stat, &out);
+	  break;
+	}
+      gss_release_buffer (&min_stat, &out);
+    }
+
+  if (i == iterations)
+    success ("%s: wrap %.1f MB/s, unwrap %.1f MB/s\n",
+	     conf_req_flag ? "sealed" : "integrity",
+	     wrap > 0 ? iterations * MSGSIZE / wrap / 1e6 : 0.0,
+	     unwrap > 0 ? iterations * MSGSIZE / unwrap / 1e6 : 0.0);
+
+  free (pt.value);
+  teardown (&cctx, &sctx);
+}
+
+/* Detached MIC against integrity-only wrap tokens: token bytes on
+   the wire and CPU time per message, for 1 KiB to 1 MiB messages. */
+static void
+bench_mic (void)
+{
+  gss_ctx_id_t cctx = GSS_C_NO_CONTEXT, sctx = GSS_C_NO_CONTEXT;
+  OM_uint32 maj_stat, min_stat;
+  gss_buffer_desc msg, tok, out;
+  size_t size, i, micbytes, wrapbytes;
+  clock_t start, mic, wrap;
+
+  if (handshake (&cctx, &sctx))
+    return;
+
+  for (size = 1024; size <= 1024 * 1024; size *= 4)
+    {
+      msg.length = size;
+      msg.value = malloc (size);
+      if (!msg.value)
+	{
+	  fail ("malloc\n");
+	  break;
+	}
+      memset (msg.value, 'x', size);
+
+      micbytes = wrapbytes = 0;
+
+      start = clock ();
+      for (i = 0; i < iterations; i++)
+	{
+	  maj_stat = gss_get_mic (&min_stat, cctx, 0, &msg, &tok);
+	  if (maj_stat != GSS_S_COMPLETE)
+	    {
+	      fail ("gss_get_mic (%d, %d)\n", maj_stat, min_stat);
+	      break;
+	    }
+	  micbytes = tok.length;
+	  maj_stat = gss_verify_mic (&min_stat, sctx, &msg, &tok, NULL);
+	  gss_release_buffer (&min_stat, &tok);
+	  if (maj_stat != GSS_S_COMPLETE)
+	    {
+	      fail ("gss_verify_mic (%d, %d)\n", maj_stat, min_stat);
+	      break;
+	    }
+	}
+      mic = clock () - start;
+
+      start = clock ();
+      for (i = 0; i < iterations; i++)
+	{
+	  maj_stat = gss_wrap (&min_stat, cctx, 0, 0, &msg, NULL, &tok);
+	  if (maj_stat != GSS_S_COMPLETE)
+	    {
+	      fail ("gss_wrap (%d, %d)\n", maj_stat, min_stat);
+	      break;
+	    }
+	  wrapbytes = tok.length;
+	  maj_stat = gss_unwrap (&min_stat, sctx, &tok, &out, NULL, NULL);
+	  gss_release_buffer (&min_stat, &tok);
+	  gss_release_buffer (&min_stat, &out);
+	  if (maj_stat != GSS_S_COMPLETE)
+	    {
+	      fail ("gss_unwrap (%d, %d)\n", maj_stat, min_stat);
+	      break;
+	    }
+	}
+      wrap = clock () - start;
+
+      free (msg.value);
+      if (error_count)
+	break;
+
+      success ("%7lu bytes: mic %lu bytes %.1f us, wrap %lu bytes %.1f us\n",
+	       (unsigned long) size, (unsigned long) micbytes,
+	       1e6 * mic / CLOCKS_PER_SEC / iterations,
+	       (unsigned long) wrapbytes,
+	       1e6 * wrap / CLOCKS_PER_SEC / iterations);
+    }
+
+  teardown (&cctx, &sctx);
+}
+
+/* Per-message cost of the checksum key derivation that contexts now
+   do once: a keyed checksum of a small message through
+   shishi_checksum, which derives the checksum key each time, against
+   HMAC-SHA1 with the key derived up front. */
+static void
+bench_derive (void)
+{
+  static const int32_t etypes[] = {
+    SHISHI_DES3_CBC_HMAC_SHA1_KD,
+    SHISHI_AES128_CTS_HMAC_SHA1_96,
+    SHISHI_AES256_CTS_HMAC_SHA1_96
+  };
+  /* Key usage 23, checksum key, as in RFC 3961. */
+  static const char constant[5] = { 0, 0, 0, 23, (char) 0x99 };
+  char msg[64];
+  Shishi *h;
+  Shishi_key *key, *kc;
+  double start, derive, cached;
+  char *out;
+  size_t outlen, i, j;
+  int rc;
+
+  if (shishi_init (&h) != SHISHI_OK)
+    {
+      fail ("shishi_init\n");
+      return;
+    }
+  memset (msg, 'x', sizeof (msg));
+
+  for (j = 0; j < sizeof (etypes) / sizeof (etypes[0]); j++)
+    {
+      rc = shishi_key_random (h, etypes[j], &key);
+      if (rc == SHISHI_OK)
+	rc = shishi_key_from_value (h, etypes[j], NULL, &kc);
+      if (rc == SHISHI_OK)
+	rc = shishi_dk (h, key, constant, sizeof (constant), kc);
+      if (rc != SHISHI_OK)
+	{
+	  fail ("key setup (%d)\n", rc);
+	  break;
+	}
+
+      start = now ();
+      for (i = 0; i < iterations && rc == SHISHI_OK; i++)
+	{
+	  rc = shishi_checksum (h, key, 23,
+				shishi_cipher_defaultcksumtype (etypes[j]),
+				msg, sizeof (msg), &out, &outlen);
+	  if (rc == SHISHI_OK)
+	    free (out);
+	}
+      derive = now () - start;
+
+      start = now ();
+      for (i = 0; i < iterations && rc == SHISHI_OK; i++)
+	{
+	  rc = shishi_hmac_sha1 (h, shishi_key_value (kc),
+				 shishi_key_length (kc),
+				 msg, sizeof (msg), &out);
+	  if (rc == SHISHI_OK)
+	    free (out);
+	}
+      cached = now () - start;
+
+      shishi_key_done (kc);
+      shishi_key_done (key);
+
+      if (rc != SHISHI_OK)
+	{
+	  fail ("checksum (%d)\n", rc);
+	  break;
+	}
+
+      success ("%s: checksum %.2f us deriving, %.2f us with cached key\n",
+	       shishi_cipher_name (etypes[j]),
+	       1e6 * derive / iterations, 1e6 * cached / iterations);
+    }
+
+  shishi_done (h);
+}
+
+/* Time to hand a server context to another process: export it and
+   import the token again, against establishing a new context. */
+static void
+bench_export (void)
+{
+  gss_ctx_id_t cctx = GSS_C_NO_CONTEXT, sctx = GSS_C_NO_CONTEXT;
+  OM_uint32 maj_stat, min_stat;
+  gss_buffer_desc tok;
+  double start, handover, handshakes;
+  size_t i;
+
+  if (handshake (&cctx, &sctx))
+    return;
+
+  start = now ();
+  for (i = 0; i < iterations; i++)
+    {
+      maj_stat = gss_export_sec_context (&min_stat, &sctx, &tok);
+      if (maj_stat != GSS_S_COMPLETE)
+	{
+	  fail ("gss_export_sec_context (%d, %d)\n", maj_stat, min_stat);
+	  teardown (&cctx, &sctx);
+	  return;
+	}
+
+      maj_stat = gss_import_sec_context (&min_stat, &tok, &sctx);
+      gss_release_buffer (&min_stat, &tok);
+      if (maj_stat != GSS_S_COMPLETE)
+	{
+	  fail ("gss_import_sec_context (%d, %d)\n", maj_stat, min_stat);
+	  teardown (&cctx, &sctx);
+	  return;
+	}
+    }
+  handover = now () - start;
+
+  teardown (&cctx, &sctx);
+
+  start = now ();
+  for (i = 0; i < iterations; i++)
+    {
+      if (handshake (&cctx, &sctx))
+	return;
+      teardown (&cctx, &sctx);
+    }
+  handshakes = now () - start;
+
+  success ("context handover: %.2f us export+import, %.2f us handshake\n",
+	   1e6 * handover / iterations, 1e6 * handshakes / iterations);
+}
+
+int
+main (int argc, char *argv[])
+{
+  OM_uint32 maj_stat, min_stat;
+  gss_buffer_desc bufdesc;
+
+  do
+    if (strcmp (argv[argc - 1], "-v") == 0 ||
+	strcmp (argv[argc - 1], "--verbose") == 0)
+      debug = 1;
+    else if (strcmp (argv[argc - 1], "-b") == 0 ||
+	     strcmp (argv[argc - 1], "--break-on-error") == 0)
+      break_on_error = 1;
+    else if (strcmp (argv[argc - 1], "-h") == 0 ||
+	     strcmp (argv[argc - 1], "-?") == 0 ||
+	     strcmp (argv[argc - 1], "--help") == 0)
+      {
+	printf ("Usage: %s [-vbh?] [--verbose] [--break-on-error] [--help]"
+		" [ITERATIONS]\n", argv[0]);
+	return 1;
+      }
+    else if (argc > 1 && isdigit ((unsigned char) argv[argc - 1][0]))
+      iterations = strtoul (argv[argc - 1], NULL, 10);
+  while (argc-- > 1);
+
+  bufdesc.value = (char *) "host@latte.josefsson.org";
+  bufdesc.length = strlen (bufdesc.value);
+
+  maj_stat = gss_import_name (&min_stat, &bufdesc,
+			      GSS_C_NT_HOSTBASED_SERVICE, &servername);
+  if (GSS_ERROR (maj_stat))
+    fail ("gss_import_name (host/server)\n");
+
+  maj_stat = gss_acquire_cred (&min_stat, servername, 0,
+			       GSS_C_NULL_OID_SET, GSS_C_ACCEPT,
+			       &server_creds, NULL, NULL);
+  if (GSS_ERROR (maj_stat))
+    fail ("gss_acquire_cred\n");
+
+  if (!error_count)
+    bench_handshake ();
+  if (!error_count)
+    bench_wrap (0);
+  if (!error_count)
+    bench_wrap (1);
+  if (!error_count)
+    bench_mic ();
+  if (!error_count)
+    bench_derive ();
+  if (!error_count)
+    bench_export ();
+
+  gss_release_cred (&min_stat, &server_creds);
+  gss_release_name (&min_stat, &servername);
+
+  if (debug)
+    printf ("Kerberos 5 benchmarks done with %d errors\n", error_count);
+
+  return error_count ? 1 : 0;
+}
@@ -27,6 +27,7 @@
 #include <stdarg.h>
 #include <ctype.h>
 #include <string.h>
+#include <errno.h>
 
 /* Get GSS prototypes. */
 #include <gss.h>
@@ -73,7 +74,7 @@ display_status (const char *msg, OM_uint32 maj_stat, OM_uint32 min_stat)
 int
 main (int argc, char *argv[])
 {
-  gss_uint32 maj_stat, min_stat, ret_flags, time_rec;
+  gss_uint32 maj_stat, min_stat, ret_flags, time_rec, accept_flags;
   gss_buffer_desc bufdesc, bufdesc2;
   gss_name_t servername = GSS_C_NO_NAME, name;
   gss_ctx_id_t cctx = GSS_C_NO_CONTEXT;
@@ -225,9 +226,8 @@ main (int argc, char *argv[])
 					     &bufdesc,
 					     &ret_flags, &time_rec, NULL);
 	  if (ret_flags != (GSS_C_MUTUAL_FLAG |
-			    /* XXX GSS_C_REPLAY_FLAG |
-			       GSS_C_SEQUENCE_FLAG | */
-			    GSS_C_PROT_READY_FLAG))
+			    GSS_C_REPLAY_FLAG |
+			    GSS_C_SEQUENCE_FLAG | GSS_C_PROT_READY_FLAG))
 	    fail ("loop 0 accept flag failure (%d)\n", ret_flags);
 	  break;
 
@@ -253,6 +253,10 @@ main (int argc, char *argv[])
 					     NULL,
 					     &bufdesc,
 					     &ret_flags, &time_rec, NULL);
+	  if (ret_flags != (GSS_C_REPLAY_FLAG |
+			    GSS_C_CONF_FLAG |
+			    GSS_C_SEQUENCE_FLAG | GSS_C_PROT_READY_FLAG))
+	    fail ("loop 2 accept flag failure (%d)\n", ret_flags);
 	  break;
 	default:
 	  fail ("default?!\n");
@@ -263,6 +267,7 @@ main (int argc, char *argv[])
 	  fail ("gss_accept_sec_context failure\n");
 	  display_status ("accept_sec_context", maj_stat, min_stat);
 	}
+      accept_flags = ret_flags;
 
       if (debug)
 	{
@@ -351,6 +356,377 @@ main (int argc, char *argv[])
 
 	gss_release_buffer (&min_stat, &ct);
 	gss_release_buffer (&min_stat, &pt2);
+
+	maj_stat = gss_wrap (&min_stat, cctx, 1, 0, &pt, &conf_state, &ct);
+	if (GSS_ERROR (maj_stat) || !conf_state)
+	  {
+	    fail ("client gss_wrap conf failure\n");
+	    display_status ("client wrap conf", maj_stat, min_stat);
+	  }
+
+	maj_stat = gss_unwrap (&min_stat, sctx,
+			       &ct, &pt2, &conf_state, &qop_state);
+	if (GSS_ERROR (maj_stat) || !conf_state)
+	  {
+	    fail ("server gss_unwrap conf failure\n");
+	    display_status ("server unwrap conf", maj_stat, min_stat);
+	  }
+
+	if (pt.length != pt2.length
+	    || memcmp (pt2.value, pt.value, pt.length) != 0)
+	  fail ("wrap+unwrap conf failed (%d, %d, %.*s)\n",
+		(int) pt.length, (int) pt2.length, (int) pt2.length,
+		(char *) pt2.value);
+
+	gss_release_buffer (&min_stat, &ct);
+	gss_release_buffer (&min_stat, &pt2);
+      }
+
+      {
+	gss_buffer_desc msg, mic;
+
+	msg.value = (char *) "foo";
+	msg.length = strlen (msg.value);
+
+	maj_stat = gss_get_mic (&min_stat, cctx, 0, &msg, &mic);
+	if (GSS_ERROR (maj_stat))
+	  {
+	    fail ("client gss_get_mic failure\n");
+	    display_status ("client get_mic", maj_stat, min_stat);
+	  }
+
+	maj_stat = gss_verify_mic (&min_stat, sctx, &msg, &mic, NULL);
+	if (GSS_ERROR (maj_stat))
+	  {
+	    fail ("server gss_verify_mic failure\n");
+	    display_status ("server verify_mic", maj_stat, min_stat);
+	  }
+
+	gss_release_buffer (&min_stat, &mic);
+
+	maj_stat = gss_get_mic (&min_stat, sctx, 0, &msg, &mic);
+	if (GSS_ERROR (maj_stat))
+	  {
+	    fail ("server gss_get_mic failure\n");
+	    display_status ("server get_mic", maj_stat, min_stat);
+	  }
+
+	msg.value = (char *) "bar";
+	maj_stat = gss_verify_mic (&min_stat, cctx, &msg, &mic, NULL);
+	if (maj_stat != GSS_S_BAD_MIC)
+	  fail ("client gss_verify_mic accepted bad message (%d)\n",
+		maj_stat);
+
+	gss_release_buffer (&min_stat, &mic);
+      }
+
+      {
+	/* Tokens of both formats, only one of which matches the
+	   session key, must be rejected without touching keys that
+	   were never derived. */
+	static const char *prefixes[] = { "\x04\x04", "\x05\x04",
+	  "\x01\x01", "\x02\x01"
+	};
+	gss_buffer_desc msg, tok, out;
+	char forged[64];
+	size_t j;
+
+	msg.value = (char *) "foo";
+	msg.length = strlen (msg.value);
+
+	for (j = 0; j < sizeof (prefixes) / sizeof (prefixes[0]); j++)
+	  {
+	    memset (forged, 0, sizeof (forged));
+	    memcpy (forged, prefixes[j], 2);
+	    tok.value = forged;
+	    tok.length = sizeof (forged);
+
+	    maj_stat = gss_verify_mic (&min_stat, sctx, &msg, &tok, NULL);
+	    if (!GSS_ERROR (maj_stat))
+	      fail ("gss_verify_mic accepted forged token %lu\n",
+		    (unsigned long) j);
+
+	    maj_stat = gss_unwrap (&min_stat, sctx, &tok, &out, NULL, NULL);
+	    if (!GSS_ERROR (maj_stat))
+	      fail ("gss_unwrap accepted forged token %lu\n",
+		    (unsigned long) j);
+	  }
+      }
+
+      {
+	gss_iov_buffer_desc iov[4];
+	char data[] = "foo";
+
+	iov[0].type = GSS_IOV_BUFFER_TYPE_HEADER | GSS_IOV_BUFFER_FLAG_ALLOCATE;
+	iov[1].type = GSS_IOV_BUFFER_TYPE_DATA;
+	iov[1].buffer.value = data;
+	iov[1].buffer.length = sizeof (data);
+	iov[2].type = GSS_IOV_BUFFER_TYPE_PADDING | GSS_IOV_BUFFER_FLAG_ALLOCATE;
+	iov[3].type = GSS_IOV_BUFFER_TYPE_TRAILER | GSS_IOV_BUFFER_FLAG_ALLOCATE;
+
+	maj_stat = gss_wrap_iov (&min_stat, cctx, 1, 0, NULL, iov, 4);
+	if (GSS_ERROR (maj_stat))
+	  {
+	    fail ("client gss_wrap_iov failure\n");
+	    display_status ("client wrap_iov", maj_stat, min_stat);
+	  }
+
+	maj_stat = gss_unwrap_iov (&min_stat, sctx, NULL, NULL, iov, 4);
+	if (GSS_ERROR (maj_stat))
+	  {
+	    fail ("server gss_unwrap_iov failure\n");
+	    display_status ("server unwrap_iov", maj_stat, min_stat);
+	  }
+
+	if (memcmp (data, "foo", sizeof (data)) != 0)
+	  fail ("wrap_iov+unwrap_iov failed (%.*s)\n",
+		(int) sizeof (data), data);
+
+	gss_release_iov_buffer (&min_stat, iov, 4);
+      }
+
+      {
+	/* The message in pieces, with the trailer rotated into the
+	   header, and then unwrapped from a single stream. */
+	gss_iov_buffer_desc iov[4];
+	char data[] = "the quick brown fox jumps over the lazy dog";
+	char stream[256];
+	size_t i, len;
+
+	iov[0].type = GSS_IOV_BUFFER_TYPE_HEADER | GSS_IOV_BUFFER_FLAG_ALLOCATE;
+	iov[1].type = GSS_IOV_BUFFER_TYPE_DATA;
+	iov[1].buffer.value = data;
+	iov[1].buffer.length = 7;
+	iov[2].type = GSS_IOV_BUFFER_TYPE_DATA;
+	iov[2].buffer.value = data + 7;
+	iov[2].buffer.length = sizeof (data) - 7;
+	iov[3].type = GSS_IOV_BUFFER_TYPE_PADDING | GSS_IOV_BUFFER_FLAG_ALLOCATE;
+
+	maj_stat = gss_wrap_iov (&min_stat, cctx, 1, 0, NULL, iov, 4);
+	if (GSS_ERROR (maj_stat))
+	  {
+	    fail ("client gss_wrap_iov pieces failure\n");
+	    display_status ("client wrap_iov", maj_stat, min_stat);
+	  }
+
+	for (i = 0, len = 0; i < 4; i++)
+	  if (len + iov[i].buffer.length <= sizeof (stream))
+	    {
+	      memcpy (stream + len, iov[i].buffer.value,
+		      iov[i].buffer.length);
+	      len += iov[i].buffer.length;
+	    }
+	gss_release_iov_buffer (&min_stat, iov, 4);
+
+	iov[0].type = GSS_IOV_BUFFER_TYPE_STREAM;
+	iov[0].buffer.value = stream;
+	iov[0].buffer.length = len;
+	iov[1].type = GSS_IOV_BUFFER_TYPE_DATA;
+	iov[1].buffer.value = NULL;
+	iov[1].buffer.length = 0;
+
+	maj_stat = gss_unwrap_iov (&min_stat, sctx, NULL, NULL, iov, 2);
+	if (GSS_ERROR (maj_stat))
+	  {
+	    fail ("server gss_unwrap_iov stream failure\n");
+	    display_status ("server unwrap_iov", maj_stat, min_stat);
+	  }
+	else if (iov[1].buffer.length != sizeof (data)
+		 || (char *) iov[1].buffer.value < stream
+		 || (char *) iov[1].buffer.value >= stream + len
+		 || memcmp (iov[1].buffer.value, "the quick brown fox",
+			    19) != 0)
+	  fail ("wrap_iov+unwrap_iov stream failed\n");
+      }
+
+      {
+	gss_buffer_desc pt, ct, pt2, mic;
+	char ctbuf[256], ptbuf[256], micbuf[128];
+	int conf_state;
+
+	pt.value = (char *) "foo";
+	pt.length = strlen (pt.value) + 1;
+
+	ct.value = ctbuf;
+	ct.length = 1;
+	maj_stat = gss_wrap_into (&min_stat, cctx, 1, 0, &pt, &conf_state, &ct);
+	if (maj_stat != GSS_S_FAILURE || min_stat != ERANGE
+	    || ct.length <= pt.length || ct.length > sizeof (ctbuf))
+	  fail ("client gss_wrap_into short buffer (%d, %d)\n",
+		maj_stat, min_stat);
+
+	ct.length = sizeof (ctbuf);
+	maj_stat = gss_wrap_into (&min_stat, cctx, 1, 0, &pt, &conf_state, &ct);
+	if (GSS_ERROR (maj_stat) || !conf_state || ct.value != ctbuf)
+	  {
+	    fail ("client gss_wrap_into failure\n");
+	    display_status ("client wrap_into", maj_stat, min_stat);
+	  }
+
+	pt2.value = ptbuf;
+	pt2.length = sizeof (ptbuf);
+	maj_stat = gss_unwrap_into (&min_stat, sctx, &ct, &pt2,
+				    &conf_state, NULL);
+	if (GSS_ERROR (maj_stat) || !conf_state)
+	  {
+	    fail ("server gss_unwrap_into failure\n");
+	    display_status ("server unwrap_into", maj_stat, min_stat);
+	  }
+
+	if (pt.length != pt2.length
+	    || memcmp (pt2.value, pt.value, pt.length) != 0)
+	  fail ("wrap_into+unwrap_into failed (%d, %d)\n",
+		(int) pt.length, (int) pt2.length);
+
+	mic.value = micbuf;
+	mic.length = sizeof (micbuf);
+	maj_stat = gss_get_mic_into (&min_stat, cctx, 0, &pt, &mic);
+	if (GSS_ERROR (maj_stat))
+	  {
+	    fail ("client gss_get_mic_into failure\n");
+	    display_status ("client get_mic_into", maj_stat, min_stat);
+	  }
+
+	maj_stat = gss_verify_mic (&min_stat, sctx, &pt, &mic, NULL);
+	if (GSS_ERROR (maj_stat))
+	  {
+	    fail ("server gss_verify_mic (into) failure\n");
+	    display_status ("server verify_mic", maj_stat, min_stat);
+	  }
+      }
+
+      {
+	gss_buffer_desc ctok, stok, stok2, view, pt, ct, pt2;
+	const unsigned char *q;
+	OM_uint32 t;
+	int conf_state;
+
+	/* Hand both contexts over as if to another process. */
+	maj_stat = gss_export_sec_context (&min_stat, &cctx, &ctok);
+	if (GSS_ERROR (maj_stat) || cctx != GSS_C_NO_CONTEXT)
+	  {
+	    fail ("client gss_export_sec_context failure\n");
+	    display_status ("client export", maj_stat, min_stat);
+	  }
+
+	maj_stat = gss_export_sec_context (&min_stat, &sctx, &stok);
+	if (GSS_ERROR (maj_stat) || sctx != GSS_C_NO_CONTEXT)
+	  {
+	    fail ("server gss_export_sec_context failure\n");
+	    display_status ("server export", maj_stat, min_stat);
+	  }
+
+	maj_stat = gss_import_sec_context (&min_stat, &ctok, &cctx);
+	if (GSS_ERROR (maj_stat))
+	  {
+	    fail ("client gss_import_sec_context failure\n");
+	    display_status ("client import", maj_stat, min_stat);
+	  }
+
+	/* The acceptor keeps the flags the initiator asked for. */
+	maj_stat = gss_decapsulate_token_view (&stok, GSS_KRB5, &view);
+	q = view.value;
+	if (maj_stat != GSS_S_COMPLETE || view.length < 6 || q[1] != 1
+	    || ((OM_uint32) q[2] << 24 | (OM_uint32) q[3] << 16
+		| (OM_uint32) q[4] << 8 | q[5]) != accept_flags)
+	  fail ("server export flags failure (%d)\n", accept_flags);
+
+	maj_stat = gss_import_sec_context (&min_stat, &stok, &sctx);
+	if (GSS_ERROR (maj_stat))
+	  {
+	    fail ("server gss_import_sec_context failure\n");
+	    display_status ("server import", maj_stat, min_stat);
+	  }
+
+	/* An imported acceptor context exports to the same token. */
+	maj_stat = gss_export_sec_context (&min_stat, &sctx, &stok2);
+	if (GSS_ERROR (maj_stat) || stok2.length != stok.length
+	    || memcmp (stok2.value, stok.value, stok.length) != 0)
+	  fail ("server re-export failure (%d)\n", maj_stat);
+	gss_release_buffer (&min_stat, &stok);
+	maj_stat = gss_import_sec_context (&min_stat, &stok2, &sctx);
+	if (GSS_ERROR (maj_stat))
+	  fail ("server re-import failure (%d)\n", maj_stat);
+
+	gss_release_buffer (&min_stat, &ctok);
+	gss_release_buffer (&min_stat, &stok2);
+
+	maj_stat = gss_context_time (&min_stat, sctx, &t);
+	if (GSS_ERROR (maj_stat) || t == 0 || t == GSS_C_INDEFINITE)
+	  fail ("imported gss_context_time failure (%d, %lu)\n",
+		maj_stat, (unsigned long) t);
+
+	/* The sequence numbers carry over, in both directions. */
+	pt.value = (char *) "foo";
+	pt.length = strlen (pt.value) + 1;
+	maj_stat = gss_wrap (&min_stat, cctx, 1, 0, &pt, &conf_state, &ct);
+	if (GSS_ERROR (maj_stat))
+	  fail ("imported client gss_wrap failure\n");
+	maj_stat = gss_unwrap (&min_stat, sctx, &ct, &pt2, &conf_state, NULL);
+	if (GSS_ERROR (maj_stat) || !conf_state || pt.length != pt2.length
+	    || memcmp (pt2.value, pt.value, pt.length) != 0)
+	  fail ("imported server gss_unwrap failure (%d)\n", maj_stat);
+	gss_release_buffer (&min_stat, &ct);
+	gss_release_buffer (&min_stat, &pt2);
+
+	maj_stat = gss_wrap (&min_stat, sctx, 0, 0, &pt, &conf_state, &ct);
+	if (GSS_ERROR (maj_stat))
+	  fail ("imported server gss_wrap failure\n");
+	maj_stat = gss_unwrap (&min_stat, cctx, &ct, &pt2, &conf_state, NULL);
+	if (GSS_ERROR (maj_stat) || pt.length != pt2.length
+	    || memcmp (pt2.value, pt.value, pt.length) != 0)
+	  fail ("imported client gss_unwrap failure (%d)\n", maj_stat);
+	gss_release_buffer (&min_stat, &ct);
+	gss_release_buffer (&min_stat, &pt2);
+      }
+
+      {
+	static const OM_uint32 sizes[] = { 100, 133, 1000, 65536 };
+	gss_buffer_desc pt, ct;
+	OM_uint32 max_input;
+	size_t j;
+	int conf;
+
+	/* The limit is exact: a message of the maximum size fits, and
+	   one octet more does not. */
+	for (conf = 0; conf <= 1; conf++)
+	  for (j = 0; j < sizeof (sizes) / sizeof (sizes[0]); j++)
+	    {
+	      maj_stat = gss_wrap_size_limit (&min_stat, cctx, conf, 0,
+					      sizes[j], &max_input);
+	      if (GSS_ERROR (maj_stat))
+		{
+		  fail ("client gss_wrap_size_limit failure\n");
+		  display_status ("client wrap_size_limit", maj_stat,
+				  min_stat);
+		  break;
+		}
+
+	      pt.length = max_input + 1;
+	      pt.value = calloc (1, pt.length);
+	      if (!pt.value)
+		{
+		  fail ("calloc\n");
+		  break;
+		}
+
+	      maj_stat = gss_wrap (&min_stat, cctx, conf, 0, &pt, NULL, &ct);
+	      if (GSS_ERROR (maj_stat) || ct.length <= sizes[j])
+		fail ("gss_wrap_size_limit (%d, %lu) too small: %lu\n",
+		      conf, (unsigned long) sizes[j],
+		      (unsigned long) max_input);
+	      gss_release_buffer (&min_stat, &ct);
+
+	      pt.length--;
+	      maj_stat = gss_wrap (&min_stat, cctx, conf, 0, &pt, NULL, &ct);
+	      if (GSS_ERROR (maj_stat) || ct.length > sizes[j])
+		fail ("gss_wrap_size_limit (%d, %lu) too large: %lu\n",
+		      conf, (unsigned long) sizes[j],
+		      (unsigned long) max_input);
+	      gss_release_buffer (&min_stat, &ct);
+
+	      free (pt.value);
+	    }
       }
 
       maj_stat = gss_delete_sec_context (&min_stat, &cctx, GSS_C_NO_BUFFER);
@@ -370,6 +746,74 @@ main (int argc, char *argv[])
       success ("loop %d ok\n", (int) i);
     }
 
+  /* Accept without a credential: the key is found from the ticket. */
+  {
+    gss_buffer_desc pt, ct, pt2;
+    gss_name_t client = GSS_C_NO_NAME;
+
+    maj_stat = gss_init_sec_context (&min_stat, GSS_C_NO_CREDENTIAL, &cctx,
+				     servername, GSS_KRB5,
+				     GSS_C_REPLAY_FLAG | GSS_C_SEQUENCE_FLAG,
+				     0, GSS_C_NO_CHANNEL_BINDINGS,
+				     GSS_C_NO_BUFFER, NULL, &bufdesc2,
+				     NULL, NULL);
+    if (maj_stat != GSS_S_COMPLETE)
+      {
+	fail ("gss_init_sec_context (default acceptor) failure\n");
+	display_status ("init_sec_context", maj_stat, min_stat);
+      }
+
+    maj_stat = gss_accept_sec_context (&min_stat, &sctx, GSS_C_NO_CREDENTIAL,
+				       &bufdesc2, GSS_C_NO_CHANNEL_BINDINGS,
+				       &client, NULL, &bufdesc, NULL, NULL,
+				       NULL);
+    if (maj_stat != GSS_S_COMPLETE)
+      {
+	fail ("gss_accept_sec_context (default acceptor) failure\n");
+	display_status ("accept_sec_context", maj_stat, min_stat);
+      }
+    else
+      {
+	if (client == GSS_C_NO_NAME)
+	  fail ("gss_accept_sec_context (default acceptor) no name\n");
+	gss_release_name (&min_stat, &client);
+	gss_release_buffer (&min_stat, &bufdesc);
+
+	pt.value = (char *) "foo";
+	pt.length = strlen (pt.value) + 1;
+	maj_stat = gss_wrap (&min_stat, cctx, 1, 0, &pt, NULL, &ct);
+	if (GSS_ERROR (maj_stat))
+	  fail ("default acceptor gss_wrap failure\n");
+	maj_stat = gss_unwrap (&min_stat, sctx, &ct, &pt2, NULL, NULL);
+	if (GSS_ERROR (maj_stat) || pt.length != pt2.length
+	    || memcmp (pt2.value, pt.value, pt.length) != 0)
+	  fail ("default acceptor gss_unwrap failure (%d)\n", maj_stat);
+	gss_release_buffer (&min_stat, &ct);
+	gss_release_buffer (&min_stat, &pt2);
+
+	success ("default acceptor ok\n");
+      }
+
+    /* The same AP-REQ again is a replay. */
+    {
+      gss_ctx_id_t rctx = GSS_C_NO_CONTEXT;
+
+      maj_stat = gss_accept_sec_context (&min_stat, &rctx,
+					 GSS_C_NO_CREDENTIAL, &bufdesc2,
+					 GSS_C_NO_CHANNEL_BINDINGS, NULL,
+					 NULL, &bufdesc, NULL, NULL, NULL);
+      if (maj_stat != (GSS_S_FAILURE | GSS_S_DUPLICATE_TOKEN))
+	fail ("gss_accept_sec_context replay (%d)\n", maj_stat);
+      else
+	success ("replayed AP-REQ rejected\n");
+      gss_delete_sec_context (&min_stat, &rctx, GSS_C_NO_BUFFER);
+    }
+
+    gss_release_buffer (&min_stat, &bufdesc2);
+    gss_delete_sec_context (&min_stat, &cctx, GSS_C_NO_BUFFER);
+    gss_delete_sec_context (&min_stat, &sctx, GSS_C_NO_BUFFER);
+  }
+
   /* Clean up. */
 
   maj_stat = gss_release_cred (&min_stat, &server_creds);
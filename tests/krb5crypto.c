@@ -0,0 +1,649 @@
+/* krb5crypto.c --- Check Kerberos V5 tokens against Shishi's crypto.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <string.h>
+
+/* Get GSS prototypes. */
+#include <gss.h>
+
+/* Get Shishi prototypes. */
+#include <shishi.h>
+
+#include "utils.c"
+
+/* The per-message functions do their own DES, DES3 and AES-CTS on
+   Nettle, so wrapping and unwrapping through them alone would not
+   notice a mistake made the same way in both directions.  Here the
+   tokens of a context with a known key are instead compared with
+   tokens built from the specifications with Shishi's checksum and
+   encryption functions, and tokens built that way are unwrapped.
+   MIC tokens, and Wrap tokens given the confounder, are fully
+   determined by the key, so they are compared octet by octet.  The
+   contexts are made by importing an interprocess token, see
+   gss_krb5_export_sec_context. */
+
+#define MESSAGE "Known answer test for the per-message tokens."
+
+/* Sequence numbers of the two directions. */
+#define INITSEQNR 0x01020304
+#define ACCEPTSEQNR 0x0A0B0C0D
+
+/* RFC 4121 key usages. */
+#define KG_USAGE_ACCEPTOR_SEAL 22
+#define KG_USAGE_ACCEPTOR_SIGN 23
+#define KG_USAGE_INITIATOR_SEAL 24
+#define KG_USAGE_INITIATOR_SIGN 25
+
+#define CFX_FLAG_SENT_BY_ACCEPTOR 0x01
+#define CFX_FLAG_SEALED 0x02
+
+/* Keys from the string-to-key examples of RFC 3961 and RFC 3962. */
+static const struct
+{
+  const char *name;
+  int32_t etype;
+  int32_t cksumtype;
+  const char *key;
+  size_t keylen;
+} keys[] = {
+  {"des-cbc-md5", SHISHI_DES_CBC_MD5, SHISHI_RSA_MD5_DES_GSS,
+   "\xcb\xc2\x2f\xae\x23\x52\x98\xe3", 8},
+  {"des3-cbc-sha1-kd", SHISHI_DES3_CBC_HMAC_SHA1_KD,
+   SHISHI_HMAC_SHA1_DES3_KD,
+   "\x85\x0b\xb5\x13\x58\x54\x8c\xd0\x5e\x86\x76\x8c"
+   "\x31\x3e\x3b\xfe\xf7\x51\x19\x37\xdc\xf7\x2c\x3e", 24},
+  {"aes128-cts-hmac-sha1-96", SHISHI_AES128_CTS_HMAC_SHA1_96,
+   SHISHI_HMAC_SHA1_96_AES128,
+   "\x42\x26\x3c\x6e\x89\xf4\xfc\x28\xb8\xdf\x68\xee\x09\x79\x9f\x15", 16},
+  {"aes256-cts-hmac-sha1-96", SHISHI_AES256_CTS_HMAC_SHA1_96,
+   SHISHI_HMAC_SHA1_96_AES256,
+   "\xfe\x69\x7b\x52\xbc\x0d\x3c\xe1\x44\x32\xba\x03\x6a\x92\xe6\x5b"
+   "\xbb\x52\x28\x09\x90\xa2\xfa\x27\x88\x39\x98\xd7\x2a\xf3\x01\x61", 32}
+};
+
+static Shishi *handle;
+
+static char *
+put32 (char *p, uint32_t n)
+{
+  *p++ = (n >> 24) & 0xFF;
+  *p++ = (n >> 16) & 0xFF;
+  *p++ = (n >> 8) & 0xFF;
+  *p++ = n & 0xFF;
+  return p;
+}
+
+/* Make in *CTX an established initiator context with key KEY of
+   type ETYPE. */
+static OM_uint32
+import_context (int32_t etype, const char *key, size_t keylen,
+		gss_ctx_id_t * ctx)
+{
+  const char *peer = "host/latte.josefsson.org@JOSEFSSON.ORG";
+  char buf[128], *p = buf;
+  gss_buffer_desc inner, token;
+  OM_uint32 maj_stat, min_stat;
+
+  *p++ = 1;			/* version */
+  *p++ = 0;			/* initiator */
+  p = put32 (p, GSS_C_CONF_FLAG | GSS_C_INTEG_FLAG);
+  p = put32 (p, INITSEQNR);
+  p = put32 (p, ACCEPTSEQNR);
+  p = put32 (p, 0);		/* end time */
+  p = put32 (p, 0xFFFFFFFF);
+  p = put32 (p, etype);
+  p = put32 (p, keylen);
+  memcpy (p, key, keylen);
+  p += keylen;
+  p = put32 (p, strlen (peer));
+  memcpy (p, peer, strlen (peer));
+  p += strlen (peer);
+
+  inner.value = buf;
+  inner.length = p - buf;
+  maj_stat = gss_encapsulate_token (&inner, GSS_KRB5, &token);
+  if (GSS_ERROR (maj_stat))
+    return maj_stat;
+
+  *ctx = GSS_C_NO_CONTEXT;
+  maj_stat = gss_import_sec_context (&min_stat, &token, ctx);
+  gss_release_buffer (&min_stat, &token);
+
+  return maj_stat;
+}
+
+/* Store in OUT the Shishi checksum of type CKSUMTYPE with key usage
+   USAGE over A followed by B, and return its length, or 0. */
+static size_t
+checksum (Shishi_key * key, int usage, int32_t cksumtype,
+	  const char *a, size_t alen, const char *b, size_t blen, char *out)
+{
+  char buf[256], *cksum;
+  size_t len;
+
+  memcpy (buf, a, alen);
+  memcpy (buf + alen, b, blen);
+  if (shishi_checksum (handle, key, usage, cksumtype, buf, alen + blen,
+		       &cksum, &len) != SHISHI_OK)
+    return 0;
+  memcpy (out, cksum, len);
+  free (cksum);
+
+  return len;
+}
+
+/* Encrypt or decrypt LEN octets at IN to OUT with key KEY in CBC mode
+   without confounder or checksum, using the 8 octet IV. */
+static int
+cbc (Shishi_key * key, int des3, int decryptp, const char *iv,
+     const char *in, size_t len, char *out)
+{
+  int32_t etype = des3 ? SHISHI_DES3_CBC_NONE : SHISHI_DES_CBC_NONE;
+  char *tmp;
+  size_t tmplen;
+  int rc;
+
+  if (decryptp)
+    rc = shishi_decrypt_iv_etype (handle, key, 0, etype, iv, 8, in, len,
+				  &tmp, &tmplen);
+  else
+    rc = shishi_encrypt_iv_etype (handle, key, 0, etype, iv, 8, in, len,
+				  &tmp, &tmplen);
+  if (rc != SHISHI_OK)
+    return rc;
+  if (tmplen != len)
+    rc = SHISHI_CRYPTO_ERROR;
+  else
+    memcpy (out, tmp, len);
+  free (tmp);
+
+  return rc;
+}
+
+/* Build in OUT the RFC 1964 token, MIC if WRAP is 0, with the 8
+   octet CONFOUNDER otherwise, for MSG sent by the acceptor if
+   ACCEPTOR, with sequence number SEQNR.  Returns a Shishi error
+   code. */
+static int
+token_1964 (Shishi_key * key, Shishi_key * sealkey, int des3, int wrap,
+	    int conf, int acceptor, uint32_t seqnr, const char *confounder,
+	    const char *msg, gss_buffer_t out)
+{
+  size_t msglen = strlen (msg);
+  size_t cksumlen = des3 ? 20 : 8;
+  size_t padlength = 8 - msglen % 8;
+  char tok[256], plain[128], seq[8];
+  char *data = tok + 16 + cksumlen;
+  size_t datalen = 0;
+  gss_buffer_desc inner;
+  char iv[8];
+  int rc;
+
+  memcpy (tok, wrap ? "\x02\x01" : "\x01\x01", 2);
+  memcpy (tok + 2, des3 ? "\x04\x00" : "\x00\x00", 2);
+  if (!wrap || !conf)
+    memcpy (tok + 4, "\xFF\xFF", 2);
+  else
+    memcpy (tok + 4, des3 ? "\x02\x00" : "\x00\x00", 2);
+  memcpy (tok + 6, "\xFF\xFF", 2);
+
+  if (wrap)
+    {
+      memcpy (plain, confounder, 8);
+      memcpy (plain + 8, msg, msglen);
+      memset (plain + 8 + msglen, (int) padlength, padlength);
+      datalen = 8 + msglen + padlength;
+    }
+  else
+    {
+      memcpy (plain, msg, msglen);
+      datalen = msglen;
+    }
+
+  if (checksum (key, des3 ? SHISHI_KEYUSAGE_GSS_R2 : 0,
+		des3 ? SHISHI_HMAC_SHA1_DES3_KD : SHISHI_RSA_MD5_DES_GSS,
+		tok, 8, plain, datalen, tok + 16) != cksumlen)
+    return SHISHI_CRYPTO_ERROR;
+
+  seq[0] = seqnr & 0xFF;
+  seq[1] = (seqnr >> 8) & 0xFF;
+  seq[2] = (seqnr >> 16) & 0xFF;
+  seq[3] = (seqnr >> 24) & 0xFF;
+  memset (seq + 4, acceptor ? 0xFF : 0, 4);
+  rc = cbc (key, des3, 0, tok + 16, seq, 8, tok + 8);
+  if (rc != SHISHI_OK)
+    return rc;
+
+  if (wrap && conf)
+    {
+      memset (iv, 0, sizeof (iv));
+      rc = cbc (sealkey, des3, 0, iv, plain, datalen, data);
+      if (rc != SHISHI_OK)
+	return rc;
+    }
+  else if (wrap)
+    memcpy (data, plain, datalen);
+  else
+    datalen = 0;
+
+  inner.value = tok;
+  inner.length = 16 + cksumlen + datalen;
+  if (gss_encapsulate_token (&inner, GSS_KRB5, out) != GSS_S_COMPLETE)
+    return SHISHI_MALLOC_ERROR;
+
+  return SHISHI_OK;
+}
+
+/* Write an RFC 4121 token header to HDR. */
+static void
+cfx_header (char *hdr, int wrap, int flags, size_t ec, uint32_t seqnr)
+{
+  memcpy (hdr, wrap ? "\x05\x04" : "\x04\x04", 2);
+  hdr[2] = flags;
+  memset (hdr + 3, 0xFF, 5);
+  if (wrap)
+    {
+      /* EC, and RRC zero. */
+      hdr[4] = (ec >> 8) & 0xFF;
+      hdr[5] = ec & 0xFF;
+      hdr[6] = hdr[7] = 0;
+    }
+  memset (hdr + 8, 0, 4);
+  put32 (hdr + 12, seqnr);
+}
+
+/* Build in OUT the RFC 4121 MIC token, or the Wrap token without
+   confidentiality if WRAP, for MSG sent by the acceptor if ACCEPTOR,
+   with sequence number SEQNR.  Returns a Shishi error code. */
+static int
+token_cfx (Shishi_key * key, int32_t cksumtype, int wrap, int acceptor,
+	   uint32_t seqnr, const char *msg, gss_buffer_t out)
+{
+  int usage = acceptor ? KG_USAGE_ACCEPTOR_SIGN : KG_USAGE_INITIATOR_SIGN;
+  int flags = acceptor ? CFX_FLAG_SENT_BY_ACCEPTOR : 0;
+  size_t msglen = strlen (msg);
+  char hdr[16], cksum[20];
+  size_t len;
+  char *p;
+
+  /* The checksum covers a Wrap header with EC zero. */
+  cfx_header (hdr, wrap, flags, 0, seqnr);
+  len = checksum (key, usage, cksumtype, msg, msglen, hdr, 16, cksum);
+  if (len != 12)
+    return SHISHI_CRYPTO_ERROR;
+
+  out->length = 16 + (wrap ? msglen : 0) + len;
+  out->value = p = malloc (out->length);
+  if (!p)
+    return SHISHI_MALLOC_ERROR;
+
+  cfx_header (p, wrap, flags, len, seqnr);
+  p += 16;
+  if (wrap)
+    {
+      memcpy (p, msg, msglen);
+      p += msglen;
+    }
+  memcpy (p, cksum, len);
+
+  return SHISHI_OK;
+}
+
+/* Build in OUT the sealed RFC 4121 Wrap token for MSG, sent by the
+   acceptor, with sequence number SEQNR.  The confounder is Shishi's
+   own.  Returns a Shishi error code. */
+static int
+sealed_cfx (Shishi_key * key, uint32_t seqnr, const char *msg,
+	    gss_buffer_t out)
+{
+  size_t msglen = strlen (msg);
+  char plain[128], *ct;
+  size_t ctlen;
+  int rc;
+
+  /* The plaintext is the message and a copy of the header. */
+  cfx_header (plain + msglen, 1,
+	      CFX_FLAG_SENT_BY_ACCEPTOR | CFX_FLAG_SEALED, 0, seqnr);
+  memcpy (plain, msg, msglen);
+  rc = shishi_encrypt (handle, key, KG_USAGE_ACCEPTOR_SEAL, plain,
+		       msglen + 16, &ct, &ctlen);
+  if (rc != SHISHI_OK)
+    return rc;
+
+  out->length = 16 + ctlen;
+  out->value = malloc (out->length);
+  if (!out->value)
+    {
+      free (ct);
+      return SHISHI_MALLOC_ERROR;
+    }
+  memcpy (out->value, plain + msglen, 16);
+  memcpy ((char *) out->value + 16, ct, ctlen);
+  free (ct);
+
+  return SHISHI_OK;
+}
+
+static int
+same_p (const gss_buffer_t a, const gss_buffer_t b)
+{
+  return a->length == b->length && memcmp (a->value, b->value,
+					   a->length) == 0;
+}
+
+/* Check that TOKEN, from gss_wrap with the initiator sequence number
+   SEQNR, is the RFC 1964 Wrap token for MESSAGE with the confounder
+   it carries. */
+static void
+check_wrap_1964 (Shishi_key * key, Shishi_key * sealkey, int des3,
+		 int conf, uint32_t seqnr, const gss_buffer_t token)
+{
+  size_t cksumlen = des3 ? 20 : 8;
+  gss_buffer_desc inner, expect;
+  OM_uint32 min_stat;
+  char confounder[8], iv[8];
+  char *data;
+
+  if (gss_decapsulate_token (token, GSS_KRB5, &inner) != GSS_S_COMPLETE
+      || inner.length < 16 + cksumlen + 16)
+    {
+      fail ("gss_wrap conf %d token malformed\n", conf);
+      return;
+    }
+  data = (char *) inner.value + 16 + cksumlen;
+
+  memset (iv, 0, sizeof (iv));
+  if (!conf)
+    memcpy (confounder, data, 8);
+  else if (cbc (sealkey, des3, 1, iv, data, 8, confounder) != SHISHI_OK)
+    fail ("shishi decrypt of confounder failed\n");
+
+  if (token_1964 (key, sealkey, des3, 1, conf, 0, seqnr, confounder,
+		  MESSAGE, &expect) != SHISHI_OK)
+    fail ("shishi wrap token conf %d failed\n", conf);
+  else
+    {
+      if (!same_p (token, &expect))
+	fail ("gss_wrap conf %d token differs from Shishi's\n", conf);
+      gss_release_buffer (&min_stat, &expect);
+    }
+  gss_release_buffer (&min_stat, &inner);
+}
+
+/* Check that TOKEN, from gss_wrap with confidentiality and the
+   initiator sequence number SEQNR, decrypts with Shishi to MESSAGE
+   and the header. */
+static void
+check_sealed_cfx (Shishi_key * key, uint32_t seqnr,
+		  const gss_buffer_t token)
+{
+  size_t msglen = strlen (MESSAGE);
+  char hdr[16], *plain;
+  size_t len;
+
+  cfx_header (hdr, 1, CFX_FLAG_SEALED, 0, seqnr);
+  if (token->length < 16 || memcmp (token->value, hdr, 16) != 0)
+    {
+      fail ("gss_wrap sealed token header wrong\n");
+      return;
+    }
+
+  if (shishi_decrypt (handle, key, KG_USAGE_INITIATOR_SEAL,
+		      (char *) token->value + 16, token->length - 16,
+		      &plain, &len) != SHISHI_OK)
+    {
+      fail ("gss_wrap sealed token does not decrypt with Shishi\n");
+      return;
+    }
+
+  /* Whatever Shishi leaves of the confounder, the message and the
+     header copy come last. */
+  if (len < msglen + 16
+      || memcmp (plain + len - 16 - msglen, MESSAGE, msglen) != 0
+      || memcmp (plain + len - 16, hdr, 16) != 0)
+    fail ("gss_wrap sealed token plaintext wrong\n");
+  free (plain);
+}
+
+/* Unwrap TOKEN, which must give MESSAGE with confidentiality CONF. */
+static void
+check_unwrap (gss_ctx_id_t ctx, int conf, const gss_buffer_t token)
+{
+  OM_uint32 maj_stat, min_stat;
+  gss_buffer_desc out;
+  int conf_state;
+
+  maj_stat = gss_unwrap (&min_stat, ctx, token, &out, &conf_state, NULL);
+  if (maj_stat != GSS_S_COMPLETE)
+    {
+      fail ("gss_unwrap of Shishi token conf %d (%d, %d)\n", conf,
+	    maj_stat, min_stat);
+      return;
+    }
+  if (out.length != strlen (MESSAGE)
+      || memcmp (out.value, MESSAGE, out.length) != 0 || conf_state != conf)
+    fail ("gss_unwrap of Shishi token conf %d gave wrong data\n", conf);
+  gss_release_buffer (&min_stat, &out);
+}
+
+static void
+test_key (size_t i)
+{
+  int cfx = keys[i].etype == SHISHI_AES128_CTS_HMAC_SHA1_96
+    || keys[i].etype == SHISHI_AES256_CTS_HMAC_SHA1_96;
+  int des3 = keys[i].etype == SHISHI_DES3_CBC_HMAC_SHA1_KD;
+  gss_buffer_desc msg, token, expect;
+  gss_ctx_id_t ctx;
+  OM_uint32 maj_stat, min_stat;
+  Shishi_key *key, *sealkey = NULL;
+  char sealvalue[24];
+  size_t j;
+  int rc;
+
+  if (shishi_key_from_value (handle, keys[i].etype, keys[i].key,
+			     &key) != SHISHI_OK)
+    {
+      fail ("shishi_key_from_value %s\n", keys[i].name);
+      return;
+    }
+
+  /* The RFC 1964 DES sealing key is the session key XOR F0. */
+  memcpy (sealvalue, keys[i].key, keys[i].keylen);
+  if (keys[i].etype == SHISHI_DES_CBC_MD5)
+    for (j = 0; j < keys[i].keylen; j++)
+      sealvalue[j] ^= 0xF0;
+  if (!cfx && shishi_key_from_value (handle, keys[i].etype, sealvalue,
+				     &sealkey) != SHISHI_OK)
+    {
+      fail ("shishi_key_from_value %s sealing key\n", keys[i].name);
+      shishi_key_done (key);
+      return;
+    }
+
+  maj_stat = import_context (keys[i].etype, keys[i].key, keys[i].keylen,
+			     &ctx);
+  if (maj_stat != GSS_S_COMPLETE)
+    {
+      fail ("gss_import_sec_context %s (%d)\n", keys[i].name, maj_stat);
+      shishi_key_done (key);
+      if (sealkey)
+	shishi_key_done (sealkey);
+      return;
+    }
+
+  msg.value = (char *) MESSAGE;
+  msg.length = strlen (MESSAGE);
+
+  /* Tokens sent by the context. */
+
+  maj_stat = gss_get_mic (&min_stat, ctx, 0, &msg, &token);
+  if (maj_stat != GSS_S_COMPLETE)
+    fail ("gss_get_mic %s (%d, %d)\n", keys[i].name, maj_stat, min_stat);
+  else
+    {
+      rc = cfx ? token_cfx (key, keys[i].cksumtype, 0, 0, INITSEQNR,
+			    MESSAGE, &expect)
+	: token_1964 (key, sealkey, des3, 0, 0, 0, INITSEQNR, NULL,
+		      MESSAGE, &expect);
+      if (rc != SHISHI_OK)
+	fail ("shishi MIC token %s: %s\n", keys[i].name,
+	      shishi_strerror (rc));
+      else
+	{
+	  if (!same_p (&token, &expect))
+	    fail ("gss_get_mic %s token differs from Shishi's\n",
+		  keys[i].name);
+	  gss_release_buffer (&min_stat, &expect);
+	}
+      gss_release_buffer (&min_stat, &token);
+    }
+
+  maj_stat = gss_wrap (&min_stat, ctx, 1, 0, &msg, NULL, &token);
+  if (maj_stat != GSS_S_COMPLETE)
+    fail ("gss_wrap %s (%d, %d)\n", keys[i].name, maj_stat, min_stat);
+  else
+    {
+      if (cfx)
+	check_sealed_cfx (key, INITSEQNR + 1, &token);
+      else
+	check_wrap_1964 (key, sealkey, des3, 1, INITSEQNR + 1, &token);
+      gss_release_buffer (&min_stat, &token);
+    }
+
+  maj_stat = gss_wrap (&min_stat, ctx, 0, 0, &msg, NULL, &token);
+  if (maj_stat != GSS_S_COMPLETE)
+    fail ("gss_wrap %s (%d, %d)\n", keys[i].name, maj_stat, min_stat);
+  else if (cfx)
+    {
+      rc = token_cfx (key, keys[i].cksumtype, 1, 0, INITSEQNR + 2,
+		      MESSAGE, &expect);
+      if (rc != SHISHI_OK)
+	fail ("shishi wrap token %s: %s\n", keys[i].name,
+	      shishi_strerror (rc));
+      else
+	{
+	  if (!same_p (&token, &expect))
+	    fail ("gss_wrap %s token differs from Shishi's\n", keys[i].name);
+	  gss_release_buffer (&min_stat, &expect);
+	}
+      gss_release_buffer (&min_stat, &token);
+    }
+  else
+    {
+      check_wrap_1964 (key, sealkey, des3, 0, INITSEQNR + 2, &token);
+      gss_release_buffer (&min_stat, &token);
+    }
+
+  /* Tokens from the peer. */
+
+  rc = cfx ? token_cfx (key, keys[i].cksumtype, 0, 1, ACCEPTSEQNR,
+			MESSAGE, &token)
+    : token_1964 (key, sealkey, des3, 0, 0, 1, ACCEPTSEQNR, NULL,
+		  MESSAGE, &token);
+  if (rc != SHISHI_OK)
+    fail ("shishi MIC token %s: %s\n", keys[i].name, shishi_strerror (rc));
+  else
+    {
+      maj_stat = gss_verify_mic (&min_stat, ctx, &msg, &token, NULL);
+      if (maj_stat != GSS_S_COMPLETE)
+	fail ("gss_verify_mic of Shishi token %s (%d, %d)\n",
+	      keys[i].name, maj_stat, min_stat);
+      gss_release_buffer (&min_stat, &token);
+    }
+
+  rc = cfx ? sealed_cfx (key, ACCEPTSEQNR + 1, MESSAGE, &token)
+    : token_1964 (key, sealkey, des3, 1, 1, 1, ACCEPTSEQNR + 1,
+		  "confound", MESSAGE, &token);
+  if (rc != SHISHI_OK)
+    fail ("shishi wrap token %s: %s\n", keys[i].name, shishi_strerror (rc));
+  else
+    {
+      check_unwrap (ctx, 1, &token);
+      gss_release_buffer (&min_stat, &token);
+    }
+
+  rc = cfx ? token_cfx (key, keys[i].cksumtype, 1, 1, ACCEPTSEQNR + 2,
+			MESSAGE, &token)
+    : token_1964 (key, sealkey, des3, 1, 0, 1, ACCEPTSEQNR + 2,
+		  "confound", MESSAGE, &token);
+  if (rc != SHISHI_OK)
+    fail ("shishi wrap token %s: %s\n", keys[i].name, shishi_strerror (rc));
+  else
+    {
+      check_unwrap (ctx, 0, &token);
+      gss_release_buffer (&min_stat, &token);
+    }
+
+  gss_delete_sec_context (&min_stat, &ctx, GSS_C_NO_BUFFER);
+  shishi_key_done (key);
+  if (sealkey)
+    shishi_key_done (sealkey);
+
+  success ("%s tokens match Shishi\n", keys[i].name);
+}
+
+int
+main (int argc, char *argv[])
+{
+  size_t i;
+
+  do
+    if (strcmp (argv[argc - 1], "-v") == 0 ||
+	strcmp (argv[argc - 1], "--verbose") == 0)
+      debug = 1;
+    else if (strcmp (argv[argc - 1], "-b") == 0 ||
+	     strcmp (argv[argc - 1], "--break-on-error") == 0)
+      break_on_error = 1;
+    else if (strcmp (argv[argc - 1], "-h") == 0 ||
+	     strcmp (argv[argc - 1], "-?") == 0 ||
+	     strcmp (argv[argc - 1], "--help") == 0)
+      {
+	printf ("Usage: %s [-vbh?] [--verbose] [--break-on-error] [--help]\n",
+		argv[0]);
+	return 1;
+      }
+  while (argc-- > 1);
+
+  handle = shishi ();
+  if (handle == NULL)
+    {
+      fail ("shishi () failed\n");
+      return 1;
+    }
+
+  for (i = 0; i < sizeof (keys) / sizeof (keys[0]); i++)
+    test_key (i);
+
+  shishi_done (handle);
+
+  if (debug)
+    printf ("Kerberos 5 known answer tests done with %d errors\n",
+	    error_count);
+
+  return error_count ? 1 : 0;
+}
@@ -0,0 +1,177 @@
+/* krb5keytab.c --- Acceptor key cache self tests.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <string.h>
+
+/* Get GSS prototypes. */
+#include <gss.h>
+
+#include "utils.c"
+
+#define KEYFILE "krb5keytab.key"
+#define NEWFILE "krb5keytab.new"
+
+/* Replace KEYFILE with DATA, through a rename so that the change is
+   visible even within the granularity of the file time stamps. */
+static int
+write_keys (const char *data, size_t len)
+{
+  FILE *fh;
+
+  fh = fopen (NEWFILE, "w");
+  if (!fh)
+    return 1;
+  if (fwrite (data, 1, len, fh) != len)
+    {
+      fclose (fh);
+      return 1;
+    }
+  if (fclose (fh) != 0)
+    return 1;
+
+  return rename (NEWFILE, KEYFILE) != 0;
+}
+
+static OM_uint32
+acquire (gss_name_t name)
+{
+  OM_uint32 maj_stat, min_stat;
+  gss_cred_id_t cred;
+
+  maj_stat = gss_acquire_cred (&min_stat, name, 0, GSS_C_NULL_OID_SET,
+			       GSS_C_ACCEPT, &cred, NULL, NULL);
+  if (!GSS_ERROR (maj_stat))
+    gss_release_cred (&min_stat, &cred);
+
+  return maj_stat;
+}
+
+int
+main (int argc, char *argv[])
+{
+  OM_uint32 maj_stat, min_stat;
+  gss_buffer_desc bufdesc;
+  gss_name_t servername;
+  const char *keys = getenv ("SHISHI_KEYS");
+  char data[4096], *p;
+  size_t len;
+  FILE *fh;
+
+  do
+    if (strcmp (argv[argc - 1], "-v") == 0 ||
+	strcmp (argv[argc - 1], "--verbose") == 0)
+      debug = 1;
+    else if (strcmp (argv[argc - 1], "-b") == 0 ||
+	     strcmp (argv[argc - 1], "--break-on-error") == 0)
+      break_on_error = 1;
+    else if (strcmp (argv[argc - 1], "-h") == 0 ||
+	     strcmp (argv[argc - 1], "-?") == 0 ||
+	     strcmp (argv[argc - 1], "--help") == 0)
+      {
+	printf ("Usage: %s [-vbh?] [--verbose] [--break-on-error] [--help]\n",
+		argv[0]);
+	return 1;
+      }
+  while (argc-- > 1);
+
+  /* Work on a copy of the test keys. */
+  if (!keys || !(fh = fopen (keys, "r")))
+    {
+      printf ("SHISHI_KEYS not readable, skipping\n");
+      return 77;
+    }
+  len = fread (data, 1, sizeof (data), fh);
+  fclose (fh);
+
+  if (write_keys (data, len) || setenv ("SHISHI_KEYS", KEYFILE, 1) != 0)
+    fail ("cannot write %s\n", KEYFILE);
+
+  bufdesc.value = (char *) "host@latte.josefsson.org";
+  bufdesc.length = strlen (bufdesc.value);
+
+  maj_stat = gss_import_name (&min_stat, &bufdesc,
+			      GSS_C_NT_HOSTBASED_SERVICE, &servername);
+  if (GSS_ERROR (maj_stat))
+    fail ("gss_import_name (host/server)\n");
+
+  /* The second acquisition is served from the cache. */
+  maj_stat = acquire (servername);
+  if (maj_stat == GSS_S_COMPLETE)
+    success ("gss_acquire_cred () OK\n");
+  else
+    fail ("gss_acquire_cred () failed (%d)\n", maj_stat);
+
+  maj_stat = acquire (servername);
+  if (maj_stat == GSS_S_COMPLETE)
+    success ("gss_acquire_cred (cached) OK\n");
+  else
+    fail ("gss_acquire_cred (cached) failed (%d)\n", maj_stat);
+
+  /* Rotate the key to another principal; it must be noticed. */
+  p = strstr (data, "host/latte");
+  if (!p || (size_t) (p - data) >= len)
+    fail ("no host/latte key in %s\n", keys);
+  else
+    {
+      memcpy (p, "host/other", strlen ("host/other"));
+      if (write_keys (data, len))
+	fail ("cannot write %s\n", KEYFILE);
+
+      maj_stat = acquire (servername);
+      if (maj_stat == GSS_S_NO_CRED)
+	success ("gss_acquire_cred (rotated away) OK\n");
+      else
+	fail ("gss_acquire_cred (rotated away) failed (%d)\n", maj_stat);
+
+      memcpy (p, "host/latte", strlen ("host/latte"));
+      if (write_keys (data, len))
+	fail ("cannot write %s\n", KEYFILE);
+
+      maj_stat = acquire (servername);
+      if (maj_stat == GSS_S_COMPLETE)
+	success ("gss_acquire_cred (rotated back) OK\n");
+      else
+	fail ("gss_acquire_cred (rotated back) failed (%d)\n", maj_stat);
+    }
+
+  /* A missing file has no keys. */
+  remove (KEYFILE);
+  maj_stat = acquire (servername);
+  if (maj_stat == GSS_S_NO_CRED)
+    success ("gss_acquire_cred (no file) OK\n");
+  else
+    fail ("gss_acquire_cred (no file) failed (%d)\n", maj_stat);
+
+  gss_release_name (&min_stat, &servername);
+
+  if (debug)
+    printf ("Kerberos 5 keytab self tests done with %d errors\n",
+	    error_count);
+
+  return error_count ? 1 : 0;
+}
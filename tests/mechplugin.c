@@ -0,0 +1,302 @@
+/* mechplugin.c --- Self tests of mechanisms loaded from plugins.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <string.h>
+#include <errno.h>
+
+/* Get GSS prototypes. */
+#include <gss.h>
+
+#include "utils.c"
+
+#ifdef HAVE_DLOPEN
+
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define CONFIG_FILE "mechplugin.conf"
+
+/* Where libtool leaves the plugin built from testmech.c. */
+#define MODULE ".libs/testmech.so"
+
+/* 1.3.6.1.4.1.11591.4.99 down to .95, which GNU has not assigned. */
+#define OID_PREFIX "\x2b\x06\x01\x04\x01\xda\x47\x04"
+static gss_OID_desc testmech_oid = { 9, (void *) OID_PREFIX "\x63" };
+static gss_OID_desc nosuch_oid = { 9, (void *) OID_PREFIX "\x62" };
+static gss_OID_desc malformed_oid = { 9, (void *) OID_PREFIX "\x61" };
+static gss_OID_desc duplicate_oid = { 9, (void *) OID_PREFIX "\x60" };
+static gss_OID_desc default_oid = { 9, (void *) OID_PREFIX "\x5f" };
+
+static double
+now (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* Whether the process has the plugin at PATH loaded. */
+static int
+loaded_p (const char *path)
+{
+#ifdef RTLD_NOLOAD
+  void *h = dlopen (path, RTLD_NOW | RTLD_NOLOAD);
+
+  if (h)
+    dlclose (h);
+
+  return h != NULL;
+#else
+  return -1;
+#endif
+}
+
+/* The number of live contexts, or -1. */
+static long
+contexts (void)
+{
+  OM_uint32 min_stat;
+  gss_stats_t stats;
+  long n;
+
+  if (gss_stats_snapshot (&min_stat, &stats) != GSS_S_COMPLETE)
+    return -1;
+  n = stats->contexts;
+  gss_release_stats (&min_stat, &stats);
+
+  return n;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gss_ctx_id_t ctx = GSS_C_NO_CONTEXT;
+  OM_uint32 maj_stat, min_stat;
+  gss_buffer_desc bufdesc, bufdesc2, token;
+  gss_OID_set mechs;
+  gss_OID oid;
+  char cwd[1024], path[1100];
+  double start, setup, load;
+  FILE *fh;
+  int present;
+
+  do
+    if (strcmp (argv[argc - 1], "-v") == 0 ||
+	strcmp (argv[argc - 1], "--verbose") == 0)
+      debug = 1;
+    else if (strcmp (argv[argc - 1], "-b") == 0 ||
+	     strcmp (argv[argc - 1], "--break-on-error") == 0)
+      break_on_error = 1;
+    else if (strcmp (argv[argc - 1], "-h") == 0 ||
+	     strcmp (argv[argc - 1], "-?") == 0 ||
+	     strcmp (argv[argc - 1], "--help") == 0)
+      {
+	printf ("Usage: %s [-vbh?] [--verbose] [--break-on-error] [--help]\n",
+		argv[0]);
+	return 1;
+      }
+  while (argc-- > 1);
+
+  if (!getcwd (cwd, sizeof (cwd)))
+    {
+      printf ("Cannot get the working directory, skipping\n");
+      return 77;
+    }
+  sprintf (path, "%s/" MODULE, cwd);
+  if (access (path, R_OK) != 0)
+    {
+      printf ("No shared plugin %s, skipping\n", path);
+      return 77;
+    }
+
+  fh = fopen (CONFIG_FILE, "w");
+  if (!fh)
+    {
+      printf ("Cannot write %s, skipping\n", CONFIG_FILE);
+      return 77;
+    }
+  fprintf (fh, "# Mechanism plugins for the mechplugin self-test.\n\n");
+  fprintf (fh, "1.3.6.1.4.1.11591.4.99\tGS2-TESTMECH\t%s\n", path);
+  fprintf (fh, "1.3.6.1.4.1.11591.4.98 GS2-NOSUCH %s/nosuch.so\n", cwd);
+  fprintf (fh, "1.3.6.1.4.1.11591.4.97 GS2-MALFORMED\n");
+  fprintf (fh, "1.3.6.1.4.1.11591.4.96 GS2-TESTMECH %s\n", path);
+  fprintf (fh, "default GS2-TESTMECH\n");
+  fprintf (fh, "1.3.6.1.4.1.11591.4.95 GS2-TESTMECH-DEFAULT %s\n", path);
+  fprintf (fh, "default 1.3.6.1.4.1.11591.4.95\n");
+  if (fclose (fh) != 0)
+    {
+      printf ("Cannot write %s, skipping\n", CONFIG_FILE);
+      return 77;
+    }
+
+  maj_stat = gss_set_mech_config (&min_stat, CONFIG_FILE);
+  if (maj_stat != GSS_S_COMPLETE)
+    fail ("gss_set_mech_config (%d, %d)\n", maj_stat, min_stat);
+
+  /* The first lookup reads the configuration file. */
+  start = now ();
+  maj_stat = gss_indicate_mechs (&min_stat, &mechs);
+  setup = now () - start;
+  if (maj_stat != GSS_S_COMPLETE)
+    fail ("gss_indicate_mechs (%d, %d)\n", maj_stat, min_stat);
+  else
+    {
+      if (gss_test_oid_set_member (&min_stat, &testmech_oid, mechs,
+				   &present) != GSS_S_COMPLETE || !present)
+	fail ("plugin missing from gss_indicate_mechs\n");
+      if (gss_test_oid_set_member (&min_stat, &nosuch_oid, mechs,
+				   &present) != GSS_S_COMPLETE || !present)
+	fail ("unloadable plugin missing from gss_indicate_mechs\n");
+      if (gss_test_oid_set_member (&min_stat, &malformed_oid, mechs,
+				   &present) != GSS_S_COMPLETE || present)
+	fail ("malformed line in gss_indicate_mechs\n");
+      if (gss_test_oid_set_member (&min_stat, &duplicate_oid, mechs,
+				   &present) != GSS_S_COMPLETE || present)
+	fail ("duplicate SASL name in gss_indicate_mechs\n");
+      gss_release_oid_set (&min_stat, &mechs);
+    }
+
+  maj_stat = gss_set_mech_config (&min_stat, NULL);
+  if (maj_stat != GSS_S_FAILURE || min_stat != EBUSY)
+    fail ("gss_set_mech_config after use (%d, %d)\n", maj_stat, min_stat);
+
+  bufdesc.value = (char *) "GS2-TESTMECH";
+  bufdesc.length = strlen (bufdesc.value);
+  maj_stat = gss_inquire_mech_for_saslname (&min_stat, &bufdesc, &oid);
+  if (maj_stat != GSS_S_COMPLETE || !gss_oid_equal (oid, &testmech_oid))
+    fail ("gss_inquire_mech_for_saslname (%d, %d)\n", maj_stat, min_stat);
+
+  /* Listing and naming mechanisms does not load them. */
+  if (loaded_p (path) > 0)
+    fail ("plugin loaded before use\n");
+
+  start = now ();
+  maj_stat = gss_init_sec_context (&min_stat, GSS_C_NO_CREDENTIAL, &ctx,
+				   GSS_C_NO_NAME, &testmech_oid, 0, 0,
+				   GSS_C_NO_CHANNEL_BINDINGS, GSS_C_NO_BUFFER,
+				   NULL, &token, NULL, NULL);
+  load = now () - start;
+  if (maj_stat != GSS_S_COMPLETE)
+    fail ("gss_init_sec_context (%d, %d)\n", maj_stat, min_stat);
+  else if (token.length != 8 || memcmp (token.value, "testmech", 8) != 0)
+    fail ("gss_init_sec_context token\n");
+  else
+    {
+      success ("gss_init_sec_context through plugin OK\n");
+      gss_release_buffer (&min_stat, &token);
+    }
+
+  if (loaded_p (path) == 0)
+    fail ("plugin not loaded after use\n");
+
+  if (ctx != GSS_C_NO_CONTEXT)
+    {
+      if (contexts () != 1)
+	fail ("gss_stats_snapshot contexts %ld\n", contexts ());
+
+      bufdesc.value = (char *) "foo";
+      bufdesc.length = 3;
+      maj_stat = gss_wrap (&min_stat, ctx, 0, 0, &bufdesc, NULL, &bufdesc2);
+      if (maj_stat != GSS_S_COMPLETE)
+	fail ("gss_wrap (%d, %d)\n", maj_stat, min_stat);
+      else
+	{
+	  maj_stat = gss_unwrap (&min_stat, ctx, &bufdesc2, &token,
+				 NULL, NULL);
+	  if (maj_stat != GSS_S_COMPLETE || token.length != 3
+	      || memcmp (token.value, "foo", 3) != 0)
+	    fail ("gss_unwrap (%d, %d)\n", maj_stat, min_stat);
+	  else
+	    gss_release_buffer (&min_stat, &token);
+	  gss_release_buffer (&min_stat, &bufdesc2);
+	}
+
+      maj_stat = gss_delete_sec_context (&min_stat, &ctx, GSS_C_NO_BUFFER);
+      if (maj_stat != GSS_S_COMPLETE)
+	fail ("gss_delete_sec_context (%d, %d)\n", maj_stat, min_stat);
+      else if (contexts () != 0)
+	fail ("gss_stats_snapshot contexts %ld after delete\n", contexts ());
+    }
+
+  maj_stat = gss_inquire_saslname_for_mech (&min_stat, &testmech_oid,
+					    NULL, &bufdesc, NULL);
+  if (maj_stat != GSS_S_COMPLETE || bufdesc.length != 4
+      || memcmp (bufdesc.value, "Test", 4) != 0)
+    fail ("gss_inquire_saslname_for_mech (%d, %d)\n", maj_stat, min_stat);
+  else
+    gss_release_buffer (&min_stat, &bufdesc);
+
+  /* A mechanism whose plugin is missing is not replaced by another. */
+  maj_stat = gss_init_sec_context (&min_stat, GSS_C_NO_CREDENTIAL, &ctx,
+				   GSS_C_NO_NAME, &nosuch_oid, 0, 0,
+				   GSS_C_NO_CHANNEL_BINDINGS, GSS_C_NO_BUFFER,
+				   NULL, &token, NULL, NULL);
+  if (maj_stat != GSS_S_BAD_MECH || ctx != GSS_C_NO_CONTEXT)
+    fail ("gss_init_sec_context without plugin (%d, %d)\n",
+	  maj_stat, min_stat);
+
+  /* The last "default" line wins. */
+  maj_stat = gss_init_sec_context (&min_stat, GSS_C_NO_CREDENTIAL, &ctx,
+				   GSS_C_NO_NAME, GSS_C_NO_OID, 0, 0,
+				   GSS_C_NO_CHANNEL_BINDINGS, GSS_C_NO_BUFFER,
+				   &oid, &token, NULL, NULL);
+  if (maj_stat != GSS_S_COMPLETE || !gss_oid_equal (oid, &default_oid))
+    fail ("gss_init_sec_context default mechanism (%d, %d)\n",
+	  maj_stat, min_stat);
+  else
+    {
+      success ("gss_init_sec_context default mechanism OK\n");
+      gss_release_buffer (&min_stat, &token);
+      gss_delete_sec_context (&min_stat, &ctx, GSS_C_NO_BUFFER);
+    }
+
+  success ("registry set up in %.3f ms, plugin loaded in %.3f ms\n",
+	   setup * 1000, load * 1000);
+
+  remove (CONFIG_FILE);
+
+  if (debug)
+    printf ("Mechanism plugin self tests done with %d errors\n",
+	    error_count);
+
+  return error_count ? 1 : 0;
+}
+
+#else
+
+int
+main (void)
+{
+  printf ("Mechanism plugins need dlopen, skipping\n");
+  return 77;
+}
+
+#endif
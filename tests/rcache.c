@@ -0,0 +1,349 @@
+/* rcache.c --- Self tests and benchmark of the replay cache.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+/* The replay cache is internal to the library, so it is compiled
+   into this program instead of being linked from it. */
+#include "../lib/rcache.c"
+
+#include <sys/time.h>
+
+#include "utils.c"
+
+/* Number of insertions in the benchmark.  The default is small so
+   that the benchmark doubles as a self test; pass a larger count on
+   the command line to get stable numbers. */
+static size_t iterations = 200000;
+
+#define THREADS 4
+#define RCACHE_FILE "rcache.tmp"
+
+static double
+now (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static uint64_t
+key (size_t i)
+{
+  return _gss_rcache_hash (_GSS_RCACHE_HASH_INIT, &i, sizeof (i));
+}
+
+static void
+test_basic (void)
+{
+  _gss_rcache_t rc;
+  time_t t = 1000000;
+  size_t i;
+  int res;
+
+  if (_gss_rcache_open (NULL, 1024, &rc) != 0)
+    {
+      fail ("_gss_rcache_open\n");
+      return;
+    }
+
+  if (_gss_rcache_insert (rc, key (1), t + 10, t) != _GSS_RCACHE_OK)
+    fail ("insert new\n");
+  if (_gss_rcache_insert (rc, key (1), t + 10, t) != _GSS_RCACHE_REPLAY)
+    fail ("insert replay\n");
+  if (_gss_rcache_insert (rc, key (1), t + 10, t + 10) != _GSS_RCACHE_REPLAY)
+    fail ("insert replay at expiry\n");
+  if (_gss_rcache_insert (rc, key (2), t + 10, t) != _GSS_RCACHE_OK)
+    fail ("insert other\n");
+
+  /* Once expired, the slot is reused. */
+  if (_gss_rcache_insert (rc, key (1), t + 30, t + 11) != _GSS_RCACHE_OK)
+    fail ("insert after expiry\n");
+  if (_gss_rcache_insert (rc, key (1), t + 30, t + 12) != _GSS_RCACHE_REPLAY)
+    fail ("insert replay after reuse\n");
+
+  /* A full cache refuses tokens rather than forgetting them. */
+  for (i = 3; i < 2048; i++)
+    {
+      res = _gss_rcache_insert (rc, key (i), t + 100, t + 20);
+      if (res == _GSS_RCACHE_FULL)
+	break;
+      if (res != _GSS_RCACHE_OK)
+	fail ("insert %lu: %d\n", (unsigned long) i, res);
+    }
+  if (i == 2048)
+    fail ("cache never full\n");
+  else
+    success ("cache full after %lu tokens\n", (unsigned long) i);
+
+  /* And accepts them again once entries expire. */
+  if (_gss_rcache_insert (rc, key (i), t + 200, t + 101) != _GSS_RCACHE_OK)
+    fail ("insert after full cache expired\n");
+
+  _gss_rcache_close (rc);
+}
+
+static void
+test_file (void)
+{
+  _gss_rcache_t rc;
+  time_t t = time (NULL);
+
+  remove (RCACHE_FILE);
+
+  if (_gss_rcache_open (RCACHE_FILE, 4096, &rc) != 0)
+    {
+      fail ("_gss_rcache_open (file)\n");
+      return;
+    }
+  if (_gss_rcache_insert (rc, key (1), t + 10, t) != _GSS_RCACHE_OK)
+    fail ("file insert new\n");
+  _gss_rcache_close (rc);
+
+  /* The size of an existing file is kept. */
+  if (_gss_rcache_open (RCACHE_FILE, 0, &rc) != 0)
+    {
+      fail ("_gss_rcache_open (file again)\n");
+      return;
+    }
+  if (rc->mask != 4095)
+    fail ("file size changed: %lu\n", (unsigned long) rc->mask + 1);
+  if (_gss_rcache_insert (rc, key (1), t + 10, t) != _GSS_RCACHE_REPLAY)
+    fail ("replay not remembered across open\n");
+  if (_gss_rcache_insert (rc, key (2), t + 10, t) != _GSS_RCACHE_OK)
+    fail ("file insert other\n");
+  _gss_rcache_close (rc);
+
+  remove (RCACHE_FILE);
+}
+
+/* The default cache holds the tokens of a full clock skew window at
+   the rate it is sized for. */
+static void
+test_default (void)
+{
+  _gss_rcache_t rc;
+  time_t t = 1000000, lifetime = 600;
+  size_t i, count = RCACHE_DEFAULT_RATE * (size_t) lifetime;
+
+  if (_gss_rcache_default (lifetime, &rc) != 0)
+    {
+      fail ("_gss_rcache_default\n");
+      return;
+    }
+
+  for (i = 0; i < count; i++)
+    if (_gss_rcache_insert (rc, key (i), t + i / RCACHE_DEFAULT_RATE
+			    + lifetime, t + i / RCACHE_DEFAULT_RATE)
+	!= _GSS_RCACHE_OK)
+      {
+	fail ("default cache full after %lu tokens\n", (unsigned long) i);
+	break;
+      }
+}
+
+#ifdef HAVE_PTHREAD_H
+struct worker
+{
+  pthread_t thread;
+  _gss_rcache_t rc;
+  size_t first;
+  size_t count;
+  size_t fresh;
+  size_t replays;
+};
+
+static void *
+worker (void *arg)
+{
+  struct worker *w = arg;
+  time_t t = 1000000;
+  size_t i;
+
+  for (i = w->first; i < w->first + w->count; i++)
+    switch (_gss_rcache_insert (w->rc, key (i), t + 600, t))
+      {
+      case _GSS_RCACHE_OK:
+	w->fresh++;
+	break;
+
+      case _GSS_RCACHE_REPLAY:
+	w->replays++;
+	break;
+      }
+
+  return NULL;
+}
+
+/* Run THREADS threads inserting COUNT tokens each, starting from
+   token STRIDE * thread number.  Returns the elapsed time, or a
+   negative value on failure. */
+static double
+run_threads (_gss_rcache_t rc, size_t count, size_t stride,
+	     size_t * fresh, size_t * replays)
+{
+  struct worker w[THREADS];
+  double start;
+  size_t i;
+
+  memset (w, 0, sizeof (w));
+  *fresh = *replays = 0;
+
+  start = now ();
+  for (i = 0; i < THREADS; i++)
+    {
+      w[i].rc = rc;
+      w[i].first = i * stride;
+      w[i].count = count;
+      if (pthread_create (&w[i].thread, NULL, worker, &w[i]) != 0)
+	{
+	  fail ("pthread_create\n");
+	  while (i-- > 0)
+	    pthread_join (w[i].thread, NULL);
+	  return -1;
+	}
+    }
+  for (i = 0; i < THREADS; i++)
+    {
+      pthread_join (w[i].thread, NULL);
+      *fresh += w[i].fresh;
+      *replays += w[i].replays;
+    }
+
+  return now () - start;
+}
+
+/* All threads insert the same tokens, so each must be new exactly
+   once. */
+static void
+test_threads (void)
+{
+  _gss_rcache_t rc;
+  size_t count = iterations / THREADS, fresh, replays;
+
+  if (_gss_rcache_open (NULL, 2 * count, &rc) != 0)
+    {
+      fail ("_gss_rcache_open\n");
+      return;
+    }
+
+  if (run_threads (rc, count, 0, &fresh, &replays) >= 0
+      && (fresh != count || replays != (THREADS - 1) * count))
+    fail ("threads: %lu new, %lu replays of %lu\n", (unsigned long) fresh,
+	  (unsigned long) replays, (unsigned long) count);
+
+  _gss_rcache_close (rc);
+}
+#endif
+
+/* Insertions per second into a cache that is at most half full, from
+   one thread and from several. */
+static void
+bench_insert (void)
+{
+  _gss_rcache_t rc;
+  double start, elapsed;
+  time_t t = 1000000;
+  size_t i;
+
+  if (_gss_rcache_open (NULL, 2 * iterations, &rc) != 0)
+    {
+      fail ("_gss_rcache_open\n");
+      return;
+    }
+
+  start = now ();
+  for (i = 0; i < iterations; i++)
+    if (_gss_rcache_insert (rc, key (i), t + 600, t) != _GSS_RCACHE_OK)
+      {
+	fail ("bench insert %lu\n", (unsigned long) i);
+	break;
+      }
+  elapsed = now () - start;
+
+  success ("insert: %.0f/s in one thread\n",
+	   elapsed > 0 ? iterations / elapsed : 0.0);
+
+  _gss_rcache_close (rc);
+
+#ifdef HAVE_PTHREAD_H
+  {
+    size_t count = iterations / THREADS, fresh, replays;
+
+    if (_gss_rcache_open (NULL, 2 * iterations, &rc) != 0)
+      {
+	fail ("_gss_rcache_open\n");
+	return;
+      }
+
+    elapsed = run_threads (rc, count, count, &fresh, &replays);
+    if (elapsed >= 0 && fresh != THREADS * count)
+      fail ("bench threads: %lu new of %lu\n", (unsigned long) fresh,
+	    (unsigned long) (THREADS * count));
+    else if (elapsed >= 0)
+      success ("insert: %.0f/s in %d threads\n",
+	       elapsed > 0 ? THREADS * count / elapsed : 0.0, THREADS);
+
+    _gss_rcache_close (rc);
+  }
+#endif
+}
+
+int
+main (int argc, char *argv[])
+{
+  do
+    if (strcmp (argv[argc - 1], "-v") == 0 ||
+	strcmp (argv[argc - 1], "--verbose") == 0)
+      debug = 1;
+    else if (strcmp (argv[argc - 1], "-b") == 0 ||
+	     strcmp (argv[argc - 1], "--break-on-error") == 0)
+      break_on_error = 1;
+    else if (strcmp (argv[argc - 1], "-h") == 0 ||
+	     strcmp (argv[argc - 1], "-?") == 0 ||
+	     strcmp (argv[argc - 1], "--help") == 0)
+      {
+	printf ("Usage: %s [-vbh?] [--verbose] [--break-on-error] [--help]"
+		" [ITERATIONS]\n", argv[0]);
+	return 1;
+      }
+    else if (argc > 1 && isdigit ((unsigned char) argv[argc - 1][0]))
+      iterations = strtoul (argv[argc - 1], NULL, 10);
+  while (argc-- > 1);
+
+  if (iterations < THREADS)
+    iterations = THREADS;
+
+  test_basic ();
+  test_file ();
+  test_default ();
+#ifdef HAVE_PTHREAD_H
+  test_threads ();
+#endif
+  if (!error_count)
+    bench_insert ();
+
+  if (debug)
+    printf ("Replay cache self tests done with %d errors\n", error_count);
+
+  return error_count ? 1 : 0;
+}
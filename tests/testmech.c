@@ -0,0 +1,168 @@
+/* testmech.c --- Mechanism plugin used by the mechplugin self-test.
+ * Copyright (C) 2003-2011 Simon Josefsson
+ *
+ * This file is part of the Generic Security Service (GSS).
+ *
+ * GSS is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GSS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GSS; if not, see http://www.gnu.org/licenses or write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/* Get gss_mech_plugin_desc. */
+#include <gss/plugin.h>
+
+/* A mechanism without security: the initial token is a fixed string,
+   and wrap and unwrap copy the message.  A context counts the
+   messages it wrapped. */
+
+#define TESTMECH_TOKEN "testmech"
+
+struct testmech_ctx
+{
+  size_t wrapped;
+};
+
+static OM_uint32
+copy (OM_uint32 * minor_status, const void *data, size_t len,
+      gss_buffer_t out)
+{
+  out->value = malloc (len > 0 ? len : 1);
+  if (!out->value)
+    {
+      if (minor_status)
+	*minor_status = ENOMEM;
+      return GSS_S_FAILURE;
+    }
+  memcpy (out->value, data, len);
+  out->length = len;
+
+  if (minor_status)
+    *minor_status = 0;
+  return GSS_S_COMPLETE;
+}
+
+static OM_uint32
+testmech_init_sec_context (OM_uint32 * minor_status,
+			   void *cred_data,
+			   void **context_data,
+			   const gss_name_t target_name,
+			   const gss_OID mech_type,
+			   OM_uint32 req_flags,
+			   OM_uint32 time_req,
+			   const gss_channel_bindings_t input_chan_bindings,
+			   const gss_buffer_t input_token,
+			   gss_OID * actual_mech_type,
+			   gss_buffer_t output_token,
+			   OM_uint32 * ret_flags, OM_uint32 * time_rec)
+{
+  if (*context_data == NULL)
+    {
+      *context_data = calloc (1, sizeof (struct testmech_ctx));
+      if (*context_data == NULL)
+	{
+	  if (minor_status)
+	    *minor_status = ENOMEM;
+	  return GSS_S_FAILURE;
+	}
+    }
+
+  if (ret_flags)
+    *ret_flags = 0;
+  if (time_rec)
+    *time_rec = GSS_C_INDEFINITE;
+
+  return copy (minor_status, TESTMECH_TOKEN, strlen (TESTMECH_TOKEN),
+	       output_token);
+}
+
+static OM_uint32
+testmech_delete_sec_context (OM_uint32 * minor_status,
+			     void *context_data, gss_buffer_t output_token)
+{
+  free (context_data);
+
+  if (minor_status)
+    *minor_status = 0;
+  return GSS_S_COMPLETE;
+}
+
+static OM_uint32
+testmech_wrap (OM_uint32 * minor_status,
+	       void *context_data,
+	       int conf_req_flag,
+	       gss_qop_t qop_req,
+	       const gss_buffer_t input_message_buffer,
+	       int *conf_state, gss_buffer_t output_message_buffer)
+{
+  struct testmech_ctx *ctx = context_data;
+
+  ctx->wrapped++;
+  if (conf_state)
+    *conf_state = 0;
+
+  return copy (minor_status, input_message_buffer->value,
+	       input_message_buffer->length, output_message_buffer);
+}
+
+static OM_uint32
+testmech_unwrap (OM_uint32 * minor_status,
+		 void *context_data,
+		 const gss_buffer_t input_message_buffer,
+		 gss_buffer_t output_message_buffer,
+		 int *conf_state, gss_qop_t * qop_state)
+{
+  struct testmech_ctx *ctx = context_data;
+
+  /* Only what this context wrapped, as the test uses the same one. */
+  if (ctx->wrapped == 0)
+    {
+      if (minor_status)
+	*minor_status = 0;
+      return GSS_S_DEFECTIVE_TOKEN;
+    }
+
+  if (conf_state)
+    *conf_state = 0;
+  if (qop_state)
+    *qop_state = 0;
+
+  return copy (minor_status, input_message_buffer->value,
+	       input_message_buffer->length, output_message_buffer);
+}
+
+/* The OID and SASL name come from the configuration file. */
+gss_mech_plugin_desc gss_mech_plugin = {
+  GSS_MECH_PLUGIN_VERSION,
+  "Test",
+  "Test mechanism plugin",
+  {
+   GSS_C_NO_OID},
+  testmech_init_sec_context,
+  NULL,
+  testmech_delete_sec_context,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  testmech_wrap,
+  testmech_unwrap
+};